@@ -0,0 +1,1243 @@
+#include <algorithm>
+#include <cfloat>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "MeshProc/Attributes.h"
+#include "MeshProc/Bvh.h"
+#include "MeshProc/Components.h"
+#include "MeshProc/Decimate.h"
+#include "MeshProc/Geodesic.h"
+#include "MeshProc/HalfEdge.h"
+#include "MeshProc/HalfEdgeCache.h"
+#include "MeshProc/HalfEdgeEdit.h"
+#include "MeshProc/HalfEdgeReorder.h"
+#include "MeshProc/IndexOptimize.h"
+#include "MeshProc/Laplacian.h"
+#include "MeshProc/Load.h"
+#include "MeshProc/Mesh.h"
+#include "MeshProc/Meshlet.h"
+#include "MeshProc/TopologyBuilder.h"
+#include "MeshProc/TopologyConvert.h"
+#include "MeshProc/TriEdge.h"
+#include "MeshProc/Weld.h"
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <Windows.h>
+#include <Psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+// Every heap allocation goes through these, so each measured operation can report the peak heap it added on top of
+// what was live when it started.
+namespace heap
+{
+	static constexpr size_t HEADER_SIZE = alignof(std::max_align_t);
+	static std::atomic<size_t> liveBytes{ 0 };
+	static std::atomic<size_t> peakBytes{ 0 };
+
+	static void* Allocate(size_t size)
+	{
+		char* const block = static_cast<char*>(std::malloc(size + HEADER_SIZE));
+
+		if (!block)
+			return nullptr;
+
+		*reinterpret_cast<size_t*>(block) = size;
+
+		const size_t live = liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+		size_t peak = peakBytes.load(std::memory_order_relaxed);
+
+		while (live > peak && !peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed));
+
+		return block + HEADER_SIZE;
+	}
+
+	static void Free(void* ptr)
+	{
+		if (ptr)
+		{
+			char* const block = static_cast<char*>(ptr) - HEADER_SIZE;
+
+			liveBytes.fetch_sub(*reinterpret_cast<size_t*>(block), std::memory_order_relaxed);
+			std::free(block);
+		}
+	}
+
+	static size_t ResetPeak()
+	{
+		const size_t live = liveBytes.load(std::memory_order_relaxed);
+
+		peakBytes.store(live, std::memory_order_relaxed);
+		return live;
+	}
+
+	static size_t PeakRss()
+	{
+#if defined(_WIN32)
+		PROCESS_MEMORY_COUNTERS counters;
+
+		GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+		return counters.PeakWorkingSetSize;
+#else
+		rusage usage;
+
+		getrusage(RUSAGE_SELF, &usage);
+		return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+	}
+}
+
+void* operator new(size_t size)
+{
+	void* const ptr = heap::Allocate(size);
+
+	if (!ptr)
+		throw std::bad_alloc();
+
+	return ptr;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return heap::Allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return heap::Allocate(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+	heap::Free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+	heap::Free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+	heap::Free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+	heap::Free(ptr);
+}
+
+namespace
+{
+	struct GeneratedMesh
+	{
+		std::string name;
+		std::vector<float> positions; // Packed xyz
+		std::vector<unsigned> indices;
+
+		unsigned TriCount() const { return static_cast<unsigned>(indices.size() / 3); }
+		unsigned VertCount() const { return static_cast<unsigned>(positions.size() / 3); }
+	};
+
+	namespace gen
+	{
+		static void AddQuad(std::vector<unsigned>* outIndices, unsigned a, unsigned b, unsigned c, unsigned d)
+		{
+			const unsigned quad[6] = { a, b, d, a, d, c };
+
+			outIndices->insert(outIndices->end(), quad, quad + 6);
+		}
+
+		static void GridPositions(unsigned quadsX, unsigned quadsY, std::vector<float>* outPositions)
+		{
+			outPositions->reserve(static_cast<size_t>(quadsX + 1) * (quadsY + 1) * 3);
+
+			for (unsigned y = 0; y <= quadsY; ++y)
+			{
+				for (unsigned x = 0; x <= quadsX; ++x)
+				{
+					outPositions->push_back(static_cast<float>(x));
+					outPositions->push_back(static_cast<float>(y));
+					outPositions->push_back(0.25f * std::sin(x * 0.37f) * std::cos(y * 0.23f));
+				}
+			}
+		}
+
+		static GeneratedMesh Grid(unsigned targetTris)
+		{
+			const unsigned quadsX = std::max(1u, static_cast<unsigned>(std::sqrt(targetTris / 2.0)));
+			const unsigned quadsY = std::max(1u, targetTris / (2 * quadsX));
+			GeneratedMesh mesh;
+
+			mesh.name = "grid";
+			GridPositions(quadsX, quadsY, &mesh.positions);
+
+			mesh.indices.reserve(static_cast<size_t>(quadsX) * quadsY * 6);
+			for (unsigned y = 0; y < quadsY; ++y)
+			{
+				for (unsigned x = 0; x < quadsX; ++x)
+				{
+					const unsigned a = y * (quadsX + 1) + x;
+
+					AddQuad(&mesh.indices, a, a + 1, a + quadsX + 1, a + quadsX + 2);
+				}
+			}
+
+			return mesh;
+		}
+
+		// Slices are capped so pole valence stays in the range of real meshes
+		static GeneratedMesh UVSphere(unsigned targetTris)
+		{
+			static const float PI = 3.14159265358979f;
+			const unsigned slices = std::min(128u, std::max(8u, static_cast<unsigned>(std::sqrt(targetTris / 2.0))));
+			const unsigned stacks = std::max(3u, targetTris / (2 * slices) + 1);
+			const unsigned bottomVert = 1 + (stacks - 1) * slices;
+			auto RingVert = [slices](unsigned stack, unsigned slice) { return 1 + (stack - 1) * slices + slice % slices; };
+			GeneratedMesh mesh;
+
+			mesh.name = "sphere";
+			mesh.positions.reserve((bottomVert + 1) * 3);
+			mesh.positions.insert(mesh.positions.end(), { 0.0f, 1.0f, 0.0f });
+			for (unsigned stack = 1; stack < stacks; ++stack)
+			{
+				const float theta = PI * stack / stacks;
+
+				for (unsigned slice = 0; slice < slices; ++slice)
+				{
+					const float phi = 2.0f * PI * slice / slices;
+
+					mesh.positions.insert(mesh.positions.end(), { std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi) });
+				}
+			}
+			mesh.positions.insert(mesh.positions.end(), { 0.0f, -1.0f, 0.0f });
+
+			mesh.indices.reserve(static_cast<size_t>(stacks) * slices * 6);
+			for (unsigned slice = 0; slice < slices; ++slice)
+			{
+				const unsigned tri[3] = { 0, RingVert(1, slice + 1), RingVert(1, slice) };
+
+				mesh.indices.insert(mesh.indices.end(), tri, tri + 3);
+			}
+
+			for (unsigned stack = 1; stack + 1 < stacks; ++stack)
+			{
+				for (unsigned slice = 0; slice < slices; ++slice)
+					AddQuad(&mesh.indices, RingVert(stack, slice), RingVert(stack, slice + 1), RingVert(stack + 1, slice), RingVert(stack + 1, slice + 1));
+			}
+
+			for (unsigned slice = 0; slice < slices; ++slice)
+			{
+				const unsigned tri[3] = { bottomVert, RingVert(stacks - 1, slice), RingVert(stacks - 1, slice + 1) };
+
+				mesh.indices.insert(mesh.indices.end(), tri, tri + 3);
+			}
+
+			return mesh;
+		}
+
+		// Grid split into 4x4 quad cells. Even cells lose one quad, leaving a hole. Odd cells lose two quads touching at a
+		// single corner, leaving a boundary that passes the corner vert twice.
+		static GeneratedMesh HoledGrid(unsigned targetTris)
+		{
+			const unsigned quadsX = std::max(4u, static_cast<unsigned>(std::sqrt(targetTris / 2.0)) & ~3u);
+			const unsigned quadsY = std::max(4u, (targetTris / (2 * quadsX)) & ~3u);
+			GeneratedMesh mesh;
+
+			mesh.name = "holes";
+			GridPositions(quadsX, quadsY, &mesh.positions);
+
+			mesh.indices.reserve(static_cast<size_t>(quadsX) * quadsY * 6);
+			for (unsigned y = 0; y < quadsY; ++y)
+			{
+				for (unsigned x = 0; x < quadsX; ++x)
+				{
+					const unsigned cellX = x & 3;
+					const unsigned cellY = y & 3;
+					const bool singularCell = ((x >> 2) + (y >> 2)) & 1;
+					const bool hole = singularCell ? (cellX == 1 && cellY == 1) || (cellX == 2 && cellY == 2) : cellX == 1 && cellY == 1;
+
+					if (!hole)
+					{
+						const unsigned a = y * (quadsX + 1) + x;
+
+						AddQuad(&mesh.indices, a, a + 1, a + quadsX + 1, a + quadsX + 2);
+					}
+				}
+			}
+
+			return mesh;
+		}
+	}
+
+	struct Options
+	{
+		unsigned minTris = 1000;
+		unsigned maxTris = 20000000;
+		unsigned reps = 3;
+		unsigned threadCount = 1;
+		std::string meshFilter;
+		std::string filePath;
+		std::string jsonPath;
+	};
+
+	struct Result
+	{
+		std::string op;
+		std::string mesh;
+		unsigned tris;
+		unsigned verts;
+		unsigned threads;
+		double minMs;
+		double medianMs;
+		size_t peakHeapBytes;
+		bool ok;
+	};
+
+	// Runs setup (untimed) then op once per rep. Reports best and median time and the largest heap peak above the
+	// live bytes at the start of op.
+	template<typename SetupFn, typename OpFn>
+	static Result Measure(const Options& options, const char* opName, const GeneratedMesh& mesh, unsigned threads, const SetupFn& setup, const OpFn& op)
+	{
+		std::vector<double> times;
+		Result result{ opName, mesh.name, mesh.TriCount(), mesh.VertCount(), threads, 0.0, 0.0, 0, true };
+
+		for (unsigned rep = 0; rep < options.reps; ++rep)
+		{
+			setup();
+
+			const size_t startBytes = heap::ResetPeak();
+			const auto start = std::chrono::steady_clock::now();
+
+			result.ok &= op();
+
+			const auto end = std::chrono::steady_clock::now();
+
+			times.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+			result.peakHeapBytes = std::max(result.peakHeapBytes, heap::peakBytes.load() - startBytes);
+		}
+
+		std::sort(times.begin(), times.end());
+		result.minMs = times.front();
+		result.medianMs = times[times.size() / 2];
+
+		return result;
+	}
+
+	static void PrintResult(const Result& result)
+	{
+		const double seconds = result.minMs / 1000.0;
+
+		std::printf("%-27s %-7s %9u tris %2u thr  min %10.3f ms  med %10.3f ms  %8.2f Mtri/s  %8.2f Mvert/s  heap %9.1f MB%s\n",
+			result.op.c_str(), result.mesh.c_str(), result.tris, result.threads, result.minMs, result.medianMs,
+			result.tris / seconds / 1e6, result.verts / seconds / 1e6, result.peakHeapBytes / (1024.0 * 1024.0), result.ok ? "" : "  FAILED");
+		std::fflush(stdout);
+	}
+
+	static void PrintConstructStats(const mesh::half_edge::ConstructStats& stats)
+	{
+		std::printf("  phases");
+		for (unsigned phase = 0; phase < mesh::half_edge::CONSTRUCT_PHASE_COUNT; ++phase)
+			std::printf("  %s %.3f ms", mesh::half_edge::CONSTRUCT_PHASE_NAMES[phase], stats.phaseSeconds[phase] * 1000.0);
+
+		std::printf("\n  pairing  %llu shifts  %u sorted buckets  max bucket %u  %u coarse buckets  max coarse %u\n",
+			static_cast<unsigned long long>(stats.pairShifts), stats.pairSortedBuckets, stats.pairMaxBucketEdges, stats.pairCoarseBuckets, stats.pairMaxCoarseEdges);
+		std::printf("  boundary %u loops  %u half edges  length %u to %u  split %u fans off %u verts  scratch %.1f MB\n",
+			stats.boundaryLoops, stats.boundaryHalfEdges, stats.boundaryMinLength, stats.boundaryMaxLength, stats.splitFans, stats.splitVerts, stats.peakScratchBytes / (1024.0 * 1024.0));
+		std::fflush(stdout);
+	}
+
+	static bool WriteJson(const std::string& path, const std::vector<Result>& results)
+	{
+		FILE* const file = std::fopen(path.c_str(), "w");
+
+		if (!file)
+			return false;
+
+		// Thread counts above hardwareThreads share cores, so their timings don't show scaling
+		std::fprintf(file, "{\n  \"format\": 1,\n  \"hardwareThreads\": %u,\n  \"peakRssBytes\": %zu,\n  \"results\": [\n", std::thread::hardware_concurrency(), heap::PeakRss());
+		for (size_t resultIndex = 0; resultIndex < results.size(); ++resultIndex)
+		{
+			const Result& result = results[resultIndex];
+			const double seconds = result.minMs / 1000.0;
+
+			std::fprintf(file, "    {\"op\": \"%s\", \"mesh\": \"%s\", \"tris\": %u, \"verts\": %u, \"threads\": %u, \"minMs\": %.4f, \"medianMs\": %.4f, \"trisPerSec\": %.1f, \"vertsPerSec\": %.1f, \"peakHeapBytes\": %zu, \"ok\": %s}%s\n",
+				result.op.c_str(), result.mesh.c_str(), result.tris, result.verts, result.threads, result.minMs, result.medianMs,
+				result.tris / seconds, result.verts / seconds, result.peakHeapBytes, result.ok ? "true" : "false", resultIndex + 1 < results.size() ? "," : "");
+		}
+		std::fprintf(file, "  ]\n}\n");
+		std::fclose(file);
+
+		return true;
+	}
+
+	static bool ParseOptions(int argc, char* argv[], Options* outOptions)
+	{
+		for (int argIndex = 1; argIndex < argc; ++argIndex)
+		{
+			const std::string arg = argv[argIndex];
+			const char* const value = argIndex + 1 < argc ? argv[argIndex + 1] : nullptr;
+
+			if (arg == "--help" || !value)
+			{
+				std::printf("Usage: Benchmark [--min-tris N] [--max-tris N] [--reps N] [--threads N] [--mesh grid|sphere|holes] [--file PATH] [--json PATH]\n");
+				return false;
+			}
+
+			if (arg == "--min-tris")
+				outOptions->minTris = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+			else if (arg == "--max-tris")
+				outOptions->maxTris = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+			else if (arg == "--reps")
+				outOptions->reps = std::max(1u, static_cast<unsigned>(std::strtoul(value, nullptr, 10)));
+			else if (arg == "--threads")
+				outOptions->threadCount = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+			else if (arg == "--mesh")
+				outOptions->meshFilter = value;
+			else if (arg == "--file")
+				outOptions->filePath = value;
+			else if (arg == "--json")
+				outOptions->jsonPath = value;
+			else
+			{
+				std::printf("Unknown option %s\n", arg.c_str());
+				return false;
+			}
+
+			++argIndex;
+		}
+
+		return true;
+	}
+
+	// Self checks run as ops: they report ok = false when the library breaks an invariant it promises to keep
+	namespace check
+	{
+		static inline unsigned NextRandom(uint32_t* inoutState)
+		{
+			uint32_t state = *inoutState;
+
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			*inoutState = state;
+
+			return state;
+		}
+
+		// Applies editCount edits of random kind at random live elements, compacts and validates the result. New
+		// verts get realIndex values from firstNewRealIndex up, as if their positions were appended.
+		static bool RandomEdits(mesh::half_edge::Topology* inoutMesh, unsigned editCount, unsigned firstNewRealIndex, uint32_t seed)
+		{
+			using namespace mesh::half_edge;
+			Editor editor;
+			uint32_t state = seed | 1;
+			unsigned nextRealIndex = firstNewRealIndex;
+
+			BeginEdit(inoutMesh, &editor);
+
+			for (unsigned edit = 0; edit < editCount; ++edit)
+			{
+				const unsigned kind = NextRandom(&state) % 4;
+
+				if (kind == 2)
+				{
+					const unsigned face = NextRandom(&state) % static_cast<unsigned>(inoutMesh->faceHalfEdges[FaceType::REAL].size());
+
+					if (inoutMesh->faceHalfEdges[FaceType::REAL][face] != INVALID_INDEX)
+						SplitFace(&editor, face, nextRealIndex++);
+
+					continue;
+				}
+
+				const unsigned halfEdge = NextRandom(&state) % static_cast<unsigned>(inoutMesh->halfEdgeNexts.size());
+
+				if (inoutMesh->halfEdgeNexts[halfEdge] == INVALID_INDEX)
+					continue;
+
+				if (kind == 0)
+					FlipEdge(&editor, halfEdge);
+				else if (kind == 1)
+					SplitEdge(&editor, halfEdge, nextRealIndex++);
+				else
+					CollapseEdge(&editor, halfEdge);
+			}
+
+			Compact(&editor);
+
+			return Validate(*inoutMesh);
+		}
+
+		template<typename T, typename U>
+		static bool SameArray(mesh::half_edge::ArrayView<T> view, const std::vector<U>& array)
+		{
+			static_assert(sizeof(T) == sizeof(U), "Cached arrays hold the same elements");
+
+			return view.size() == array.size() && (array.empty() || std::memcmp(view.data, array.data(), array.size() * sizeof(U)) == 0);
+		}
+
+		static bool SameTopology(const mesh::half_edge::TopologyView& view, const mesh::half_edge::Topology& mesh)
+		{
+			using namespace mesh::half_edge;
+			bool same = SameArray(view.vertHalfEdges, mesh.vertHalfEdges) && SameArray(view.verts, mesh.verts);
+
+			for (unsigned faceType = 0; faceType < FaceType::COUNT; ++faceType)
+				same &= SameArray(view.faceHalfEdges[faceType], mesh.faceHalfEdges[faceType]);
+
+			return same && SameArray(view.halfEdgeVerts, mesh.halfEdgeVerts) && SameArray(view.halfEdgeFaces, mesh.halfEdgeFaces) && SameArray(view.halfEdgeNexts, mesh.halfEdgeNexts);
+		}
+
+		template<typename T>
+		static bool SameArray(const std::vector<T>& arrayA, const std::vector<T>& arrayB)
+		{
+			return arrayA.size() == arrayB.size() && (arrayA.empty() || std::memcmp(arrayA.data(), arrayB.data(), arrayA.size() * sizeof(T)) == 0);
+		}
+
+		template<typename IdT>
+		static bool SameTopology(const mesh::half_edge::TopologyT<IdT>& meshA, const mesh::half_edge::TopologyT<IdT>& meshB)
+		{
+			using namespace mesh::half_edge;
+			bool same = SameArray(meshA.vertHalfEdges, meshB.vertHalfEdges) && SameArray(meshA.verts, meshB.verts);
+
+			for (unsigned faceType = 0; faceType < FaceType::COUNT; ++faceType)
+				same &= SameArray(meshA.faceHalfEdges[faceType], meshB.faceHalfEdges[faceType]);
+
+			return same && SameArray(meshA.halfEdgeVerts, meshB.halfEdgeVerts) && SameArray(meshA.halfEdgeFaces, meshB.halfEdgeFaces) && SameArray(meshA.halfEdgeNexts, meshB.halfEdgeNexts);
+		}
+
+		// Builds the mesh with 1 and with threadCount threads and checks every array matches. Then points one next link
+		// back at its own half edge and checks Validate reports the same failure for both thread counts at either level.
+		static bool ThreadsAgree(const unsigned* indices, unsigned triCount, unsigned threadCount)
+		{
+			using namespace mesh::half_edge;
+			ConstructOptions constructOptions;
+			Topology serial;
+			Topology parallel;
+
+			constructOptions.threadCount = threadCount;
+			if (!Construct(indices, triCount, &serial) || !Construct(indices, triCount, &parallel, constructOptions) || !SameTopology(serial, parallel))
+				return false;
+
+			const unsigned brokenHE = static_cast<unsigned>(serial.halfEdgeNexts.size() / 2);
+			bool ok = true;
+
+			serial.halfEdgeNexts[brokenHE] = brokenHE;
+			for (ValidateLevel level : { ValidateLevel::VALIDATE_STRUCTURE, ValidateLevel::VALIDATE_FULL })
+			{
+				ValidateOptions validateOptions;
+				ValidateReport serialReport;
+				ValidateReport parallelReport;
+
+				validateOptions.level = level;
+				ok &= !Validate(serial, &serialReport, validateOptions);
+
+				validateOptions.threadCount = threadCount;
+				ok &= !Validate(serial, &parallelReport, validateOptions);
+				ok &= serialReport.error == parallelReport.error && serialReport.element == parallelReport.element;
+			}
+
+			return ok;
+		}
+
+		// Writes, opens and loads a cache of mesh at path and checks it matches. Then checks a stale source hash and a
+		// flipped byte in the last array are both rejected. Removes the file afterwards.
+		static bool CacheRoundTrip(const char* path, const mesh::half_edge::Topology& mesh, const unsigned* indices, unsigned triCount)
+		{
+			using namespace mesh::half_edge;
+			const uint64_t sourceHash = HashSource(indices, triCount);
+			CacheOptions verifyOptions;
+			CachedTopology cached;
+			bool ok = WriteCache(path, mesh, sourceHash);
+
+			verifyOptions.verifyChecksum = true;
+			ok &= OpenCache(path, sourceHash, &cached, verifyOptions) && SameTopology(cached.view, mesh);
+			ok &= !OpenCache(path, sourceHash + 1, &cached);
+			ok &= LoadCache(path, indices, triCount, &cached, ConstructOptions(), verifyOptions) && cached.mappedData && SameTopology(cached.view, mesh);
+			CloseCache(&cached);
+
+			if (FILE* const file = std::fopen(path, "r+b"))
+			{
+				ok &= std::fseek(file, -1, SEEK_END) == 0;
+
+				const int last = std::fgetc(file);
+
+				ok &= last != EOF && std::fseek(file, -1, SEEK_END) == 0 && std::fputc(last ^ 0x5A, file) != EOF;
+				ok &= std::fclose(file) == 0;
+			}
+			else
+				ok = false;
+
+			// The header still matches, so only the checksum catches the flipped byte
+			ok &= OpenCache(path, sourceHash, &cached);
+			ok &= !OpenCache(path, sourceHash, &cached, verifyOptions);
+			CloseCache(&cached);
+
+			return std::remove(path) == 0 && ok;
+		}
+	}
+
+	// The hash map half_edge::Construct the counting sort replaced, kept so its speedup can be measured. It runs as it did
+	// before, with what kept it from finishing fixed: arrays grown per edge rather than presized, the boundary walk
+	// advancing and giving boundary half edges their tail vert, and singular verts split the way Construct splits them,
+	// so both build the same topology.
+	namespace reference
+	{
+		using namespace mesh::half_edge;
+
+		static constexpr unsigned HE_NONE = ~0u;
+		static constexpr unsigned MAX_TRIS = 2000000;
+
+		static bool KeepsVert(const Topology& mesh, unsigned boundaryHE)
+		{
+			const unsigned vertHE = mesh.vertHalfEdges[mesh.halfEdgeVerts[boundaryHE]];
+			unsigned halfEdge = boundaryHE;
+
+			do
+			{
+				if (halfEdge == vertHE)
+					return true;
+
+				halfEdge = mesh.halfEdgeNexts[halfEdge ^ 1];
+			} while (halfEdge != boundaryHE);
+
+			return false;
+		}
+
+		static void SplitSingularities(Topology* inoutMesh)
+		{
+			Topology& mesh = *inoutMesh;
+			std::vector<unsigned> splitHEs;
+
+			// Fans move only once every KeepsVert has run, since those read the verts being moved
+			for (unsigned boundaryHE : mesh.faceHalfEdges[FaceType::BOUNDARY])
+			{
+				unsigned halfEdge = boundaryHE;
+
+				do
+				{
+					if (!KeepsVert(mesh, halfEdge))
+						splitHEs.push_back(halfEdge);
+
+					halfEdge = mesh.halfEdgeNexts[halfEdge];
+				} while (halfEdge != boundaryHE);
+			}
+
+			std::vector<uint8_t> vertSplits(mesh.verts.size(), 0);
+
+			for (unsigned splitHE : splitHEs)
+			{
+				const unsigned vert = mesh.halfEdgeVerts[splitHE];
+				const unsigned newVert = static_cast<unsigned>(mesh.verts.size());
+				Vert newVertId = mesh.verts[vert];
+				unsigned halfEdge = splitHE;
+
+				newVertId.splitIndex += ++vertSplits[vert];
+				mesh.verts.push_back(newVertId);
+				mesh.vertHalfEdges.push_back(splitHE);
+
+				do
+				{
+					mesh.halfEdgeVerts[halfEdge] = newVert;
+					halfEdge = mesh.halfEdgeNexts[halfEdge ^ 1];
+				} while (halfEdge != splitHE);
+			}
+		}
+
+		static bool ConstructHashMap(const unsigned* indices, unsigned triCount, Topology* outMesh)
+		{
+			std::vector<unsigned> indexVertMap;
+			std::vector<unsigned> outVertHEs;
+			std::vector<Vert> outVerts;
+			std::vector<unsigned> outFaceHEs(triCount);
+			std::vector<unsigned> outHEVerts;
+			std::vector<FaceIndex> outHEFaces;
+			std::vector<unsigned> outHENexts;
+			std::unordered_map<uint64_t, unsigned> halfEdgeMap;
+			auto FindAddVert = [&](unsigned vertIndex)
+			{
+				if (vertIndex >= indexVertMap.size())
+					indexVertMap.resize(vertIndex + 1, HE_NONE);
+
+				if (indexVertMap[vertIndex] == HE_NONE)
+				{
+					Vert vert;
+
+					vert.id = 0;
+					vert.realIndex = vertIndex;
+					indexVertMap[vertIndex] = static_cast<unsigned>(outVerts.size());
+					outVerts.push_back(vert);
+					outVertHEs.push_back(HE_NONE);
+				}
+
+				return indexVertMap[vertIndex];
+			};
+
+			for (unsigned triIndex = 0; triIndex < triCount; ++triIndex)
+			{
+				const unsigned* const triIndices = indices + triIndex * 3;
+				const unsigned verts[3] = { FindAddVert(triIndices[0]), FindAddVert(triIndices[1]), FindAddVert(triIndices[2]) };
+				unsigned triHEs[3];
+
+				if (verts[0] == verts[1] || verts[1] == verts[2] || verts[2] == verts[0])
+					return false;
+
+				for (unsigned vertIndex = 0; vertIndex < 3; ++vertIndex)
+				{
+					const unsigned vertA = verts[vertIndex];
+					const unsigned vertB = verts[(vertIndex + 1) % 3];
+					const uint64_t edgeId = (static_cast<uint64_t>(vertA) << 32) | vertB;
+					auto edgeIt = halfEdgeMap.find(edgeId);
+
+					if (edgeIt == halfEdgeMap.end())
+					{
+						const unsigned newHalfEdge = static_cast<unsigned>(outHEVerts.size());
+
+						outHEVerts.resize(newHalfEdge + 2, HE_NONE);
+						outHEFaces.resize(newHalfEdge + 2, FaceIndex{ 0, FaceType::BOUNDARY });
+						outHENexts.resize(newHalfEdge + 2, HE_NONE);
+
+						halfEdgeMap.emplace((static_cast<uint64_t>(vertB) << 32) | vertA, newHalfEdge + 1);
+						edgeIt = halfEdgeMap.emplace(edgeId, newHalfEdge).first;
+					}
+					else if (outHEVerts[edgeIt->second] != HE_NONE)
+						return false;
+
+					const unsigned halfEdge = edgeIt->second;
+
+					outHEVerts[halfEdge] = vertA;
+					outHEFaces[halfEdge] = FaceIndex{ triIndex, FaceType::REAL };
+					outVertHEs[vertA] = halfEdge;
+					triHEs[vertIndex] = halfEdge;
+				}
+
+				for (unsigned vertIndex = 0; vertIndex < 3; ++vertIndex)
+					outHENexts[triHEs[vertIndex]] = triHEs[(vertIndex + 1) % 3];
+
+				outFaceHEs[triIndex] = triHEs[2];
+			}
+
+			// Walk each boundary backwards, finding the unpaired half edge before the current one around its head vert
+			std::vector<unsigned> outBoundaryHEs;
+			for (unsigned heIndex = 0; heIndex < static_cast<unsigned>(outHENexts.size()); ++heIndex)
+			{
+				if (outHEVerts[heIndex] != HE_NONE)
+					continue;
+
+				const FaceIndex boundaryFace{ static_cast<unsigned>(outBoundaryHEs.size()), FaceType::BOUNDARY };
+				unsigned boundaryHEIndex = heIndex;
+
+				outBoundaryHEs.push_back(heIndex);
+
+				do
+				{
+					const unsigned boundaryHEFlipIndex = boundaryHEIndex ^ 1;
+					unsigned boundaryPrevIndex = outHENexts[boundaryHEFlipIndex] ^ 1;
+
+					while (outHEFaces[boundaryPrevIndex].type == FaceType::REAL)
+						boundaryPrevIndex = outHENexts[boundaryPrevIndex] ^ 1;
+
+					outHEFaces[boundaryHEIndex] = boundaryFace;
+					outHEVerts[boundaryHEIndex] = outHEVerts[outHENexts[boundaryHEFlipIndex]];
+					outHENexts[boundaryPrevIndex] = boundaryHEIndex;
+					boundaryHEIndex = boundaryPrevIndex;
+				} while (boundaryHEIndex != heIndex);
+			}
+
+			outMesh->vertHalfEdges = std::move(outVertHEs);
+			outMesh->verts = std::move(outVerts);
+			outMesh->faceHalfEdges[FaceType::REAL] = std::move(outFaceHEs);
+			outMesh->faceHalfEdges[FaceType::BOUNDARY] = std::move(outBoundaryHEs);
+			outMesh->halfEdgeVerts = std::move(outHEVerts);
+			outMesh->halfEdgeFaces = std::move(outHEFaces);
+			outMesh->halfEdgeNexts = std::move(outHENexts);
+
+			SplitSingularities(outMesh);
+
+			return Validate(*outMesh);
+		}
+	}
+
+	static void RunMeshOps(const Options& options, const GeneratedMesh& mesh, std::vector<Result>* inoutResults)
+	{
+		std::vector<Result>& results = *inoutResults;
+		std::vector<float> workPositions;
+		auto CopyPositions = [&]() { workPositions = mesh.positions; };
+
+		{
+			mesh::half_edge::Topology topology;
+			auto Reset = [&]() { topology = mesh::half_edge::Topology(); };
+
+			results.push_back(Measure(options, "half_edge::Construct", mesh, 1, Reset, [&]() { return mesh::half_edge::Construct(mesh.indices.data(), mesh.TriCount(), &topology); }));
+			PrintResult(results.back());
+
+			// The replaced hash map path, which must build the same topology. Skipped on the largest meshes, where it
+			// takes seconds per rep.
+			if (mesh.TriCount() <= reference::MAX_TRIS)
+			{
+				mesh::half_edge::Topology hashMapTopology;
+
+				results.push_back(Measure(options, "half_edge hash map reference", mesh, 1, [&]() { hashMapTopology = mesh::half_edge::Topology(); }, [&]() { return reference::ConstructHashMap(mesh.indices.data(), mesh.TriCount(), &hashMapTopology); }));
+				results.back().ok &= check::SameTopology(hashMapTopology, topology);
+				PrintResult(results.back());
+			}
+
+			if (options.threadCount != 1)
+			{
+				mesh::half_edge::ConstructOptions constructOptions;
+
+				constructOptions.threadCount = options.threadCount;
+				results.push_back(Measure(options, "half_edge::Construct", mesh, options.threadCount, Reset, [&]() { return mesh::half_edge::Construct(mesh.indices.data(), mesh.TriCount(), &topology, constructOptions); }));
+				PrintResult(results.back());
+			}
+
+			// One more build with the phase breakdown, when the library records it
+			if (mesh::half_edge::CONSTRUCT_STATS_ENABLED)
+			{
+				mesh::half_edge::ConstructOptions constructOptions;
+				mesh::half_edge::ConstructStats stats;
+
+				constructOptions.threadCount = options.threadCount;
+				constructOptions.optOutStats = &stats;
+				mesh::half_edge::Construct(mesh.indices.data(), mesh.TriCount(), &topology, constructOptions);
+				PrintConstructStats(stats);
+			}
+		}
+
+		{
+			mesh::half_edge::Topology constructed;
+			mesh::half_edge::Topology topology;
+			auto CopyTopology = [&]() { topology = constructed; };
+
+			mesh::half_edge::Construct(mesh.indices.data(), mesh.TriCount(), &constructed);
+
+			for (unsigned pass = 0; pass < (options.threadCount != 1 ? 2u : 1u); ++pass)
+			{
+				mesh::half_edge::ValidateOptions validateOptions;
+
+				validateOptions.threadCount = pass ? options.threadCount : 1;
+				results.push_back(Measure(options, "half_edge::Validate", mesh, validateOptions.threadCount, []() {}, [&]() { return mesh::half_edge::Validate(constructed, nullptr, validateOptions); }));
+				PrintResult(results.back());
+			}
+
+			// Serial and parallel builds and reports must match. Meshes under 32K triangles build serially at any count.
+			{
+				const unsigned agreeThreads = options.threadCount != 1 ? options.threadCount : 4;
+
+				results.push_back(Measure(options, "half_edge threads agree", mesh, agreeThreads, []() {}, [&]() { return check::ThreadsAgree(mesh.indices.data(), mesh.TriCount(), agreeThreads); }));
+				PrintResult(results.back());
+			}
+
+			results.push_back(Measure(options, "half_edge::Reorder", mesh, 1, CopyTopology, [&]() { mesh::half_edge::Reorder(&topology, mesh.positions.data()); return true; }));
+			PrintResult(results.back());
+
+			results.push_back(Measure(options, "half_edge cache round trip", mesh, 1, []() {}, [&]() { return check::CacheRoundTrip("Benchmark.cache", constructed, mesh.indices.data(), mesh.TriCount()); }));
+			PrintResult(results.back());
+
+			// One random edit per four triangles, then Compact and Validate
+			results.push_back(Measure(options, "half_edge random edits", mesh, 1, CopyTopology, [&]() { return check::RandomEdits(&topology, mesh.TriCount() / 4, mesh.VertCount(), mesh.TriCount()); }));
+			PrintResult(results.back());
+		}
+
+		{
+			// Builder and topology are kept across runs and warmed up once, so this measures rebuilds without allocations
+			mesh::TopologyBuilder builder;
+			mesh::half_edge::Topology topology;
+			auto Construct = [&]() { return mesh::half_edge::Construct(&builder, mesh.indices.data(), mesh.TriCount(), &topology); };
+			auto WarmUp = [&]() { if (topology.verts.empty()) Construct(); };
+
+			results.push_back(Measure(options, "half_edge::Construct reused", mesh, 1, WarmUp, Construct));
+			PrintResult(results.back());
+		}
+
+		{
+			mesh::tri_edge::Topology topology;
+			auto Reset = [&]() { topology = mesh::tri_edge::Topology(); };
+
+			results.push_back(Measure(options, "tri_edge::Construct", mesh, 1, Reset, [&]() { return mesh::tri_edge::Construct(mesh.indices.data(), mesh.TriCount(), &topology); }));
+			PrintResult(results.back());
+		}
+
+		{
+			// Wide ids for meshes over 16M verts, compared against the compact layout above
+			mesh::half_edge::Topology64 halfEdges;
+			mesh::tri_edge::Topology64 triEdges;
+			auto Reset = [&]() { halfEdges = mesh::half_edge::Topology64(); triEdges = mesh::tri_edge::Topology64(); };
+
+			results.push_back(Measure(options, "half_edge::Construct 64", mesh, 1, Reset, [&]() { return mesh::half_edge::Construct(mesh.indices.data(), mesh.TriCount(), &halfEdges); }));
+			PrintResult(results.back());
+
+			results.push_back(Measure(options, "tri_edge::Construct 64", mesh, 1, Reset, [&]() { return mesh::tri_edge::Construct(mesh.indices.data(), mesh.TriCount(), &triEdges); }));
+			PrintResult(results.back());
+		}
+
+		{
+			mesh::TopologyBuilder builder;
+			mesh::tri_edge::Topology topology;
+			auto Construct = [&]() { return mesh::tri_edge::Construct(&builder, mesh.indices.data(), mesh.TriCount(), &topology); };
+			auto WarmUp = [&]() { if (topology.verts.empty()) Construct(); };
+
+			results.push_back(Measure(options, "tri_edge::Construct reused", mesh, 1, WarmUp, Construct));
+			PrintResult(results.back());
+		}
+
+		{
+			mesh::half_edge::Topology halfEdges;
+			mesh::tri_edge::Topology triEdges;
+			mesh::half_edge::Topology convertedHalfEdges;
+			mesh::tri_edge::Topology convertedTriEdges;
+			auto Reset = [&]() { convertedHalfEdges = mesh::half_edge::Topology(); convertedTriEdges = mesh::tri_edge::Topology(); };
+
+			mesh::half_edge::Construct(mesh.indices.data(), mesh.TriCount(), &halfEdges);
+			mesh::tri_edge::Construct(mesh.indices.data(), mesh.TriCount(), &triEdges);
+
+			for (unsigned pass = 0; pass < (options.threadCount != 1 ? 2u : 1u); ++pass)
+			{
+				mesh::ConvertOptions convertOptions;
+
+				convertOptions.threadCount = pass ? options.threadCount : 1;
+				results.push_back(Measure(options, "Convert to half_edge", mesh, convertOptions.threadCount, Reset, [&]() { mesh::Convert(triEdges, &convertedHalfEdges, convertOptions); return true; }));
+				PrintResult(results.back());
+
+				results.push_back(Measure(options, "Convert to tri_edge", mesh, convertOptions.threadCount, Reset, [&]() { mesh::Convert(halfEdges, &convertedTriEdges, convertOptions); return true; }));
+				PrintResult(results.back());
+			}
+		}
+
+		{
+			std::vector<float> soup(mesh.indices.size() * 3);
+			std::vector<unsigned> weldedIndices;
+			std::vector<float> weldedPositions;
+
+			for (size_t corner = 0; corner < mesh.indices.size(); ++corner)
+				std::copy(&mesh.positions[mesh.indices[corner] * 3ull], &mesh.positions[mesh.indices[corner] * 3ull] + 3, &soup[corner * 3]);
+
+			for (unsigned pass = 0; pass < (options.threadCount != 1 ? 2u : 1u); ++pass)
+			{
+				mesh::WeldOptions weldOptions;
+
+				weldOptions.threadCount = pass ? options.threadCount : 1;
+				results.push_back(Measure(options, "WeldSoup", mesh, weldOptions.threadCount, []() {}, [&]() { return mesh::WeldSoup(soup.data(), mesh.TriCount(), &weldedIndices, &weldedPositions, weldOptions) <= mesh.VertCount(); }));
+				PrintResult(results.back());
+
+				weldOptions.epsilon = 1e-6f;
+				results.push_back(Measure(options, "WeldSoup epsilon", mesh, weldOptions.threadCount, []() {}, [&]() { return mesh::WeldSoup(soup.data(), mesh.TriCount(), &weldedIndices, &weldedPositions, weldOptions) <= mesh.VertCount(); }));
+				PrintResult(results.back());
+			}
+		}
+
+		{
+			std::vector<unsigned> optimized(mesh.indices.size());
+			std::vector<unsigned> vertRemap;
+
+			results.push_back(Measure(options, "OptimizeIndices", mesh, 1, []() {}, [&]() { mesh::OptimizeIndices(mesh.indices.data(), mesh.TriCount(), optimized.data(), &vertRemap); return true; }));
+			PrintResult(results.back());
+		}
+
+		for (unsigned pass = 0; pass < (options.threadCount != 1 ? 2u : 1u); ++pass)
+		{
+			mesh::TransformOptions transformOptions;
+
+			transformOptions.threadCount = pass ? options.threadCount : 1;
+
+			results.push_back(Measure(options, "Recenter", mesh, transformOptions.threadCount, CopyPositions, [&]() { mesh::Recenter(workPositions.data(), mesh.VertCount(), nullptr, nullptr, transformOptions); return true; }));
+			PrintResult(results.back());
+
+			results.push_back(Measure(options, "Normalize", mesh, transformOptions.threadCount, CopyPositions, [&]() { return mesh::Normalize(workPositions.data(), mesh.VertCount(), transformOptions) > 0.0f; }));
+			PrintResult(results.back());
+
+			results.push_back(Measure(options, "RecenterNormalize", mesh, transformOptions.threadCount, CopyPositions, [&]() { return mesh::RecenterNormalize(workPositions.data(), mesh.VertCount(), nullptr, nullptr, transformOptions) > 0.0f; }));
+			PrintResult(results.back());
+		}
+
+		{
+			// Queries start off a spread of verts and aim back at them, so most rays hit near their vert
+			const unsigned queryCount = std::min(mesh.TriCount(), 1u << 20);
+			std::vector<mesh::Ray> rays(queryCount);
+			std::vector<float> points(queryCount * 3ull);
+			std::vector<mesh::RayHit> hits(queryCount);
+			std::vector<uint8_t> occluded(queryCount);
+			std::vector<mesh::ClosestPoint> closest(queryCount);
+			const float offset[3] = { 0.3f, 0.2f, 1.0f };
+			mesh::Bvh bvh;
+
+			for (unsigned query = 0; query < queryCount; ++query)
+			{
+				const float* const vert = &mesh.positions[(query * 7919ull % mesh.VertCount()) * 3];
+
+				for (unsigned axis = 0; axis < 3; ++axis)
+				{
+					rays[query].origin[axis] = vert[axis] + offset[axis];
+					rays[query].dir[axis] = -offset[axis];
+					points[query * 3ull + axis] = vert[axis] + offset[axis] * 0.01f;
+				}
+			}
+
+			for (unsigned pass = 0; pass < (options.threadCount != 1 ? 2u : 1u); ++pass)
+			{
+				mesh::BvhOptions bvhOptions;
+				mesh::BvhQueryOptions queryOptions;
+
+				bvhOptions.threadCount = queryOptions.threadCount = pass ? options.threadCount : 1;
+
+				results.push_back(Measure(options, "BuildBvh", mesh, bvhOptions.threadCount, [&]() { bvh = mesh::Bvh(); }, [&]() { mesh::BuildBvh(mesh.positions.data(), mesh.indices.data(), mesh.TriCount(), &bvh, bvhOptions); return !bvh.nodes.empty(); }));
+				PrintResult(results.back());
+
+				results.push_back(Measure(options, "Bvh Intersect", mesh, queryOptions.threadCount, []() {}, [&]() { mesh::Intersect(bvh, rays.data(), queryCount, hits.data(), queryOptions); return true; }));
+				PrintResult(results.back());
+
+				results.push_back(Measure(options, "Bvh Occluded", mesh, queryOptions.threadCount, []() {}, [&]() { mesh::Occluded(bvh, rays.data(), queryCount, occluded.data(), queryOptions); return true; }));
+				PrintResult(results.back());
+
+				results.push_back(Measure(options, "Bvh FindClosestPoints", mesh, queryOptions.threadCount, []() {}, [&]() { mesh::FindClosestPoints(bvh, points.data(), queryCount, closest.data(), FLT_MAX, queryOptions); return true; }));
+				PrintResult(results.back());
+			}
+		}
+
+		{
+			mesh::half_edge::Topology topology;
+			mesh::half_edge::Components components;
+
+			mesh::half_edge::Construct(mesh.indices.data(), mesh.TriCount(), &topology);
+
+			for (unsigned pass = 0; pass < (options.threadCount != 1 ? 2u : 1u); ++pass)
+			{
+				mesh::half_edge::ComponentOptions componentOptions;
+
+				componentOptions.threadCount = pass ? options.threadCount : 1;
+				results.push_back(Measure(options, "FindComponents", mesh, componentOptions.threadCount, []() {}, [&]() { mesh::half_edge::FindComponents(topology, &components, componentOptions); return !components.components.empty(); }));
+				PrintResult(results.back());
+			}
+		}
+
+		{
+			mesh::half_edge::Topology topology;
+			mesh::half_edge::Attributes attributes;
+
+			mesh::half_edge::Construct(mesh.indices.data(), mesh.TriCount(), &topology);
+
+			for (unsigned pass = 0; pass < (options.threadCount != 1 ? 2u : 1u); ++pass)
+			{
+				mesh::half_edge::AttributeOptions attributeOptions;
+
+				attributeOptions.threadCount = pass ? options.threadCount : 1;
+				results.push_back(Measure(options, "ComputeAttributes", mesh, attributeOptions.threadCount, []() {}, [&]() { mesh::half_edge::ComputeAttributes(topology, mesh.positions.data(), mesh::half_edge::ATTRIBUTE_ALL, &attributes, attributeOptions); return true; }));
+				PrintResult(results.back());
+
+				attributeOptions.fused = false;
+				results.push_back(Measure(options, "ComputeAttributes unfused", mesh, attributeOptions.threadCount, []() {}, [&]() { mesh::half_edge::ComputeAttributes(topology, mesh.positions.data(), mesh::half_edge::ATTRIBUTE_ALL, &attributes, attributeOptions); return true; }));
+				PrintResult(results.back());
+			}
+		}
+
+		{
+			// Sparse Cholesky fill grows faster than the mesh, so the factorization is only timed on smaller meshes
+			static const unsigned MAX_FACTOR_TRIS = 1u << 17;
+			mesh::half_edge::Topology topology;
+			mesh::half_edge::SparseMatrix laplacian;
+			mesh::half_edge::LaplacianSolver solver;
+			std::vector<double> mass;
+			std::vector<double> rhs;
+			std::vector<double> solution;
+			mesh::half_edge::GeodesicSolver geodesics;
+			std::vector<unsigned> sources;
+			std::vector<unsigned> setStarts;
+			std::vector<float> distances;
+
+			mesh::half_edge::Construct(mesh.indices.data(), mesh.TriCount(), &topology);
+
+			for (unsigned pass = 0; pass < (options.threadCount != 1 ? 2u : 1u); ++pass)
+			{
+				mesh::half_edge::LaplacianOptions laplacianOptions;
+
+				laplacianOptions.threadCount = pass ? options.threadCount : 1;
+				results.push_back(Measure(options, "AssembleLaplacian", mesh, laplacianOptions.threadCount, []() {}, [&]() { mesh::half_edge::AssembleLaplacian(topology, mesh.positions.data(), &laplacian, &mass, laplacianOptions); return true; }));
+				PrintResult(results.back());
+
+				if (mesh.TriCount() > MAX_FACTOR_TRIS)
+					continue;
+
+				// One implicit smoothing step, (M + 0.01 L) x = M p
+				results.push_back(Measure(options, "AnalyzeLaplacian", mesh, laplacianOptions.threadCount, []() {}, [&]() { mesh::half_edge::AnalyzeLaplacian(topology, &solver, laplacianOptions); return true; }));
+				PrintResult(results.back());
+
+				results.push_back(Measure(options, "FactorLaplacian", mesh, laplacianOptions.threadCount, []() {}, [&]() { return mesh::half_edge::FactorLaplacian(topology, mesh.positions.data(), 1.0, 0.01, &solver, laplacianOptions); }));
+				PrintResult(results.back());
+
+				const size_t vertCount = topology.verts.size();
+
+				rhs.resize(vertCount * 3);
+				solution.resize(vertCount * 3);
+				for (size_t vert = 0; vert < vertCount; ++vert)
+				{
+					for (unsigned component = 0; component < 3; ++component)
+						rhs[component * vertCount + vert] = solver.mass[vert] * mesh.positions[topology.verts[vert].realIndex * 3ull + component];
+				}
+
+				results.push_back(Measure(options, "SolveLaplacian", mesh, laplacianOptions.threadCount, []() {}, [&]() { mesh::half_edge::SolveLaplacian(solver, rhs.data(), 3, solution.data(), laplacianOptions); return true; }));
+				PrintResult(results.back());
+
+				mesh::half_edge::GeodesicOptions geodesicOptions;
+				mesh::half_edge::GeodesicQueryOptions queryOptions;
+
+				geodesicOptions.threadCount = queryOptions.threadCount = laplacianOptions.threadCount;
+				results.push_back(Measure(options, "PrepareGeodesics", mesh, geodesicOptions.threadCount, []() {}, [&]() { return mesh::half_edge::PrepareGeodesics(topology, mesh.positions.data(), &geodesics, geodesicOptions); }));
+				PrintResult(results.back());
+
+				// Eight sets of one to three sources spread over the verts
+				sources.clear();
+				setStarts.assign(1, 0);
+				for (unsigned set = 0; set < 8; ++set)
+				{
+					for (unsigned source = 0; source <= set % 3; ++source)
+						sources.push_back(static_cast<unsigned>((sources.size() * 7919ull + 1) % vertCount));
+
+					setStarts.push_back(static_cast<unsigned>(sources.size()));
+				}
+
+				distances.resize(vertCount * 8);
+				results.push_back(Measure(options, "ComputeGeodesics", mesh, queryOptions.threadCount, []() {}, [&]() { mesh::half_edge::ComputeGeodesics(geodesics, sources.data(), 1, distances.data(), queryOptions); return true; }));
+				PrintResult(results.back());
+
+				results.push_back(Measure(options, "ComputeGeodesics batch 8", mesh, queryOptions.threadCount, []() {}, [&]() { mesh::half_edge::ComputeGeodesics(geodesics, sources.data(), setStarts.data(), 8, distances.data(), queryOptions); return true; }));
+				PrintResult(results.back());
+			}
+		}
+
+		{
+			// Quarter the mesh, or halve it four times. Each LOD must validate and carry a position for every vert.
+			static const unsigned LOD_COUNT = 4;
+			mesh::half_edge::Topology topology;
+			mesh::half_edge::Lod lod;
+			std::vector<mesh::half_edge::Lod> lods;
+			unsigned targetTris[LOD_COUNT];
+			auto ValidLod = [](const mesh::half_edge::Lod& lod) { return mesh::half_edge::Validate(lod.mesh) && lod.positions.size() == lod.mesh.verts.size() * 3 && lod.sourceVerts.size() == lod.mesh.verts.size(); };
+
+			mesh::half_edge::Construct(mesh.indices.data(), mesh.TriCount(), &topology);
+			for (unsigned level = 0; level < LOD_COUNT; ++level)
+				targetTris[level] = mesh.TriCount() >> (level + 1);
+
+			for (unsigned pass = 0; pass < (options.threadCount != 1 ? 2u : 1u); ++pass)
+			{
+				mesh::half_edge::DecimateOptions decimateOptions;
+
+				decimateOptions.threadCount = pass ? options.threadCount : 1;
+				results.push_back(Measure(options, "Decimate", mesh, decimateOptions.threadCount, []() {}, [&]() { mesh::half_edge::Decimate(topology, mesh.positions.data(), mesh.TriCount() / 4, &lod, decimateOptions); return ValidLod(lod); }));
+				PrintResult(results.back());
+
+				results.push_back(Measure(options, "DecimateLods", mesh, decimateOptions.threadCount, []() {}, [&]() { mesh::half_edge::DecimateLods(topology, mesh.positions.data(), targetTris, LOD_COUNT, &lods, decimateOptions); return std::all_of(lods.begin(), lods.end(), ValidLod); }));
+				PrintResult(results.back());
+			}
+		}
+
+		{
+			// Each hierarchy level decimates every group, so the hierarchy is only timed on smaller meshes
+			static const unsigned MAX_HIERARCHY_TRIS = 1u << 20;
+			mesh::half_edge::Topology topology;
+			mesh::half_edge::Meshlets meshlets;
+
+			mesh::half_edge::Construct(mesh.indices.data(), mesh.TriCount(), &topology);
+
+			for (unsigned pass = 0; pass < (options.threadCount != 1 ? 2u : 1u); ++pass)
+			{
+				mesh::half_edge::MeshletOptions meshletOptions;
+
+				meshletOptions.threadCount = pass ? options.threadCount : 1;
+				results.push_back(Measure(options, "BuildMeshlets", mesh, meshletOptions.threadCount, []() {}, [&]() { mesh::half_edge::BuildMeshlets(topology, mesh.positions.data(), &meshlets, meshletOptions); return !meshlets.meshlets.empty(); }));
+				PrintResult(results.back());
+
+				if (mesh.TriCount() > MAX_HIERARCHY_TRIS)
+					continue;
+
+				meshletOptions.buildHierarchy = true;
+				results.push_back(Measure(options, "BuildMeshlets hierarchy", mesh, meshletOptions.threadCount, []() {}, [&]() { mesh::half_edge::BuildMeshlets(topology, mesh.positions.data(), &meshlets, meshletOptions); return !meshlets.meshlets.empty(); }));
+				PrintResult(results.back());
+			}
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	static const unsigned SIZES[] = { 1000, 10000, 100000, 1000000, 5000000, 20000000 };
+	Options options;
+	std::vector<Result> results;
+
+	if (!ParseOptions(argc, argv, &options))
+		return 1;
+
+	if (!options.filePath.empty())
+	{
+		GeneratedMesh mesh;
+		mesh::io::IndexedMesh loaded;
+		auto Reset = [&]() { loaded = mesh::io::IndexedMesh(); };
+
+		mesh.name = "file";
+		for (unsigned pass = 0; pass < (options.threadCount != 1 ? 2u : 1u); ++pass)
+		{
+			mesh::io::LoadOptions loadOptions;
+
+			loadOptions.threadCount = pass ? options.threadCount : 1;
+			results.push_back(Measure(options, "io::Load", mesh, loadOptions.threadCount, Reset, [&]() { return mesh::io::Load(options.filePath.c_str(), &loaded, loadOptions); }));
+			results.back().tris = loaded.TriCount();
+			results.back().verts = loaded.VertCount();
+			PrintResult(results.back());
+		}
+
+		if (!results.back().ok)
+		{
+			std::printf("Failed to load %s\n", options.filePath.c_str());
+			return 1;
+		}
+
+		mesh.positions = std::move(loaded.positions);
+		mesh.indices = std::move(loaded.indices);
+		RunMeshOps(options, mesh, &results);
+	}
+
+	for (unsigned targetTris : SIZES)
+	{
+		if (!options.filePath.empty())
+			break;
+
+		if (targetTris < options.minTris || targetTris > options.maxTris)
+			continue;
+
+		for (GeneratedMesh (*Generate)(unsigned) : { &gen::Grid, &gen::UVSphere, &gen::HoledGrid })
+		{
+			const GeneratedMesh mesh = Generate(targetTris);
+
+			if (!options.meshFilter.empty() && options.meshFilter != mesh.name)
+				continue;
+
+			RunMeshOps(options, mesh, &results);
+		}
+	}
+
+	std::printf("peak RSS %.1f MB\n", heap::PeakRss() / (1024.0 * 1024.0));
+
+	if (!options.jsonPath.empty() && !WriteJson(options.jsonPath, results))
+	{
+		std::printf("Failed to write %s\n", options.jsonPath.c_str());
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,462 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <emmintrin.h>
+#include "MeshProc/Attributes.h"
+#include "MeshProc/HalfEdgeCirculators.h"
+#include "Parallel.h"
+#include "sanity.h"
+
+namespace
+{
+	using namespace mesh;
+	using namespace mesh::half_edge;
+
+	// Below this the threads cost more than the passes they split
+	static constexpr unsigned PARALLEL_MIN_ELEMENTS = 1u << 14;
+
+	static constexpr float PI = 3.14159265358979323846f;
+
+	static unsigned ThreadCount(unsigned elementCount, const AttributeOptions& options)
+	{
+		return elementCount < PARALLEL_MIN_ELEMENTS ? 1 : std::min(Parallel_ThreadCount(options.threadCount), elementCount / (PARALLEL_MIN_ELEMENTS / 4));
+	}
+
+	namespace simd
+	{
+		struct Vec
+		{
+			__m128 x, y, z;
+		};
+
+		static inline Vec Sub(const Vec& lhs, const Vec& rhs)
+		{
+			return Vec{ _mm_sub_ps(lhs.x, rhs.x), _mm_sub_ps(lhs.y, rhs.y), _mm_sub_ps(lhs.z, rhs.z) };
+		}
+
+		static inline Vec Scale(const Vec& vec, __m128 scale)
+		{
+			return Vec{ _mm_mul_ps(vec.x, scale), _mm_mul_ps(vec.y, scale), _mm_mul_ps(vec.z, scale) };
+		}
+
+		// lhs * lhsScale + rhs * rhsScale
+		static inline Vec Combine(const Vec& lhs, __m128 lhsScale, const Vec& rhs, __m128 rhsScale)
+		{
+			return Vec{ _mm_add_ps(_mm_mul_ps(lhs.x, lhsScale), _mm_mul_ps(rhs.x, rhsScale)),
+				_mm_add_ps(_mm_mul_ps(lhs.y, lhsScale), _mm_mul_ps(rhs.y, rhsScale)),
+				_mm_add_ps(_mm_mul_ps(lhs.z, lhsScale), _mm_mul_ps(rhs.z, rhsScale)) };
+		}
+
+		static inline __m128 Dot(const Vec& lhs, const Vec& rhs)
+		{
+			return _mm_add_ps(_mm_add_ps(_mm_mul_ps(lhs.x, rhs.x), _mm_mul_ps(lhs.y, rhs.y)), _mm_mul_ps(lhs.z, rhs.z));
+		}
+
+		static inline Vec Cross(const Vec& lhs, const Vec& rhs)
+		{
+			return Vec{ _mm_sub_ps(_mm_mul_ps(lhs.y, rhs.z), _mm_mul_ps(lhs.z, rhs.y)),
+				_mm_sub_ps(_mm_mul_ps(lhs.z, rhs.x), _mm_mul_ps(lhs.x, rhs.z)),
+				_mm_sub_ps(_mm_mul_ps(lhs.x, rhs.y), _mm_mul_ps(lhs.y, rhs.x)) };
+		}
+
+		static inline __m128 Select(__m128 mask, __m128 ifTrue, __m128 ifFalse)
+		{
+			return _mm_or_ps(_mm_and_ps(mask, ifTrue), _mm_andnot_ps(mask, ifFalse));
+		}
+
+		// atan2 for y >= 0, 0 when both are. Reduces to atan on [0, tan(pi/8)] and uses the Cephes atanf polynomial,
+		// within a few ulp.
+		static inline __m128 Atan2(__m128 y, __m128 x)
+		{
+			const __m128 absX = _mm_andnot_ps(_mm_set1_ps(-0.0f), x);
+			const __m128 num = _mm_min_ps(y, absX);
+			const __m128 den = _mm_max_ps(y, absX);
+			const __m128 ratio = Select(_mm_cmpgt_ps(den, _mm_setzero_ps()), _mm_div_ps(num, den), _mm_setzero_ps());
+
+			const __m128 reduce = _mm_cmpgt_ps(ratio, _mm_set1_ps(0.41421356f));
+			const __m128 z = Select(reduce, _mm_div_ps(_mm_sub_ps(ratio, _mm_set1_ps(1.0f)), _mm_add_ps(ratio, _mm_set1_ps(1.0f))), ratio);
+			const __m128 zz = _mm_mul_ps(z, z);
+
+			__m128 poly = _mm_set1_ps(8.05374449538e-2f);
+			poly = _mm_sub_ps(_mm_mul_ps(poly, zz), _mm_set1_ps(1.38776856032e-1f));
+			poly = _mm_add_ps(_mm_mul_ps(poly, zz), _mm_set1_ps(1.99777106478e-1f));
+			poly = _mm_sub_ps(_mm_mul_ps(poly, zz), _mm_set1_ps(3.33329491539e-1f));
+
+			__m128 angle = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(poly, zz), z), z);
+
+			angle = _mm_add_ps(angle, _mm_and_ps(reduce, _mm_set1_ps(PI * 0.25f)));
+			angle = Select(_mm_cmpgt_ps(y, absX), _mm_sub_ps(_mm_set1_ps(PI * 0.5f), angle), angle);
+
+			return Select(_mm_cmplt_ps(x, _mm_setzero_ps()), _mm_sub_ps(_mm_set1_ps(PI), angle), angle);
+		}
+	}
+
+	// Arrays the passes read and write. Null entries are not needed for the requested attributes. Corner arrays are
+	// indexed by the half edge leaving the corner's vert inside its face.
+	struct Targets
+	{
+		float* faceNormals;
+		float* faceAreas;
+		float* cornerAngles;
+		float* cornerAreas;
+		float* cornerLaplace; // Packed xyz cotangent weighted edge vectors
+		float* vertNormals;
+		float* vertAreas;
+		float* meanCurvature;
+		float* gaussianCurvature;
+	};
+
+	namespace face
+	{
+		static constexpr unsigned LANES = 4;
+
+		struct Block
+		{
+			unsigned halfEdges[3][LANES];
+			alignas(16) float positions[3][3][LANES]; // corner, component, lane
+		};
+
+		// Gathers faces [first, first + laneCount) into SoA lanes. Lanes past laneCount repeat the last face so every
+		// lane holds finite values, and deleted faces read as a point at the origin.
+		template<typename IdT>
+		static void Gather(const TopologyT<IdT>& mesh, const float* positions, unsigned first, unsigned laneCount, Block* outBlock)
+		{
+			for (unsigned lane = 0; lane < LANES; ++lane)
+			{
+				const unsigned face = first + std::min(lane, laneCount - 1);
+				unsigned halfEdge = mesh.faceHalfEdges[FaceType::REAL][face];
+
+				for (unsigned corner = 0; corner < 3; ++corner)
+				{
+					outBlock->halfEdges[corner][lane] = halfEdge;
+
+					if (halfEdge == ~0u)
+					{
+						for (unsigned component = 0; component < 3; ++component)
+							outBlock->positions[corner][component][lane] = 0.0f;
+
+						continue;
+					}
+
+					const float* const position = positions + static_cast<size_t>(mesh.verts[mesh.halfEdgeVerts[halfEdge]].realIndex) * 3;
+
+					for (unsigned component = 0; component < 3; ++component)
+						outBlock->positions[corner][component][lane] = position[component];
+
+					halfEdge = mesh.halfEdgeNexts[halfEdge];
+				}
+			}
+		}
+
+		static inline void StoreVec(const simd::Vec& vec, unsigned lane, float* out)
+		{
+			alignas(16) float x[LANES], y[LANES], z[LANES];
+
+			_mm_store_ps(x, vec.x);
+			_mm_store_ps(y, vec.y);
+			_mm_store_ps(z, vec.z);
+			out[0] = x[lane];
+			out[1] = y[lane];
+			out[2] = z[lane];
+		}
+
+		// Every quantity is computed whatever is requested and only the stores are skipped, so an attribute comes out
+		// the same bits fused or on its own.
+		static void Evaluate(const Block& block, unsigned first, unsigned laneCount, const Targets& targets)
+		{
+			simd::Vec p[3];
+
+			for (unsigned corner = 0; corner < 3; ++corner)
+				p[corner] = simd::Vec{ _mm_load_ps(block.positions[corner][0]), _mm_load_ps(block.positions[corner][1]), _mm_load_ps(block.positions[corner][2]) };
+
+			const simd::Vec edge01 = simd::Sub(p[1], p[0]);
+			const simd::Vec edge02 = simd::Sub(p[2], p[0]);
+			const simd::Vec edge12 = simd::Sub(p[2], p[1]);
+			const simd::Vec cross = simd::Cross(edge01, edge02);
+
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 doubleArea = _mm_sqrt_ps(simd::Dot(cross, cross));
+			const __m128 area = _mm_mul_ps(doubleArea, _mm_set1_ps(0.5f));
+			const __m128 invDoubleArea = simd::Select(_mm_cmpgt_ps(doubleArea, zero), _mm_div_ps(_mm_set1_ps(1.0f), doubleArea), zero);
+			const simd::Vec normal = simd::Scale(cross, invDoubleArea);
+
+			// Corner dot products. Over twice the area they give the cotangents, 0 on degenerate faces.
+			const __m128 dots[3] = {
+				simd::Dot(edge01, edge02),
+				_mm_sub_ps(zero, simd::Dot(edge01, edge12)),
+				simd::Dot(edge02, edge12)
+			};
+			const __m128 cots[3] = { _mm_mul_ps(dots[0], invDoubleArea), _mm_mul_ps(dots[1], invDoubleArea), _mm_mul_ps(dots[2], invDoubleArea) };
+
+			const __m128 length01 = simd::Dot(edge01, edge01);
+			const __m128 length02 = simd::Dot(edge02, edge02);
+			const __m128 length12 = simd::Dot(edge12, edge12);
+
+			// Voronoi areas where no angle is obtuse, otherwise half the area to the obtuse corner and a quarter to the others
+			const __m128 eighth = _mm_set1_ps(0.125f);
+			const __m128 obtuse[3] = { _mm_cmplt_ps(dots[0], zero), _mm_cmplt_ps(dots[1], zero), _mm_cmplt_ps(dots[2], zero) };
+			const __m128 anyObtuse = _mm_or_ps(_mm_or_ps(obtuse[0], obtuse[1]), obtuse[2]);
+			const __m128 voronoi[3] = {
+				_mm_mul_ps(_mm_add_ps(_mm_mul_ps(length02, cots[1]), _mm_mul_ps(length01, cots[2])), eighth),
+				_mm_mul_ps(_mm_add_ps(_mm_mul_ps(length01, cots[2]), _mm_mul_ps(length12, cots[0])), eighth),
+				_mm_mul_ps(_mm_add_ps(_mm_mul_ps(length12, cots[0]), _mm_mul_ps(length02, cots[1])), eighth)
+			};
+
+			__m128 cornerAreas[3];
+
+			for (unsigned corner = 0; corner < 3; ++corner)
+			{
+				const __m128 split = _mm_mul_ps(area, simd::Select(obtuse[corner], _mm_set1_ps(0.5f), _mm_set1_ps(0.25f)));
+
+				cornerAreas[corner] = simd::Select(anyObtuse, split, voronoi[corner]);
+			}
+
+			// Each edge vector from the neighbor to the corner, weighted by the cotangent of the angle across from it
+			const simd::Vec laplace[3] = {
+				simd::Combine(edge01, _mm_sub_ps(zero, cots[2]), edge02, _mm_sub_ps(zero, cots[1])),
+				simd::Combine(edge01, cots[2], edge12, _mm_sub_ps(zero, cots[0])),
+				simd::Combine(edge02, cots[1], edge12, cots[0])
+			};
+
+			const __m128 angles[3] = { simd::Atan2(doubleArea, dots[0]), simd::Atan2(doubleArea, dots[1]), simd::Atan2(doubleArea, dots[2]) };
+
+			alignas(16) float laneAreas[LANES];
+			alignas(16) float laneCornerAreas[3][LANES];
+			alignas(16) float laneAngles[3][LANES];
+
+			_mm_store_ps(laneAreas, area);
+			for (unsigned corner = 0; corner < 3; ++corner)
+			{
+				_mm_store_ps(laneCornerAreas[corner], cornerAreas[corner]);
+				_mm_store_ps(laneAngles[corner], angles[corner]);
+			}
+
+			for (unsigned lane = 0; lane < laneCount; ++lane)
+			{
+				const unsigned faceIndex = first + lane;
+
+				if (targets.faceNormals)
+					StoreVec(normal, lane, targets.faceNormals + static_cast<size_t>(faceIndex) * 3);
+
+				if (targets.faceAreas)
+					targets.faceAreas[faceIndex] = laneAreas[lane];
+
+				if (block.halfEdges[0][lane] == ~0u)
+					continue;
+
+				for (unsigned corner = 0; corner < 3; ++corner)
+				{
+					const unsigned halfEdge = block.halfEdges[corner][lane];
+
+					if (targets.cornerAngles)
+						targets.cornerAngles[halfEdge] = laneAngles[corner][lane];
+
+					if (targets.cornerAreas)
+						targets.cornerAreas[halfEdge] = laneCornerAreas[corner][lane];
+
+					if (targets.cornerLaplace)
+						StoreVec(laplace[corner], lane, targets.cornerLaplace + static_cast<size_t>(halfEdge) * 3);
+				}
+			}
+		}
+
+		template<typename IdT>
+		static void Pass(const TopologyT<IdT>& mesh, const float* positions, const Targets& targets, const AttributeOptions& options)
+		{
+			const unsigned faceCount = static_cast<unsigned>(mesh.faceHalfEdges[FaceType::REAL].size());
+			const unsigned blockCount = (faceCount + LANES - 1) / LANES;
+
+			Parallel_For(ThreadCount(faceCount, options), blockCount, [&](unsigned, unsigned begin, unsigned end)
+			{
+				Block block;
+
+				for (unsigned blockIndex = begin; blockIndex < end; ++blockIndex)
+				{
+					const unsigned first = blockIndex * LANES;
+					const unsigned laneCount = std::min(LANES, faceCount - first);
+
+					Gather(mesh, positions, first, laneCount, &block);
+					Evaluate(block, first, laneCount, targets);
+				}
+			});
+		}
+	}
+
+	namespace vert
+	{
+		// Each vert only reads its own fan's half edges and faces and writes its own slots.
+		template<typename IdT>
+		static void Pass(const TopologyT<IdT>& mesh, const Targets& targets, const AttributeOptions& options)
+		{
+			const unsigned vertCount = static_cast<unsigned>(mesh.verts.size());
+			const bool needNormal = targets.vertNormals || targets.meanCurvature;
+
+			Parallel_For(ThreadCount(vertCount, options), vertCount, [&](unsigned, unsigned begin, unsigned end)
+			{
+				for (unsigned vert = begin; vert < end; ++vert)
+				{
+					float normal[3] = {};
+					float laplace[3] = {};
+					float area = 0.0f;
+					float angle = 0.0f;
+					bool boundary = false;
+
+					for (unsigned halfEdge : VertRing(mesh, vert))
+					{
+						const FaceIndex faceIndex = mesh.halfEdgeFaces[halfEdge];
+
+						if (faceIndex.type == FaceType::BOUNDARY)
+						{
+							boundary = true;
+							continue;
+						}
+
+						if (needNormal)
+						{
+							const size_t face = faceIndex.index;
+							const float faceArea = targets.faceAreas[face];
+
+							for (unsigned component = 0; component < 3; ++component)
+								normal[component] += targets.faceNormals[face * 3 + component] * faceArea;
+						}
+
+						if (targets.cornerAreas)
+							area += targets.cornerAreas[halfEdge];
+
+						if (targets.cornerAngles)
+							angle += targets.cornerAngles[halfEdge];
+
+						if (targets.cornerLaplace)
+						{
+							for (unsigned component = 0; component < 3; ++component)
+								laplace[component] += targets.cornerLaplace[static_cast<size_t>(halfEdge) * 3 + component];
+						}
+					}
+
+					const float normalLength = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+					const float invNormalLength = normalLength > 0.0f ? 1.0f / normalLength : 0.0f;
+					const bool curved = !boundary && area > 0.0f;
+
+					if (targets.vertNormals)
+					{
+						for (unsigned component = 0; component < 3; ++component)
+							targets.vertNormals[static_cast<size_t>(vert) * 3 + component] = normal[component] * invNormalLength;
+					}
+
+					if (targets.vertAreas)
+						targets.vertAreas[vert] = area;
+
+					// The cotangent weighted edges sum to 4 H n times the vert area
+					if (targets.meanCurvature)
+					{
+						const float length = std::sqrt(laplace[0] * laplace[0] + laplace[1] * laplace[1] + laplace[2] * laplace[2]);
+						const float side = laplace[0] * normal[0] + laplace[1] * normal[1] + laplace[2] * normal[2];
+
+						targets.meanCurvature[vert] = curved ? (side < 0.0f ? -length : length) / (4.0f * area) : 0.0f;
+					}
+
+					if (targets.gaussianCurvature)
+						targets.gaussianCurvature[vert] = curved ? (2.0f * PI - angle) / area : 0.0f;
+				}
+			});
+		}
+	}
+
+	template<typename IdT>
+	static void Compute(const TopologyT<IdT>& mesh, const float* positions, uint32_t flags, Attributes* outAttributes, const AttributeOptions& options)
+	{
+		const size_t faceCount = mesh.faceHalfEdges[FaceType::REAL].size();
+		const size_t vertCount = mesh.verts.size();
+		const size_t halfEdgeCount = mesh.halfEdgeNexts.size();
+		const bool needFaceNormals = (flags & (ATTRIBUTE_FACE_NORMALS | ATTRIBUTE_VERT_NORMALS | ATTRIBUTE_MEAN_CURVATURE)) != 0;
+		const bool needFaceAreas = needFaceNormals || (flags & ATTRIBUTE_FACE_AREAS);
+		const bool needCornerAreas = (flags & (ATTRIBUTE_VERT_AREAS | ATTRIBUTE_MEAN_CURVATURE | ATTRIBUTE_GAUSSIAN_CURVATURE)) != 0;
+
+		std::vector<float> faceNormalScratch;
+		std::vector<float> faceAreaScratch;
+		std::vector<float> cornerAngles;
+		std::vector<float> cornerAreas;
+		std::vector<float> cornerLaplace;
+
+		// Requested arrays double as the pass scratch
+		std::vector<float>* const faceNormals = flags & ATTRIBUTE_FACE_NORMALS ? &outAttributes->faceNormals : &faceNormalScratch;
+		std::vector<float>* const faceAreas = flags & ATTRIBUTE_FACE_AREAS ? &outAttributes->faceAreas : &faceAreaScratch;
+
+		if (needFaceNormals)
+			faceNormals->resize(faceCount * 3);
+
+		if (needFaceAreas)
+			faceAreas->resize(faceCount);
+
+		if (flags & ATTRIBUTE_GAUSSIAN_CURVATURE)
+			cornerAngles.resize(halfEdgeCount);
+
+		if (needCornerAreas)
+			cornerAreas.resize(halfEdgeCount);
+
+		if (flags & ATTRIBUTE_MEAN_CURVATURE)
+			cornerLaplace.resize(halfEdgeCount * 3);
+
+		if (flags & ATTRIBUTE_VERT_NORMALS)
+			outAttributes->vertNormals.resize(vertCount * 3);
+
+		if (flags & ATTRIBUTE_VERT_AREAS)
+			outAttributes->vertAreas.resize(vertCount);
+
+		if (flags & ATTRIBUTE_MEAN_CURVATURE)
+			outAttributes->meanCurvature.resize(vertCount);
+
+		if (flags & ATTRIBUTE_GAUSSIAN_CURVATURE)
+			outAttributes->gaussianCurvature.resize(vertCount);
+
+		const Targets targets = {
+			needFaceNormals ? faceNormals->data() : nullptr,
+			needFaceAreas ? faceAreas->data() : nullptr,
+			cornerAngles.empty() ? nullptr : cornerAngles.data(),
+			cornerAreas.empty() ? nullptr : cornerAreas.data(),
+			cornerLaplace.empty() ? nullptr : cornerLaplace.data(),
+			flags & ATTRIBUTE_VERT_NORMALS ? outAttributes->vertNormals.data() : nullptr,
+			flags & ATTRIBUTE_VERT_AREAS ? outAttributes->vertAreas.data() : nullptr,
+			flags & ATTRIBUTE_MEAN_CURVATURE ? outAttributes->meanCurvature.data() : nullptr,
+			flags & ATTRIBUTE_GAUSSIAN_CURVATURE ? outAttributes->gaussianCurvature.data() : nullptr
+		};
+
+		face::Pass(mesh, positions, targets, options);
+
+		if (flags & ~(ATTRIBUTE_FACE_NORMALS | ATTRIBUTE_FACE_AREAS))
+			vert::Pass(mesh, targets, options);
+	}
+}
+
+namespace mesh
+{
+	namespace half_edge
+	{
+		template<typename IdT>
+		void ComputeAttributes(const TopologyT<IdT>& mesh, const float* positions, uint32_t flags, Attributes* outAttributes, const AttributeOptions& options)
+		{
+			sanity(!(flags & ~ATTRIBUTE_ALL) && "mesh::half_edge::ComputeAttributes unknown flag");
+
+			for (std::vector<float>* attribute : { &outAttributes->faceNormals, &outAttributes->faceAreas, &outAttributes->vertNormals,
+				&outAttributes->vertAreas, &outAttributes->meanCurvature, &outAttributes->gaussianCurvature })
+				attribute->clear();
+
+			if (options.fused)
+			{
+				Compute(mesh, positions, flags, outAttributes, options);
+			}
+			else
+			{
+				for (uint32_t flag = 1; flag & ATTRIBUTE_ALL; flag <<= 1)
+				{
+					if (flags & flag)
+						Compute(mesh, positions, flag, outAttributes, options);
+				}
+			}
+		}
+
+		template void ComputeAttributes(const Topology&, const float*, uint32_t, Attributes*, const AttributeOptions&);
+		template void ComputeAttributes(const Topology64&, const float*, uint32_t, Attributes*, const AttributeOptions&);
+	}
+}
@@ -0,0 +1,926 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <emmintrin.h>
+#include "MeshProc/Bvh.h"
+#include "Parallel.h"
+#include "sanity.h"
+
+namespace
+{
+	using namespace mesh;
+
+	static constexpr unsigned PARALLEL_MIN_TRIS = 1u << 15; // Below this, thread start up costs more than it saves
+	static constexpr unsigned PARALLEL_MIN_QUERIES = 1u << 10;
+	static constexpr unsigned BIN_COUNT = 16;
+	static constexpr unsigned SUBTREE_SPLITS = 256; // Ranges under triCount / SUBTREE_SPLITS are built as separate subtrees
+
+	// Ranges this many splits deep are split at the median instead, which bounds tree depth by MAX_SAH_DEPTH plus
+	// log2 of the face count. Every traversal step pops one entry and pushes at most four, so 3 entries per level
+	// fit in STACK_SIZE.
+	static constexpr unsigned MAX_SAH_DEPTH = 48;
+	static constexpr unsigned STACK_SIZE = 256;
+
+	// Lane 3 is padding, so boxes grow with one SSE min and max
+	struct alignas(16) Box
+	{
+		float mins[4];
+		float maxs[4];
+	};
+
+	namespace box
+	{
+		static Box Empty()
+		{
+			return Box{ { FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+		}
+
+		static void Grow(Box* inoutBox, __m128 mins, __m128 maxs)
+		{
+			_mm_store_ps(inoutBox->mins, _mm_min_ps(_mm_load_ps(inoutBox->mins), mins));
+			_mm_store_ps(inoutBox->maxs, _mm_max_ps(_mm_load_ps(inoutBox->maxs), maxs));
+		}
+
+		static void Grow(Box* inoutBox, const Box& other)
+		{
+			Grow(inoutBox, _mm_load_ps(other.mins), _mm_load_ps(other.maxs));
+		}
+
+		static __m128 Centroid(const Box& box)
+		{
+			return _mm_mul_ps(_mm_add_ps(_mm_load_ps(box.mins), _mm_load_ps(box.maxs)), _mm_set1_ps(0.5f));
+		}
+
+		static float Centroid(const Box& box, unsigned axis)
+		{
+			return (box.mins[axis] + box.maxs[axis]) * 0.5f;
+		}
+
+		static void GrowCentroid(Box* inoutBox, const Box& other)
+		{
+			const __m128 centroid = Centroid(other);
+
+			Grow(inoutBox, centroid, centroid);
+		}
+
+		static float HalfArea(const Box& box)
+		{
+			const float x = box.maxs[0] - box.mins[0];
+			const float y = box.maxs[1] - box.mins[1];
+			const float z = box.maxs[2] - box.mins[2];
+
+			return x < 0.0f ? 0.0f : x * y + y * z + z * x;
+		}
+	}
+
+	namespace build
+	{
+		struct Range
+		{
+			unsigned begin, end;
+			unsigned depth;
+			Box bounds;
+			Box centroidBounds;
+
+			unsigned Count() const { return end - begin; }
+		};
+
+		struct Bin
+		{
+			Box bounds = box::Empty();
+			Box centroidBounds = box::Empty();
+			unsigned count = 0;
+
+			void Add(const Bin& other)
+			{
+				box::Grow(&bounds, other.bounds);
+				box::Grow(&centroidBounds, other.centroidBounds);
+				count += other.count;
+			}
+		};
+
+		struct Bins
+		{
+			Bin bins[3][BIN_COUNT];
+		};
+
+		struct Context
+		{
+			// Reordered together in place as ranges split, so binning reads boxes in order
+			Box* boxes;
+			unsigned* faces;
+			unsigned maxLeafFaces;
+		};
+
+		// Pending node to fill from a range
+		struct Task
+		{
+			Range range;
+			unsigned node;
+		};
+
+		// Range left for a separate subtree, to be linked into children[slot] of node
+		struct Subtree
+		{
+			Range range;
+			unsigned node;
+			unsigned slot;
+		};
+
+		static float BinScale(const Range& range, unsigned axis)
+		{
+			const float extent = range.centroidBounds.maxs[axis] - range.centroidBounds.mins[axis];
+
+			return extent > 0.0f ? BIN_COUNT / extent : 0.0f;
+		}
+
+		// Bin of the face's centroid along each axis. Binning and partitioning both go through here, so they agree.
+		struct Binner
+		{
+			__m128 centroidMins;
+			__m128 scales;
+
+			explicit Binner(const Range& range)
+				: centroidMins(_mm_load_ps(range.centroidBounds.mins))
+				, scales(_mm_setr_ps(BinScale(range, 0), BinScale(range, 1), BinScale(range, 2), 0.0f))
+			{
+			}
+
+			void Indices(const Box& faceBox, int* outIndices) const
+			{
+				const __m128 offsets = _mm_mul_ps(_mm_sub_ps(box::Centroid(faceBox), centroidMins), scales);
+
+				_mm_store_si128(reinterpret_cast<__m128i*>(outIndices), _mm_cvttps_epi32(_mm_min_ps(offsets, _mm_set1_ps(BIN_COUNT - 1.0f))));
+			}
+		};
+
+		// Bins only take mins, maxs and counts, so merging slices gives the same bins for any thread count
+		static void BinFaces(const Context& ctx, const Range& range, unsigned threadCount, Bins* outBins)
+		{
+			const unsigned sliceCount = range.Count() < PARALLEL_MIN_TRIS ? 1 : threadCount;
+			const Binner binner(range);
+			std::vector<Bins> sliceBins(sliceCount - 1);
+
+			Parallel_For(sliceCount, range.Count(), [&](unsigned threadIndex, unsigned begin, unsigned end)
+			{
+				Bins& bins = threadIndex ? sliceBins[threadIndex - 1] : *outBins;
+
+				for (unsigned index = range.begin + begin; index < range.begin + end; ++index)
+				{
+					const Box& faceBox = ctx.boxes[index];
+					const __m128 mins = _mm_load_ps(faceBox.mins);
+					const __m128 maxs = _mm_load_ps(faceBox.maxs);
+					const __m128 centroid = box::Centroid(faceBox);
+					alignas(16) int binIndices[4];
+
+					binner.Indices(faceBox, binIndices);
+
+					for (unsigned axis = 0; axis < 3; ++axis)
+					{
+						Bin& bin = bins.bins[axis][binIndices[axis]];
+
+						box::Grow(&bin.bounds, mins, maxs);
+						box::Grow(&bin.centroidBounds, centroid, centroid);
+						++bin.count;
+					}
+				}
+			});
+
+			for (const Bins& bins : sliceBins)
+			{
+				for (unsigned axis = 0; axis < 3; ++axis)
+				{
+					for (unsigned bin = 0; bin < BIN_COUNT; ++bin)
+						outBins->bins[axis][bin].Add(bins.bins[axis][bin]);
+				}
+			}
+		}
+
+		static Range MakeRange(const Context& ctx, unsigned begin, unsigned end, unsigned depth)
+		{
+			Range range{ begin, end, depth, box::Empty(), box::Empty() };
+
+			for (unsigned index = begin; index < end; ++index)
+			{
+				box::Grow(&range.bounds, ctx.boxes[index]);
+				box::GrowCentroid(&range.centroidBounds, ctx.boxes[index]);
+			}
+
+			return range;
+		}
+
+		// Binned SAH split, falling back to the median along the widest centroid extent when the range is too deep
+		// or every centroid coincides. Both sides always get at least one face. range is a copy, as outLeft may be
+		// the range being split.
+		static void Split(const Context& ctx, const Range range, unsigned threadCount, Range* outLeft, Range* outRight)
+		{
+			unsigned bestAxis = ~0u;
+			unsigned bestSplit = 0;
+			float bestCost = FLT_MAX;
+			Bins bins;
+
+			if (range.depth < MAX_SAH_DEPTH)
+			{
+				BinFaces(ctx, range, threadCount, &bins);
+
+				for (unsigned axis = 0; axis < 3; ++axis)
+				{
+					if (!(range.centroidBounds.maxs[axis] > range.centroidBounds.mins[axis]))
+						continue;
+
+					// rightCosts[split] covers bins split onward
+					float rightCosts[BIN_COUNT];
+					Bin right;
+
+					for (unsigned split = BIN_COUNT - 1; split > 0; --split)
+					{
+						right.Add(bins.bins[axis][split]);
+						rightCosts[split] = box::HalfArea(right.bounds) * right.count;
+					}
+
+					Bin left;
+
+					for (unsigned split = 1; split < BIN_COUNT; ++split)
+					{
+						left.Add(bins.bins[axis][split - 1]);
+
+						const float cost = box::HalfArea(left.bounds) * left.count + rightCosts[split];
+
+						if (left.count && left.count < range.Count() && cost < bestCost)
+						{
+							bestCost = cost;
+							bestAxis = axis;
+							bestSplit = split;
+						}
+					}
+				}
+			}
+
+			if (bestAxis != ~0u)
+			{
+				const Binner binner(range);
+				const auto isLeft = [&](unsigned index)
+				{
+					alignas(16) int binIndices[4];
+
+					binner.Indices(ctx.boxes[index], binIndices);
+					return static_cast<unsigned>(binIndices[bestAxis]) < bestSplit;
+				};
+				unsigned mid = range.begin;
+
+				for (unsigned last = range.end; ; ++mid, --last)
+				{
+					while (mid < last && isLeft(mid))
+						++mid;
+
+					while (mid < last && !isLeft(last - 1))
+						--last;
+
+					if (mid == last)
+						break;
+
+					std::swap(ctx.boxes[mid], ctx.boxes[last - 1]);
+					std::swap(ctx.faces[mid], ctx.faces[last - 1]);
+				}
+				Bin left, right;
+
+				for (unsigned bin = 0; bin < BIN_COUNT; ++bin)
+					(bin < bestSplit ? left : right).Add(bins.bins[bestAxis][bin]);
+
+				sanity(mid - range.begin == left.count && "Partition disagrees with its bins");
+
+				*outLeft = Range{ range.begin, mid, range.depth + 1, left.bounds, left.centroidBounds };
+				*outRight = Range{ mid, range.end, range.depth + 1, right.bounds, right.centroidBounds };
+				return;
+			}
+
+			unsigned axis = 0;
+
+			for (unsigned other = 1; other < 3; ++other)
+			{
+				if (range.centroidBounds.maxs[other] - range.centroidBounds.mins[other] > range.centroidBounds.maxs[axis] - range.centroidBounds.mins[axis])
+					axis = other;
+			}
+
+			// Rare enough to reorder through scratch copies
+			const unsigned mid = range.begin + range.Count() / 2;
+			std::vector<unsigned> order(range.Count());
+			std::vector<Box> boxes(range.Count());
+			std::vector<unsigned> faces(range.Count());
+
+			for (unsigned index = 0; index < range.Count(); ++index)
+				order[index] = range.begin + index;
+
+			std::nth_element(order.begin(), order.begin() + (mid - range.begin), order.end(), [&](unsigned a, unsigned b)
+			{
+				const float centroidA = box::Centroid(ctx.boxes[a], axis);
+				const float centroidB = box::Centroid(ctx.boxes[b], axis);
+
+				return centroidA < centroidB || (centroidA == centroidB && a < b);
+			});
+
+			for (unsigned index = 0; index < range.Count(); ++index)
+			{
+				boxes[index] = ctx.boxes[order[index]];
+				faces[index] = ctx.faces[order[index]];
+			}
+
+			std::copy(boxes.begin(), boxes.end(), ctx.boxes + range.begin);
+			std::copy(faces.begin(), faces.end(), ctx.faces + range.begin);
+
+			*outLeft = MakeRange(ctx, range.begin, mid, range.depth + 1);
+			*outRight = MakeRange(ctx, mid, range.end, range.depth + 1);
+		}
+
+		static BvhNode EmptyNode()
+		{
+			BvhNode node;
+
+			for (unsigned slot = 0; slot < 4; ++slot)
+			{
+				for (unsigned axis = 0; axis < 3; ++axis)
+				{
+					node.bounds[axis][slot] = FLT_MAX;
+					node.bounds[axis + 3][slot] = -FLT_MAX;
+				}
+
+				node.children[slot] = ~0u;
+				node.faceCounts[slot] = 0;
+			}
+
+			return node;
+		}
+
+		// Each node splits its range into up to 4 children, always splitting the largest child still holding more than
+		// maxLeafFaces. Children under subtreeMinFaces go to optOutSubtrees instead of workTasks when it is given.
+		static void BuildNodes(const Context& ctx, unsigned threadCount, unsigned subtreeMinFaces, std::vector<Task>* workTasks, std::vector<BvhNode>* inoutNodes, std::vector<Subtree>* optOutSubtrees)
+		{
+			while (!workTasks->empty())
+			{
+				const Task task = workTasks->back();
+				Range childRanges[4] = { task.range };
+				unsigned childCount = 1;
+
+				workTasks->pop_back();
+
+				while (childCount < 4)
+				{
+					unsigned largest = ~0u;
+					float largestArea = -1.0f;
+
+					for (unsigned child = 0; child < childCount; ++child)
+					{
+						if (childRanges[child].Count() > ctx.maxLeafFaces && box::HalfArea(childRanges[child].bounds) > largestArea)
+						{
+							largest = child;
+							largestArea = box::HalfArea(childRanges[child].bounds);
+						}
+					}
+
+					if (largest == ~0u)
+						break;
+
+					Split(ctx, childRanges[largest], threadCount, &childRanges[largest], &childRanges[childCount]);
+					++childCount;
+				}
+
+				BvhNode node = EmptyNode();
+
+				for (unsigned child = 0; child < childCount; ++child)
+				{
+					const Range& range = childRanges[child];
+
+					for (unsigned axis = 0; axis < 3; ++axis)
+					{
+						node.bounds[axis][child] = range.bounds.mins[axis];
+						node.bounds[axis + 3][child] = range.bounds.maxs[axis];
+					}
+
+					if (range.Count() <= ctx.maxLeafFaces)
+					{
+						node.children[child] = range.begin;
+						node.faceCounts[child] = range.Count();
+					}
+					else if (optOutSubtrees && range.Count() < subtreeMinFaces)
+					{
+						optOutSubtrees->push_back(Subtree{ range, task.node, child });
+					}
+					else
+					{
+						node.children[child] = static_cast<unsigned>(inoutNodes->size());
+						inoutNodes->push_back(BvhNode());
+						workTasks->push_back(Task{ range, node.children[child] });
+					}
+				}
+
+				(*inoutNodes)[task.node] = node;
+			}
+		}
+	}
+
+	namespace vec
+	{
+		static void Sub(const float* a, const float* b, float* out)
+		{
+			out[0] = a[0] - b[0];
+			out[1] = a[1] - b[1];
+			out[2] = a[2] - b[2];
+		}
+
+		static void Cross(const float* a, const float* b, float* out)
+		{
+			out[0] = a[1] * b[2] - a[2] * b[1];
+			out[1] = a[2] * b[0] - a[0] * b[2];
+			out[2] = a[0] * b[1] - a[1] * b[0];
+		}
+
+		static float Dot(const float* a, const float* b)
+		{
+			return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+		}
+
+		static float DistanceSquared(const float* a, const float* b)
+		{
+			float diff[3];
+
+			Sub(a, b, diff);
+			return Dot(diff, diff);
+		}
+	}
+
+	namespace traverse
+	{
+		// Either a node, or a leaf when faceCount is non zero, with the distance it was reached at
+		struct Entry
+		{
+			unsigned child;
+			unsigned faceCount;
+			float distance;
+		};
+
+		static const float* FaceVert(const Bvh& bvh, unsigned face, unsigned corner)
+		{
+			return bvh.verts + bvh.indices[face * 3 + corner] * 3ull;
+		}
+
+		// Pushes the children in lanes of hitMask, farthest first so the nearest is popped next
+		static void PushChildren(const BvhNode& node, int hitMask, __m128 distances, Entry* stack, unsigned* inoutSize)
+		{
+			alignas(16) float laneDistances[4];
+			Entry children[4];
+			unsigned count = 0;
+
+			_mm_store_ps(laneDistances, distances);
+
+			for (unsigned slot = 0; slot < 4; ++slot)
+			{
+				if (!(hitMask & (1 << slot)))
+					continue;
+
+				const Entry entry{ node.children[slot], node.faceCounts[slot], laneDistances[slot] };
+				unsigned at = count++;
+
+				for (; at > 0 && children[at - 1].distance < entry.distance; --at)
+					children[at] = children[at - 1];
+
+				children[at] = entry;
+			}
+
+			sanity(*inoutSize + count <= STACK_SIZE && "Bvh deeper than its traversal stack");
+
+			for (unsigned child = 0; child < count; ++child)
+				stack[(*inoutSize)++] = children[child];
+		}
+
+		struct RaySetup
+		{
+			__m128 origin[3];
+			__m128 invDir[3];
+			unsigned nearRows[3]; // Row of BvhNode::bounds the ray enters each axis' slab through
+		};
+
+		// Tiny direction components are nudged off zero, so slab distances stay free of 0 * inf
+		static RaySetup SetupRay(const Ray& ray)
+		{
+			RaySetup setup;
+
+			for (unsigned axis = 0; axis < 3; ++axis)
+			{
+				float dir = ray.dir[axis];
+
+				if (std::fabs(dir) < 1e-30f)
+					dir = std::signbit(dir) ? -1e-30f : 1e-30f;
+
+				setup.origin[axis] = _mm_set1_ps(ray.origin[axis]);
+				setup.invDir[axis] = _mm_set1_ps(1.0f / dir);
+				setup.nearRows[axis] = dir < 0.0f ? axis + 3 : axis;
+			}
+
+			return setup;
+		}
+
+		// Tests the ray against all 4 child boxes at once, giving the lanes hit within [tMin, tMax] and their entry
+		// distances. Empty slots are inverted boxes, so their entry lies past their exit and they never hit.
+		static int HitChildren(const BvhNode& node, const RaySetup& setup, float tMin, float tMax, __m128* outEntry)
+		{
+			__m128 entry = _mm_set1_ps(tMin);
+			__m128 exit = _mm_set1_ps(tMax);
+
+			for (unsigned axis = 0; axis < 3; ++axis)
+			{
+				const unsigned nearRow = setup.nearRows[axis];
+				const unsigned farRow = nearRow < 3 ? nearRow + 3 : nearRow - 3;
+				const __m128 near = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.bounds[nearRow]), setup.origin[axis]), setup.invDir[axis]);
+				const __m128 far = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.bounds[farRow]), setup.origin[axis]), setup.invDir[axis]);
+
+				entry = _mm_max_ps(entry, near);
+				exit = _mm_min_ps(exit, far);
+			}
+
+			*outEntry = entry;
+			return _mm_movemask_ps(_mm_cmple_ps(entry, exit));
+		}
+
+		// Moller-Trumbore, two sided
+		static bool HitFace(const Bvh& bvh, unsigned face, const Ray& ray, float tMax, RayHit* outHit)
+		{
+			const float* const p0 = FaceVert(bvh, face, 0);
+			float edge1[3], edge2[3], pvec[3], tvec[3], qvec[3];
+
+			vec::Sub(FaceVert(bvh, face, 1), p0, edge1);
+			vec::Sub(FaceVert(bvh, face, 2), p0, edge2);
+			vec::Cross(ray.dir, edge2, pvec);
+
+			const float det = vec::Dot(edge1, pvec);
+
+			if (det == 0.0f)
+				return false;
+
+			const float invDet = 1.0f / det;
+
+			vec::Sub(ray.origin, p0, tvec);
+
+			const float u = vec::Dot(tvec, pvec) * invDet;
+
+			if (u < 0.0f || u > 1.0f)
+				return false;
+
+			vec::Cross(tvec, edge1, qvec);
+
+			const float v = vec::Dot(ray.dir, qvec) * invDet;
+
+			if (v < 0.0f || u + v > 1.0f)
+				return false;
+
+			const float t = vec::Dot(edge2, qvec) * invDet;
+
+			if (t < ray.tMin || t > tMax)
+				return false;
+
+			*outHit = RayHit{ face, t, u, v };
+			return true;
+		}
+
+		// Ericson's region test, Real-Time Collision Detection 5.1.5
+		static void ClosestOnFace(const Bvh& bvh, unsigned face, const float* point, float* outPoint)
+		{
+			const float* const a = FaceVert(bvh, face, 0);
+			const float* const b = FaceVert(bvh, face, 1);
+			const float* const c = FaceVert(bvh, face, 2);
+			float ab[3], ac[3], ap[3], bp[3], cp[3];
+
+			const auto set = [&](const float* from, const float* dir, float weight)
+			{
+				for (unsigned axis = 0; axis < 3; ++axis)
+					outPoint[axis] = from[axis] + dir[axis] * weight;
+			};
+
+			vec::Sub(b, a, ab);
+			vec::Sub(c, a, ac);
+			vec::Sub(point, a, ap);
+
+			const float d1 = vec::Dot(ab, ap);
+			const float d2 = vec::Dot(ac, ap);
+
+			if (d1 <= 0.0f && d2 <= 0.0f)
+				return set(a, ab, 0.0f);
+
+			vec::Sub(point, b, bp);
+
+			const float d3 = vec::Dot(ab, bp);
+			const float d4 = vec::Dot(ac, bp);
+
+			if (d3 >= 0.0f && d4 <= d3)
+				return set(b, ab, 0.0f);
+
+			const float vc = d1 * d4 - d3 * d2;
+
+			if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+				return set(a, ab, d1 / (d1 - d3));
+
+			vec::Sub(point, c, cp);
+
+			const float d5 = vec::Dot(ab, cp);
+			const float d6 = vec::Dot(ac, cp);
+
+			if (d6 >= 0.0f && d5 <= d6)
+				return set(c, ab, 0.0f);
+
+			const float vb = d5 * d2 - d1 * d6;
+
+			if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+				return set(a, ac, d2 / (d2 - d6));
+
+			const float va = d3 * d6 - d5 * d4;
+
+			if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f)
+			{
+				float bc[3];
+
+				vec::Sub(c, b, bc);
+				return set(b, bc, (d4 - d3) / ((d4 - d3) + (d5 - d6)));
+			}
+
+			const float sum = va + vb + vc;
+
+			// Only a degenerate face reaches the interior with no area, where a is as good as any point
+			if (!(sum > 0.0f))
+				return set(a, ab, 0.0f);
+
+			for (unsigned axis = 0; axis < 3; ++axis)
+				outPoint[axis] = a[axis] + ab[axis] * (vb / sum) + ac[axis] * (vc / sum);
+		}
+
+		// Squared distance from the point to all 4 child boxes. Inverted empty slots come out at infinity.
+		static __m128 BoxDistances(const BvhNode& node, const __m128* point)
+		{
+			__m128 distance = _mm_setzero_ps();
+
+			for (unsigned axis = 0; axis < 3; ++axis)
+			{
+				const __m128 below = _mm_sub_ps(_mm_load_ps(node.bounds[axis]), point[axis]);
+				const __m128 above = _mm_sub_ps(point[axis], _mm_load_ps(node.bounds[axis + 3]));
+				const __m128 outside = _mm_max_ps(_mm_max_ps(below, above), _mm_setzero_ps());
+
+				distance = _mm_add_ps(distance, _mm_mul_ps(outside, outside));
+			}
+
+			return distance;
+		}
+	}
+
+	static unsigned QueryThreadCount(unsigned count, const BvhQueryOptions& options)
+	{
+		return count < PARALLEL_MIN_QUERIES ? 1 : Parallel_ThreadCount(options.threadCount);
+	}
+}
+
+namespace mesh
+{
+	void BuildBvh(const float* verts, const unsigned* indices, unsigned triCount, Bvh* outBvh, const BvhOptions& options)
+	{
+		sanity(options.maxLeafFaces >= 1 && options.maxLeafFaces <= 16 && "maxLeafFaces out of range");
+
+		const unsigned threadCount = triCount < PARALLEL_MIN_TRIS ? 1 : Parallel_ThreadCount(options.threadCount);
+		std::vector<Box> faceBoxes(triCount);
+
+		outBvh->verts = verts;
+		outBvh->indices = indices;
+		outBvh->nodes.clear();
+		outBvh->faces.resize(triCount);
+
+		if (!triCount)
+			return;
+
+		Parallel_For(threadCount, triCount, [&](unsigned, unsigned begin, unsigned end)
+		{
+			for (unsigned face = begin; face < end; ++face)
+			{
+				Box& faceBox = faceBoxes[face];
+
+				faceBox = Box{ { FLT_MAX, FLT_MAX, FLT_MAX, 0.0f }, { -FLT_MAX, -FLT_MAX, -FLT_MAX, 0.0f } };
+				outBvh->faces[face] = face;
+
+				for (unsigned corner = 0; corner < 3; ++corner)
+				{
+					const float* const vert = verts + indices[face * 3 + corner] * 3ull;
+
+					for (unsigned axis = 0; axis < 3; ++axis)
+					{
+						faceBox.mins[axis] = std::min(faceBox.mins[axis], vert[axis]);
+						faceBox.maxs[axis] = std::max(faceBox.maxs[axis], vert[axis]);
+					}
+				}
+			}
+		});
+
+		const build::Context ctx{ faceBoxes.data(), outBvh->faces.data(), options.maxLeafFaces };
+		std::vector<build::Task> tasks{ build::Task{ build::MakeRange(ctx, 0, triCount, 0), 0 } };
+		std::vector<build::Subtree> subtrees;
+
+		// Subtrees are cut by face count alone, so the layout does not depend on the thread count
+		const unsigned subtreeMinFaces = triCount < PARALLEL_MIN_TRIS ? 0 : std::max(triCount / SUBTREE_SPLITS, PARALLEL_MIN_TRIS / 8);
+
+		outBvh->nodes.push_back(BvhNode());
+		build::BuildNodes(ctx, threadCount, subtreeMinFaces, &tasks, &outBvh->nodes, &subtrees);
+
+		if (subtrees.empty())
+			return;
+
+		std::vector<std::vector<BvhNode>> subtreeNodes(subtrees.size());
+
+		Parallel_For(std::min(threadCount, static_cast<unsigned>(subtrees.size())), static_cast<unsigned>(subtrees.size()), [&](unsigned, unsigned begin, unsigned end)
+		{
+			std::vector<build::Task> workTasks;
+
+			for (unsigned subtree = begin; subtree < end; ++subtree)
+			{
+				subtreeNodes[subtree].push_back(BvhNode());
+				workTasks.push_back(build::Task{ subtrees[subtree].range, 0 });
+				build::BuildNodes(ctx, 1, 0, &workTasks, &subtreeNodes[subtree], nullptr);
+			}
+		});
+
+		std::vector<unsigned> subtreeStarts(subtrees.size());
+		size_t nodeCount = outBvh->nodes.size();
+
+		for (size_t subtree = 0; subtree < subtrees.size(); ++subtree)
+		{
+			subtreeStarts[subtree] = static_cast<unsigned>(nodeCount);
+			outBvh->nodes[subtrees[subtree].node].children[subtrees[subtree].slot] = subtreeStarts[subtree];
+			nodeCount += subtreeNodes[subtree].size();
+		}
+
+		outBvh->nodes.resize(nodeCount);
+
+		Parallel_For(std::min(threadCount, static_cast<unsigned>(subtrees.size())), static_cast<unsigned>(subtrees.size()), [&](unsigned, unsigned begin, unsigned end)
+		{
+			for (unsigned subtree = begin; subtree < end; ++subtree)
+			{
+				BvhNode* const out = &outBvh->nodes[subtreeStarts[subtree]];
+
+				for (size_t node = 0; node < subtreeNodes[subtree].size(); ++node)
+				{
+					out[node] = subtreeNodes[subtree][node];
+
+					for (unsigned slot = 0; slot < 4; ++slot)
+					{
+						if (!out[node].faceCounts[slot] && out[node].children[slot] != ~0u)
+							out[node].children[slot] += subtreeStarts[subtree];
+					}
+				}
+			}
+		});
+	}
+
+	bool Intersect(const Bvh& bvh, const Ray& ray, RayHit* outHit)
+	{
+		const traverse::RaySetup setup = traverse::SetupRay(ray);
+		traverse::Entry stack[STACK_SIZE];
+		unsigned stackSize = 0;
+
+		*outHit = RayHit();
+
+		if (!bvh.nodes.empty())
+			stack[stackSize++] = traverse::Entry{ 0, 0, ray.tMin };
+
+		float tMax = ray.tMax;
+
+		while (stackSize)
+		{
+			const traverse::Entry entry = stack[--stackSize];
+
+			if (entry.distance > tMax)
+				continue;
+
+			if (entry.faceCount)
+			{
+				for (unsigned index = entry.child; index < entry.child + entry.faceCount; ++index)
+				{
+					if (traverse::HitFace(bvh, bvh.faces[index], ray, tMax, outHit))
+						tMax = outHit->t;
+				}
+				continue;
+			}
+
+			const BvhNode& node = bvh.nodes[entry.child];
+			__m128 entries;
+			const int hitMask = traverse::HitChildren(node, setup, ray.tMin, tMax, &entries);
+
+			traverse::PushChildren(node, hitMask, entries, stack, &stackSize);
+		}
+
+		return outHit->face != BVH_NO_FACE;
+	}
+
+	bool Occluded(const Bvh& bvh, const Ray& ray)
+	{
+		const traverse::RaySetup setup = traverse::SetupRay(ray);
+		traverse::Entry stack[STACK_SIZE];
+		unsigned stackSize = 0;
+		RayHit hit;
+
+		if (!bvh.nodes.empty())
+			stack[stackSize++] = traverse::Entry{ 0, 0, ray.tMin };
+
+		while (stackSize)
+		{
+			const traverse::Entry entry = stack[--stackSize];
+
+			if (entry.faceCount)
+			{
+				for (unsigned index = entry.child; index < entry.child + entry.faceCount; ++index)
+				{
+					if (traverse::HitFace(bvh, bvh.faces[index], ray, ray.tMax, &hit))
+						return true;
+				}
+				continue;
+			}
+
+			const BvhNode& node = bvh.nodes[entry.child];
+			__m128 entries;
+			const int hitMask = traverse::HitChildren(node, setup, ray.tMin, ray.tMax, &entries);
+
+			traverse::PushChildren(node, hitMask, entries, stack, &stackSize);
+		}
+
+		return false;
+	}
+
+	bool FindClosestPoint(const Bvh& bvh, const float* point, ClosestPoint* outClosest, float maxDistance)
+	{
+		const __m128 lanePoint[3] = { _mm_set1_ps(point[0]), _mm_set1_ps(point[1]), _mm_set1_ps(point[2]) };
+		traverse::Entry stack[STACK_SIZE];
+		unsigned stackSize = 0;
+		float best = maxDistance * maxDistance;
+
+		*outClosest = ClosestPoint();
+
+		if (!bvh.nodes.empty())
+			stack[stackSize++] = traverse::Entry{ 0, 0, 0.0f };
+
+		while (stackSize)
+		{
+			const traverse::Entry entry = stack[--stackSize];
+
+			if (entry.distance >= best)
+				continue;
+
+			if (entry.faceCount)
+			{
+				for (unsigned index = entry.child; index < entry.child + entry.faceCount; ++index)
+				{
+					float onFace[3];
+
+					traverse::ClosestOnFace(bvh, bvh.faces[index], point, onFace);
+
+					const float distance = vec::DistanceSquared(point, onFace);
+
+					if (distance < best)
+					{
+						best = distance;
+						*outClosest = ClosestPoint{ bvh.faces[index], { onFace[0], onFace[1], onFace[2] }, distance };
+					}
+				}
+				continue;
+			}
+
+			const BvhNode& node = bvh.nodes[entry.child];
+			const __m128 distances = traverse::BoxDistances(node, lanePoint);
+			const int hitMask = _mm_movemask_ps(_mm_cmplt_ps(distances, _mm_set1_ps(best)));
+
+			traverse::PushChildren(node, hitMask, distances, stack, &stackSize);
+		}
+
+		return outClosest->face != BVH_NO_FACE;
+	}
+
+	void Intersect(const Bvh& bvh, const Ray* rays, unsigned rayCount, RayHit* outHits, const BvhQueryOptions& options)
+	{
+		Parallel_For(QueryThreadCount(rayCount, options), rayCount, [&](unsigned, unsigned begin, unsigned end)
+		{
+			for (unsigned ray = begin; ray < end; ++ray)
+				Intersect(bvh, rays[ray], &outHits[ray]);
+		});
+	}
+
+	void Occluded(const Bvh& bvh, const Ray* rays, unsigned rayCount, uint8_t* outOccluded, const BvhQueryOptions& options)
+	{
+		Parallel_For(QueryThreadCount(rayCount, options), rayCount, [&](unsigned, unsigned begin, unsigned end)
+		{
+			for (unsigned ray = begin; ray < end; ++ray)
+				outOccluded[ray] = Occluded(bvh, rays[ray]) ? 1 : 0;
+		});
+	}
+
+	void FindClosestPoints(const Bvh& bvh, const float* points, unsigned pointCount, ClosestPoint* outClosest, float maxDistance, const BvhQueryOptions& options)
+	{
+		Parallel_For(QueryThreadCount(pointCount, options), pointCount, [&](unsigned, unsigned begin, unsigned end)
+		{
+			for (unsigned point = begin; point < end; ++point)
+				FindClosestPoint(bvh, points + point * 3ull, &outClosest[point], maxDistance);
+		});
+	}
+}
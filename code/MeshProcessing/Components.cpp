@@ -0,0 +1,250 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "MeshProc/Components.h"
+#include "MeshProc/HalfEdgeCirculators.h"
+#include "Parallel.h"
+#include "sanity.h"
+
+namespace
+{
+	using namespace mesh;
+	using namespace mesh::half_edge;
+
+	// Below this the threads cost more than the passes they split
+	static constexpr unsigned PARALLEL_MIN_ELEMENTS = 1u << 14;
+
+	static unsigned ThreadCount(unsigned elementCount, const ComponentOptions& options)
+	{
+		return elementCount < PARALLEL_MIN_ELEMENTS ? 1 : std::min(Parallel_ThreadCount(options.threadCount), elementCount / (PARALLEL_MIN_ELEMENTS / 4));
+	}
+
+	// Parents only ever move to lower verts: links go from the higher root to the lower one, and path halving swaps a
+	// parent for its own parent. A root only changes through a compare exchange that still sees it as a root, so
+	// concurrent links never lose a union.
+	namespace union_find
+	{
+		static unsigned Find(std::atomic<unsigned>* parents, unsigned vert)
+		{
+			for (;;)
+			{
+				unsigned parent = parents[vert].load(std::memory_order_relaxed);
+
+				if (parent == vert)
+					return vert;
+
+				const unsigned grandParent = parents[parent].load(std::memory_order_relaxed);
+
+				if (grandParent != parent)
+					parents[vert].compare_exchange_weak(parent, grandParent, std::memory_order_relaxed);
+
+				vert = grandParent;
+			}
+		}
+
+		static void Union(std::atomic<unsigned>* parents, unsigned lhs, unsigned rhs)
+		{
+			for (;;)
+			{
+				lhs = Find(parents, lhs);
+				rhs = Find(parents, rhs);
+
+				if (lhs == rhs)
+					return;
+
+				if (lhs < rhs)
+					std::swap(lhs, rhs);
+
+				unsigned expected = lhs;
+
+				if (parents[lhs].compare_exchange_strong(expected, rhs, std::memory_order_relaxed))
+					return;
+			}
+		}
+	}
+
+	namespace count
+	{
+		struct Counts
+		{
+			unsigned verts, edges, faces, boundaries;
+		};
+
+		// Per slice counts for each component, summed over slices afterwards so no counter is shared between threads
+		template<typename ElementFn>
+		static void AddSlices(unsigned threadCount, unsigned elementCount, std::vector<std::vector<Counts>>* inoutSliceCounts, const ElementFn& elementFn)
+		{
+			Parallel_For(threadCount, elementCount, [&](unsigned threadIndex, unsigned begin, unsigned end)
+			{
+				std::vector<Counts>& counts = (*inoutSliceCounts)[threadIndex];
+
+				for (unsigned element = begin; element < end; ++element)
+					elementFn(element, counts.data());
+			});
+		}
+	}
+}
+
+namespace mesh
+{
+	namespace half_edge
+	{
+		template<typename IdT>
+		void FindComponents(const TopologyT<IdT>& mesh, Components* outComponents, const ComponentOptions& options)
+		{
+			const unsigned vertCount = static_cast<unsigned>(mesh.verts.size());
+			const unsigned edgeCount = static_cast<unsigned>(mesh.halfEdgeNexts.size() / 2);
+			const unsigned faceCount = static_cast<unsigned>(mesh.faceHalfEdges[FaceType::REAL].size());
+			const unsigned boundaryCount = static_cast<unsigned>(mesh.faceHalfEdges[FaceType::BOUNDARY].size());
+			const unsigned vertThreadCount = ThreadCount(vertCount, options);
+			std::vector<std::atomic<unsigned>> parents(vertCount);
+			std::vector<unsigned>& vertComponents = outComponents->vertComponents;
+
+			Parallel_For(vertThreadCount, vertCount, [&](unsigned, unsigned begin, unsigned end)
+			{
+				for (unsigned vert = begin; vert < end; ++vert)
+					parents[vert].store(vert, std::memory_order_relaxed);
+			});
+
+			Parallel_For(ThreadCount(edgeCount, options), edgeCount, [&](unsigned, unsigned begin, unsigned end)
+			{
+				for (unsigned edge = begin; edge < end; ++edge)
+				{
+					if (mesh.halfEdgeNexts[edge * 2] != ~0u)
+						union_find::Union(parents.data(), mesh.halfEdgeVerts[edge * 2], mesh.halfEdgeVerts[edge * 2 + 1]);
+				}
+			});
+
+			// Roots are numbered in vert order from per slice counts
+			std::vector<unsigned> sliceRootCounts(vertThreadCount + 1, 0);
+
+			vertComponents.resize(vertCount);
+			Parallel_For(vertThreadCount, vertCount, [&](unsigned threadIndex, unsigned begin, unsigned end)
+			{
+				for (unsigned vert = begin; vert < end; ++vert)
+				{
+					if (mesh.vertHalfEdges[vert] == ~0u)
+					{
+						vertComponents[vert] = COMPONENT_NONE;
+						continue;
+					}
+
+					vertComponents[vert] = union_find::Find(parents.data(), vert);
+					sliceRootCounts[threadIndex + 1] += vertComponents[vert] == vert;
+				}
+			});
+
+			for (unsigned threadIndex = 0; threadIndex < vertThreadCount; ++threadIndex)
+				sliceRootCounts[threadIndex + 1] += sliceRootCounts[threadIndex];
+
+			const unsigned componentCount = sliceRootCounts[vertThreadCount];
+
+			// The union find is done, so each root's parent slot takes its component number for the verts to look up
+			Parallel_For(vertThreadCount, vertCount, [&](unsigned threadIndex, unsigned begin, unsigned end)
+			{
+				unsigned component = sliceRootCounts[threadIndex];
+
+				for (unsigned vert = begin; vert < end; ++vert)
+				{
+					if (vertComponents[vert] == vert)
+						parents[vert].store(component++, std::memory_order_relaxed);
+				}
+			});
+
+			Parallel_For(vertThreadCount, vertCount, [&](unsigned, unsigned begin, unsigned end)
+			{
+				for (unsigned vert = begin; vert < end; ++vert)
+				{
+					if (vertComponents[vert] != COMPONENT_NONE)
+						vertComponents[vert] = parents[vertComponents[vert]].load(std::memory_order_relaxed);
+				}
+			});
+
+			parents = std::vector<std::atomic<unsigned>>();
+
+			outComponents->faceComponents.resize(faceCount);
+			Parallel_For(ThreadCount(faceCount, options), faceCount, [&](unsigned, unsigned begin, unsigned end)
+			{
+				for (unsigned face = begin; face < end; ++face)
+				{
+					const unsigned halfEdge = mesh.faceHalfEdges[FaceType::REAL][face];
+
+					outComponents->faceComponents[face] = halfEdge == ~0u ? COMPONENT_NONE : vertComponents[mesh.halfEdgeVerts[halfEdge]];
+				}
+			});
+
+			outComponents->boundaryComponents.resize(boundaryCount);
+			outComponents->boundaryLengths.resize(boundaryCount);
+			Parallel_For(ThreadCount(boundaryCount, options), boundaryCount, [&](unsigned, unsigned begin, unsigned end)
+			{
+				for (unsigned boundary = begin; boundary < end; ++boundary)
+				{
+					const unsigned first = mesh.faceHalfEdges[FaceType::BOUNDARY][boundary];
+					unsigned length = 0;
+
+					for (unsigned halfEdge : BoundaryLoop(mesh, boundary))
+					{
+						(void)halfEdge;
+						++length;
+					}
+
+					outComponents->boundaryComponents[boundary] = first == ~0u ? COMPONENT_NONE : vertComponents[mesh.halfEdgeVerts[first]];
+					outComponents->boundaryLengths[boundary] = length;
+				}
+			});
+
+			// Element counts. Each pass counts into its thread's slice, and slices are summed per component.
+			const unsigned countThreadCount = std::max(std::max(vertThreadCount, ThreadCount(edgeCount, options)), std::max(ThreadCount(faceCount, options), ThreadCount(boundaryCount, options)));
+			std::vector<std::vector<count::Counts>> sliceCounts(countThreadCount, std::vector<count::Counts>(componentCount, count::Counts{ 0, 0, 0, 0 }));
+
+			count::AddSlices(vertThreadCount, vertCount, &sliceCounts, [&](unsigned vert, count::Counts* counts)
+			{
+				if (vertComponents[vert] != COMPONENT_NONE)
+					++counts[vertComponents[vert]].verts;
+			});
+
+			count::AddSlices(ThreadCount(edgeCount, options), edgeCount, &sliceCounts, [&](unsigned edge, count::Counts* counts)
+			{
+				if (mesh.halfEdgeNexts[edge * 2] != ~0u)
+					++counts[vertComponents[mesh.halfEdgeVerts[edge * 2]]].edges;
+			});
+
+			count::AddSlices(ThreadCount(faceCount, options), faceCount, &sliceCounts, [&](unsigned face, count::Counts* counts)
+			{
+				if (outComponents->faceComponents[face] != COMPONENT_NONE)
+					++counts[outComponents->faceComponents[face]].faces;
+			});
+
+			count::AddSlices(ThreadCount(boundaryCount, options), boundaryCount, &sliceCounts, [&](unsigned boundary, count::Counts* counts)
+			{
+				if (outComponents->boundaryComponents[boundary] != COMPONENT_NONE)
+					++counts[outComponents->boundaryComponents[boundary]].boundaries;
+			});
+
+			outComponents->components.resize(componentCount);
+			Parallel_For(ThreadCount(componentCount, options), componentCount, [&](unsigned, unsigned begin, unsigned end)
+			{
+				for (unsigned component = begin; component < end; ++component)
+				{
+					ComponentInfo& info = outComponents->components[component];
+
+					info = ComponentInfo();
+					for (const std::vector<count::Counts>& counts : sliceCounts)
+					{
+						info.vertCount += counts[component].verts;
+						info.edgeCount += counts[component].edges;
+						info.faceCount += counts[component].faces;
+						info.boundaryCount += counts[component].boundaries;
+					}
+
+					info.eulerCharacteristic = static_cast<int>(info.vertCount) - static_cast<int>(info.edgeCount) + static_cast<int>(info.faceCount);
+					info.genus = static_cast<unsigned>(std::max(0, 2 - static_cast<int>(info.boundaryCount) - info.eulerCharacteristic) / 2);
+				}
+			});
+		}
+
+		template void FindComponents(const Topology&, Components*, const ComponentOptions&);
+		template void FindComponents(const Topology64&, Components*, const ComponentOptions&);
+	}
+}
@@ -0,0 +1,522 @@
+#include <algorithm>
+#include <cstddef>
+#include "MeshProc/HalfEdge.h"
+#include "MeshProc/TopologyBuilder.h"
+#include "Corners.h"
+#include "Parallel.h"
+#include "sanity.h"
+
+namespace
+{
+	using namespace mesh;
+	using namespace mesh::corners;
+
+	static constexpr ptrdiff_t INSERTION_SORT_MAX = 16;
+	static constexpr unsigned COARSE_BUCKETS_PER_THREAD = 16;
+	static constexpr uint64_t DENSE_SLOTS_PER_CORNER = 4; // Index ranges past this take the sort based remap
+
+	static bool IsDegenerate(const unsigned* triIndices)
+	{
+		return triIndices[0] == triIndices[1] || triIndices[1] == triIndices[2] || triIndices[2] == triIndices[0];
+	}
+
+	namespace remap
+	{
+		// Returns the largest index, with outBadCorner set to the first corner whose index is above maxRealIndex or NONE
+		static unsigned ScanIndices(const unsigned* indices, unsigned cornerCount, unsigned maxRealIndex, unsigned threadCount, unsigned* outBadCorner)
+		{
+			std::vector<unsigned> sliceMaxIndices(threadCount, 0);
+			std::vector<unsigned> sliceBadCorners(threadCount, NONE);
+
+			Parallel_For(threadCount, cornerCount, [&](unsigned threadIndex, unsigned begin, unsigned end)
+			{
+				unsigned sliceMax = 0;
+
+				for (unsigned corner = begin; corner < end; ++corner)
+					sliceMax = std::max(sliceMax, indices[corner]);
+
+				sliceMaxIndices[threadIndex] = sliceMax;
+				if (sliceMax > maxRealIndex)
+					sliceBadCorners[threadIndex] = static_cast<unsigned>(std::find_if(indices + begin, indices + end, [&](unsigned index) { return index > maxRealIndex; }) - indices);
+			});
+
+			*outBadCorner = NONE;
+			for (unsigned threadIndex = 0; threadIndex < threadCount && *outBadCorner == NONE; ++threadIndex)
+				*outBadCorner = sliceBadCorners[threadIndex];
+
+			return *std::max_element(sliceMaxIndices.begin(), sliceMaxIndices.end());
+		}
+
+		// Returns the vert count, or NONE with outBadTri set to the first degenerate triangle
+		static unsigned RemapVertsSerial(const unsigned* indices, unsigned triCount, unsigned indexCount, std::vector<unsigned>* workIndexVertMap, unsigned* outCornerVerts, std::vector<unsigned>* outVertIndices, unsigned* outBadTri)
+		{
+			std::vector<unsigned>& indexVertMap = *workIndexVertMap;
+
+			indexVertMap.assign(indexCount, NONE);
+			unsigned vertCount = 0;
+
+			for (unsigned triIndex = 0; triIndex < triCount; ++triIndex)
+			{
+				const unsigned* const triIndices = indices + triIndex * 3;
+				unsigned* const triVerts = outCornerVerts + triIndex * 3;
+
+				if (IsDegenerate(triIndices))
+				{
+					*outBadTri = triIndex;
+					return NONE;
+				}
+
+				for (unsigned vertIndex = 0; vertIndex < 3; ++vertIndex)
+				{
+					unsigned* const mappedVert = indexVertMap.data() + triIndices[vertIndex];
+
+					if (*mappedVert == NONE)
+						*mappedVert = vertCount++;
+
+					triVerts[vertIndex] = *mappedVert;
+				}
+			}
+
+			outVertIndices->resize(vertCount);
+			for (unsigned index = 0; index < indexVertMap.size(); ++index)
+			{
+				if (indexVertMap[index] != NONE)
+					(*outVertIndices)[indexVertMap[index]] = index;
+			}
+
+			return vertCount;
+		}
+
+		// Each index's first corner is found with an atomic min, then first corners are counted per slice to hand out
+		// the same ids as the serial path.
+		static unsigned RemapVertsParallel(const unsigned* indices, unsigned triCount, unsigned indexCount, unsigned threadCount, unsigned* outCornerVerts, std::vector<unsigned>* outVertIndices, unsigned* outBadTri)
+		{
+			const unsigned cornerCount = triCount * 3;
+			std::vector<unsigned> sliceCounts(threadCount + 1, 0);
+			std::vector<std::atomic<unsigned>> indexVertMap(indexCount);
+
+			Parallel_For(threadCount, indexCount, [&](unsigned, unsigned begin, unsigned end)
+			{
+				for (unsigned index = begin; index < end; ++index)
+					indexVertMap[index].store(NONE, std::memory_order_relaxed);
+			});
+
+			// Each slice keeps its first degenerate triangle, so the first slice holding one has the serial path's
+			std::vector<unsigned> sliceBadTris(threadCount, NONE);
+
+			Parallel_For(threadCount, triCount, [&](unsigned threadIndex, unsigned begin, unsigned end)
+			{
+				for (unsigned triIndex = begin; triIndex < end; ++triIndex)
+				{
+					const unsigned* const triIndices = indices + triIndex * 3;
+
+					if (IsDegenerate(triIndices))
+					{
+						sliceBadTris[threadIndex] = triIndex;
+						return;
+					}
+
+					for (unsigned vertIndex = 0; vertIndex < 3; ++vertIndex)
+						Parallel_AtomicMin(&indexVertMap[triIndices[vertIndex]], triIndex * 3 + vertIndex);
+				}
+			});
+
+			for (unsigned threadIndex = 0; threadIndex < threadCount; ++threadIndex)
+			{
+				if (sliceBadTris[threadIndex] != NONE)
+				{
+					*outBadTri = sliceBadTris[threadIndex];
+					return NONE;
+				}
+			}
+
+			// Flag first corners in place, the slot is overwritten with the vert id once all slices are counted
+			Parallel_For(threadCount, cornerCount, [&](unsigned threadIndex, unsigned begin, unsigned end)
+			{
+				unsigned sliceVertCount = 0;
+
+				for (unsigned corner = begin; corner < end; ++corner)
+				{
+					const bool firstUse = indexVertMap[indices[corner]].load(std::memory_order_relaxed) == corner;
+
+					outCornerVerts[corner] = firstUse;
+					sliceVertCount += firstUse;
+				}
+
+				sliceCounts[threadIndex + 1] = sliceVertCount;
+			});
+
+			sliceCounts[0] = 0;
+			for (unsigned threadIndex = 0; threadIndex < threadCount; ++threadIndex)
+				sliceCounts[threadIndex + 1] += sliceCounts[threadIndex];
+
+			Parallel_For(threadCount, cornerCount, [&](unsigned threadIndex, unsigned begin, unsigned end)
+			{
+				unsigned vertId = sliceCounts[threadIndex];
+
+				for (unsigned corner = begin; corner < end; ++corner)
+				{
+					if (outCornerVerts[corner])
+						indexVertMap[indices[corner]].store(vertId++, std::memory_order_relaxed);
+				}
+			});
+
+			Parallel_For(threadCount, cornerCount, [&](unsigned, unsigned begin, unsigned end)
+			{
+				for (unsigned corner = begin; corner < end; ++corner)
+					outCornerVerts[corner] = indexVertMap[indices[corner]].load(std::memory_order_relaxed);
+			});
+
+			outVertIndices->resize(sliceCounts[threadCount]);
+			Parallel_For(threadCount, indexCount, [&](unsigned, unsigned begin, unsigned end)
+			{
+				for (unsigned index = begin; index < end; ++index)
+				{
+					const unsigned vertId = indexVertMap[index].load(std::memory_order_relaxed);
+
+					if (vertId != NONE)
+						(*outVertIndices)[vertId] = index;
+				}
+			});
+
+			return sliceCounts[threadCount];
+		}
+
+		// For index ranges too sparse to map densely. Corners are sorted by index, so each run shares a vert, and first
+		// corners are numbered in corner order to hand out the same ids as the dense paths.
+		static unsigned RemapVertsSparse(const unsigned* indices, unsigned triCount, std::vector<uint64_t>* workKeys, unsigned* outCornerVerts, std::vector<unsigned>* outVertIndices, unsigned* outBadTri)
+		{
+			const unsigned cornerCount = triCount * 3;
+			std::vector<uint64_t>& keys = *workKeys;
+
+			for (unsigned triIndex = 0; triIndex < triCount; ++triIndex)
+			{
+				if (IsDegenerate(indices + triIndex * 3))
+				{
+					*outBadTri = triIndex;
+					return NONE;
+				}
+			}
+
+			keys.resize(cornerCount);
+			for (unsigned corner = 0; corner < cornerCount; ++corner)
+				keys[corner] = (static_cast<uint64_t>(indices[corner]) << 32) | corner;
+
+			std::sort(keys.begin(), keys.end());
+
+			// Flag first corners in place, then number them in corner order
+			std::fill(outCornerVerts, outCornerVerts + cornerCount, 0);
+			for (unsigned key = 0; key < cornerCount; ++key)
+			{
+				if (key == 0 || (keys[key] >> 32) != (keys[key - 1] >> 32))
+					outCornerVerts[static_cast<unsigned>(keys[key])] = 1;
+			}
+
+			unsigned vertCount = 0;
+
+			for (unsigned corner = 0; corner < cornerCount; ++corner)
+				outCornerVerts[corner] = outCornerVerts[corner] ? vertCount++ : NONE;
+
+			outVertIndices->resize(vertCount);
+			for (unsigned key = 0, vert = NONE; key < cornerCount; ++key)
+			{
+				const unsigned corner = static_cast<unsigned>(keys[key]);
+
+				if (outCornerVerts[corner] != NONE)
+				{
+					vert = outCornerVerts[corner];
+					(*outVertIndices)[vert] = static_cast<unsigned>(keys[key] >> 32);
+				}
+
+				outCornerVerts[corner] = vert;
+			}
+
+			return vertCount;
+		}
+	}
+
+	namespace pairing
+	{
+		static uint64_t CornerEdge(const unsigned* cornerVerts, unsigned corner, unsigned* outLowVert)
+		{
+			const unsigned vertA = cornerVerts[corner];
+			const unsigned vertB = cornerVerts[NextCorner(corner)];
+
+			*outLowVert = std::min(vertA, vertB);
+			return (static_cast<uint64_t>(std::max(vertA, vertB)) << 32) | corner;
+		}
+
+		// Returns the insertion sort moves, or ~0u when the bucket went to std::sort
+		static unsigned SortBucket(uint64_t* begin, uint64_t* end)
+		{
+			unsigned shifts = 0;
+
+			// Buckets are about a vert's valence in size, so insertion sort nearly always wins. Fans can get huge, though.
+			if (end - begin > INSERTION_SORT_MAX)
+			{
+				std::sort(begin, end);
+				return ~0u;
+			}
+
+			for (uint64_t* cur = begin + 1; cur < end; ++cur)
+			{
+				const uint64_t value = *cur;
+				uint64_t* insert = cur;
+
+				for (; insert > begin && *(insert - 1) > value; --insert)
+					*insert = *(insert - 1);
+
+				*insert = value;
+				shifts += static_cast<unsigned>(cur - insert);
+			}
+
+			return shifts;
+		}
+
+		static void ReportDefect(unsigned triIndex, const char* message, half_edge::ValidateReport* inoutReport)
+		{
+			if (triIndex < inoutReport->element)
+				*inoutReport = half_edge::ValidateReport{ half_edge::ValidateError::BROKEN_LINK, triIndex, message };
+		}
+
+		// Counting sorts one coarse bucket's edges on their lower vert, then matches edges sharing an upper vert. A null
+		// edges list stands for every corner in order, which saves the coarse scatter when there's a single bucket.
+		// A third corner on an edge, or a second running the same way, goes into inoutReport when its triangle is lower
+		// than the one already there. Matching carries on past them, so every bucket is checked for any thread count.
+		static void MatchCoarseBucket(const unsigned* cornerVerts, unsigned firstVert, unsigned endVert, const uint64_t* edges, unsigned edgeCount, uint64_t* workEdges, std::vector<unsigned>* workVertStarts, unsigned* outCornerPartners, half_edge::ValidateReport* inoutReport, CornerStats* optInoutStats)
+		{
+			std::vector<unsigned>& vertStarts = *workVertStarts;
+			unsigned lowVert;
+
+			vertStarts.assign(endVert - firstVert + 2, 0);
+
+			for (unsigned edgeIndex = 0; edgeIndex < edgeCount; ++edgeIndex)
+			{
+				CornerEdge(cornerVerts, edges ? static_cast<unsigned>(edges[edgeIndex]) : edgeIndex, &lowVert);
+				++vertStarts[lowVert - firstVert + 2];
+			}
+
+			for (unsigned vert = 2; vert < vertStarts.size(); ++vert)
+				vertStarts[vert] += vertStarts[vert - 1];
+
+			for (unsigned edgeIndex = 0; edgeIndex < edgeCount; ++edgeIndex)
+			{
+				const uint64_t edge = CornerEdge(cornerVerts, edges ? static_cast<unsigned>(edges[edgeIndex]) : edgeIndex, &lowVert);
+
+				workEdges[vertStarts[lowVert - firstVert + 1]++] = edge;
+			}
+
+			for (unsigned vert = 0; vert < endVert - firstVert; ++vert)
+			{
+				uint64_t* const bucketBegin = workEdges + vertStarts[vert];
+				uint64_t* const bucketEnd = workEdges + vertStarts[vert + 1];
+
+				const unsigned shifts = SortBucket(bucketBegin, bucketEnd);
+
+#if MESHPROC_CONSTRUCT_STATS
+				if (optInoutStats)
+				{
+					optInoutStats->pairShifts += shifts == ~0u ? 0 : shifts;
+					optInoutStats->pairSortedBuckets += shifts == ~0u;
+					optInoutStats->pairMaxBucketEdges = std::max(optInoutStats->pairMaxBucketEdges, static_cast<unsigned>(bucketEnd - bucketBegin));
+				}
+#else
+				(void)shifts;
+				(void)optInoutStats;
+#endif
+
+				for (const uint64_t* edge = bucketBegin; edge < bucketEnd; ++edge)
+				{
+					if (edge + 1 < bucketEnd && (edge[0] >> 32) == (edge[1] >> 32))
+					{
+						const unsigned firstCorner = static_cast<unsigned>(edge[0]);
+						const unsigned secondCorner = static_cast<unsigned>(edge[1]);
+
+						if (edge + 2 < bucketEnd && (edge[1] >> 32) == (edge[2] >> 32))
+							ReportDefect(static_cast<unsigned>(edge[2]) / 3, "Non-manifold edge: a triangle is the third on one of its edges", inoutReport);
+						else if (cornerVerts[firstCorner] == cornerVerts[secondCorner])
+							ReportDefect(secondCorner / 3, "Two triangles share an edge in the same direction: flipped winding or a non-manifold edge", inoutReport);
+
+						outCornerPartners[secondCorner] = firstCorner;
+						++edge;
+					}
+				}
+			}
+		}
+	}
+}
+
+namespace mesh
+{
+	namespace corners
+	{
+		unsigned RemapVerts(const unsigned* indices, unsigned triCount, unsigned maxRealIndex, unsigned threadCount, TopologyBuilder* workBuilder, unsigned* outCornerVerts, std::vector<unsigned>* outVertIndices, half_edge::ValidateReport* optOutReport, CornerStats* optOutStats)
+		{
+			sanity(triCount <= ~0u / 3 && "Corner count overflow, callers reject these meshes");
+
+			const unsigned cornerCount = triCount * 3;
+			unsigned badCorner = NONE;
+			const unsigned maxIndex = cornerCount ? remap::ScanIndices(indices, cornerCount, maxRealIndex, threadCount, &badCorner) : 0;
+
+			if (badCorner != NONE)
+			{
+				if (optOutReport)
+					*optOutReport = half_edge::ValidateReport{ half_edge::ValidateError::BAD_INDEX, badCorner / 3, "Index out of bounds [0, 1<<24) for Vert::realIndex, see Topology64" };
+
+				return NONE;
+			}
+
+			// The map is sized in 64 bits, as an index of ~0u spans 1 << 32 slots. One far out index would otherwise cost
+			// a slot for every index below it.
+			const uint64_t indexRange = cornerCount ? static_cast<uint64_t>(maxIndex) + 1 : 0;
+			const bool dense = indexRange <= static_cast<uint64_t>(cornerCount) * DENSE_SLOTS_PER_CORNER && indexRange <= NONE;
+			unsigned badTri = NONE;
+			unsigned vertCount;
+
+			if (!dense)
+				vertCount = remap::RemapVertsSparse(indices, triCount, &workBuilder->workEdges, outCornerVerts, outVertIndices, &badTri);
+			else if (threadCount == 1)
+				vertCount = remap::RemapVertsSerial(indices, triCount, static_cast<unsigned>(indexRange), &workBuilder->indexVertMap, outCornerVerts, outVertIndices, &badTri);
+			else
+				vertCount = remap::RemapVertsParallel(indices, triCount, static_cast<unsigned>(indexRange), threadCount, outCornerVerts, outVertIndices, &badTri);
+
+			if (vertCount == NONE)
+			{
+				if (optOutReport)
+					*optOutReport = half_edge::ValidateReport{ half_edge::ValidateError::BAD_LOOP, badTri, "Degenerate triangle: a vert appears twice" };
+
+				return NONE;
+			}
+
+#if MESHPROC_CONSTRUCT_STATS
+			if (optOutStats)
+				optOutStats->indexRange = dense ? indexRange : 0;
+#else
+			(void)optOutStats;
+#endif
+
+			return vertCount;
+		}
+
+		bool PairCorners(const unsigned* cornerVerts, unsigned cornerCount, unsigned vertCount, unsigned threadCount, TopologyBuilder* workBuilder, std::vector<unsigned>* outCornerPartners, half_edge::ValidateReport* optOutReport, CornerStats* optOutStats)
+		{
+			// Coarse buckets split the lower vert range into work items, each sorted and matched by one thread
+			const unsigned coarseTarget = threadCount == 1 ? 1 : threadCount * COARSE_BUCKETS_PER_THREAD;
+			unsigned coarseShift = 0;
+
+			while ((static_cast<uint64_t>(vertCount) >> coarseShift) >= coarseTarget)
+				++coarseShift;
+
+			const unsigned coarseCount = static_cast<unsigned>(static_cast<uint64_t>(vertCount) >> coarseShift) + 1;
+			std::vector<unsigned>& coarseStarts = workBuilder->coarseStarts;
+			std::vector<uint64_t>& coarseEdges = workBuilder->coarseEdges;
+			std::vector<uint64_t>& workEdges = workBuilder->workEdges;
+			std::vector<std::vector<unsigned>>& threadVertStarts = workBuilder->threadVertStarts;
+
+			coarseStarts.assign(coarseCount + 1, 0);
+			coarseEdges.clear();
+			workEdges.resize(cornerCount);
+			if (threadVertStarts.size() < threadCount)
+				threadVertStarts.resize(threadCount);
+
+			outCornerPartners->assign(cornerCount, NONE);
+
+			if (coarseCount > 1)
+			{
+				std::vector<unsigned>& sliceCoarseStarts = workBuilder->sliceCoarseStarts;
+
+				sliceCoarseStarts.assign(threadCount * coarseCount, 0);
+
+				Parallel_For(threadCount, cornerCount, [&](unsigned threadIndex, unsigned begin, unsigned end)
+				{
+					unsigned* const sliceCounts = sliceCoarseStarts.data() + threadIndex * coarseCount;
+					unsigned lowVert;
+
+					for (unsigned corner = begin; corner < end; ++corner)
+					{
+						pairing::CornerEdge(cornerVerts, corner, &lowVert);
+						++sliceCounts[lowVert >> coarseShift];
+					}
+				});
+
+				for (unsigned coarse = 0, start = 0; coarse < coarseCount; ++coarse)
+				{
+					coarseStarts[coarse] = start;
+
+					for (unsigned threadIndex = 0; threadIndex < threadCount; ++threadIndex)
+					{
+						const unsigned count = sliceCoarseStarts[threadIndex * coarseCount + coarse];
+
+						sliceCoarseStarts[threadIndex * coarseCount + coarse] = start;
+						start += count;
+					}
+				}
+
+				coarseEdges.resize(cornerCount);
+				Parallel_For(threadCount, cornerCount, [&](unsigned threadIndex, unsigned begin, unsigned end)
+				{
+					unsigned* const sliceStarts = sliceCoarseStarts.data() + threadIndex * coarseCount;
+					unsigned lowVert;
+
+					for (unsigned corner = begin; corner < end; ++corner)
+					{
+						const uint64_t edge = pairing::CornerEdge(cornerVerts, corner, &lowVert);
+
+						coarseEdges[sliceStarts[lowVert >> coarseShift]++] = edge;
+					}
+				});
+			}
+			coarseStarts[coarseCount] = cornerCount;
+
+			// Each thread counts into its own stats and keeps its own lowest defect, merged once every bucket is matched
+			std::vector<CornerStats> threadStats(optOutStats ? threadCount : 0);
+			std::vector<half_edge::ValidateReport> threadReports(threadCount);
+
+			Parallel_For(threadCount, coarseCount, [&](unsigned threadIndex, unsigned begin, unsigned end)
+			{
+				CornerStats* const stats = threadStats.empty() ? nullptr : &threadStats[threadIndex];
+
+				for (unsigned coarse = begin; coarse < end; ++coarse)
+				{
+					const unsigned firstVert = static_cast<unsigned>(static_cast<uint64_t>(coarse) << coarseShift);
+					const unsigned endVert = static_cast<unsigned>(std::min<uint64_t>(vertCount, static_cast<uint64_t>(coarse + 1) << coarseShift));
+					const unsigned edgeStart = coarseStarts[coarse];
+					const uint64_t* const edges = coarseEdges.empty() ? nullptr : coarseEdges.data() + edgeStart;
+
+					pairing::MatchCoarseBucket(cornerVerts, firstVert, endVert, edges, coarseStarts[coarse + 1] - edgeStart, workEdges.data() + edgeStart, &threadVertStarts[threadIndex], outCornerPartners->data(), &threadReports[threadIndex], stats);
+
+					if (stats)
+						stats->pairMaxCoarseEdges = std::max(stats->pairMaxCoarseEdges, coarseStarts[coarse + 1] - edgeStart);
+				}
+			});
+
+			if (optOutStats)
+			{
+				optOutStats->pairCoarseBuckets = coarseCount;
+				for (const CornerStats& stats : threadStats)
+				{
+					optOutStats->pairShifts += stats.pairShifts;
+					optOutStats->pairSortedBuckets += stats.pairSortedBuckets;
+					optOutStats->pairMaxBucketEdges = std::max(optOutStats->pairMaxBucketEdges, stats.pairMaxBucketEdges);
+					optOutStats->pairMaxCoarseEdges = std::max(optOutStats->pairMaxCoarseEdges, stats.pairMaxCoarseEdges);
+				}
+			}
+
+			half_edge::ValidateReport report;
+
+			for (const half_edge::ValidateReport& threadReport : threadReports)
+			{
+				if (threadReport.element < report.element)
+					report = threadReport;
+			}
+
+			if (report.error == half_edge::ValidateError::VALID)
+				return true;
+
+			if (optOutReport)
+				*optOutReport = report;
+
+			return false;
+		}
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "MeshProc/HalfEdge.h"
+
+// Shared building blocks for topology construction. A corner is one entry of the index buffer (triIndex * 3 + vertIndex)
+// and stands for the directed edge from its vert to the next corner's vert.
+namespace mesh
+{
+	struct TopologyBuilder;
+
+	namespace corners
+	{
+		static constexpr unsigned NONE = ~0u;
+
+		// Filled only when built with MESHPROC_CONSTRUCT_STATS, see half_edge::ConstructStats
+		struct CornerStats
+		{
+			uint64_t indexRange = 0;
+			uint64_t pairShifts = 0;
+			unsigned pairSortedBuckets = 0;
+			unsigned pairMaxBucketEdges = 0;
+			unsigned pairCoarseBuckets = 0;
+			unsigned pairMaxCoarseEdges = 0;
+		};
+
+		static inline unsigned NextCorner(unsigned corner)
+		{
+			return corner % 3 == 2 ? corner - 2 : corner + 1;
+		}
+
+		// One-off constructions drop scratch as soon as it is used up, to keep peak memory down
+		template<typename T>
+		static inline void FreeScratch(bool freeScratch, std::vector<T>* inoutScratch)
+		{
+			if (freeScratch)
+				std::vector<T>().swap(*inoutScratch);
+		}
+
+		// Largest input index a VertT<IdT>::realIndex holds
+		template<typename IdT>
+		static constexpr unsigned MaxRealIndex()
+		{
+			return sizeof(IdT) * 8 - 8 >= 32 ? NONE : (1u << (sizeof(IdT) * 8 - 8)) - 1;
+		}
+
+		// Maps each corner's input index to a dense vert id, handed out in first use order. outCornerVerts must hold
+		// triCount * 3 entries. outVertIndices receives the input index of each vert. Returns the vert count, or NONE
+		// with the first triangle holding an index above maxRealIndex reported as BAD_INDEX, checked before anything is
+		// allocated, or else the first degenerate triangle as BAD_LOOP. Sparse index ranges are sorted rather than mapped.
+		unsigned RemapVerts(const unsigned* indices, unsigned triCount, unsigned maxRealIndex, unsigned threadCount, TopologyBuilder* workBuilder, unsigned* outCornerVerts, std::vector<unsigned>* outVertIndices, half_edge::ValidateReport* optOutReport, CornerStats* optOutStats = nullptr);
+
+		// Finds the corner on the reverse of each corner's edge without hashing. For the later corner of each pair,
+		// outCornerPartners holds the earlier one; first corners and unpaired corners hold NONE. Fails when a third corner
+		// lies on an edge or two run along it the same way, reporting the lowest such triangle as BROKEN_LINK for any
+		// thread count.
+		bool PairCorners(const unsigned* cornerVerts, unsigned cornerCount, unsigned vertCount, unsigned threadCount, TopologyBuilder* workBuilder, std::vector<unsigned>* outCornerPartners, half_edge::ValidateReport* optOutReport, CornerStats* optOutStats = nullptr);
+	}
+}
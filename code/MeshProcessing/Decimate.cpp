@@ -0,0 +1,927 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <vector>
+#include "MeshProc/Decimate.h"
+#include "MeshProc/HalfEdgeEdit.h"
+#include "Parallel.h"
+#include "sanity.h"
+
+namespace
+{
+	using namespace mesh;
+	using namespace mesh::half_edge;
+
+	// Below this the patch setup costs more than the threads win back.
+	static constexpr unsigned PARALLEL_MIN_TRIS = 1u << 16;
+
+	// Picks are sorted into edge order when fewer than one per this many edges, else gathered by a scan over the edges
+	static constexpr unsigned PICK_SCAN_RATIO = 32;
+
+	namespace quadric
+	{
+		// Symmetric 4x4 error matrix [A b; b^T c], so error(p) = p^T A p + 2 b^T p + c
+		struct Quadric
+		{
+			double a00, a01, a02, a11, a12, a22;
+			double b0, b1, b2;
+			double c;
+		};
+
+		// Plane n.p + d = 0 with a unit normal, scaled by weight
+		static inline void AddPlane(Quadric* inoutQuadric, const double* normal, double d, double weight)
+		{
+			inoutQuadric->a00 += weight * normal[0] * normal[0];
+			inoutQuadric->a01 += weight * normal[0] * normal[1];
+			inoutQuadric->a02 += weight * normal[0] * normal[2];
+			inoutQuadric->a11 += weight * normal[1] * normal[1];
+			inoutQuadric->a12 += weight * normal[1] * normal[2];
+			inoutQuadric->a22 += weight * normal[2] * normal[2];
+			inoutQuadric->b0 += weight * normal[0] * d;
+			inoutQuadric->b1 += weight * normal[1] * d;
+			inoutQuadric->b2 += weight * normal[2] * d;
+			inoutQuadric->c += weight * d * d;
+		}
+
+		static inline Quadric Add(const Quadric& lhs, const Quadric& rhs)
+		{
+			return Quadric{ lhs.a00 + rhs.a00, lhs.a01 + rhs.a01, lhs.a02 + rhs.a02, lhs.a11 + rhs.a11, lhs.a12 + rhs.a12, lhs.a22 + rhs.a22,
+				lhs.b0 + rhs.b0, lhs.b1 + rhs.b1, lhs.b2 + rhs.b2, lhs.c + rhs.c };
+		}
+
+		static inline double Error(const Quadric& quadric, const float* position)
+		{
+			const double x = position[0];
+			const double y = position[1];
+			const double z = position[2];
+
+			return x * (quadric.a00 * x + 2.0 * (quadric.a01 * y + quadric.a02 * z + quadric.b0))
+				+ y * (quadric.a11 * y + 2.0 * (quadric.a12 * z + quadric.b1))
+				+ z * (quadric.a22 * z + 2.0 * quadric.b2)
+				+ quadric.c;
+		}
+
+		// Solves A p = -b. Fails when A is close to singular, as it is on flat or creased regions.
+		static bool Minimize(const Quadric& quadric, float* outPosition)
+		{
+			const double c00 = quadric.a11 * quadric.a22 - quadric.a12 * quadric.a12;
+			const double c01 = quadric.a02 * quadric.a12 - quadric.a01 * quadric.a22;
+			const double c02 = quadric.a01 * quadric.a12 - quadric.a02 * quadric.a11;
+			const double det = quadric.a00 * c00 + quadric.a01 * c01 + quadric.a02 * c02;
+			const double scale = std::max(quadric.a00, std::max(quadric.a11, quadric.a22));
+
+			if (!(std::fabs(det) > 1e-8 * scale * scale * scale))
+				return false;
+
+			const double c11 = quadric.a00 * quadric.a22 - quadric.a02 * quadric.a02;
+			const double c12 = quadric.a01 * quadric.a02 - quadric.a00 * quadric.a12;
+			const double c22 = quadric.a00 * quadric.a11 - quadric.a01 * quadric.a01;
+			const double invDet = -1.0 / det;
+
+			outPosition[0] = static_cast<float>((c00 * quadric.b0 + c01 * quadric.b1 + c02 * quadric.b2) * invDet);
+			outPosition[1] = static_cast<float>((c01 * quadric.b0 + c11 * quadric.b1 + c12 * quadric.b2) * invDet);
+			outPosition[2] = static_cast<float>((c02 * quadric.b0 + c12 * quadric.b1 + c22 * quadric.b2) * invDet);
+
+			return true;
+		}
+	}
+
+
+	// Candidates are kept in one array ordered by cost instead of a heap kept current after each collapse: a radix sort
+	// and a merge only stream through memory, where heap updates jump around it. A pass that evaluated few candidates
+	// again, as the last passes before a target do, only sorts those and merges them into the rest.
+	namespace order
+	{
+		static constexpr unsigned RADIX_BITS = 11;
+		static constexpr unsigned RADIX_SIZE = 1u << RADIX_BITS;
+		static constexpr unsigned SORT_SHIFT = 64 - 2 * RADIX_BITS;
+		static constexpr unsigned MERGE_RATIO = 8; // A pass merges when at most one key in this many changed
+
+		// The order SortByCost leaves keys gathered in index order in, so merged runs match one sort of all of them
+		static inline bool ByCost(uint64_t lhs, uint64_t rhs)
+		{
+			return (lhs >> SORT_SHIFT) < (rhs >> SORT_SHIFT) || ((lhs >> SORT_SHIFT) == (rhs >> SORT_SHIFT) && static_cast<uint32_t>(lhs) < static_cast<uint32_t>(rhs));
+		}
+
+		// Sorts (cost bits << 32 | index) keys by their cost bits. Costs are never negative, so their float bits
+		// order like integers. Only the top 22 bits are sorted on, which still tells costs apart to 1 part in 8192.
+		// The sort is stable, so close costs stay in index order.
+		static void SortByCost(std::vector<uint64_t>* inoutKeys, std::vector<uint64_t>* scratch)
+		{
+			// Both digits are counted in one read of the keys, as moving keys doesn't change the counts
+			std::vector<unsigned> counts(2 * RADIX_SIZE);
+
+			for (uint64_t key : *inoutKeys)
+			{
+				++counts[(key >> SORT_SHIFT) & (RADIX_SIZE - 1)];
+				++counts[RADIX_SIZE + ((key >> (SORT_SHIFT + RADIX_BITS)) & (RADIX_SIZE - 1))];
+			}
+
+			scratch->resize(inoutKeys->size());
+			for (unsigned digit = 0; digit < 2; ++digit)
+			{
+				const unsigned shift = SORT_SHIFT + digit * RADIX_BITS;
+				unsigned* const digitCounts = &counts[digit * RADIX_SIZE];
+				unsigned offset = 0;
+
+				for (unsigned bucket = 0; bucket < RADIX_SIZE; ++bucket)
+				{
+					const unsigned bucketCount = digitCounts[bucket];
+
+					digitCounts[bucket] = offset;
+					offset += bucketCount;
+				}
+
+				for (uint64_t key : *inoutKeys)
+					(*scratch)[digitCounts[(key >> shift) & (RADIX_SIZE - 1)]++] = key;
+
+				inoutKeys->swap(*scratch);
+			}
+		}
+	}
+
+	namespace decimate
+	{
+		using quadric::Quadric;
+
+		struct State
+		{
+			Topology mesh;
+			std::vector<float> positions; // Packed xyz for each vert
+			std::vector<Quadric> quadrics;
+			std::vector<uint8_t> boundaryVerts;
+			std::vector<unsigned> slabs; // Slab along the longest axis for each vert, one slab per thread
+			const DecimateOptions* options;
+			double lengthWeight; // Scales the squared edge length added to each cost
+			unsigned threadCount;
+			unsigned liveTris;
+			unsigned liveEdges;
+			float error;
+		};
+
+		struct Candidate
+		{
+			unsigned halfEdge; // Origin is merged into the destination. INVALID_INDEX when the edge can't collapse
+			float position[3];
+			float cost;
+		};
+
+		// What one thread's collapses removed during a pass
+		struct Removed
+		{
+			unsigned tris = 0;
+			unsigned edges = 0;
+			float error = 0.0f; // Largest collapse cost
+		};
+
+		// Kept between passes so passes don't allocate
+		struct Pass
+		{
+			std::vector<Candidate> candidates; // One for each edge
+			std::vector<uint8_t> dirtyVerts; // Merged into by the last pass, so their edges need new candidates
+			std::vector<uint8_t> rekeyedEdges; // Evaluated again, deleted or failed to collapse, so their old keys are dropped
+			std::vector<uint64_t> keys; // Every collapse candidate, ordered by cost
+			std::vector<uint64_t> newKeys;
+			std::vector<uint64_t> sortScratch;
+			bool keysCurrent = false; // keys hold the last pass's candidates under the current edge numbering
+			std::vector<uint8_t> lockedVerts;
+			std::vector<unsigned> picked; // Edges
+			std::vector<uint8_t> pickedEdges; // Set while gathering picks into edge order
+			std::vector<unsigned> vertPatches; // Patch a vert and all its neighbors belong to, INVALID_INDEX on seams
+			std::vector<std::vector<unsigned>> patchPicked;
+			std::vector<unsigned> seamPicked;
+		};
+
+		static inline const float* Position(const State& state, unsigned vert)
+		{
+			return &state.positions[static_cast<size_t>(vert) * 3];
+		}
+
+		static inline void Sub(const float* lhs, const float* rhs, double* out)
+		{
+			out[0] = static_cast<double>(lhs[0]) - rhs[0];
+			out[1] = static_cast<double>(lhs[1]) - rhs[1];
+			out[2] = static_cast<double>(lhs[2]) - rhs[2];
+		}
+
+		static inline void Cross(const double* lhs, const double* rhs, double* out)
+		{
+			out[0] = lhs[1] * rhs[2] - lhs[2] * rhs[1];
+			out[1] = lhs[2] * rhs[0] - lhs[0] * rhs[2];
+			out[2] = lhs[0] * rhs[1] - lhs[1] * rhs[0];
+		}
+
+		static inline double Dot(const double* lhs, const double* rhs)
+		{
+			return lhs[0] * rhs[0] + lhs[1] * rhs[1] + lhs[2] * rhs[2];
+		}
+
+		static inline void TriNormal(const float* p0, const float* p1, const float* p2, double* outNormal)
+		{
+			double edge1[3];
+			double edge2[3];
+
+			Sub(p1, p0, edge1);
+			Sub(p2, p0, edge2);
+			Cross(edge1, edge2, outNormal);
+		}
+
+		// Plane of the real face, weighted by its area. Returns the area.
+		static double AddFacePlane(const State& state, unsigned halfEdge, Quadric* inoutQuadric)
+		{
+			const Topology& mesh = state.mesh;
+			const float* const p0 = Position(state, mesh.halfEdgeVerts[halfEdge]);
+			const float* const p1 = Position(state, mesh.halfEdgeVerts[mesh.halfEdgeNexts[halfEdge]]);
+			const float* const p2 = Position(state, mesh.halfEdgeVerts[mesh.halfEdgeNexts[mesh.halfEdgeNexts[halfEdge]]]);
+			double normal[3];
+
+			TriNormal(p0, p1, p2, normal);
+
+			const double length = std::sqrt(Dot(normal, normal));
+
+			if (length > 0.0)
+			{
+				normal[0] /= length;
+				normal[1] /= length;
+				normal[2] /= length;
+				quadric::AddPlane(inoutQuadric, normal, -(normal[0] * p0[0] + normal[1] * p0[1] + normal[2] * p0[2]), length * 0.5);
+			}
+
+			return length * 0.5;
+		}
+
+		// Plane through a boundary edge, perpendicular to its real face, weighted by the squared edge length
+		static void AddBoundaryPlane(const State& state, unsigned boundaryHE, Quadric* inoutQuadric)
+		{
+			const Topology& mesh = state.mesh;
+			const unsigned realHE = boundaryHE ^ 1;
+			const float* const p0 = Position(state, mesh.halfEdgeVerts[realHE]);
+			const float* const p1 = Position(state, mesh.halfEdgeVerts[boundaryHE]);
+			const float* const p2 = Position(state, mesh.halfEdgeVerts[mesh.halfEdgeNexts[mesh.halfEdgeNexts[realHE]]]);
+			double edge[3];
+			double faceNormal[3];
+			double normal[3];
+
+			Sub(p1, p0, edge);
+			TriNormal(p0, p1, p2, faceNormal);
+			Cross(edge, faceNormal, normal);
+
+			const double length = std::sqrt(Dot(normal, normal));
+
+			if (length > 0.0)
+			{
+				normal[0] /= length;
+				normal[1] /= length;
+				normal[2] /= length;
+				quadric::AddPlane(inoutQuadric, normal, -(normal[0] * p0[0] + normal[1] * p0[1] + normal[2] * p0[2]), state.options->boundaryWeight * Dot(edge, edge));
+			}
+		}
+
+		// Splits the verts into slabs of equal count along the longest axis. A merged vert keeps the slab of the vert it
+		// was, so slabs are only computed once.
+		static void AssignSlabs(State* state)
+		{
+			const Topology& mesh = state->mesh;
+			const unsigned vertCount = static_cast<unsigned>(mesh.verts.size());
+			std::vector<float> keys;
+			std::vector<float> splits;
+			float mins[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+			float maxs[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+			unsigned axis = 0;
+
+			for (unsigned vert = 0; vert < vertCount; ++vert)
+			{
+				if (mesh.vertHalfEdges[vert] == INVALID_INDEX)
+					continue;
+
+				for (unsigned component = 0; component < 3; ++component)
+				{
+					mins[component] = std::min(mins[component], Position(*state, vert)[component]);
+					maxs[component] = std::max(maxs[component], Position(*state, vert)[component]);
+				}
+			}
+
+			for (unsigned component = 1; component < 3; ++component)
+			{
+				if (maxs[component] - mins[component] > maxs[axis] - mins[axis])
+					axis = component;
+			}
+
+			for (unsigned vert = 0; vert < vertCount; ++vert)
+			{
+				if (mesh.vertHalfEdges[vert] != INVALID_INDEX)
+					keys.emplace_back(Position(*state, vert)[axis]);
+			}
+
+			for (unsigned slab = 1; slab < state->threadCount && !keys.empty(); ++slab)
+			{
+				const std::vector<float>::iterator split = keys.begin() + Parallel_SliceBegin(slab, state->threadCount, static_cast<unsigned>(keys.size()));
+
+				std::nth_element(keys.begin(), split, keys.end());
+				splits.emplace_back(*split);
+			}
+
+			std::sort(splits.begin(), splits.end());
+
+			state->slabs.assign(vertCount, INVALID_INDEX);
+			for (unsigned vert = 0; vert < vertCount; ++vert)
+			{
+				if (mesh.vertHalfEdges[vert] != INVALID_INDEX)
+					state->slabs[vert] = static_cast<unsigned>(std::upper_bound(splits.begin(), splits.end(), Position(*state, vert)[axis]) - splits.begin());
+			}
+		}
+
+		static void Setup(const Topology& mesh, const float* positions, const DecimateOptions& options, State* outState)
+		{
+			const unsigned vertCount = static_cast<unsigned>(mesh.verts.size());
+			const std::vector<unsigned>& faceHEs = mesh.faceHalfEdges[FaceType::REAL];
+			const unsigned faceCount = static_cast<unsigned>(faceHEs.size());
+			const unsigned threadCount = faceCount < PARALLEL_MIN_TRIS ? 1 : Parallel_ThreadCount(options.threadCount);
+
+			outState->mesh = mesh;
+			outState->options = &options;
+			outState->threadCount = threadCount;
+			outState->positions.resize(static_cast<size_t>(vertCount) * 3);
+			outState->quadrics.assign(vertCount, Quadric{});
+			outState->boundaryVerts.assign(vertCount, 0);
+			outState->liveTris = 0;
+			outState->liveEdges = static_cast<unsigned>(std::count_if(mesh.halfEdgeNexts.begin(), mesh.halfEdgeNexts.end(), [](unsigned next) { return next != INVALID_INDEX; }) / 2);
+			outState->error = 0.0f;
+
+			Parallel_For(threadCount, vertCount, [&](unsigned, unsigned begin, unsigned end)
+			{
+				for (unsigned vert = begin; vert < end; ++vert)
+				{
+					if (mesh.vertHalfEdges[vert] == INVALID_INDEX)
+						continue;
+
+					const float* const position = positions + static_cast<size_t>(mesh.verts[vert].realIndex) * 3;
+
+					std::copy(position, position + 3, &outState->positions[static_cast<size_t>(vert) * 3]);
+				}
+			});
+
+			std::vector<double> sliceAreas(threadCount, 0.0);
+			std::vector<unsigned> sliceTris(threadCount, 0);
+
+			// One thread computes each plane once and adds it to every vert it touches. Threads instead gather the planes
+			// around their own verts, computing each plane three times but never sharing a write.
+			if (threadCount == 1)
+			{
+				for (unsigned face = 0; face < faceCount; ++face)
+				{
+					const unsigned faceHE = faceHEs[face];
+					Quadric faceQuadric{};
+
+					if (faceHE == INVALID_INDEX)
+						continue;
+
+					sliceAreas[0] += AddFacePlane(*outState, faceHE, &faceQuadric);
+					++sliceTris[0];
+
+					for (unsigned curHE = faceHE, corner = 0; corner < 3; curHE = mesh.halfEdgeNexts[curHE], ++corner)
+					{
+						Quadric& vertQuadric = outState->quadrics[mesh.halfEdgeVerts[curHE]];
+
+						vertQuadric = quadric::Add(vertQuadric, faceQuadric);
+					}
+				}
+
+				for (unsigned halfEdge = 0; halfEdge < mesh.halfEdgeNexts.size(); ++halfEdge)
+				{
+					if (mesh.halfEdgeNexts[halfEdge] == INVALID_INDEX || mesh.halfEdgeFaces[halfEdge].type != FaceType::BOUNDARY)
+						continue;
+
+					Quadric edgeQuadric{};
+
+					AddBoundaryPlane(*outState, halfEdge, &edgeQuadric);
+					for (unsigned vert : { mesh.halfEdgeVerts[halfEdge], mesh.halfEdgeVerts[halfEdge ^ 1] })
+					{
+						outState->quadrics[vert] = quadric::Add(outState->quadrics[vert], edgeQuadric);
+						outState->boundaryVerts[vert] = 1;
+					}
+				}
+			}
+			else
+			{
+				Parallel_For(threadCount, vertCount, [&](unsigned, unsigned begin, unsigned end)
+				{
+					for (unsigned vert = begin; vert < end; ++vert)
+					{
+						const unsigned vertHE = mesh.vertHalfEdges[vert];
+
+						if (vertHE == INVALID_INDEX)
+							continue;
+
+						Quadric& vertQuadric = outState->quadrics[vert];
+						unsigned curHE = vertHE;
+
+						do
+						{
+							if (mesh.halfEdgeFaces[curHE].type == FaceType::REAL)
+								AddFacePlane(*outState, curHE, &vertQuadric);
+							else
+							{
+								AddBoundaryPlane(*outState, curHE, &vertQuadric);
+								outState->boundaryVerts[vert] = 1;
+							}
+
+							if (mesh.halfEdgeFaces[curHE ^ 1].type == FaceType::BOUNDARY)
+								AddBoundaryPlane(*outState, curHE ^ 1, &vertQuadric);
+
+							curHE = mesh.halfEdgeNexts[curHE ^ 1];
+						} while (curHE != vertHE);
+					}
+				});
+
+				Parallel_For(threadCount, faceCount, [&](unsigned threadIndex, unsigned begin, unsigned end)
+				{
+					for (unsigned face = begin; face < end; ++face)
+					{
+						const unsigned faceHE = faceHEs[face];
+
+						if (faceHE == INVALID_INDEX)
+							continue;
+
+						const unsigned nextHE = mesh.halfEdgeNexts[faceHE];
+						double normal[3];
+
+						TriNormal(Position(*outState, mesh.halfEdgeVerts[faceHE]), Position(*outState, mesh.halfEdgeVerts[nextHE]), Position(*outState, mesh.halfEdgeVerts[mesh.halfEdgeNexts[nextHE]]), normal);
+						sliceAreas[threadIndex] += std::sqrt(Dot(normal, normal)) * 0.5;
+						++sliceTris[threadIndex];
+					}
+				});
+			}
+
+			// The length term is kept well below the error of any real feature: a thousandth of the mean face area
+			double area = 0.0;
+
+			for (unsigned slice = 0; slice < threadCount; ++slice)
+			{
+				area += sliceAreas[slice];
+				outState->liveTris += sliceTris[slice];
+			}
+
+			outState->lengthWeight = outState->liveTris ? 1e-3 * area / outState->liveTris : 0.0;
+
+			if (threadCount > 1)
+				AssignSlabs(outState);
+		}
+
+		static bool Evaluate(const State& state, unsigned edge, Candidate* outCandidate)
+		{
+			const Topology& mesh = state.mesh;
+			const unsigned halfEdge = edge * 2;
+			const unsigned a = mesh.halfEdgeVerts[halfEdge];
+			const unsigned b = mesh.halfEdgeVerts[halfEdge ^ 1];
+			const Quadric merged = quadric::Add(state.quadrics[a], state.quadrics[b]);
+
+			outCandidate->halfEdge = halfEdge;
+
+			if (state.options->lockBoundary && (state.boundaryVerts[a] || state.boundaryVerts[b]))
+			{
+				if (state.boundaryVerts[a] && state.boundaryVerts[b])
+					return false;
+
+				const unsigned kept = state.boundaryVerts[a] ? a : b;
+
+				outCandidate->halfEdge = kept == a ? halfEdge ^ 1 : halfEdge;
+				std::copy(Position(state, kept), Position(state, kept) + 3, outCandidate->position);
+			}
+			else if (!quadric::Minimize(merged, outCandidate->position))
+			{
+				const float* const pa = Position(state, a);
+				const float* const pb = Position(state, b);
+				const float mid[3] = { (pa[0] + pb[0]) * 0.5f, (pa[1] + pb[1]) * 0.5f, (pa[2] + pb[2]) * 0.5f };
+				const float* best = mid;
+				double bestError = quadric::Error(merged, mid);
+
+				for (const float* option : { pa, pb })
+				{
+					const double error = quadric::Error(merged, option);
+
+					if (error < bestError)
+					{
+						best = option;
+						bestError = error;
+					}
+				}
+
+				std::copy(best, best + 3, outCandidate->position);
+			}
+
+			// Flat regions cost nothing to collapse. Without the length term they fold into one ever growing fan.
+			double ab[3];
+
+			Sub(Position(state, a), Position(state, b), ab);
+			outCandidate->cost = static_cast<float>(std::max(0.0, quadric::Error(merged, outCandidate->position)) + state.lengthWeight * Dot(ab, ab));
+			return true;
+		}
+
+		// True if moving the fans of both verts onto position turns any surviving face over
+		static bool Flips(const State& state, unsigned halfEdge, const float* position)
+		{
+			const Topology& mesh = state.mesh;
+			const unsigned pairHE = halfEdge ^ 1;
+			// Faces on either side of the edge are deleted by the collapse. Around each end they start at these half edges.
+			const unsigned skipped[4] = { halfEdge, mesh.halfEdgeNexts[pairHE], pairHE, mesh.halfEdgeNexts[halfEdge] };
+
+			for (unsigned start : { halfEdge, pairHE })
+			{
+				unsigned curHE = start;
+
+				do
+				{
+					if (mesh.halfEdgeFaces[curHE].type == FaceType::REAL && std::find(skipped, skipped + 4, curHE) == skipped + 4)
+					{
+						const unsigned nextHE = mesh.halfEdgeNexts[curHE];
+						const float* const p0 = Position(state, mesh.halfEdgeVerts[curHE]);
+						const float* const p1 = Position(state, mesh.halfEdgeVerts[nextHE]);
+						const float* const p2 = Position(state, mesh.halfEdgeVerts[mesh.halfEdgeNexts[nextHE]]);
+						double before[3];
+						double after[3];
+
+						TriNormal(p0, p1, p2, before);
+						TriNormal(position, p1, p2, after);
+
+						if (Dot(before, after) <= 0.0)
+							return true;
+					}
+
+					curHE = mesh.halfEdgeNexts[curHE ^ 1];
+				} while (curHE != start);
+			}
+
+			return false;
+		}
+
+		// Flips is redone because neighbors picked in the same pass may have moved since the candidate was evaluated. A
+		// candidate that fails is dropped until a collapse changes one of its verts.
+		static void Apply(State* state, Editor* editor, Pass* inoutPass, Candidate* inoutCandidate, Removed* inoutRemoved)
+		{
+			const Candidate& candidate = *inoutCandidate;
+			Topology& mesh = state->mesh;
+			const unsigned h = candidate.halfEdge;
+			const unsigned a = mesh.halfEdgeVerts[h];
+			const unsigned b = mesh.halfEdgeVerts[h ^ 1];
+			const unsigned removedTris = (mesh.halfEdgeFaces[h].type == FaceType::REAL) + (mesh.halfEdgeFaces[h ^ 1].type == FaceType::REAL);
+
+			if (Flips(*state, h, candidate.position) || !CollapseEdge(editor, h))
+			{
+				inoutCandidate->halfEdge = INVALID_INDEX;
+				return;
+			}
+
+			state->quadrics[b] = quadric::Add(state->quadrics[a], state->quadrics[b]);
+			state->boundaryVerts[b] |= state->boundaryVerts[a];
+			std::copy(candidate.position, candidate.position + 3, &state->positions[static_cast<size_t>(b) * 3]);
+			inoutPass->dirtyVerts[b] = 1;
+			inoutRemoved->tris += removedTris;
+			inoutRemoved->edges += 1 + removedTris;
+			inoutRemoved->error = std::max(inoutRemoved->error, candidate.cost);
+		}
+
+		// A vert whose neighbors all share its slab belongs to that slab's patch. Collapses between verts of one patch
+		// only touch half edges, faces and verts of that patch, so patches are applied in parallel. Boundary verts stay
+		// out of patches: their loops can run through several.
+		static void AssignPatches(const State& state, Pass* inoutPass)
+		{
+			const Topology& mesh = state.mesh;
+
+			inoutPass->vertPatches.resize(mesh.verts.size());
+			Parallel_For(state.threadCount, static_cast<unsigned>(mesh.verts.size()), [&](unsigned, unsigned begin, unsigned end)
+			{
+				for (unsigned vert = begin; vert < end; ++vert)
+				{
+					const unsigned vertHE = mesh.vertHalfEdges[vert];
+					unsigned patch = INVALID_INDEX;
+
+					if (vertHE != INVALID_INDEX && !state.boundaryVerts[vert])
+					{
+						unsigned curHE = vertHE;
+
+						patch = state.slabs[vert];
+						do
+						{
+							if (state.slabs[mesh.halfEdgeVerts[curHE ^ 1]] != patch)
+								patch = INVALID_INDEX;
+
+							curHE = mesh.halfEdgeNexts[curHE ^ 1];
+						} while (curHE != vertHE && patch != INVALID_INDEX);
+					}
+
+					inoutPass->vertPatches[vert] = patch;
+				}
+			});
+		}
+
+		// Evaluates every edge touched by the last pass, picks the cheapest collapses that share no vert with a cheaper
+		// pick, then applies them in edge order so the writes walk memory forward. Returns false once nothing is left to
+		// pick.
+		static bool RunPass(State* state, unsigned targetTris, Pass* inoutPass)
+		{
+			Topology& mesh = state->mesh;
+			const unsigned edgeCount = static_cast<unsigned>(mesh.halfEdgeNexts.size() / 2);
+			const unsigned threadCount = state->threadCount;
+			std::vector<Candidate>& candidates = inoutPass->candidates;
+			std::vector<uint64_t>& keys = inoutPass->keys;
+			std::vector<uint64_t>& newKeys = inoutPass->newKeys;
+			std::vector<uint8_t>& rekeyedEdges = inoutPass->rekeyedEdges;
+
+			const std::vector<uint8_t>& dirtyVerts = inoutPass->dirtyVerts;
+
+			std::vector<unsigned> sliceRekeyed(threadCount, 0);
+
+			candidates.resize(edgeCount);
+			rekeyedEdges.resize(edgeCount);
+			Parallel_For(threadCount, edgeCount, [&](unsigned threadIndex, unsigned begin, unsigned end)
+			{
+				for (unsigned edge = begin; edge < end; ++edge)
+				{
+					uint8_t rekeyed = 1;
+
+					// Only edges deleted by the last pass still hold a candidate, and so maybe a key
+					if (mesh.halfEdgeNexts[edge * 2] == INVALID_INDEX)
+					{
+						rekeyed = candidates[edge].halfEdge != INVALID_INDEX;
+						candidates[edge].halfEdge = INVALID_INDEX;
+					}
+					else if (dirtyVerts[mesh.halfEdgeVerts[edge * 2]] || dirtyVerts[mesh.halfEdgeVerts[edge * 2 + 1]])
+					{
+						if (!Evaluate(*state, edge, &candidates[edge]))
+							candidates[edge].halfEdge = INVALID_INDEX;
+					}
+					else
+						rekeyed = candidates[edge].halfEdge == INVALID_INDEX;
+
+					rekeyedEdges[edge] = rekeyed;
+					sliceRekeyed[threadIndex] += rekeyed;
+				}
+			});
+
+			inoutPass->dirtyVerts.assign(mesh.verts.size(), 0);
+
+			// Merging costs a branch per key, so it only beats sorting every key again when few of them changed
+			const unsigned rekeyedCount = std::accumulate(sliceRekeyed.begin(), sliceRekeyed.end(), 0u);
+			const bool mergeKeys = inoutPass->keysCurrent && rekeyedCount <= keys.size() / order::MERGE_RATIO;
+
+			newKeys.clear();
+			newKeys.reserve(edgeCount);
+			for (unsigned edge = 0; edge < edgeCount; ++edge)
+			{
+				if ((rekeyedEdges[edge] || !mergeKeys) && candidates[edge].halfEdge != INVALID_INDEX && candidates[edge].cost <= state->options->maxError)
+				{
+					uint32_t costBits;
+
+					std::memcpy(&costBits, &candidates[edge].cost, sizeof(costBits));
+					newKeys.emplace_back(static_cast<uint64_t>(costBits) << 32 | edge);
+				}
+			}
+
+			order::SortByCost(&newKeys, &inoutPass->sortScratch);
+
+			if (mergeKeys)
+			{
+				std::vector<uint64_t>& merged = inoutPass->sortScratch;
+
+				keys.erase(std::remove_if(keys.begin(), keys.end(), [&](uint64_t key) { return rekeyedEdges[static_cast<uint32_t>(key)] != 0; }), keys.end());
+
+				merged.resize(keys.size() + newKeys.size());
+				std::merge(keys.begin(), keys.end(), newKeys.begin(), newKeys.end(), merged.begin(), order::ByCost);
+				keys.swap(merged);
+			}
+			else
+				keys.swap(newKeys);
+
+			inoutPass->keysCurrent = true;
+
+			if (keys.empty())
+				return false;
+
+			// Each collapse removes up to two triangles, one on a boundary, so picks are counted by the triangles they
+			// remove. Picks stop well short of costs far above the one the pass would need to reach, so a pass never
+			// trades quality for count.
+			const unsigned removeGoal = state->liveTris - targetTris;
+			const unsigned collapseGoal = std::max(1u, removeGoal / 2);
+			const float costLimit = candidates[static_cast<uint32_t>(keys[std::min<size_t>(collapseGoal, keys.size()) - 1])].cost * 1.5f;
+			uint32_t costLimitBits;
+			std::vector<uint8_t>& lockedVerts = inoutPass->lockedVerts;
+			std::vector<unsigned>& picked = inoutPass->picked;
+			unsigned pickedTris = 0;
+
+			std::memcpy(&costLimitBits, &costLimit, sizeof(costLimitBits));
+			lockedVerts.assign(mesh.verts.size(), 0);
+			picked.clear();
+			for (uint64_t key : keys)
+			{
+				const unsigned edge = static_cast<uint32_t>(key);
+				const unsigned a = mesh.halfEdgeVerts[edge * 2];
+				const unsigned b = mesh.halfEdgeVerts[edge * 2 + 1];
+
+				if (pickedTris >= removeGoal || ((key >> 32) > costLimitBits && !picked.empty()))
+					break;
+
+				if (lockedVerts[a] || lockedVerts[b])
+					continue;
+
+				lockedVerts[a] = 1;
+				lockedVerts[b] = 1;
+				picked.emplace_back(edge);
+				pickedTris += (mesh.halfEdgeFaces[edge * 2].type == FaceType::REAL) + (mesh.halfEdgeFaces[edge * 2 + 1].type == FaceType::REAL);
+			}
+
+			if (picked.size() < edgeCount / PICK_SCAN_RATIO)
+				std::sort(picked.begin(), picked.end());
+			else
+			{
+				std::vector<uint8_t>& pickedEdges = inoutPass->pickedEdges;
+
+				pickedEdges.resize(edgeCount);
+				for (unsigned edge : picked)
+					pickedEdges[edge] = 1;
+
+				picked.clear();
+				for (unsigned edge = 0; edge < edgeCount; ++edge)
+				{
+					if (pickedEdges[edge])
+					{
+						pickedEdges[edge] = 0;
+						picked.emplace_back(edge);
+					}
+				}
+			}
+
+			Editor editor;
+			Removed removed;
+
+			editor.mesh = &mesh;
+
+			if (threadCount > 1)
+			{
+				std::vector<Removed> patchRemoved(threadCount);
+
+				AssignPatches(*state, inoutPass);
+				inoutPass->patchPicked.resize(threadCount);
+				for (std::vector<unsigned>& patchPicked : inoutPass->patchPicked)
+					patchPicked.clear();
+				inoutPass->seamPicked.clear();
+
+				for (unsigned edge : picked)
+				{
+					const unsigned patch = inoutPass->vertPatches[mesh.halfEdgeVerts[edge * 2]];
+
+					if (patch != INVALID_INDEX && patch == inoutPass->vertPatches[mesh.halfEdgeVerts[edge * 2 + 1]])
+						inoutPass->patchPicked[patch].emplace_back(edge);
+					else
+						inoutPass->seamPicked.emplace_back(edge);
+				}
+
+				Parallel_For(threadCount, threadCount, [&](unsigned patch, unsigned, unsigned)
+				{
+					Editor patchEditor;
+
+					patchEditor.mesh = &mesh;
+					for (unsigned edge : inoutPass->patchPicked[patch])
+						Apply(state, &patchEditor, inoutPass, &candidates[edge], &patchRemoved[patch]);
+				});
+
+				for (const Removed& patch : patchRemoved)
+				{
+					removed.tris += patch.tris;
+					removed.edges += patch.edges;
+					removed.error = std::max(removed.error, patch.error);
+				}
+
+				picked.swap(inoutPass->seamPicked);
+			}
+
+			for (unsigned edge : picked)
+				Apply(state, &editor, inoutPass, &candidates[edge], &removed);
+
+			state->liveTris -= removed.tris;
+			state->liveEdges -= removed.edges;
+			state->error = std::max(state->error, removed.error);
+			return true;
+		}
+
+		// Once dead slots are the majority, drops them so later passes scan and touch less memory. Verts and edges keep
+		// their order, as in Compact.
+		static void CompactState(State* state, Pass* inoutPass)
+		{
+			Topology& mesh = state->mesh;
+			const unsigned vertCount = static_cast<unsigned>(mesh.verts.size());
+			const unsigned edgeCount = static_cast<unsigned>(mesh.halfEdgeNexts.size() / 2);
+			unsigned liveVertCount = 0;
+			unsigned liveEdgeCount = 0;
+
+			for (unsigned vert = 0; vert < vertCount; ++vert)
+			{
+				if (mesh.vertHalfEdges[vert] == INVALID_INDEX)
+					continue;
+
+				std::copy(Position(*state, vert), Position(*state, vert) + 3, &state->positions[static_cast<size_t>(liveVertCount) * 3]);
+				state->quadrics[liveVertCount] = state->quadrics[vert];
+				state->boundaryVerts[liveVertCount] = state->boundaryVerts[vert];
+				inoutPass->dirtyVerts[liveVertCount] = inoutPass->dirtyVerts[vert];
+				if (!state->slabs.empty())
+					state->slabs[liveVertCount] = state->slabs[vert];
+				++liveVertCount;
+			}
+
+			for (unsigned edge = 0; edge < edgeCount; ++edge)
+			{
+				if (mesh.halfEdgeNexts[edge * 2] == INVALID_INDEX)
+					continue;
+
+				Candidate& candidate = inoutPass->candidates[liveEdgeCount];
+
+				candidate = inoutPass->candidates[edge];
+				if (candidate.halfEdge != INVALID_INDEX)
+					candidate.halfEdge = liveEdgeCount * 2 + (candidate.halfEdge & 1);
+				++liveEdgeCount;
+			}
+
+			Editor editor;
+
+			editor.mesh = &mesh;
+			Compact(&editor);
+
+			// Keys name edges by their old numbers
+			inoutPass->keysCurrent = false;
+
+			state->positions.resize(static_cast<size_t>(liveVertCount) * 3);
+			state->quadrics.resize(liveVertCount);
+			state->boundaryVerts.resize(liveVertCount);
+			inoutPass->dirtyVerts.resize(liveVertCount);
+			if (!state->slabs.empty())
+				state->slabs.resize(liveVertCount);
+			inoutPass->candidates.resize(liveEdgeCount);
+		}
+
+		static void Snapshot(const State& state, Lod* outLod)
+		{
+			Editor editor;
+
+			outLod->mesh = state.mesh;
+			outLod->error = state.error;
+			editor.mesh = &outLod->mesh;
+			Compact(&editor);
+
+			outLod->positions.clear();
+			outLod->positions.reserve(outLod->mesh.verts.size() * 3);
+			for (unsigned vert = 0; vert < state.mesh.verts.size(); ++vert)
+			{
+				if (state.mesh.vertHalfEdges[vert] != INVALID_INDEX)
+					outLod->positions.insert(outLod->positions.end(), Position(state, vert), Position(state, vert) + 3);
+			}
+
+			// positions are indexed by compacted vert, so realIndex is pointed there and the input vert kept aside
+			outLod->sourceVerts.resize(outLod->mesh.verts.size());
+			for (unsigned vert = 0; vert < outLod->mesh.verts.size(); ++vert)
+			{
+				outLod->sourceVerts[vert] = outLod->mesh.verts[vert].realIndex;
+				outLod->mesh.verts[vert].realIndex = vert;
+			}
+		}
+	}
+}
+
+namespace mesh
+{
+	namespace half_edge
+	{
+		void Decimate(const Topology& mesh, const float* positions, unsigned targetTris, Lod* outLod, const DecimateOptions& options)
+		{
+			std::vector<Lod> lods;
+
+			DecimateLods(mesh, positions, &targetTris, 1, &lods, options);
+			*outLod = std::move(lods.front());
+		}
+
+		void DecimateLods(const Topology& mesh, const float* positions, const unsigned* targetTris, unsigned lodCount, std::vector<Lod>* outLods, const DecimateOptions& options)
+		{
+			decimate::State state;
+			decimate::Pass pass;
+
+			decimate::Setup(mesh, positions, options, &state);
+			pass.dirtyVerts.assign(mesh.verts.size(), 1);
+
+			outLods->clear();
+			outLods->resize(lodCount);
+			for (unsigned lod = 0; lod < lodCount; ++lod)
+			{
+				sanity((lod == 0 || targetTris[lod] <= targetTris[lod - 1]) && "LOD targets must be decreasing");
+
+				while (state.liveTris > targetTris[lod] && decimate::RunPass(&state, targetTris[lod], &pass))
+				{
+					if (state.liveEdges * 2 < state.mesh.halfEdgeNexts.size() / 2)
+						decimate::CompactState(&state, &pass);
+				}
+
+				decimate::Snapshot(state, &(*outLods)[lod]);
+			}
+		}
+	}
+}
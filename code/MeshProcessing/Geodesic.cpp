@@ -0,0 +1,328 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <emmintrin.h>
+#include "MeshProc/Geodesic.h"
+#include "Parallel.h"
+#include "sanity.h"
+
+namespace
+{
+	using namespace mesh;
+	using namespace mesh::half_edge;
+
+	// Below this the threads cost more than the passes they split
+	static constexpr unsigned PARALLEL_MIN_ELEMENTS = 1u << 14;
+
+	// The Poisson operator is L + (POISSON_SHIFT / t) M. Sources are shifted to 0 afterwards, so only the non constant
+	// modes feel the shift, by about this relative amount.
+	static constexpr double POISSON_SHIFT = 1e-8;
+
+	static unsigned ThreadCount(unsigned elementCount, unsigned requested)
+	{
+		return elementCount < PARALLEL_MIN_ELEMENTS ? 1 : std::min(Parallel_ThreadCount(requested), elementCount / (PARALLEL_MIN_ELEMENTS / 4));
+	}
+
+	namespace setup
+	{
+		template<typename IdT>
+		static double MeanSquaredEdgeLength(const TopologyT<IdT>& mesh, const float* positions)
+		{
+			double sum = 0.0;
+			unsigned edgeCount = 0;
+
+			for (size_t halfEdge = 0; halfEdge < mesh.halfEdgeNexts.size(); halfEdge += 2)
+			{
+				if (mesh.halfEdgeNexts[halfEdge] == ~0u)
+					continue;
+
+				const float* const from = positions + static_cast<size_t>(mesh.verts[mesh.halfEdgeVerts[halfEdge]].realIndex) * 3;
+				const float* const to = positions + static_cast<size_t>(mesh.verts[mesh.halfEdgeVerts[halfEdge ^ 1]].realIndex) * 3;
+				double lengthSquared = 0.0;
+
+				for (unsigned component = 0; component < 3; ++component)
+					lengthSquared += (static_cast<double>(to[component]) - from[component]) * (static_cast<double>(to[component]) - from[component]);
+
+				sum += lengthSquared;
+				++edgeCount;
+			}
+
+			return edgeCount ? sum / edgeCount : 0.0;
+		}
+
+		template<typename IdT>
+		static void BuildFaceBlocks(const TopologyT<IdT>& mesh, const float* positions, unsigned threadCount, GeodesicSolver* outSolver)
+		{
+			const unsigned faceCount = outSolver->faceCount;
+
+			outSolver->faceBlocks.resize((faceCount + GEODESIC_LANES - 1) / GEODESIC_LANES);
+
+			Parallel_For(ThreadCount(faceCount, threadCount), static_cast<unsigned>(outSolver->faceBlocks.size()), [&](unsigned, unsigned begin, unsigned end)
+			{
+				for (unsigned blockIndex = begin; blockIndex < end; ++blockIndex)
+				{
+					GeodesicFaceBlock& block = outSolver->faceBlocks[blockIndex];
+
+					for (unsigned lane = 0; lane < GEODESIC_LANES; ++lane)
+					{
+						const unsigned face = blockIndex * GEODESIC_LANES + lane;
+						const unsigned first = face < faceCount ? mesh.faceHalfEdges[FaceType::REAL][face] : ~0u;
+
+						if (first == ~0u)
+						{
+							for (unsigned corner = 0; corner < 3; ++corner)
+							{
+								block.verts[corner][lane] = 0;
+								for (unsigned component = 0; component < 3; ++component)
+									block.basis[corner][component][lane] = 0.0f;
+							}
+
+							continue;
+						}
+
+						const unsigned halfEdges[3] = { first, mesh.halfEdgeNexts[first], mesh.halfEdgeNexts[mesh.halfEdgeNexts[first]] };
+						double p[3][3];
+
+						for (unsigned corner = 0; corner < 3; ++corner)
+						{
+							const unsigned vert = mesh.halfEdgeVerts[halfEdges[corner]];
+							const float* const position = positions + static_cast<size_t>(mesh.verts[vert].realIndex) * 3;
+
+							block.verts[corner][lane] = vert;
+							for (unsigned component = 0; component < 3; ++component)
+								p[corner][component] = position[component];
+						}
+
+						double normal[3];
+						{
+							const double lhs[3] = { p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2] };
+							const double rhs[3] = { p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2] };
+
+							normal[0] = lhs[1] * rhs[2] - lhs[2] * rhs[1];
+							normal[1] = lhs[2] * rhs[0] - lhs[0] * rhs[2];
+							normal[2] = lhs[0] * rhs[1] - lhs[1] * rhs[0];
+
+							const double length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+							const double invLength = length > 0.0 ? 1.0 / length : 0.0;
+
+							for (double& component : normal)
+								component *= invLength;
+						}
+
+						// N x e points from the opposite edge towards the corner, with the edge's length
+						for (unsigned corner = 0; corner < 3; ++corner)
+						{
+							const double* const from = p[(corner + 1) % 3];
+							const double* const to = p[(corner + 2) % 3];
+							const double edge[3] = { to[0] - from[0], to[1] - from[1], to[2] - from[2] };
+
+							block.basis[corner][0][lane] = static_cast<float>(normal[1] * edge[2] - normal[2] * edge[1]);
+							block.basis[corner][1][lane] = static_cast<float>(normal[2] * edge[0] - normal[0] * edge[2]);
+							block.basis[corner][2][lane] = static_cast<float>(normal[0] * edge[1] - normal[1] * edge[0]);
+						}
+					}
+				}
+			});
+		}
+
+		// Face corners on each vert, in face order, so the divergence gathers instead of scattering. Deleted faces have
+		// zero basis and add nothing to vert 0.
+		static void BuildVertCorners(GeodesicSolver* outSolver)
+		{
+			std::vector<unsigned>& starts = outSolver->vertCornerStarts;
+
+			starts.assign(outSolver->vertCount + 1, 0);
+			for (unsigned face = 0; face < outSolver->faceCount; ++face)
+			{
+				const GeodesicFaceBlock& block = outSolver->faceBlocks[face / GEODESIC_LANES];
+				const unsigned lane = face % GEODESIC_LANES;
+
+				for (unsigned corner = 0; corner < 3; ++corner)
+					++starts[block.verts[corner][lane] + 1];
+			}
+
+			for (unsigned vert = 0; vert < outSolver->vertCount; ++vert)
+				starts[vert + 1] += starts[vert];
+
+			std::vector<unsigned> cursors(starts.begin(), starts.end() - 1);
+
+			outSolver->vertCorners.resize(starts.back());
+			for (unsigned face = 0; face < outSolver->faceCount; ++face)
+			{
+				const GeodesicFaceBlock& block = outSolver->faceBlocks[face / GEODESIC_LANES];
+				const unsigned lane = face % GEODESIC_LANES;
+
+				for (unsigned corner = 0; corner < 3; ++corner)
+					outSolver->vertCorners[cursors[block.verts[corner][lane]]++] = face * 3 + corner;
+			}
+		}
+	}
+
+	namespace query
+	{
+		// Integrated divergence of the unit field against the heat gradient, per face corner: X . (N x e) / 2 with
+		// X = -grad u / |grad u|. Normalizing drops every positive scale, so each face's heat is divided by its largest
+		// corner before going to float, and heat far below float range still gives a direction.
+		static void FaceDivergence(const GeodesicSolver& solver, const double* heat, unsigned threadCount, float* outCornerValues)
+		{
+			Parallel_For(ThreadCount(solver.faceCount, threadCount), static_cast<unsigned>(solver.faceBlocks.size()), [&](unsigned, unsigned begin, unsigned end)
+			{
+				for (unsigned blockIndex = begin; blockIndex < end; ++blockIndex)
+				{
+					const GeodesicFaceBlock& block = solver.faceBlocks[blockIndex];
+					alignas(16) float values[3][GEODESIC_LANES];
+
+					for (unsigned lane = 0; lane < GEODESIC_LANES; ++lane)
+					{
+						const double u[3] = { heat[block.verts[0][lane]], heat[block.verts[1][lane]], heat[block.verts[2][lane]] };
+						const double largest = std::max(u[0], std::max(u[1], u[2]));
+						const double scale = largest > 0.0 ? 1.0 / largest : 0.0;
+
+						for (unsigned corner = 0; corner < 3; ++corner)
+							values[corner][lane] = static_cast<float>(u[corner] * scale);
+					}
+
+					__m128 gradient[3];
+					__m128 basis[3][3];
+
+					for (unsigned component = 0; component < 3; ++component)
+					{
+						gradient[component] = _mm_setzero_ps();
+						for (unsigned corner = 0; corner < 3; ++corner)
+						{
+							basis[corner][component] = _mm_load_ps(block.basis[corner][component]);
+							gradient[component] = _mm_add_ps(gradient[component], _mm_mul_ps(_mm_load_ps(values[corner]), basis[corner][component]));
+						}
+					}
+
+					const __m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(gradient[0], gradient[0]), _mm_mul_ps(gradient[1], gradient[1])), _mm_mul_ps(gradient[2], gradient[2]));
+					const __m128 nonZero = _mm_cmpgt_ps(lengthSquared, _mm_setzero_ps());
+					const __m128 scale = _mm_and_ps(nonZero, _mm_div_ps(_mm_set1_ps(-0.5f), _mm_sqrt_ps(lengthSquared)));
+					alignas(16) float divergence[3][GEODESIC_LANES];
+
+					for (unsigned corner = 0; corner < 3; ++corner)
+					{
+						const __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(gradient[0], basis[corner][0]), _mm_mul_ps(gradient[1], basis[corner][1])), _mm_mul_ps(gradient[2], basis[corner][2]));
+
+						_mm_store_ps(divergence[corner], _mm_mul_ps(dot, scale));
+					}
+
+					const unsigned laneCount = std::min(GEODESIC_LANES, solver.faceCount - blockIndex * GEODESIC_LANES);
+
+					for (unsigned lane = 0; lane < laneCount; ++lane)
+					{
+						for (unsigned corner = 0; corner < 3; ++corner)
+							outCornerValues[(static_cast<size_t>(blockIndex) * GEODESIC_LANES + lane) * 3 + corner] = divergence[corner][lane];
+					}
+				}
+			});
+		}
+
+		static void VertDivergence(const GeodesicSolver& solver, const float* cornerValues, unsigned threadCount, double* outDivergence)
+		{
+			Parallel_For(ThreadCount(solver.vertCount, threadCount), solver.vertCount, [&](unsigned, unsigned begin, unsigned end)
+			{
+				for (unsigned vert = begin; vert < end; ++vert)
+				{
+					double sum = 0.0;
+
+					for (unsigned cornerIndex = solver.vertCornerStarts[vert]; cornerIndex < solver.vertCornerStarts[vert + 1]; ++cornerIndex)
+						sum += cornerValues[solver.vertCorners[cornerIndex]];
+
+					outDivergence[vert] = sum;
+				}
+			});
+		}
+
+		// Shifts the sources to 0 on average and clamps what the solve leaves slightly below them
+		static void ShiftToSources(const double* potential, const unsigned* sourceVerts, unsigned sourceCount, unsigned vertCount, float* outDistances)
+		{
+			double shift = 0.0;
+
+			for (unsigned source = 0; source < sourceCount; ++source)
+				shift += potential[sourceVerts[source]];
+
+			shift /= sourceCount;
+
+			for (unsigned vert = 0; vert < vertCount; ++vert)
+				outDistances[vert] = static_cast<float>(std::max(potential[vert] - shift, 0.0));
+		}
+	}
+}
+
+namespace mesh
+{
+	namespace half_edge
+	{
+		template<typename IdT>
+		bool PrepareGeodesics(const TopologyT<IdT>& mesh, const float* positions, GeodesicSolver* outSolver, const GeodesicOptions& options)
+		{
+			LaplacianOptions laplacianOptions;
+
+			laplacianOptions.threadCount = options.threadCount;
+
+			outSolver->faceCount = static_cast<unsigned>(mesh.faceHalfEdges[FaceType::REAL].size());
+			outSolver->vertCount = static_cast<unsigned>(mesh.verts.size());
+			outSolver->time = options.timeScale * setup::MeanSquaredEdgeLength(mesh, positions);
+
+			setup::BuildFaceBlocks(mesh, positions, options.threadCount, outSolver);
+			setup::BuildVertCorners(outSolver);
+
+			if (!(outSolver->time > 0.0))
+				return false;
+
+			AnalyzeLaplacian(mesh, &outSolver->heat, laplacianOptions);
+			AnalyzeLaplacian(mesh, &outSolver->poisson, laplacianOptions);
+
+			return FactorLaplacian(mesh, positions, 1.0, outSolver->time, &outSolver->heat, laplacianOptions)
+				&& FactorLaplacian(mesh, positions, POISSON_SHIFT / outSolver->time, 1.0, &outSolver->poisson, laplacianOptions);
+		}
+
+		void ComputeGeodesics(const GeodesicSolver& solver, const unsigned* sourceVerts, unsigned sourceCount, float* outDistances, const GeodesicQueryOptions& options)
+		{
+			const unsigned setStarts[2] = { 0, sourceCount };
+
+			ComputeGeodesics(solver, sourceVerts, setStarts, 1, outDistances, options);
+		}
+
+		void ComputeGeodesics(const GeodesicSolver& solver, const unsigned* sourceVerts, const unsigned* setStarts, unsigned setCount, float* outDistances, const GeodesicQueryOptions& options)
+		{
+			const size_t vertCount = solver.vertCount;
+			LaplacianOptions solveOptions;
+			std::vector<double> columns(vertCount * setCount, 0.0);
+			std::vector<double> heat(vertCount * setCount);
+			std::vector<float> cornerValues(static_cast<size_t>(solver.faceCount) * 3);
+
+			solveOptions.threadCount = options.threadCount;
+
+			for (unsigned set = 0; set < setCount; ++set)
+			{
+				sanity(setStarts[set] < setStarts[set + 1] && "mesh::half_edge::ComputeGeodesics source set without sources");
+
+				for (unsigned source = setStarts[set]; source < setStarts[set + 1]; ++source)
+				{
+					sanity(sourceVerts[source] < vertCount && "mesh::half_edge::ComputeGeodesics source vert out of range");
+					columns[set * vertCount + sourceVerts[source]] = 1.0;
+				}
+			}
+
+			SolveLaplacian(solver.heat, columns.data(), setCount, heat.data(), solveOptions);
+
+			// columns now receives the divergence, then heat the potential
+			for (unsigned set = 0; set < setCount; ++set)
+			{
+				query::FaceDivergence(solver, heat.data() + set * vertCount, options.threadCount, cornerValues.data());
+				query::VertDivergence(solver, cornerValues.data(), options.threadCount, columns.data() + set * vertCount);
+			}
+
+			SolveLaplacian(solver.poisson, columns.data(), setCount, heat.data(), solveOptions);
+
+			for (unsigned set = 0; set < setCount; ++set)
+				query::ShiftToSources(heat.data() + set * vertCount, sourceVerts + setStarts[set], setStarts[set + 1] - setStarts[set], solver.vertCount, outDistances + set * vertCount);
+		}
+
+		template bool PrepareGeodesics(const Topology&, const float*, GeodesicSolver*, const GeodesicOptions&);
+		template bool PrepareGeodesics(const Topology64&, const float*, GeodesicSolver*, const GeodesicOptions&);
+	}
+}
@@ -1,412 +1,555 @@
 #include <algorithm>
-#include <unordered_map>
-#include <cassert>
+#include <chrono>
 #include "MeshProc/HalfEdge.h"
-#include "BitSet.h"
+#include "MeshProc/HalfEdgeCirculators.h"
+#include "MeshProc/TopologyBuilder.h"
+#include "Corners.h"
+#include "Parallel.h"
 #include "sanity.h"
 
 namespace
 {
+	using namespace mesh;
 	using namespace mesh::half_edge;
 
-	static unsigned EdgeLoopLength(const Topology& mesh, unsigned halfEdge)
-	{
-		const unsigned heStart = halfEdge;
-		unsigned loopLength = 0;
-
-		do
-		{
-			sanity(halfEdge < mesh.halfEdgeNexts.size());
+	static constexpr unsigned HE_NONE = ~0u;
+	static constexpr unsigned FACE_NONE = (1u << 31) - 1;
+	static constexpr unsigned PARALLEL_MIN_TRIS = 1u << 15; // Below this, thread start up costs more than it saves
+	static constexpr unsigned MAX_TRIS = ~0u / 3; // Corner ids are 32 bit
+	static constexpr unsigned MAX_EDGES = HE_NONE / 2; // Half edge ids are 32 bit and HE_NONE is reserved
 
-			++loopLength;
-			halfEdge = mesh.halfEdgeNexts[halfEdge];
-		} while (halfEdge != heStart);
+	// Inputs the topology can't be built from are reported like a failed validation. Elements are input triangles,
+	// half edges or boundaries as the message says.
+	static bool Reject(ValidateError error, unsigned element, const char* message, ValidateReport* optOutReport)
+	{
+		if (optOutReport)
+			*optOutReport = ValidateReport{ error, element, message };
 
-		return loopLength;
+		return false;
 	}
 
-	namespace singularity
+	namespace construct
 	{
-		namespace singularity_internal
+		// Numbers edges in first seen order from paired corners, the first corner on an edge getting the even half edge
+		// and its pair the odd one. Returns the edge count, leaving the corners unnumbered past MAX_EDGES.
+		static unsigned NumberEdges(const std::vector<unsigned>& cornerPartners, unsigned threadCount, std::vector<unsigned>* workSliceCounts, std::vector<unsigned>* outCornerHEs)
 		{
-			static unsigned NextSingularityStart(const Topology& mesh, BitSet* workBitSet, const unsigned startHalfEdge, unsigned halfEdge)
+			const unsigned cornerCount = static_cast<unsigned>(cornerPartners.size());
+			std::vector<unsigned>& sliceCounts = *workSliceCounts;
+
+			sliceCounts.assign(threadCount + 1, 0);
+
+			Parallel_For(threadCount, cornerCount, [&](unsigned threadIndex, unsigned begin, unsigned end)
 			{
-				const unsigned boundaryFaceIndex = mesh.halfEdgeFaces[startHalfEdge].index;
+				unsigned sliceEdgeCount = 0;
 
-				do
-				{
-					const unsigned halfEdgeVertIndex = mesh.halfEdgeVerts[halfEdge];
+				for (unsigned corner = begin; corner < end; ++corner)
+					sliceEdgeCount += cornerPartners[corner] == corners::NONE;
+
+				sliceCounts[threadIndex + 1] = sliceEdgeCount;
+			});
+
+			for (unsigned threadIndex = 0; threadIndex < threadCount; ++threadIndex)
+				sliceCounts[threadIndex + 1] += sliceCounts[threadIndex];
 
-					sanity(mesh.halfEdgeFaces[halfEdge].type == FaceType::BOUNDARY);
-					sanity(mesh.halfEdgeFaces[halfEdge].index == boundaryFaceIndex);
+			if (sliceCounts[threadCount] > MAX_EDGES)
+				return sliceCounts[threadCount];
 
-					if (BitSet_IsSet(*workBitSet, halfEdgeVertIndex))
+			outCornerHEs->resize(cornerCount);
+			Parallel_For(threadCount, cornerCount, [&](unsigned threadIndex, unsigned begin, unsigned end)
+			{
+				unsigned halfEdge = sliceCounts[threadIndex] * 2;
+
+				for (unsigned corner = begin; corner < end; ++corner)
+				{
+					if (cornerPartners[corner] == corners::NONE)
 					{
-						break;
+						(*outCornerHEs)[corner] = halfEdge;
+						halfEdge += 2;
 					}
-					else
+				}
+			});
+
+			Parallel_For(threadCount, cornerCount, [&](unsigned, unsigned begin, unsigned end)
+			{
+				for (unsigned corner = begin; corner < end; ++corner)
+				{
+					if (cornerPartners[corner] != corners::NONE)
+						(*outCornerHEs)[corner] = (*outCornerHEs)[cornerPartners[corner]] + 1;
+				}
+			});
+
+			return sliceCounts[threadCount];
+		}
+
+		// Every half edge without a next is unpaired. Gives each its vert, links them into loops by rotating around their
+		// head vert through the real faces, and turns each loop into a boundary face. Loops are numbered by their lowest half edge.
+		// Fails on edges without a real face and on loops that don't close or are shorter than 3.
+		static bool CreateBoundaryFaces(unsigned* inoutHEVerts, FaceIndex* inoutHEFaces, unsigned* inoutHENexts, unsigned halfEdgeCount, unsigned threadCount, std::vector<unsigned>* outBoundaryHEs, ValidateReport* optOutReport, ConstructStats* optInoutStats)
+		{
+			// Each slice keeps its first unreferenced edge, so the first slice holding one has the lowest
+			std::vector<unsigned> sliceBadHEs(threadCount, HE_NONE);
+
+			Parallel_For(threadCount, halfEdgeCount, [&](unsigned threadIndex, unsigned begin, unsigned end)
+			{
+				for (unsigned halfEdge = begin; halfEdge < end; ++halfEdge)
+				{
+					if (inoutHEFaces[halfEdge].type == FaceType::BOUNDARY)
 					{
-						BitSet_Set(workBitSet, halfEdgeVertIndex);
-					}
+						if (inoutHEFaces[halfEdge ^ 1].type != FaceType::REAL)
+						{
+							sliceBadHEs[threadIndex] = halfEdge;
+							return;
+						}
 
-					halfEdge = mesh.halfEdgeNexts[halfEdge];
-				} while (halfEdge != startHalfEdge);
+						inoutHEVerts[halfEdge] = inoutHEVerts[inoutHENexts[halfEdge ^ 1]];
+					}
+				}
+			});
 
-				return halfEdge;
+			for (unsigned badHE : sliceBadHEs)
+			{
+				if (badHE != HE_NONE)
+					return Reject(ValidateError::BROKEN_LINK, badHE, "Unreferenced edge: neither half edge has a real face", optOutReport);
 			}
 
-			static void SplitBoundarySingularities(Topology* inoutMesh, BitSet* workBitSet, unsigned firstHalfEdge)
+			// Each boundary half edge finds its own next, rotating around its head vert through the real faces to the
+			// boundary half edge leaving it. Only real nexts are read and each slot is written by its own half edge, so
+			// slices never touch the same memory. Around a non-manifold vert two half edges can find the same next, which
+			// the loop walk below reports.
+			Parallel_For(threadCount, halfEdgeCount, [=](unsigned, unsigned begin, unsigned end)
 			{
-				for (unsigned loopStartHE = NextSingularityStart(*inoutMesh, workBitSet, firstHalfEdge, firstHalfEdge); loopStartHE != firstHalfEdge; loopStartHE = NextSingularityStart(*inoutMesh, workBitSet, firstHalfEdge, loopStartHE))
+				for (unsigned halfEdge = begin; halfEdge < end; ++halfEdge)
 				{
-					const FaceIndex oldBoundary = inoutMesh->halfEdgeFaces[loopStartHE];
-					const FaceIndex newBoundary{ (unsigned)inoutMesh->faceHalfEdges[oldBoundary.type].size(), oldBoundary.type };
-					const unsigned loopStartVertIndex = inoutMesh->halfEdgeVerts[loopStartHE];
-					const unsigned newVertIndex = static_cast<unsigned>(inoutMesh->verts.size());
-					Vert* const newVert = &inoutMesh->verts.emplace_back(inoutMesh->verts[loopStartVertIndex]);
-					const unsigned newSplitIndex = newVert->splitIndex + 1;
-					unsigned curHalfEdge = inoutMesh->halfEdgeNexts[loopStartHE];
-					unsigned prevHalfEdge = loopStartHE;
-
-					// Cut the into two boundaries at the singularity, tracking the edge pointing to the vert
+					if (inoutHEFaces[halfEdge].type == FaceType::BOUNDARY)
 					{
-						sanity(newBoundary.index == inoutMesh->faceHalfEdges[oldBoundary.type].size() && "FaceIndex::type overflow");
-						sanity(inoutMesh->halfEdgeVerts[curHalfEdge] != loopStartVertIndex);
+						unsigned nextHalfEdge = inoutHENexts[inoutHENexts[halfEdge ^ 1]] ^ 1;
 
-						inoutMesh->faceHalfEdges[newBoundary.type].emplace_back(loopStartHE);
+						// Find next unpaired edge
+						while (inoutHEFaces[nextHalfEdge].type == FaceType::REAL)
+							nextHalfEdge = inoutHENexts[inoutHENexts[nextHalfEdge]] ^ 1;
 
-						do
-						{
-							inoutMesh->halfEdgeFaces[prevHalfEdge] = newBoundary;
+						inoutHENexts[halfEdge] = nextHalfEdge;
+					}
+				}
+			});
 
-							prevHalfEdge = curHalfEdge;
-							curHalfEdge = inoutMesh->halfEdgeNexts[curHalfEdge];
-						} while (inoutMesh->halfEdgeVerts[curHalfEdge] != loopStartVertIndex);
+			for (unsigned halfEdge = 0; halfEdge < halfEdgeCount; ++halfEdge)
+			{
+				if (inoutHEFaces[halfEdge].type == FaceType::BOUNDARY && inoutHEFaces[halfEdge].index == FACE_NONE)
+				{
+					const FaceIndex boundaryFace{ static_cast<unsigned>(outBoundaryHEs->size()), FaceType::BOUNDARY };
+					unsigned boundaryHE = halfEdge;
+					unsigned boundaryLoopLen = 0;
 
-						inoutMesh->halfEdgeNexts[prevHalfEdge] = loopStartHE;
-					}
+					sanity(boundaryFace.index == outBoundaryHEs->size() && "FaceIndex::index overflow");
+					outBoundaryHEs->emplace_back(halfEdge);
 
-					// Update the new verts split index and move all edges off of it to the new index
+					// Every half edge has a next, so a walk that doesn't close runs into a half edge already given a loop
+					do
 					{
-						newVert->splitIndex = newSplitIndex;
-						sanity(newVert->splitIndex == newSplitIndex && "mesh::half_edge::Vert::splitIndex overflow");
+						++boundaryLoopLen;
 
-						curHalfEdge = prevHalfEdge ^ 1;
-						do
-						{
-							curHalfEdge = inoutMesh->halfEdgeNexts[curHalfEdge];
+						inoutHEFaces[boundaryHE] = boundaryFace;
+						boundaryHE = inoutHENexts[boundaryHE];
 
-							sanity(inoutMesh->verts[inoutMesh->halfEdgeVerts[curHalfEdge]].realIndex == newVert->realIndex);
-							sanity(inoutMesh->halfEdgeFaces[curHalfEdge].type != FaceType::BOUNDARY);
+						if (boundaryHE != halfEdge && inoutHEFaces[boundaryHE].index != FACE_NONE)
+							return Reject(ValidateError::BROKEN_LINK, halfEdge, "Non-manifold vertex: a boundary loop does not close", optOutReport);
+					} while (boundaryHE != halfEdge);
 
-							inoutMesh->halfEdgeVerts[curHalfEdge] = newVertIndex;
-							curHalfEdge ^= 1;
-						} while (curHalfEdge != loopStartHE);
+					if (boundaryLoopLen < 3)
+						return Reject(ValidateError::BAD_LOOP, boundaryFace.index, "Overlapping faces: a boundary loop is shorter than 3", optOutReport);
 
-						inoutMesh->halfEdgeVerts[loopStartHE] = newVertIndex;
+					if (optInoutStats)
+					{
+						optInoutStats->boundaryMinLength = optInoutStats->boundaryLoops ? std::min(optInoutStats->boundaryMinLength, boundaryLoopLen) : boundaryLoopLen;
+						optInoutStats->boundaryMaxLength = std::max(optInoutStats->boundaryMaxLength, boundaryLoopLen);
+						optInoutStats->boundaryHalfEdges += boundaryLoopLen;
+						++optInoutStats->boundaryLoops;
 					}
 				}
 			}
-		}
-
-		static void SplitSingularities(Topology* inoutMesh)
-		{
-			const unsigned numVerts = static_cast<unsigned>(inoutMesh->verts.size());
-			const unsigned maxNewVerts = numVerts >> 2; // 25% verts created from splitting singularities should be unreasonably high
-			const unsigned maxVerts = numVerts + maxNewVerts;
-			ScopedBitSet vertBitSet;
-
-			BitSet_Create(&vertBitSet, maxVerts);
 
-			for (unsigned boundaryHE : inoutMesh->faceHalfEdges[FaceType::BOUNDARY])
-			{
-				BitSet_ClearAll(&vertBitSet);
-				singularity_internal::SplitBoundarySingularities(inoutMesh, &vertBitSet, boundaryHE);
-			}
+			return true;
 		}
 	}
 
-	namespace validate
+	namespace singularity
 	{
-		namespace validate_internal
+		namespace singularity_internal
 		{
-			static bool HasIsolatedVertices(const Topology& mesh)
+			// A boundary half edge leaving a vert starts one of its fans. The vert keeps the fan its vertHalfEdges entry
+			// lies in, which rotating from the boundary half edge finds, and every other fan moves to a new vert.
+			template<typename IdT>
+			static bool KeepsVert(const TopologyT<IdT>& mesh, unsigned boundaryHE)
 			{
-				for (unsigned vertIndex : mesh.halfEdgeVerts)
+				const unsigned vertHE = mesh.vertHalfEdges[mesh.halfEdgeVerts[boundaryHE]];
+
+				for (unsigned halfEdge : RingFrom(mesh, boundaryHE))
 				{
-					if (vertIndex > mesh.verts.size())
+					if (halfEdge == vertHE)
 						return true;
 				}
 
 				return false;
 			}
+		}
 
-			static bool HasSingularities(const Topology& mesh)
+		// Boundary loops are independent, so each is walked by one thread: once to count the fans that need a new vert,
+		// then again, after a prefix sum over loops hands out vert ids, to move them. Work follows the fans around
+		// boundary verts rather than the vert count, and there's no limit on how many verts get split.
+		template<typename IdT>
+		static void SplitSingularities(TopologyT<IdT>* inoutMesh, unsigned threadCount, std::vector<unsigned>* workLoopSplitStarts, std::vector<uint64_t>* workSplitVerts, ConstructStats* optInoutStats)
+		{
+			TopologyT<IdT>& mesh = *inoutMesh;
+			const std::vector<unsigned>& boundaryHEs = mesh.faceHalfEdges[FaceType::BOUNDARY];
+			const unsigned boundaryCount = static_cast<unsigned>(boundaryHEs.size());
+			const unsigned vertCount = static_cast<unsigned>(mesh.verts.size());
+			std::vector<unsigned>& loopSplitStarts = *workLoopSplitStarts;
+			std::vector<uint64_t>& splitVerts = *workSplitVerts;
+
+			loopSplitStarts.assign(boundaryCount + 1, 0);
+			Parallel_For(threadCount, boundaryCount, [&](unsigned, unsigned begin, unsigned end)
 			{
-				const size_t vertFaceCountSize = mesh.verts.size() * sizeof(uint8_t);
-				uint8_t* const vertFaceCount = (uint8_t*)_malloca(vertFaceCountSize);
+				for (unsigned boundary = begin; boundary < end; ++boundary)
+				{
+					for (unsigned boundaryHE : BoundaryLoop(mesh, boundary))
+						loopSplitStarts[boundary + 1] += !singularity_internal::KeepsVert(mesh, boundaryHE);
+				}
+			});
 
-				memset(vertFaceCount, 0, vertFaceCountSize);
+			for (unsigned boundary = 0; boundary < boundaryCount; ++boundary)
+				loopSplitStarts[boundary + 1] += loopSplitStarts[boundary];
 
-				for (unsigned type = 0; type < FaceType::COUNT; ++type)
+			const unsigned splitCount = loopSplitStarts[boundaryCount];
+
+			if (splitCount == 0)
+				return;
+
+			sanity(static_cast<uint64_t>(vertCount) + splitCount < (1ull << 32) && "Vert count overflow from splitting");
+
+			mesh.verts.resize(vertCount + splitCount);
+			mesh.vertHalfEdges.resize(vertCount + splitCount);
+			splitVerts.resize(splitCount);
+
+			Parallel_For(threadCount, boundaryCount, [&](unsigned, unsigned begin, unsigned end)
+			{
+				for (unsigned boundary = begin; boundary < end; ++boundary)
 				{
-					for (unsigned faceHE : mesh.faceHalfEdges[type])
-					{
-						unsigned curHE = faceHE;
+					unsigned split = loopSplitStarts[boundary];
 
-						do
-						{
-							const unsigned heVert = mesh.halfEdgeVerts[curHE];
+					for (unsigned boundaryHE : BoundaryLoop(mesh, boundary))
+					{
+						if (singularity_internal::KeepsVert(mesh, boundaryHE))
+							continue;
 
-							sanity(heVert < mesh.verts.size());
-							++vertFaceCount[heVert];
+						const unsigned newVert = vertCount + split;
 
-							curHE = mesh.halfEdgeNexts[curHE];
-						} while (curHE != faceHE);
+						splitVerts[split++] = (static_cast<uint64_t>(mesh.halfEdgeVerts[boundaryHE]) << 32) | newVert;
+						mesh.vertHalfEdges[newVert] = boundaryHE;
 					}
 				}
+			});
 
-				for (size_t vertIndex = 0; vertIndex < mesh.verts.size(); ++vertIndex)
+			// Fans move only once every KeepsVert has run, since those read the verts being moved. Fans are disjoint.
+			Parallel_For(threadCount, splitCount, [&](unsigned, unsigned begin, unsigned end)
+			{
+				for (unsigned split = begin; split < end; ++split)
 				{
-					const unsigned vertHE = mesh.vertHalfEdges[vertIndex];
-					unsigned curHE = vertHE;
-					unsigned vertDegree = 0;
+					const unsigned newVert = static_cast<unsigned>(splitVerts[split]);
 
-					do
-					{
-						++vertDegree;
-						curHE = mesh.halfEdgeNexts[curHE ^ 1];
-					} while (curHE != vertHE);
-
-					if (vertDegree != vertFaceCount[vertIndex])
-						return true;
+					for (unsigned halfEdge : RingFrom(mesh, mesh.vertHalfEdges[newVert]))
+						mesh.halfEdgeVerts[halfEdge] = newVert;
 				}
+			});
 
-				return false;
-			}
-		}
+			// Splits of one vert are numbered in new vert order, which sorting on the original vert keeps
+			std::sort(splitVerts.begin(), splitVerts.end());
 
-		static bool ValidateBoundaries(const Topology& mesh)
-		{
-			for (unsigned boundaryHE : mesh.faceHalfEdges[FaceType::BOUNDARY])
+			for (unsigned split = 0, splitIndex = 0; split < splitCount; ++split)
 			{
-				const unsigned boundaryLen = EdgeLoopLength(mesh, boundaryHE);
+				const unsigned vert = static_cast<unsigned>(splitVerts[split] >> 32);
+				const unsigned newVert = static_cast<unsigned>(splitVerts[split]);
+				VertT<IdT> newVertId = mesh.verts[vert];
+
+				splitIndex = split && (splitVerts[split - 1] >> 32) == vert ? splitIndex + 1 : newVertId.splitIndex + 1;
+				newVertId.splitIndex = splitIndex;
+				sanity(newVertId.splitIndex == splitIndex && "mesh::half_edge::Vert::splitIndex overflow");
+
+				mesh.verts[newVert] = newVertId;
 
-				if (boundaryLen < 3)
+				if (optInoutStats)
 				{
-					sanity(0 && "Mesh has overlapping faces");
-					return false;
+					++optInoutStats->splitFans;
+					optInoutStats->splitVerts += split == 0 || (splitVerts[split - 1] >> 32) != vert;
 				}
 			}
+		}
+	}
 
-			return true;
+	namespace stats
+	{
+		using Clock = std::chrono::steady_clock;
+
+		template<typename T>
+		static uint64_t Bytes(const std::vector<T>& scratch)
+		{
+			return scratch.capacity() * sizeof(T);
 		}
 
-		static bool ValidateVertices(const Topology& mesh)
+		static uint64_t ScratchBytes(const TopologyBuilder& builder)
 		{
-			if (validate_internal::HasIsolatedVertices(mesh))
-			{
-				sanity(0 && "Mesh has verts attached to no edges");
-				return false;
-			}
+			uint64_t bytes = Bytes(builder.cornerVerts) + Bytes(builder.cornerPartners) + Bytes(builder.cornerHalfEdges) + Bytes(builder.vertIndices) + Bytes(builder.indexVertMap);
 
-			if (validate_internal::HasSingularities(mesh))
-			{
-				sanity(0 && "Mesh has vertices on multiple boundaries we failed to correct for");
-				return false;
-			}
+			bytes += Bytes(builder.sliceCounts) + Bytes(builder.coarseStarts) + Bytes(builder.sliceCoarseStarts) + Bytes(builder.threadVertStarts);
+			for (const std::vector<unsigned>& vertStarts : builder.threadVertStarts)
+				bytes += Bytes(vertStarts);
 
-			return true;
+			return bytes + Bytes(builder.coarseEdges) + Bytes(builder.workEdges) + Bytes(builder.loopSplitStarts) + Bytes(builder.splitVerts) + Bytes(builder.vertBoundaryCorners);
 		}
 
-		static bool ValidateMesh(const Topology& mesh)
+		static void Begin(unsigned threadCount, Clock::time_point* outLapStart, ConstructStats* outStats)
 		{
-			return ValidateBoundaries(mesh) && ValidateVertices(mesh);
+			*outStats = ConstructStats();
+			outStats->threadCount = threadCount;
+			*outLapStart = Clock::now();
 		}
-	}
 
-}
+		// Phases run back to back, so each lap closes the phase that was running and starts the next
+		static void Lap(ConstructPhase phase, Clock::time_point* inoutLapStart, ConstructStats* inoutStats)
+		{
+			const Clock::time_point now = Clock::now();
 
-namespace mesh
-{
-	namespace half_edge
+			inoutStats->phaseSeconds[phase] = std::chrono::duration<double>(now - *inoutLapStart).count();
+			inoutStats->totalSeconds += inoutStats->phaseSeconds[phase];
+			*inoutLapStart = now;
+		}
+
+		// Builder scratch is sampled before each FreeScratch, along with any map a phase allocates on its own
+		static void SamplePeak(const TopologyBuilder& builder, uint64_t transientBytes, ConstructStats* inoutStats)
+		{
+			inoutStats->peakScratchBytes = std::max(inoutStats->peakScratchBytes, ScratchBytes(builder) + transientBytes);
+		}
+	}
+
+	template<typename IdT>
+	static bool ConstructTopology(TopologyBuilder* builder, const unsigned* indices, unsigned triCount, const ConstructOptions& options, bool freeScratch, TopologyT<IdT>* inoutMesh)
 	{
-		bool Construct(const unsigned* indices, unsigned triCount, Topology* outMesh)
+		const unsigned threadCount = triCount < PARALLEL_MIN_TRIS ? 1 : Parallel_ThreadCount(options.threadCount);
+		std::vector<unsigned>& cornerVerts = builder->cornerVerts;
+		std::vector<unsigned>& vertIndices = builder->vertIndices;
+#if MESHPROC_CONSTRUCT_STATS
+		ConstructStats* const stats = options.optOutStats;
+#else
+		ConstructStats* const stats = nullptr;
+#endif
+		corners::CornerStats cornerStats;
+		corners::CornerStats* const optCornerStats = stats ? &cornerStats : nullptr;
+		stats::Clock::time_point lapStart;
+
+		// One-off builds drop their scratch on failure as well
+		auto Fail = [&]()
 		{
-			static constexpr unsigned HE_NONE = ~0u;
-			const unsigned realHalfEdgeCount = triCount * 6;
-			std::vector<unsigned> indexVertMap;
-			std::vector<unsigned> outVertHEs;
-			std::vector<Vert> outVerts;
-			std::vector<unsigned> outFaceHEs(triCount);
-			std::vector<unsigned> outHEVerts(realHalfEdgeCount);
-			std::vector<FaceIndex> outHEFaces(realHalfEdgeCount);
-			std::vector<unsigned> outHENexts(realHalfEdgeCount);
-			std::unordered_map<uint64_t, unsigned> halfEdgeMap;
-			auto FindAddVert = [&indexVertMap, &outVerts, &outVertHEs](unsigned vertIndex)
-			{
-				if (vertIndex > indexVertMap.size())
-					indexVertMap.resize(vertIndex + 1, HE_NONE);
+			if (freeScratch)
+				*builder = TopologyBuilder();
 
-				if (indexVertMap[vertIndex] == HE_NONE)
-				{
-					indexVertMap[vertIndex] = static_cast<unsigned>(outVerts.size());
-					outVerts.emplace_back(Vert{ {vertIndex, 0} });
-					outVertHEs.emplace_back(HE_NONE);
+			return false;
+		};
 
-					assert(outVerts.back().realIndex == vertIndex && "Vert::realIndex overflow.");
-				}
+		if (stats)
+			stats::Begin(threadCount, &lapStart, stats);
 
-				return indexVertMap[vertIndex];
-			};
+		if (triCount > MAX_TRIS)
+			return Reject(ValidateError::BAD_SIZE, ~0u, "Corner count overflows 32 bits", options.optOutReport);
 
-			// Build real topology
-			for (unsigned triIndex = 0; triIndex < triCount; ++triIndex)
+		cornerVerts.resize(triCount * 3);
+		const unsigned vertCount = corners::RemapVerts(indices, triCount, corners::MaxRealIndex<IdT>(), threadCount, builder, cornerVerts.data(), &vertIndices, options.optOutReport, optCornerStats);
+
+		if (vertCount == corners::NONE)
+			return Fail();
+
+		// The parallel remap keeps its atomic map to itself
+		if (stats)
+			stats::SamplePeak(*builder, threadCount == 1 ? 0 : cornerStats.indexRange * sizeof(std::atomic<unsigned>), stats);
+
+		corners::FreeScratch(freeScratch, &builder->indexVertMap);
+
+		std::vector<VertT<IdT>>& outVerts = inoutMesh->verts;
+
+		// RemapVerts already rejected indices past realIndex
+		outVerts.resize(vertCount);
+		Parallel_For(threadCount, vertCount, [&](unsigned, unsigned begin, unsigned end)
+		{
+			for (unsigned vert = begin; vert < end; ++vert)
 			{
-				const unsigned* const triIndices = indices + triIndex * 3;
-				const unsigned verts[3] = { FindAddVert(triIndices[0]), FindAddVert(triIndices[1]), FindAddVert(triIndices[2]) };
+				outVerts[vert].id = 0;
+				outVerts[vert].realIndex = vertIndices[vert];
+			}
+		});
 
-				sanity(!(triIndices[0] == triIndices[1] || triIndices[1] == triIndices[2] || triIndices[2] == triIndices[0]) && "Degenerate tri detected");
+		corners::FreeScratch(freeScratch, &vertIndices);
 
-				for (unsigned vertIndex = 0; vertIndex < 3; ++vertIndex)
-				{
-					const unsigned nextVertIndex = (vertIndex + 1) % 3;
-					const unsigned vertA = verts[vertIndex];
-					const unsigned vertB = verts[nextVertIndex];
-					const uint64_t edgeId = (static_cast<uint64_t>(vertA) << 32) | vertB;
-					auto edgeIt = halfEdgeMap.find(edgeId);
+		if (stats)
+			stats::Lap(CONSTRUCT_REMAP, &lapStart, stats);
 
-					if (edgeIt == halfEdgeMap.end())
-					{
-						const uint64_t reverseEdge = (static_cast<uint64_t>(vertB) << 32) | vertA;
-						const unsigned newHalfEdge = static_cast<unsigned>(outHEVerts.size());
+		std::vector<unsigned>& cornerHEs = builder->cornerHalfEdges;
+		unsigned halfEdgeCount;
+		{
+			std::vector<unsigned>& cornerPartners = builder->cornerPartners;
 
-						outHEVerts.resize(outHEVerts.size() + 2, HE_NONE);
-						outHEFaces.resize(outHEFaces.size() + 2, FaceIndex{ HE_NONE, FaceType::COUNT });
-						outHENexts.resize(outHENexts.size() + 2, HE_NONE);
+			if (!corners::PairCorners(cornerVerts.data(), triCount * 3, vertCount, threadCount, builder, &cornerPartners, options.optOutReport, optCornerStats))
+				return Fail();
 
-						sanity((newHalfEdge & 1) == 0);
+			if (stats)
+				stats::SamplePeak(*builder, 0, stats);
 
-						halfEdgeMap.emplace(reverseEdge, newHalfEdge + 1);
-						edgeIt = halfEdgeMap.emplace(edgeId, newHalfEdge).first;
-					}
-					else
-					{
-						sanity((edgeIt->second & 1) == 1 && "Non-manifold edge detected");
-					}
+			corners::FreeScratch(freeScratch, &builder->workEdges);
+			corners::FreeScratch(freeScratch, &builder->coarseEdges);
+			const unsigned edgeCount = construct::NumberEdges(cornerPartners, threadCount, &builder->sliceCounts, &cornerHEs);
 
-					const unsigned halfEdge = edgeIt->second;
+			if (edgeCount > MAX_EDGES)
+			{
+				Reject(ValidateError::BAD_SIZE, ~0u, "Half edge count overflows 32 bits", options.optOutReport);
+				return Fail();
+			}
 
-					sanity(outHEVerts[halfEdge] == HE_NONE && "Non-manifold edge detected");
-					sanity(outHEFaces[halfEdge].type == FaceType::COUNT && "Non-manifold edge detected");
+			halfEdgeCount = edgeCount * 2;
+			if (stats)
+				stats::SamplePeak(*builder, 0, stats);
 
-					outHEVerts[halfEdge] = vertA;
-					outHEFaces[halfEdge].index = triIndex;
-					outHEFaces[halfEdge].type = FaceType::REAL;
-					sanity(outHEFaces[halfEdge].index == triIndex && "FaceIndex::index overflow");
+			corners::FreeScratch(freeScratch, &cornerPartners);
+		}
 
-					outVertHEs[vertA] = halfEdge;
-				}
+		if (stats)
+			stats::Lap(CONSTRUCT_PAIR, &lapStart, stats);
+
+		std::vector<unsigned>& outVertHEs = inoutMesh->vertHalfEdges;
+		std::vector<unsigned>& outFaceHEs = inoutMesh->faceHalfEdges[FaceType::REAL];
+		std::vector<unsigned>& outHEVerts = inoutMesh->halfEdgeVerts;
+		std::vector<FaceIndex>& outHEFaces = inoutMesh->halfEdgeFaces;
+		std::vector<unsigned>& outHENexts = inoutMesh->halfEdgeNexts;
+		std::vector<unsigned>& outBoundaryHEs = inoutMesh->faceHalfEdges[FaceType::BOUNDARY];
+		std::vector<std::atomic<unsigned>> vertLastCorners(threadCount == 1 ? 0 : vertCount);
+
+		outVertHEs.assign(vertCount, HE_NONE);
+		outFaceHEs.resize(triCount);
+		outHEVerts.assign(halfEdgeCount, HE_NONE);
+		outHEFaces.assign(halfEdgeCount, FaceIndex{ FACE_NONE, FaceType::BOUNDARY });
+		outHENexts.assign(halfEdgeCount, HE_NONE);
+		outBoundaryHEs.clear();
+
+		// Build real topology
+		Parallel_For(threadCount, triCount, [&](unsigned, unsigned begin, unsigned end)
+		{
+			for (unsigned triIndex = begin; triIndex < end; ++triIndex)
+			{
+				const unsigned* const triHEs = cornerHEs.data() + triIndex * 3;
+				const unsigned* const triVerts = cornerVerts.data() + triIndex * 3;
 
-				unsigned prevVert = verts[2];
-				unsigned prevVertHE = outVertHEs[prevVert];
 				for (unsigned vertIndex = 0; vertIndex < 3; ++vertIndex)
 				{
-					const unsigned curVert = verts[vertIndex];
-					const unsigned curVertHE = outVertHEs[curVert];
+					const unsigned halfEdge = triHEs[vertIndex];
+					const unsigned vert = triVerts[vertIndex];
 
-					outHENexts[prevVertHE] = curVertHE;
+					sanity(outHENexts[halfEdge] == HE_NONE && "Corner pairing let a non-manifold edge through");
 
-					sanity(outHENexts[prevVertHE] == HE_NONE && "Non-manifold edge detected");
+					outHEVerts[halfEdge] = vert;
+					outHEFaces[halfEdge].index = triIndex;
+					outHEFaces[halfEdge].type = FaceType::REAL;
+					sanity(outHEFaces[halfEdge].index == triIndex && "FaceIndex::index overflow");
 
-					prevVert = curVert;
-					prevVertHE = curVertHE;
+					outHENexts[halfEdge] = triHEs[(vertIndex + 1) % 3];
+
+					// A vert takes the half edge of its last corner
+					if (threadCount == 1)
+						outVertHEs[vert] = halfEdge;
+					else
+						Parallel_AtomicMax(&vertLastCorners[vert], triIndex * 3 + vertIndex);
 				}
 
-				outFaceHEs[triIndex] = prevVertHE;
+				outFaceHEs[triIndex] = triHEs[2];
 			}
+		});
 
-			sanity(outHEFaces.size() == outHENexts.size() && outHEFaces.size() == outHEVerts.size());
-
-			// Add imaginary boundary faces
-			std::vector<unsigned> outBoundaryHEs;
-			for (size_t heIndex = 0; heIndex < outHENexts.size(); ++heIndex)
+		if (threadCount != 1)
+		{
+			Parallel_For(threadCount, vertCount, [&](unsigned, unsigned begin, unsigned end)
 			{
-				if (outHENexts[heIndex] == HE_NONE)
-				{
-					const unsigned boundaryIndex = static_cast<unsigned>(outBoundaryHEs.size());
-					const FaceIndex boundaryFace{ boundaryIndex, FaceType::BOUNDARY };
-					unsigned boundaryHEIndex = static_cast<unsigned>(heIndex);
-					unsigned boundaryLoopLen = 0;
-
-					outBoundaryHEs.emplace_back(boundaryHEIndex);
-
-					// Create the new face by walking around the unpaired edges
-					do
-					{
-						const unsigned boundaryHEFlipIndex = boundaryHEIndex ^ 1;
-						unsigned boundaryNextIndex = outHENexts[boundaryHEFlipIndex] ^ 1;
+				for (unsigned vert = begin; vert < end; ++vert)
+					outVertHEs[vert] = cornerHEs[vertLastCorners[vert].load(std::memory_order_relaxed)];
+			});
+		}
 
-						// Find next unpaired edge
-						while (outHENexts[boundaryNextIndex] != HE_NONE)
-							boundaryNextIndex = outHENexts[boundaryNextIndex] ^ 1;
+		if (stats)
+			stats::SamplePeak(*builder, static_cast<uint64_t>(vertLastCorners.capacity()) * sizeof(std::atomic<unsigned>), stats);
 
-						++boundaryLoopLen;
+		corners::FreeScratch(freeScratch, &cornerHEs);
+		corners::FreeScratch(freeScratch, &cornerVerts);
+		vertLastCorners = std::vector<std::atomic<unsigned>>();
 
-						outHEFaces[boundaryHEIndex] = boundaryFace;
-						outHEVerts[boundaryHEIndex] = outHEVerts[boundaryHEFlipIndex];
-						outHENexts[boundaryNextIndex] = boundaryHEIndex; // reverse order for boundary face
-					} while (boundaryHEIndex != heIndex);
+		if (stats)
+			stats::Lap(CONSTRUCT_LINK, &lapStart, stats);
 
-					sanity(boundaryLoopLen >= 3 && "Overlapping faces");
-				}
-			}
+		// Add imaginary boundary faces
+		if (!construct::CreateBoundaryFaces(outHEVerts.data(), outHEFaces.data(), outHENexts.data(), halfEdgeCount, threadCount, &outBoundaryHEs, options.optOutReport, stats))
+			return Fail();
 
-			sanity(outHEFaces.size() == outHENexts.size() && outHEFaces.size() == outHEVerts.size());
+		if (stats)
+			stats::Lap(CONSTRUCT_BOUNDARY, &lapStart, stats);
 
-			for (unsigned halfEdge : outVertHEs)
-				sanity(halfEdge < outHENexts.size());
+		singularity::SplitSingularities(inoutMesh, threadCount, &builder->loopSplitStarts, &builder->splitVerts, stats);
 
-			for (unsigned halfEdge : outFaceHEs)
-				sanity(halfEdge < outHENexts.size());
-
-			for (unsigned halfEdge : outBoundaryHEs)
-				sanity(halfEdge < outHENexts.size());
+		if (stats)
+		{
+			stats::SamplePeak(*builder, 0, stats);
+			stats::Lap(CONSTRUCT_SPLIT, &lapStart, stats);
+		}
 
-			for (unsigned vertIndex : outHEVerts)
-				sanity(vertIndex < outVerts.size());
+		ValidateOptions validateOptions;
 
-			for (unsigned halfEdge : outHENexts)
-				sanity(halfEdge < outHENexts.size());
+		validateOptions.level = options.validate;
+		validateOptions.threadCount = threadCount;
+		const bool valid = Validate(*inoutMesh, options.optOutReport, validateOptions);
 
-			for (FaceIndex faceIndex : outHEFaces)
-			{
-				switch (faceIndex.type)
-				{
-				case FaceType::REAL:
-					sanity(faceIndex.index < outFaceHEs.size());
-					break;
-				case FaceType::BOUNDARY:
-					sanity(faceIndex.index < outBoundaryHEs.size());
-					break;
-				default:
-					sanity(0 && "Unreachable");
-				}
-			}
+		if (stats)
+		{
+			stats::Lap(CONSTRUCT_VALIDATE, &lapStart, stats);
+			stats->indexRange = cornerStats.indexRange;
+			stats->vertCount = vertCount;
+			stats->edgeCount = halfEdgeCount / 2;
+			stats->pairShifts = cornerStats.pairShifts;
+			stats->pairSortedBuckets = cornerStats.pairSortedBuckets;
+			stats->pairMaxBucketEdges = cornerStats.pairMaxBucketEdges;
+			stats->pairCoarseBuckets = cornerStats.pairCoarseBuckets;
+			stats->pairMaxCoarseEdges = cornerStats.pairMaxCoarseEdges;
+		}
 
-			outMesh->vertHalfEdges = std::move(outVertHEs);
-			outMesh->verts = std::move(outVerts);
+		return valid;
+	}
 
-			outMesh->faceHalfEdges[FaceType::REAL] = std::move(outFaceHEs);
-			outMesh->faceHalfEdges[FaceType::BOUNDARY] = std::move(outBoundaryHEs);
+}
 
-			outMesh->halfEdgeVerts = std::move(outHEVerts);
-			outMesh->halfEdgeFaces = std::move(outHEFaces);
-			outMesh->halfEdgeNexts = std::move(outHENexts);
+namespace mesh
+{
+	namespace half_edge
+	{
+		template<typename IdT>
+		bool Construct(const unsigned* indices, unsigned triCount, TopologyT<IdT>* outMesh, const ConstructOptions& options)
+		{
+			TopologyBuilder builder;
 
-			singularity::SplitSingularities(outMesh);
+			return ConstructTopology(&builder, indices, triCount, options, true, outMesh);
+		}
 
-			return validate::ValidateMesh(*outMesh);
+		template<typename IdT>
+		bool Construct(TopologyBuilder* builder, const unsigned* indices, unsigned triCount, TopologyT<IdT>* inoutMesh, const ConstructOptions& options)
+		{
+			return ConstructTopology(builder, indices, triCount, options, false, inoutMesh);
 		}
+
+		template bool Construct(const unsigned*, unsigned, Topology*, const ConstructOptions&);
+		template bool Construct(const unsigned*, unsigned, Topology64*, const ConstructOptions&);
+		template bool Construct(TopologyBuilder*, const unsigned*, unsigned, Topology*, const ConstructOptions&);
+		template bool Construct(TopologyBuilder*, const unsigned*, unsigned, Topology64*, const ConstructOptions&);
 	}
-}
+}
\ No newline at end of file
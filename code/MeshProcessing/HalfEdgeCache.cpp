@@ -0,0 +1,418 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include "MeshProc/HalfEdgeCache.h"
+#include "MappedFile.h"
+
+namespace
+{
+	using namespace mesh;
+	using namespace mesh::half_edge;
+
+	static_assert(sizeof(Vert) == 4 && sizeof(FaceIndex) == 4, "Cached arrays are written as raw 32 bit elements");
+
+	static constexpr char CACHE_MAGIC[8] = { 'M', 'P', 'H', 'E', 'T', 'O', 'P', 'O' };
+	static constexpr uint32_t CACHE_VERSION = 1;
+	static constexpr uint32_t CACHE_ENDIAN_TAG = 0x01020304;
+	static constexpr uint64_t CACHE_ALIGNMENT = 64;
+
+	enum CacheArray : uint32_t
+	{
+		VERT_HALF_EDGES,
+		VERTS,
+		REAL_FACE_HALF_EDGES,
+		BOUNDARY_FACE_HALF_EDGES,
+		HALF_EDGE_VERTS,
+		HALF_EDGE_FACES,
+		HALF_EDGE_NEXTS,
+		CACHE_ARRAY_COUNT
+	};
+
+	struct CacheArrayEntry
+	{
+		uint64_t offset; // From the start of the file, CACHE_ALIGNMENT aligned.
+		uint64_t count; // In 32 bit elements.
+	};
+
+	struct CacheHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t endianTag;
+		uint64_t sourceHash;
+		uint64_t checksum; // Of every array in order, chained through the hash seed.
+		uint64_t fileSize;
+		CacheArrayEntry arrays[CACHE_ARRAY_COUNT];
+	};
+
+	namespace hash
+	{
+		// XXH64.
+		static constexpr uint64_t P1 = 0x9E3779B185EBCA87ull;
+		static constexpr uint64_t P2 = 0xC2B2AE3D27D4EB4Full;
+		static constexpr uint64_t P3 = 0x165667B19E3779F9ull;
+		static constexpr uint64_t P4 = 0x85EBCA77C2B2AE63ull;
+		static constexpr uint64_t P5 = 0x27D4EB2F165667C5ull;
+
+		static inline uint64_t Rotl(uint64_t value, unsigned shift)
+		{
+			return (value << shift) | (value >> (64 - shift));
+		}
+
+		static inline uint64_t Read64(const unsigned char* src)
+		{
+			uint64_t value;
+
+			std::memcpy(&value, src, sizeof(value));
+			return value;
+		}
+
+		static inline uint32_t Read32(const unsigned char* src)
+		{
+			uint32_t value;
+
+			std::memcpy(&value, src, sizeof(value));
+			return value;
+		}
+
+		static inline uint64_t Round(uint64_t acc, uint64_t input)
+		{
+			return Rotl(acc + input * P2, 31) * P1;
+		}
+
+		static inline uint64_t MergeRound(uint64_t acc, uint64_t value)
+		{
+			return (acc ^ Round(0, value)) * P1 + P4;
+		}
+
+		static uint64_t Hash64(const void* data, size_t size, uint64_t seed)
+		{
+			const unsigned char* cur = static_cast<const unsigned char*>(data);
+			const unsigned char* const end = cur + size;
+			uint64_t h;
+
+			if (size >= 32)
+			{
+				uint64_t v[4] = { seed + P1 + P2, seed + P2, seed, seed - P1 };
+
+				for (; end - cur >= 32; cur += 32)
+				{
+					for (unsigned lane = 0; lane < 4; ++lane)
+						v[lane] = Round(v[lane], Read64(cur + lane * 8));
+				}
+
+				h = Rotl(v[0], 1) + Rotl(v[1], 7) + Rotl(v[2], 12) + Rotl(v[3], 18);
+				for (unsigned lane = 0; lane < 4; ++lane)
+					h = MergeRound(h, v[lane]);
+			}
+			else
+			{
+				h = seed + P5;
+			}
+
+			h += size;
+
+			for (; end - cur >= 8; cur += 8)
+				h = Rotl(h ^ Round(0, Read64(cur)), 27) * P1 + P4;
+
+			if (end - cur >= 4)
+			{
+				h = Rotl(h ^ (Read32(cur) * P1), 23) * P2 + P3;
+				cur += 4;
+			}
+
+			for (; cur < end; ++cur)
+				h = Rotl(h ^ (*cur * P5), 11) * P1;
+
+			h ^= h >> 33;
+			h *= P2;
+			h ^= h >> 29;
+			h *= P3;
+			h ^= h >> 32;
+
+			return h;
+		}
+	}
+
+	namespace cache
+	{
+		struct ArrayData
+		{
+			const void* data;
+			size_t count;
+		};
+
+		static void GatherArrays(const TopologyView& view, ArrayData* outArrays)
+		{
+			outArrays[VERT_HALF_EDGES] = { view.vertHalfEdges.data, view.vertHalfEdges.count };
+			outArrays[VERTS] = { view.verts.data, view.verts.count };
+			outArrays[REAL_FACE_HALF_EDGES] = { view.faceHalfEdges[FaceType::REAL].data, view.faceHalfEdges[FaceType::REAL].count };
+			outArrays[BOUNDARY_FACE_HALF_EDGES] = { view.faceHalfEdges[FaceType::BOUNDARY].data, view.faceHalfEdges[FaceType::BOUNDARY].count };
+			outArrays[HALF_EDGE_VERTS] = { view.halfEdgeVerts.data, view.halfEdgeVerts.count };
+			outArrays[HALF_EDGE_FACES] = { view.halfEdgeFaces.data, view.halfEdgeFaces.count };
+			outArrays[HALF_EDGE_NEXTS] = { view.halfEdgeNexts.data, view.halfEdgeNexts.count };
+		}
+
+		static uint64_t Checksum(const ArrayData* arrays)
+		{
+			uint64_t checksum = 0;
+
+			for (unsigned arrayIndex = 0; arrayIndex < CACHE_ARRAY_COUNT; ++arrayIndex)
+				checksum = hash::Hash64(arrays[arrayIndex].data, arrays[arrayIndex].count * 4, checksum);
+
+			return checksum;
+		}
+
+		static inline uint64_t AlignUp(uint64_t offset)
+		{
+			return (offset + CACHE_ALIGNMENT - 1) & ~(CACHE_ALIGNMENT - 1);
+		}
+
+		template<typename T>
+		static ArrayView<T> MappedArray(const char* data, const CacheArrayEntry& entry)
+		{
+			ArrayView<T> view;
+
+			view.data = reinterpret_cast<const T*>(data + entry.offset);
+			view.count = static_cast<size_t>(entry.count);
+
+			return view;
+		}
+
+		// Only checks what is needed to hand out the arrays safely. The topology itself was validated when built.
+		static bool ValidateHeader(const CacheHeader& header, size_t fileSize, uint64_t sourceHash)
+		{
+			if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.version != CACHE_VERSION || header.endianTag != CACHE_ENDIAN_TAG)
+				return false;
+
+			if (header.sourceHash != sourceHash || header.fileSize != fileSize)
+				return false;
+
+			for (const CacheArrayEntry& entry : header.arrays)
+			{
+				if (entry.offset % CACHE_ALIGNMENT || entry.offset < sizeof(CacheHeader) || entry.offset > fileSize || entry.count > (fileSize - entry.offset) / 4)
+					return false;
+			}
+
+			const uint64_t halfEdgeCount = header.arrays[HALF_EDGE_VERTS].count;
+
+			return header.arrays[VERTS].count == header.arrays[VERT_HALF_EDGES].count &&
+				header.arrays[HALF_EDGE_FACES].count == halfEdgeCount &&
+				header.arrays[HALF_EDGE_NEXTS].count == halfEdgeCount;
+		}
+	}
+}
+
+namespace mesh
+{
+	namespace half_edge
+	{
+		CachedTopology::~CachedTopology()
+		{
+			CloseCache(this);
+		}
+
+		CachedTopology::CachedTopology(CachedTopology&& other) noexcept
+		{
+			*this = std::move(other);
+		}
+
+		CachedTopology& CachedTopology::operator=(CachedTopology&& other) noexcept
+		{
+			if (this == &other)
+				return *this;
+
+			CloseCache(this);
+
+			// Moving the vectors keeps their buffers, so a view into built stays valid.
+			view = other.view;
+			built = std::move(other.built);
+			mappedData = other.mappedData;
+			mappedSize = other.mappedSize;
+			mappedHandle = other.mappedHandle;
+
+			other.view = TopologyView();
+			other.built = Topology();
+			other.mappedData = nullptr;
+			other.mappedSize = 0;
+			other.mappedHandle = nullptr;
+
+			return *this;
+		}
+
+		TopologyView View(const Topology& mesh)
+		{
+			TopologyView view;
+
+			view.vertHalfEdges = { mesh.vertHalfEdges.data(), mesh.vertHalfEdges.size() };
+			view.verts = { mesh.verts.data(), mesh.verts.size() };
+			for (unsigned faceType = 0; faceType < FaceType::COUNT; ++faceType)
+				view.faceHalfEdges[faceType] = { mesh.faceHalfEdges[faceType].data(), mesh.faceHalfEdges[faceType].size() };
+			view.halfEdgeVerts = { mesh.halfEdgeVerts.data(), mesh.halfEdgeVerts.size() };
+			view.halfEdgeFaces = { mesh.halfEdgeFaces.data(), mesh.halfEdgeFaces.size() };
+			view.halfEdgeNexts = { mesh.halfEdgeNexts.data(), mesh.halfEdgeNexts.size() };
+
+			return view;
+		}
+
+		uint64_t HashSource(const unsigned* indices, unsigned triCount)
+		{
+			return hash::Hash64(indices, static_cast<size_t>(triCount) * 3 * sizeof(unsigned), 0);
+		}
+
+		bool WriteCache(const char* path, const Topology& mesh, uint64_t sourceHash)
+		{
+			static const char PADDING[CACHE_ALIGNMENT] = {};
+			cache::ArrayData arrays[CACHE_ARRAY_COUNT];
+			CacheHeader header;
+			uint64_t offset = sizeof(CacheHeader);
+
+			cache::GatherArrays(View(mesh), arrays);
+
+			std::memset(&header, 0, sizeof(header));
+			std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+			header.version = CACHE_VERSION;
+			header.endianTag = CACHE_ENDIAN_TAG;
+			header.sourceHash = sourceHash;
+			header.checksum = cache::Checksum(arrays);
+
+			for (unsigned arrayIndex = 0; arrayIndex < CACHE_ARRAY_COUNT; ++arrayIndex)
+			{
+				offset = cache::AlignUp(offset);
+				header.arrays[arrayIndex] = { offset, arrays[arrayIndex].count };
+				offset += arrays[arrayIndex].count * 4;
+			}
+
+			header.fileSize = offset;
+
+			const std::string tempPath = std::string(path) + ".tmp";
+			FILE* const file = std::fopen(tempPath.c_str(), "wb");
+
+			if (!file)
+				return false;
+
+			bool written = std::fwrite(&header, sizeof(header), 1, file) == 1;
+
+			offset = sizeof(CacheHeader);
+			for (unsigned arrayIndex = 0; arrayIndex < CACHE_ARRAY_COUNT && written; ++arrayIndex)
+			{
+				const size_t padding = static_cast<size_t>(header.arrays[arrayIndex].offset - offset);
+				const size_t arrayBytes = arrays[arrayIndex].count * 4;
+
+				written &= std::fwrite(PADDING, 1, padding, file) == padding;
+				written &= arrayBytes == 0 || std::fwrite(arrays[arrayIndex].data, 1, arrayBytes, file) == arrayBytes;
+				offset = header.arrays[arrayIndex].offset + arrayBytes;
+			}
+
+			written &= std::fclose(file) == 0;
+
+			// rename does not replace an existing file everywhere.
+			if (written)
+			{
+				std::remove(path);
+				written = std::rename(tempPath.c_str(), path) == 0;
+			}
+
+			if (!written)
+				std::remove(tempPath.c_str());
+
+			return written;
+		}
+
+		bool OpenCache(const char* path, uint64_t sourceHash, CachedTopology* outCache, const CacheOptions& options)
+		{
+			MappedFile file;
+
+			CloseCache(outCache);
+
+			if (!MappedFile_Open(path, &file))
+				return false;
+
+			CacheHeader header;
+
+			if (file.size < sizeof(header))
+			{
+				MappedFile_Close(&file);
+				return false;
+			}
+
+			std::memcpy(&header, file.data, sizeof(header));
+
+			if (!cache::ValidateHeader(header, file.size, sourceHash))
+			{
+				MappedFile_Close(&file);
+				return false;
+			}
+
+			TopologyView view;
+
+			view.vertHalfEdges = cache::MappedArray<unsigned>(file.data, header.arrays[VERT_HALF_EDGES]);
+			view.verts = cache::MappedArray<Vert>(file.data, header.arrays[VERTS]);
+			view.faceHalfEdges[FaceType::REAL] = cache::MappedArray<unsigned>(file.data, header.arrays[REAL_FACE_HALF_EDGES]);
+			view.faceHalfEdges[FaceType::BOUNDARY] = cache::MappedArray<unsigned>(file.data, header.arrays[BOUNDARY_FACE_HALF_EDGES]);
+			view.halfEdgeVerts = cache::MappedArray<unsigned>(file.data, header.arrays[HALF_EDGE_VERTS]);
+			view.halfEdgeFaces = cache::MappedArray<FaceIndex>(file.data, header.arrays[HALF_EDGE_FACES]);
+			view.halfEdgeNexts = cache::MappedArray<unsigned>(file.data, header.arrays[HALF_EDGE_NEXTS]);
+
+			if (options.verifyChecksum)
+			{
+				cache::ArrayData arrays[CACHE_ARRAY_COUNT];
+
+				cache::GatherArrays(view, arrays);
+				if (cache::Checksum(arrays) != header.checksum)
+				{
+					MappedFile_Close(&file);
+					return false;
+				}
+			}
+
+			outCache->view = view;
+			outCache->mappedData = file.data;
+			outCache->mappedSize = file.size;
+			outCache->mappedHandle = file.handle;
+
+			return true;
+		}
+
+		bool LoadCache(const char* path, const unsigned* indices, unsigned triCount, CachedTopology* outCache, const ConstructOptions& constructOptions, const CacheOptions& options)
+		{
+			const uint64_t sourceHash = HashSource(indices, triCount);
+
+			if (OpenCache(path, sourceHash, outCache, options))
+				return true;
+
+			Topology built;
+
+			if (!Construct(indices, triCount, &built, constructOptions))
+				return false;
+
+			if (WriteCache(path, built, sourceHash) && OpenCache(path, sourceHash, outCache, options))
+				return true;
+
+			// The cache could not be written. Serve the built topology instead.
+			outCache->built = std::move(built);
+			outCache->view = View(outCache->built);
+
+			return true;
+		}
+
+		void CloseCache(CachedTopology* inoutCache)
+		{
+			if (inoutCache->mappedData)
+			{
+				MappedFile file;
+
+				file.data = static_cast<const char*>(inoutCache->mappedData);
+				file.size = inoutCache->mappedSize;
+				file.handle = inoutCache->mappedHandle;
+				MappedFile_Close(&file);
+			}
+
+			inoutCache->view = TopologyView();
+			inoutCache->built = Topology();
+			inoutCache->mappedData = nullptr;
+			inoutCache->mappedSize = 0;
+			inoutCache->mappedHandle = nullptr;
+		}
+	}
+}
@@ -0,0 +1,589 @@
+#include <algorithm>
+#include "MeshProc/HalfEdgeEdit.h"
+#include "sanity.h"
+
+namespace
+{
+	using namespace mesh;
+	using namespace mesh::half_edge;
+
+	static constexpr unsigned FACE_NONE = (1u << 31) - 1;
+
+	namespace edit
+	{
+		static inline bool IsReal(const Topology& mesh, unsigned halfEdge)
+		{
+			return mesh.halfEdgeFaces[halfEdge].type == FaceType::REAL;
+		}
+
+		static inline unsigned Dest(const Topology& mesh, unsigned halfEdge)
+		{
+			return mesh.halfEdgeVerts[halfEdge ^ 1];
+		}
+
+		// Real faces are triangles. Boundary loops have no back pointers, so their previous half edge is found by
+		// rotating through the edges entering the origin, O(valence).
+		static unsigned Prev(const Topology& mesh, unsigned halfEdge)
+		{
+			if (IsReal(mesh, halfEdge))
+				return mesh.halfEdgeNexts[mesh.halfEdgeNexts[halfEdge]];
+
+			unsigned incoming = halfEdge ^ 1;
+
+			while (mesh.halfEdgeNexts[incoming] != halfEdge)
+				incoming = mesh.halfEdgeNexts[incoming] ^ 1;
+
+			return incoming;
+		}
+
+		static bool IsBoundaryVert(const Topology& mesh, unsigned vert)
+		{
+			const unsigned vertHE = mesh.vertHalfEdges[vert];
+			unsigned curHE = vertHE;
+
+			do
+			{
+				if (!IsReal(mesh, curHE))
+					return true;
+
+				curHE = mesh.halfEdgeNexts[curHE ^ 1];
+			} while (curHE != vertHE);
+
+			return false;
+		}
+
+		static unsigned Valence(const Topology& mesh, unsigned vert)
+		{
+			const unsigned vertHE = mesh.vertHalfEdges[vert];
+			unsigned curHE = vertHE;
+			unsigned valence = 0;
+
+			do
+			{
+				++valence;
+				curHE = mesh.halfEdgeNexts[curHE ^ 1];
+			} while (curHE != vertHE);
+
+			return valence;
+		}
+
+		static inline bool IsLiveHalfEdge(const Topology& mesh, unsigned halfEdge)
+		{
+			return halfEdge < mesh.halfEdgeNexts.size() && mesh.halfEdgeNexts[halfEdge] != INVALID_INDEX;
+		}
+
+		// Allocation may grow the arrays, so callers allocate everything before taking pointers into them.
+		static unsigned AllocEdge(Editor* editor)
+		{
+			Topology* const mesh = editor->mesh;
+
+			if (!editor->freeEdges.empty())
+			{
+				const unsigned edge = editor->freeEdges.back();
+
+				editor->freeEdges.pop_back();
+				return edge;
+			}
+
+			const unsigned edge = static_cast<unsigned>(mesh->halfEdgeNexts.size() / 2);
+
+			sanity(edge < (INVALID_INDEX >> 1) && "Half edge index overflow");
+
+			mesh->halfEdgeVerts.resize(mesh->halfEdgeVerts.size() + 2, INVALID_INDEX);
+			mesh->halfEdgeFaces.resize(mesh->halfEdgeFaces.size() + 2, FaceIndex{ FACE_NONE, FaceType::BOUNDARY });
+			mesh->halfEdgeNexts.resize(mesh->halfEdgeNexts.size() + 2, INVALID_INDEX);
+
+			return edge;
+		}
+
+		static unsigned AllocFace(Editor* editor)
+		{
+			std::vector<unsigned>& faceHEs = editor->mesh->faceHalfEdges[FaceType::REAL];
+
+			if (!editor->freeFaces.empty())
+			{
+				const unsigned face = editor->freeFaces.back();
+
+				editor->freeFaces.pop_back();
+				return face;
+			}
+
+			sanity(faceHEs.size() < FACE_NONE && "FaceIndex::index overflow");
+
+			faceHEs.emplace_back(INVALID_INDEX);
+			return static_cast<unsigned>(faceHEs.size() - 1);
+		}
+
+		static unsigned AllocVert(Editor* editor, unsigned realIndex)
+		{
+			Topology* const mesh = editor->mesh;
+			Vert vert;
+			unsigned vertIndex;
+
+			vert.id = 0;
+			vert.realIndex = realIndex;
+			sanity(vert.realIndex == realIndex && "mesh::half_edge::Vert::realIndex overflow");
+
+			if (!editor->freeVerts.empty())
+			{
+				vertIndex = editor->freeVerts.back();
+				editor->freeVerts.pop_back();
+				mesh->verts[vertIndex] = vert;
+			}
+			else
+			{
+				vertIndex = static_cast<unsigned>(mesh->verts.size());
+				mesh->verts.emplace_back(vert);
+				mesh->vertHalfEdges.emplace_back(INVALID_INDEX);
+			}
+
+			return vertIndex;
+		}
+
+		static void FreeEdge(Editor* editor, unsigned edge)
+		{
+			Topology* const mesh = editor->mesh;
+
+			for (unsigned halfEdge = edge * 2; halfEdge < edge * 2 + 2; ++halfEdge)
+			{
+				mesh->halfEdgeVerts[halfEdge] = INVALID_INDEX;
+				mesh->halfEdgeFaces[halfEdge] = FaceIndex{ FACE_NONE, FaceType::BOUNDARY };
+				mesh->halfEdgeNexts[halfEdge] = INVALID_INDEX;
+			}
+
+			editor->freeEdges.emplace_back(edge);
+		}
+
+		static void FreeFace(Editor* editor, unsigned face)
+		{
+			editor->mesh->faceHalfEdges[FaceType::REAL][face] = INVALID_INDEX;
+			editor->freeFaces.emplace_back(face);
+		}
+
+		static void FreeVert(Editor* editor, unsigned vert)
+		{
+			editor->mesh->vertHalfEdges[vert] = INVALID_INDEX;
+			editor->freeVerts.emplace_back(vert);
+		}
+
+		// Puts replacement where replaced sits in its face loop, taking over its face. replaced is left dangling.
+		static void ReplaceInLoop(Topology* inoutMesh, unsigned replaced, unsigned replacement)
+		{
+			const unsigned prevHE = Prev(*inoutMesh, replaced);
+			const FaceIndex face = inoutMesh->halfEdgeFaces[replaced];
+			unsigned& faceHE = inoutMesh->faceHalfEdges[face.type][face.index];
+
+			inoutMesh->halfEdgeNexts[prevHE] = replacement;
+			inoutMesh->halfEdgeNexts[replacement] = inoutMesh->halfEdgeNexts[replaced];
+			inoutMesh->halfEdgeFaces[replacement] = face;
+
+			if (faceHE == replaced)
+				faceHE = replacement;
+		}
+
+		static void SetFace(Topology* inoutMesh, unsigned face, unsigned he0, unsigned he1, unsigned he2)
+		{
+			const FaceIndex faceIndex{ face, FaceType::REAL };
+
+			inoutMesh->halfEdgeNexts[he0] = he1;
+			inoutMesh->halfEdgeNexts[he1] = he2;
+			inoutMesh->halfEdgeNexts[he2] = he0;
+			inoutMesh->halfEdgeFaces[he0] = faceIndex;
+			inoutMesh->halfEdgeFaces[he1] = faceIndex;
+			inoutMesh->halfEdgeFaces[he2] = faceIndex;
+			inoutMesh->faceHalfEdges[FaceType::REAL][face] = he0;
+		}
+	}
+}
+
+namespace mesh
+{
+	namespace half_edge
+	{
+		void BeginEdit(Topology* mesh, Editor* outEditor)
+		{
+			outEditor->mesh = mesh;
+			outEditor->freeEdges.clear();
+			outEditor->freeFaces.clear();
+			outEditor->freeVerts.clear();
+
+			for (unsigned halfEdge = 0; halfEdge < mesh->halfEdgeNexts.size(); halfEdge += 2)
+			{
+				if (mesh->halfEdgeNexts[halfEdge] == INVALID_INDEX)
+					outEditor->freeEdges.emplace_back(halfEdge / 2);
+			}
+
+			for (unsigned face = 0; face < mesh->faceHalfEdges[FaceType::REAL].size(); ++face)
+			{
+				if (mesh->faceHalfEdges[FaceType::REAL][face] == INVALID_INDEX)
+					outEditor->freeFaces.emplace_back(face);
+			}
+
+			for (unsigned vert = 0; vert < mesh->vertHalfEdges.size(); ++vert)
+			{
+				if (mesh->vertHalfEdges[vert] == INVALID_INDEX)
+					outEditor->freeVerts.emplace_back(vert);
+			}
+		}
+
+		bool FlipEdge(Editor* editor, unsigned halfEdge)
+		{
+			Topology* const mesh = editor->mesh;
+			const unsigned h = halfEdge;
+			const unsigned t = halfEdge ^ 1;
+
+			sanity(edit::IsLiveHalfEdge(*mesh, h) && "Editing a deleted half edge");
+
+			if (!edit::IsReal(*mesh, h) || !edit::IsReal(*mesh, t))
+				return false;
+
+			// h: a->b in (a, b, c). t: b->a in (b, a, d).
+			const unsigned h1 = mesh->halfEdgeNexts[h];
+			const unsigned h2 = mesh->halfEdgeNexts[h1];
+			const unsigned t1 = mesh->halfEdgeNexts[t];
+			const unsigned t2 = mesh->halfEdgeNexts[t1];
+			const unsigned a = mesh->halfEdgeVerts[h];
+			const unsigned b = mesh->halfEdgeVerts[t];
+			const unsigned c = mesh->halfEdgeVerts[h2];
+			const unsigned d = mesh->halfEdgeVerts[t2];
+
+			if (c == d)
+				return false;
+
+			const unsigned cVertHE = mesh->vertHalfEdges[c];
+			unsigned curHE = cVertHE;
+
+			do
+			{
+				if (edit::Dest(*mesh, curHE) == d)
+					return false;
+
+				curHE = mesh->halfEdgeNexts[curHE ^ 1];
+			} while (curHE != cVertHE);
+
+			// h: d->c in (a, d, c). t: c->d in (d, b, c).
+			mesh->halfEdgeVerts[h] = d;
+			mesh->halfEdgeVerts[t] = c;
+			edit::SetFace(mesh, mesh->halfEdgeFaces[h].index, h, h2, t1);
+			edit::SetFace(mesh, mesh->halfEdgeFaces[t].index, t, t2, h1);
+
+			if (mesh->vertHalfEdges[a] == h)
+				mesh->vertHalfEdges[a] = t1;
+
+			if (mesh->vertHalfEdges[b] == t)
+				mesh->vertHalfEdges[b] = h1;
+
+			return true;
+		}
+
+		unsigned SplitEdge(Editor* editor, unsigned halfEdge, unsigned realIndex)
+		{
+			Topology* const mesh = editor->mesh;
+
+			sanity(edit::IsLiveHalfEdge(*mesh, halfEdge) && "Editing a deleted half edge");
+
+			// A boundary side is extended in place after h, which needs no previous half edge
+			const unsigned h = edit::IsReal(*mesh, halfEdge ^ 1) ? halfEdge : halfEdge ^ 1;
+			const unsigned t = h ^ 1;
+			const bool hReal = edit::IsReal(*mesh, h);
+
+			const unsigned m = edit::AllocVert(editor, realIndex);
+			const unsigned e0 = edit::AllocEdge(editor) * 2;
+			const unsigned e1 = e0 + 1;
+			const unsigned g0 = edit::AllocEdge(editor) * 2;
+			const unsigned g1 = g0 + 1;
+			const unsigned f0 = hReal ? edit::AllocEdge(editor) * 2 : INVALID_INDEX;
+			const unsigned f1 = f0 + 1;
+			const unsigned hNewFace = hReal ? edit::AllocFace(editor) : INVALID_INDEX;
+			const unsigned tNewFace = edit::AllocFace(editor);
+
+			// h: a->m, e0: m->b, e1: b->m, t: m->a
+			const unsigned b = mesh->halfEdgeVerts[t];
+			const unsigned h1 = mesh->halfEdgeNexts[h];
+			const unsigned t1 = mesh->halfEdgeNexts[t];
+			const unsigned t2 = mesh->halfEdgeNexts[t1];
+			const unsigned d = mesh->halfEdgeVerts[t2];
+
+			mesh->halfEdgeVerts[e0] = m;
+			mesh->halfEdgeVerts[e1] = b;
+			mesh->halfEdgeVerts[t] = m;
+
+			if (hReal)
+			{
+				// (a, b, c) becomes (a, m, c) and (m, b, c)
+				const unsigned h2 = mesh->halfEdgeNexts[h1];
+				const unsigned c = mesh->halfEdgeVerts[h2];
+
+				mesh->halfEdgeVerts[f0] = m;
+				mesh->halfEdgeVerts[f1] = c;
+				edit::SetFace(mesh, mesh->halfEdgeFaces[h].index, h, f0, h2);
+				edit::SetFace(mesh, hNewFace, e0, h1, f1);
+			}
+			else
+			{
+				mesh->halfEdgeNexts[h] = e0;
+				mesh->halfEdgeNexts[e0] = h1;
+				mesh->halfEdgeFaces[e0] = mesh->halfEdgeFaces[h];
+			}
+
+			// (b, a, d) becomes (m, a, d) and (b, m, d)
+			mesh->halfEdgeVerts[g0] = m;
+			mesh->halfEdgeVerts[g1] = d;
+			edit::SetFace(mesh, mesh->halfEdgeFaces[t].index, t, t1, g1);
+			edit::SetFace(mesh, tNewFace, e1, g0, t2);
+
+			mesh->vertHalfEdges[m] = e0;
+			if (mesh->vertHalfEdges[b] == t)
+				mesh->vertHalfEdges[b] = e1;
+
+			return m;
+		}
+
+		unsigned SplitFace(Editor* editor, unsigned face, unsigned realIndex)
+		{
+			Topology* const mesh = editor->mesh;
+
+			sanity(face < mesh->faceHalfEdges[FaceType::REAL].size() && mesh->faceHalfEdges[FaceType::REAL][face] != INVALID_INDEX && "Editing a deleted face");
+
+			const unsigned m = edit::AllocVert(editor, realIndex);
+			const unsigned a0 = edit::AllocEdge(editor) * 2;
+			const unsigned b0 = edit::AllocEdge(editor) * 2;
+			const unsigned c0 = edit::AllocEdge(editor) * 2;
+			const unsigned bFace = edit::AllocFace(editor);
+			const unsigned cFace = edit::AllocFace(editor);
+
+			// h0: a->b, h1: b->c, h2: c->a. x0: m->x, x1: x->m.
+			const unsigned h0 = mesh->faceHalfEdges[FaceType::REAL][face];
+			const unsigned h1 = mesh->halfEdgeNexts[h0];
+			const unsigned h2 = mesh->halfEdgeNexts[h1];
+
+			mesh->halfEdgeVerts[a0] = m;
+			mesh->halfEdgeVerts[a0 + 1] = mesh->halfEdgeVerts[h0];
+			mesh->halfEdgeVerts[b0] = m;
+			mesh->halfEdgeVerts[b0 + 1] = mesh->halfEdgeVerts[h1];
+			mesh->halfEdgeVerts[c0] = m;
+			mesh->halfEdgeVerts[c0 + 1] = mesh->halfEdgeVerts[h2];
+
+			edit::SetFace(mesh, face, h0, b0 + 1, a0);
+			edit::SetFace(mesh, bFace, h1, c0 + 1, b0);
+			edit::SetFace(mesh, cFace, h2, a0 + 1, c0);
+
+			mesh->vertHalfEdges[m] = a0;
+
+			return m;
+		}
+
+		bool CanCollapseEdge(Editor* editor, unsigned halfEdge)
+		{
+			const Topology& mesh = *editor->mesh;
+			const unsigned h = halfEdge;
+			const unsigned t = halfEdge ^ 1;
+
+			sanity(edit::IsLiveHalfEdge(mesh, h) && "Editing a deleted half edge");
+
+			const bool hReal = edit::IsReal(mesh, h);
+			const bool tReal = edit::IsReal(mesh, t);
+			const unsigned a = mesh.halfEdgeVerts[h];
+			const unsigned b = mesh.halfEdgeVerts[t];
+
+			// Would close a triangular hole down to two edges
+			if ((!hReal && mesh.halfEdgeNexts[mesh.halfEdgeNexts[mesh.halfEdgeNexts[h]]] == h) ||
+				(!tReal && mesh.halfEdgeNexts[mesh.halfEdgeNexts[mesh.halfEdgeNexts[t]]] == t))
+				return false;
+
+			// Would pinch two boundary verts together through the interior
+			if (hReal && tReal && edit::IsBoundaryVert(mesh, a) && edit::IsBoundaryVert(mesh, b))
+				return false;
+
+			const unsigned c = hReal ? mesh.halfEdgeVerts[mesh.halfEdgeNexts[mesh.halfEdgeNexts[h]]] : INVALID_INDEX;
+			const unsigned d = tReal ? mesh.halfEdgeVerts[mesh.halfEdgeNexts[mesh.halfEdgeNexts[t]]] : INVALID_INDEX;
+
+			// Link condition: a and b may only share the verts opposite the edge
+			std::vector<unsigned>& aNeighbors = editor->scratch;
+			unsigned curHE = h;
+
+			aNeighbors.clear();
+			do
+			{
+				aNeighbors.emplace_back(edit::Dest(mesh, curHE));
+				curHE = mesh.halfEdgeNexts[curHE ^ 1];
+			} while (curHE != h);
+
+			curHE = t;
+			do
+			{
+				const unsigned neighbor = edit::Dest(mesh, curHE);
+
+				if (neighbor != a && neighbor != c && neighbor != d && std::find(aNeighbors.begin(), aNeighbors.end(), neighbor) != aNeighbors.end())
+					return false;
+
+				curHE = mesh.halfEdgeNexts[curHE ^ 1];
+			} while (curHE != t);
+
+			// Opposite verts lose an edge and must keep a face of their own
+			for (unsigned opposite : { c, d })
+			{
+				if (opposite != INVALID_INDEX && edit::Valence(mesh, opposite) <= (edit::IsBoundaryVert(mesh, opposite) ? 2u : 3u))
+					return false;
+			}
+
+			return true;
+		}
+
+		bool CollapseEdge(Editor* editor, unsigned halfEdge)
+		{
+			if (!CanCollapseEdge(editor, halfEdge))
+				return false;
+
+			Topology* const mesh = editor->mesh;
+			const unsigned h = halfEdge;
+			const unsigned t = halfEdge ^ 1;
+			const bool hReal = edit::IsReal(*mesh, h);
+			const bool tReal = edit::IsReal(*mesh, t);
+			const unsigned a = mesh->halfEdgeVerts[h];
+			const unsigned b = mesh->halfEdgeVerts[t];
+			unsigned bVertHE;
+
+			// Move a's fan onto b
+			unsigned curHE = h;
+			do
+			{
+				mesh->halfEdgeVerts[curHE] = b;
+				curHE = mesh->halfEdgeNexts[curHE ^ 1];
+			} while (curHE != h);
+
+			// Each real side (a, b, c) folds flat: h1 (b->c) takes the place of a->c, and the c->a edge goes away
+			if (hReal)
+			{
+				const unsigned h1 = mesh->halfEdgeNexts[h];
+				const unsigned h2 = mesh->halfEdgeNexts[h1];
+				const unsigned c = mesh->halfEdgeVerts[h2];
+
+				edit::ReplaceInLoop(mesh, h2 ^ 1, h1);
+
+				if (mesh->vertHalfEdges[c] == h2)
+					mesh->vertHalfEdges[c] = h1 ^ 1;
+
+				edit::FreeFace(editor, mesh->halfEdgeFaces[h].index);
+				edit::FreeEdge(editor, h2 / 2);
+				bVertHE = h1;
+			}
+			else
+			{
+				const unsigned prevHE = edit::Prev(*mesh, h);
+				const unsigned nextHE = mesh->halfEdgeNexts[h];
+				unsigned& boundaryHE = mesh->faceHalfEdges[FaceType::BOUNDARY][mesh->halfEdgeFaces[h].index];
+
+				mesh->halfEdgeNexts[prevHE] = nextHE;
+				if (boundaryHE == h)
+					boundaryHE = nextHE;
+
+				bVertHE = nextHE;
+			}
+
+			// (b, a, d) folds the same way: t2 (d->b) takes the place of d->a, and the a->d edge goes away
+			if (tReal)
+			{
+				const unsigned t1 = mesh->halfEdgeNexts[t];
+				const unsigned t2 = mesh->halfEdgeNexts[t1];
+				const unsigned d = mesh->halfEdgeVerts[t2];
+
+				edit::ReplaceInLoop(mesh, t1 ^ 1, t2);
+
+				if (mesh->vertHalfEdges[d] == (t1 ^ 1))
+					mesh->vertHalfEdges[d] = t2;
+
+				edit::FreeFace(editor, mesh->halfEdgeFaces[t].index);
+				edit::FreeEdge(editor, t1 / 2);
+			}
+			else
+			{
+				const unsigned prevHE = edit::Prev(*mesh, t);
+				const unsigned nextHE = mesh->halfEdgeNexts[t];
+				unsigned& boundaryHE = mesh->faceHalfEdges[FaceType::BOUNDARY][mesh->halfEdgeFaces[t].index];
+
+				mesh->halfEdgeNexts[prevHE] = nextHE;
+				if (boundaryHE == t)
+					boundaryHE = nextHE;
+			}
+
+			mesh->vertHalfEdges[b] = bVertHE;
+			edit::FreeEdge(editor, h / 2);
+			edit::FreeVert(editor, a);
+
+			return true;
+		}
+
+		void Compact(Editor* editor)
+		{
+			Topology* const mesh = editor->mesh;
+			std::vector<unsigned>& realFaceHEs = mesh->faceHalfEdges[FaceType::REAL];
+			const unsigned halfEdgeCount = static_cast<unsigned>(mesh->halfEdgeNexts.size());
+			const unsigned vertCount = static_cast<unsigned>(mesh->verts.size());
+			const unsigned faceCount = static_cast<unsigned>(realFaceHEs.size());
+			std::vector<unsigned> edgeRemap(halfEdgeCount / 2);
+			std::vector<unsigned> vertRemap(vertCount);
+			std::vector<unsigned> faceRemap(faceCount);
+			unsigned liveEdgeCount = 0;
+			unsigned liveVertCount = 0;
+			unsigned liveFaceCount = 0;
+
+			for (unsigned edge = 0; edge < halfEdgeCount / 2; ++edge)
+				edgeRemap[edge] = mesh->halfEdgeNexts[edge * 2] == INVALID_INDEX ? INVALID_INDEX : liveEdgeCount++;
+
+			for (unsigned vert = 0; vert < vertCount; ++vert)
+				vertRemap[vert] = mesh->vertHalfEdges[vert] == INVALID_INDEX ? INVALID_INDEX : liveVertCount++;
+
+			for (unsigned face = 0; face < faceCount; ++face)
+				faceRemap[face] = realFaceHEs[face] == INVALID_INDEX ? INVALID_INDEX : liveFaceCount++;
+
+			auto RemapHalfEdge = [&](unsigned halfEdge) { return edgeRemap[halfEdge / 2] * 2 + (halfEdge & 1); };
+
+			// Every slot moves down or stays, so compacting front to back never overwrites an unread slot
+			for (unsigned halfEdge = 0; halfEdge < halfEdgeCount; ++halfEdge)
+			{
+				if (edgeRemap[halfEdge / 2] == INVALID_INDEX)
+					continue;
+
+				const unsigned newHalfEdge = RemapHalfEdge(halfEdge);
+				FaceIndex face = mesh->halfEdgeFaces[halfEdge];
+
+				if (face.type == FaceType::REAL)
+					face.index = faceRemap[face.index];
+
+				mesh->halfEdgeVerts[newHalfEdge] = vertRemap[mesh->halfEdgeVerts[halfEdge]];
+				mesh->halfEdgeFaces[newHalfEdge] = face;
+				mesh->halfEdgeNexts[newHalfEdge] = RemapHalfEdge(mesh->halfEdgeNexts[halfEdge]);
+			}
+
+			for (unsigned vert = 0; vert < vertCount; ++vert)
+			{
+				if (vertRemap[vert] != INVALID_INDEX)
+				{
+					mesh->verts[vertRemap[vert]] = mesh->verts[vert];
+					mesh->vertHalfEdges[vertRemap[vert]] = RemapHalfEdge(mesh->vertHalfEdges[vert]);
+				}
+			}
+
+			for (unsigned face = 0; face < faceCount; ++face)
+			{
+				if (faceRemap[face] != INVALID_INDEX)
+					realFaceHEs[faceRemap[face]] = RemapHalfEdge(realFaceHEs[face]);
+			}
+
+			for (unsigned& boundaryHE : mesh->faceHalfEdges[FaceType::BOUNDARY])
+				boundaryHE = RemapHalfEdge(boundaryHE);
+
+			mesh->halfEdgeVerts.resize(liveEdgeCount * 2);
+			mesh->halfEdgeFaces.resize(liveEdgeCount * 2);
+			mesh->halfEdgeNexts.resize(liveEdgeCount * 2);
+			mesh->verts.resize(liveVertCount);
+			mesh->vertHalfEdges.resize(liveVertCount);
+			realFaceHEs.resize(liveFaceCount);
+
+			editor->freeEdges.clear();
+			editor->freeFaces.clear();
+			editor->freeVerts.clear();
+		}
+	}
+}
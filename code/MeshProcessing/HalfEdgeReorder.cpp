@@ -0,0 +1,293 @@
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+#include <vector>
+#include "MeshProc/HalfEdgeCirculators.h"
+#include "MeshProc/HalfEdgeReorder.h"
+#include "Parallel.h"
+#include "sanity.h"
+
+namespace
+{
+	using namespace mesh;
+	using namespace mesh::half_edge;
+
+	static constexpr unsigned NONE = ~0u;
+	static constexpr unsigned MORTON_BITS = 10; // Per axis, so a code fits the top 30 bits of a key's high word
+	static constexpr unsigned RADIX_BITS = 10;
+	static constexpr unsigned PARALLEL_MIN_VERTS = 1u << 15; // Below this, thread start up costs more than it saves
+
+	namespace order
+	{
+		// Moves the low 10 bits of value to every third bit
+		static uint32_t SpreadBits(uint32_t value)
+		{
+			value &= 0x3FF;
+			value = (value | (value << 16)) & 0x030000FF;
+			value = (value | (value << 8)) & 0x0300F00F;
+			value = (value | (value << 4)) & 0x030C30C3;
+			value = (value | (value << 2)) & 0x09249249;
+			return value;
+		}
+
+		static void MortonOrder(const Topology& mesh, const float* positions, unsigned threadCount, std::vector<unsigned>* outOrder)
+		{
+			const unsigned vertCount = static_cast<unsigned>(mesh.verts.size());
+			std::vector<float> sliceBounds(threadCount * 6);
+
+			Parallel_For(threadCount, vertCount, [&](unsigned threadIndex, unsigned begin, unsigned end)
+			{
+				float* const bounds = sliceBounds.data() + threadIndex * 6;
+
+				for (unsigned axis = 0; axis < 3; ++axis)
+				{
+					bounds[axis] = FLT_MAX;
+					bounds[axis + 3] = -FLT_MAX;
+				}
+
+				for (unsigned vert = begin; vert < end; ++vert)
+				{
+					const float* const position = positions + mesh.verts[vert].realIndex * 3;
+
+					for (unsigned axis = 0; axis < 3; ++axis)
+					{
+						bounds[axis] = std::min(bounds[axis], position[axis]);
+						bounds[axis + 3] = std::max(bounds[axis + 3], position[axis]);
+					}
+				}
+			});
+
+			float boundsMin[3];
+			float scale[3];
+
+			for (unsigned axis = 0; axis < 3; ++axis)
+			{
+				float boundsMax = -FLT_MAX;
+
+				boundsMin[axis] = FLT_MAX;
+				for (unsigned threadIndex = 0; threadIndex < threadCount; ++threadIndex)
+				{
+					boundsMin[axis] = std::min(boundsMin[axis], sliceBounds[threadIndex * 6 + axis]);
+					boundsMax = std::max(boundsMax, sliceBounds[threadIndex * 6 + axis + 3]);
+				}
+
+				const float extent = boundsMax - boundsMin[axis];
+				scale[axis] = extent > 0.0f ? ((1u << MORTON_BITS) - 1) / extent : 0.0f;
+			}
+
+			// Keys hold the code above the vert, so a stable sort on the code bits alone keeps ties in vert order
+			std::vector<uint64_t> keys(vertCount);
+			std::vector<uint64_t> sortScratch(vertCount);
+
+			Parallel_For(threadCount, vertCount, [&](unsigned, unsigned begin, unsigned end)
+			{
+				for (unsigned vert = begin; vert < end; ++vert)
+				{
+					const float* const position = positions + mesh.verts[vert].realIndex * 3;
+					uint32_t code = 0;
+
+					for (unsigned axis = 0; axis < 3; ++axis)
+						code |= SpreadBits(static_cast<uint32_t>((position[axis] - boundsMin[axis]) * scale[axis] + 0.5f)) << (2 - axis);
+
+					keys[vert] = (static_cast<uint64_t>(code) << 32) | vert;
+				}
+			});
+
+			for (unsigned shift = 32; shift < 32 + MORTON_BITS * 3; shift += RADIX_BITS)
+			{
+				unsigned bucketStarts[(1u << RADIX_BITS) + 1] = {};
+
+				for (uint64_t key : keys)
+					++bucketStarts[((key >> shift) & ((1u << RADIX_BITS) - 1)) + 1];
+
+				for (unsigned bucket = 1; bucket <= (1u << RADIX_BITS); ++bucket)
+					bucketStarts[bucket] += bucketStarts[bucket - 1];
+
+				for (uint64_t key : keys)
+					sortScratch[bucketStarts[(key >> shift) & ((1u << RADIX_BITS) - 1)]++] = key;
+
+				keys.swap(sortScratch);
+			}
+
+			outOrder->resize(vertCount);
+			Parallel_For(threadCount, vertCount, [&](unsigned, unsigned begin, unsigned end)
+			{
+				for (unsigned index = begin; index < end; ++index)
+					(*outOrder)[index] = static_cast<uint32_t>(keys[index]);
+			});
+		}
+
+		// Numbers real faces in the order their first vert is reached
+		static void VisitFaces(const Topology& mesh, unsigned vert, std::vector<unsigned>* inoutFaceOrder, std::vector<unsigned>* inoutFaceMap)
+		{
+			for (unsigned halfEdge : VertRing(mesh, vert))
+			{
+				const FaceIndex face = mesh.halfEdgeFaces[halfEdge];
+
+				if (face.type == FaceType::REAL && (*inoutFaceMap)[face.index] == NONE)
+				{
+					(*inoutFaceMap)[face.index] = static_cast<unsigned>(inoutFaceOrder->size());
+					inoutFaceOrder->push_back(face.index);
+				}
+			}
+		}
+
+		// Visits one rings in rotation order, so neighbors around a vert get consecutive numbers. The order vector
+		// doubles as the queue. Faces are numbered on the same walk.
+		static void BreadthFirstOrder(const Topology& mesh, std::vector<unsigned>* outOrder, std::vector<unsigned>* outVertMap, std::vector<unsigned>* outFaceOrder, std::vector<unsigned>* outFaceMap)
+		{
+			const unsigned vertCount = static_cast<unsigned>(mesh.verts.size());
+			std::vector<unsigned>& order = *outOrder;
+			std::vector<unsigned>& vertMap = *outVertMap;
+
+			order.clear();
+			order.reserve(vertCount);
+			vertMap.assign(vertCount, NONE);
+			outFaceOrder->clear();
+			outFaceOrder->reserve(mesh.faceHalfEdges[FaceType::REAL].size());
+			outFaceMap->assign(mesh.faceHalfEdges[FaceType::REAL].size(), NONE);
+
+			for (unsigned seed = 0; seed < vertCount; ++seed)
+			{
+				if (vertMap[seed] != NONE)
+					continue;
+
+				vertMap[seed] = static_cast<unsigned>(order.size());
+				order.push_back(seed);
+
+				for (unsigned queued = vertMap[seed]; queued < order.size(); ++queued)
+				{
+					for (unsigned halfEdge : VertRing(mesh, order[queued]))
+					{
+						const unsigned neighbor = mesh.halfEdgeVerts[halfEdge ^ 1];
+
+						if (vertMap[neighbor] == NONE)
+						{
+							vertMap[neighbor] = static_cast<unsigned>(order.size());
+							order.push_back(neighbor);
+						}
+					}
+
+					VisitFaces(mesh, order[queued], outFaceOrder, outFaceMap);
+				}
+			}
+		}
+	}
+
+	namespace remap
+	{
+		// Numbers edges in the order their first real face is reached and writes each face's half edges as it goes, so
+		// the new arrays fill mostly front to back. Every edge has a real face on at least one side; the twins left on
+		// boundaries are written from their loops afterwards.
+		static void RemapHalfEdges(const Topology& mesh, const std::vector<unsigned>& vertMap, const std::vector<unsigned>& faceOrder, std::vector<unsigned>* outEdgeMap, Topology* outMesh)
+		{
+			const unsigned halfEdgeCount = static_cast<unsigned>(mesh.halfEdgeNexts.size());
+			std::vector<unsigned>& edgeMap = *outEdgeMap;
+			unsigned edgeCount = 0;
+
+			edgeMap.assign(halfEdgeCount / 2, NONE);
+			outMesh->halfEdgeVerts.resize(halfEdgeCount);
+			outMesh->halfEdgeFaces.resize(halfEdgeCount);
+			outMesh->halfEdgeNexts.resize(halfEdgeCount);
+			outMesh->faceHalfEdges[FaceType::REAL].resize(faceOrder.size());
+			outMesh->faceHalfEdges[FaceType::BOUNDARY].resize(mesh.faceHalfEdges[FaceType::BOUNDARY].size());
+
+			auto MapHalfEdge = [&](unsigned halfEdge) { return edgeMap[halfEdge / 2] * 2 + (halfEdge & 1); };
+			auto WriteHalfEdge = [&](unsigned halfEdge, FaceIndex face)
+			{
+				const unsigned newHalfEdge = MapHalfEdge(halfEdge);
+
+				outMesh->halfEdgeVerts[newHalfEdge] = vertMap[mesh.halfEdgeVerts[halfEdge]];
+				outMesh->halfEdgeFaces[newHalfEdge] = face;
+				outMesh->halfEdgeNexts[newHalfEdge] = MapHalfEdge(mesh.halfEdgeNexts[halfEdge]);
+			};
+
+			for (unsigned newFace = 0; newFace < faceOrder.size(); ++newFace)
+			{
+				const unsigned faceHalfEdge = mesh.faceHalfEdges[FaceType::REAL][faceOrder[newFace]];
+
+				for (unsigned halfEdge : LoopFrom(mesh, faceHalfEdge))
+				{
+					if (edgeMap[halfEdge / 2] == NONE)
+						edgeMap[halfEdge / 2] = edgeCount++;
+				}
+
+				for (unsigned halfEdge : LoopFrom(mesh, faceHalfEdge))
+					WriteHalfEdge(halfEdge, FaceIndex{ newFace, FaceType::REAL });
+
+				outMesh->faceHalfEdges[FaceType::REAL][newFace] = MapHalfEdge(faceHalfEdge);
+			}
+
+			sanity(edgeCount == edgeMap.size() && "Edge without a real face");
+
+			for (unsigned boundary = 0; boundary < mesh.faceHalfEdges[FaceType::BOUNDARY].size(); ++boundary)
+			{
+				for (unsigned halfEdge : BoundaryLoop(mesh, boundary))
+					WriteHalfEdge(halfEdge, FaceIndex{ boundary, FaceType::BOUNDARY });
+
+				outMesh->faceHalfEdges[FaceType::BOUNDARY][boundary] = MapHalfEdge(mesh.faceHalfEdges[FaceType::BOUNDARY][boundary]);
+			}
+		}
+	}
+}
+
+namespace mesh
+{
+	namespace half_edge
+	{
+		void Reorder(Topology* inoutMesh, const float* optPositions, const ReorderOptions& options)
+		{
+			const Topology& mesh = *inoutMesh;
+			const unsigned vertCount = static_cast<unsigned>(mesh.verts.size());
+			const unsigned faceCount = static_cast<unsigned>(mesh.faceHalfEdges[FaceType::REAL].size());
+			const unsigned threadCount = vertCount < PARALLEL_MIN_VERTS ? 1 : Parallel_ThreadCount(options.threadCount);
+			std::vector<unsigned> vertOrder;
+			std::vector<unsigned> vertMap;
+			std::vector<unsigned> faceOrder;
+			std::vector<unsigned> faceMap;
+
+			if (options.method == ReorderMethod::MORTON)
+			{
+				sanity(optPositions && "MORTON reordering needs positions");
+
+				order::MortonOrder(mesh, optPositions, threadCount, &vertOrder);
+
+				vertMap.resize(vertCount);
+				faceMap.assign(faceCount, NONE);
+				faceOrder.reserve(faceCount);
+				for (unsigned vert = 0; vert < vertCount; ++vert)
+				{
+					vertMap[vertOrder[vert]] = vert;
+					order::VisitFaces(mesh, vertOrder[vert], &faceOrder, &faceMap);
+				}
+			}
+			else
+			{
+				order::BreadthFirstOrder(mesh, &vertOrder, &vertMap, &faceOrder, &faceMap);
+			}
+
+			sanity(faceOrder.size() == faceCount && "Real face unreachable from its verts");
+			faceMap = std::vector<unsigned>();
+
+			Topology reordered;
+			std::vector<unsigned> edgeMap;
+
+			remap::RemapHalfEdges(mesh, vertMap, faceOrder, &edgeMap, &reordered);
+
+			reordered.verts.resize(vertCount);
+			reordered.vertHalfEdges.resize(vertCount);
+			Parallel_For(threadCount, vertCount, [&](unsigned, unsigned begin, unsigned end)
+			{
+				for (unsigned vert = begin; vert < end; ++vert)
+				{
+					const unsigned halfEdge = mesh.vertHalfEdges[vertOrder[vert]];
+
+					reordered.verts[vert] = mesh.verts[vertOrder[vert]];
+					reordered.vertHalfEdges[vert] = edgeMap[halfEdge / 2] * 2 + (halfEdge & 1);
+				}
+			});
+
+			*inoutMesh = std::move(reordered);
+		}
+	}
+}
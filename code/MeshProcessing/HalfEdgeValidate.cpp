@@ -0,0 +1,297 @@
+#include <cstdint>
+#include <vector>
+#include "MeshProc/HalfEdge.h"
+#include "MeshProc/HalfEdgeCirculators.h"
+#include "Parallel.h"
+
+namespace
+{
+	using namespace mesh;
+	using namespace mesh::half_edge;
+
+	static constexpr unsigned PARALLEL_MIN_HALF_EDGES = 1u << 16; // Below this, thread start up costs more than it saves
+
+	// One result per slice. Slice 0 is kept inline, so single threaded validation makes no allocations.
+	template<typename T>
+	struct SliceResults
+	{
+		T first = T();
+		std::vector<T> rest;
+
+		explicit SliceResults(unsigned threadCount) : rest(threadCount - 1) {}
+
+		T& operator[](unsigned threadIndex) { return threadIndex ? rest[threadIndex - 1] : first; }
+	};
+
+	// Checks are plain functions of the element index. Each slice stops at its first failure and the lowest failing
+	// slice wins, so the report names the first failing element whatever the thread count.
+	template<typename CheckFn>
+	static bool CheckEach(unsigned threadCount, unsigned count, ValidateError error, const CheckFn& check, ValidateReport* optOutReport)
+	{
+		SliceResults<ValidateReport> sliceReports(threadCount);
+
+		Parallel_For(threadCount, count, [&](unsigned threadIndex, unsigned begin, unsigned end)
+		{
+			for (unsigned index = begin; index < end; ++index)
+			{
+				if (const char* const message = check(index))
+				{
+					sliceReports[threadIndex] = ValidateReport{ error, index, message };
+					return;
+				}
+			}
+		});
+
+		for (unsigned threadIndex = 0; threadIndex < threadCount; ++threadIndex)
+		{
+			if (sliceReports[threadIndex].error != ValidateError::VALID)
+			{
+				if (optOutReport)
+					*optOutReport = sliceReports[threadIndex];
+
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	static bool Fail(ValidateError error, unsigned element, const char* message, ValidateReport* optOutReport)
+	{
+		if (optOutReport)
+			*optOutReport = ValidateReport{ error, element, message };
+
+		return false;
+	}
+
+	namespace structure
+	{
+		template<typename IdT>
+		static bool CheckSizes(const TopologyT<IdT>& mesh, ValidateReport* optOutReport)
+		{
+			const size_t halfEdgeCount = mesh.halfEdgeNexts.size();
+
+			if (mesh.vertHalfEdges.size() != mesh.verts.size())
+				return Fail(ValidateError::BAD_SIZE, ~0u, "vertHalfEdges and verts differ in size", optOutReport);
+
+			if (mesh.halfEdgeVerts.size() != halfEdgeCount || mesh.halfEdgeFaces.size() != halfEdgeCount || halfEdgeCount % 2)
+				return Fail(ValidateError::BAD_SIZE, ~0u, "Half edge arrays differ in size or hold an odd count", optOutReport);
+
+			if (halfEdgeCount > ~0u || mesh.verts.size() > ~0u)
+				return Fail(ValidateError::BAD_SIZE, ~0u, "Half edge or vert count overflows 32 bits", optOutReport);
+
+			return true;
+		}
+
+		template<typename IdT>
+		static bool CheckVerts(const TopologyT<IdT>& mesh, unsigned threadCount, ValidateReport* optOutReport)
+		{
+			return CheckEach(threadCount, static_cast<unsigned>(mesh.verts.size()), ValidateError::BAD_INDEX, [&](unsigned vert) -> const char*
+			{
+				return mesh.vertHalfEdges[vert] < mesh.halfEdgeNexts.size() ? nullptr : "vertHalfEdges entry out of range";
+			}, optOutReport)
+			&& CheckEach(threadCount, static_cast<unsigned>(mesh.verts.size()), ValidateError::BROKEN_LINK, [&](unsigned vert) -> const char*
+			{
+				return mesh.halfEdgeVerts[mesh.vertHalfEdges[vert]] == vert ? nullptr : "vertHalfEdges entry leaves another vert";
+			}, optOutReport);
+		}
+
+		template<typename IdT>
+		static bool CheckFaces(const TopologyT<IdT>& mesh, FaceType type, unsigned threadCount, ValidateReport* optOutReport)
+		{
+			const std::vector<unsigned>& faceHalfEdges = mesh.faceHalfEdges[type];
+
+			return CheckEach(threadCount, static_cast<unsigned>(faceHalfEdges.size()), ValidateError::BAD_INDEX, [&](unsigned face) -> const char*
+			{
+				return faceHalfEdges[face] < mesh.halfEdgeNexts.size() ? nullptr : "faceHalfEdges entry out of range";
+			}, optOutReport)
+			&& CheckEach(threadCount, static_cast<unsigned>(faceHalfEdges.size()), ValidateError::BROKEN_LINK, [&](unsigned face) -> const char*
+			{
+				const FaceIndex heFace = mesh.halfEdgeFaces[faceHalfEdges[face]];
+
+				return heFace.index == face && heFace.type == type ? nullptr : "faceHalfEdges entry belongs to another face";
+			}, optOutReport);
+		}
+
+		template<typename IdT>
+		static bool CheckHalfEdges(const TopologyT<IdT>& mesh, unsigned threadCount, ValidateReport* optOutReport)
+		{
+			const unsigned halfEdgeCount = static_cast<unsigned>(mesh.halfEdgeNexts.size());
+
+			return CheckEach(threadCount, halfEdgeCount, ValidateError::BAD_INDEX, [&](unsigned halfEdge) -> const char*
+			{
+				const FaceIndex face = mesh.halfEdgeFaces[halfEdge];
+
+				if (mesh.halfEdgeVerts[halfEdge] >= mesh.verts.size())
+					return "halfEdgeVerts entry out of range";
+
+				if (mesh.halfEdgeNexts[halfEdge] >= halfEdgeCount)
+					return "halfEdgeNexts entry out of range";
+
+				if (face.index >= mesh.faceHalfEdges[face.type].size())
+					return "halfEdgeFaces entry out of range";
+
+				return nullptr;
+			}, optOutReport)
+			&& CheckEach(threadCount, halfEdgeCount, ValidateError::BROKEN_LINK, [&](unsigned halfEdge) -> const char*
+			{
+				const unsigned next = mesh.halfEdgeNexts[halfEdge];
+				const FaceIndex face = mesh.halfEdgeFaces[halfEdge];
+				const FaceIndex nextFace = mesh.halfEdgeFaces[next];
+
+				if (nextFace.index != face.index || nextFace.type != face.type)
+					return "halfEdgeNexts entry leaves the face";
+
+				if (mesh.halfEdgeVerts[next] != mesh.halfEdgeVerts[halfEdge ^ 1])
+					return "halfEdgeNexts entry does not start where the half edge ends";
+
+				if (face.type == FaceType::BOUNDARY && mesh.halfEdgeFaces[halfEdge ^ 1].type == FaceType::BOUNDARY)
+					return "Edge without a real face";
+
+				return nullptr;
+			}, optOutReport);
+		}
+	}
+
+	namespace full
+	{
+		template<typename IdT>
+		static unsigned RingLength(const TopologyT<IdT>& mesh, unsigned vert)
+		{
+			unsigned length = 0;
+
+			for (unsigned halfEdge : VertRing(mesh, vert))
+			{
+				(void)halfEdge;
+				++length;
+			}
+
+			return length;
+		}
+
+		// Each loop is walked from its faceHalfEdges entry. With every next staying in its face, loops that all close
+		// and add up to the half edge count leave no half edge off a loop, so nexts are a permutation.
+		template<typename IdT>
+		static bool CheckLoops(const TopologyT<IdT>& mesh, unsigned threadCount, ValidateReport* optOutReport)
+		{
+			const unsigned halfEdgeCount = static_cast<unsigned>(mesh.halfEdgeNexts.size());
+			const std::vector<unsigned>& boundaryHalfEdges = mesh.faceHalfEdges[FaceType::BOUNDARY];
+			uint64_t loopLength = mesh.faceHalfEdges[FaceType::REAL].size() * 3ull;
+
+			const bool trianglesClose = CheckEach(threadCount, static_cast<unsigned>(mesh.faceHalfEdges[FaceType::REAL].size()), ValidateError::BAD_LOOP, [&](unsigned face) -> const char*
+			{
+				const unsigned first = mesh.faceHalfEdges[FaceType::REAL][face];
+				const unsigned second = mesh.halfEdgeNexts[first];
+				const unsigned third = mesh.halfEdgeNexts[second];
+
+				return second != first && third != first && mesh.halfEdgeNexts[third] == first ? nullptr : "Real face is not a triangle";
+			}, optOutReport);
+
+			if (!trianglesClose)
+				return false;
+
+			// Boundaries hold few half edges, so they are walked on one thread while their lengths add up
+			const bool boundariesClose = CheckEach(1, static_cast<unsigned>(boundaryHalfEdges.size()), ValidateError::BAD_LOOP, [&](unsigned boundary) -> const char*
+			{
+				unsigned halfEdge = boundaryHalfEdges[boundary];
+				unsigned length = 0;
+
+				do
+				{
+					halfEdge = mesh.halfEdgeNexts[halfEdge];
+					++length;
+				} while (halfEdge != boundaryHalfEdges[boundary] && length <= halfEdgeCount);
+
+				if (length > halfEdgeCount)
+					return "Boundary loop does not close";
+
+				if (length < 3)
+					return "Boundary loop shorter than 3, overlapping faces";
+
+				loopLength += length;
+				return nullptr;
+			}, optOutReport);
+
+			if (!boundariesClose)
+				return false;
+
+			if (loopLength != halfEdgeCount)
+				return Fail(ValidateError::BAD_LOOP, ~0u, "Half edges left off every face loop", optOutReport);
+
+			return true;
+		}
+
+		// Rings only hold half edges leaving their vert, so they cover every half edge exactly when their lengths add up
+		// to the half edge count. Anything short means some vert has a second fan, which a counting pass then finds.
+		template<typename IdT>
+		static bool CheckSingularities(const TopologyT<IdT>& mesh, unsigned threadCount, ValidateReport* optOutReport)
+		{
+			const unsigned vertCount = static_cast<unsigned>(mesh.verts.size());
+			SliceResults<uint64_t> sliceLengths(threadCount);
+
+			Parallel_For(threadCount, vertCount, [&](unsigned threadIndex, unsigned begin, unsigned end)
+			{
+				uint64_t sliceLength = 0;
+
+				for (unsigned vert = begin; vert < end; ++vert)
+					sliceLength += RingLength(mesh, vert);
+
+				sliceLengths[threadIndex] = sliceLength;
+			});
+
+			uint64_t ringLength = 0;
+
+			for (unsigned threadIndex = 0; threadIndex < threadCount; ++threadIndex)
+				ringLength += sliceLengths[threadIndex];
+
+			if (ringLength == mesh.halfEdgeNexts.size())
+				return true;
+
+			std::vector<unsigned> vertHalfEdgeCounts(vertCount, 0);
+
+			for (unsigned vert : mesh.halfEdgeVerts)
+				++vertHalfEdgeCounts[vert];
+
+			for (unsigned vert = 0; vert < vertCount; ++vert)
+			{
+				if (RingLength(mesh, vert) != vertHalfEdgeCounts[vert])
+					return Fail(ValidateError::SINGULAR_VERT, vert, "Vert on multiple fans", optOutReport);
+			}
+
+			return Fail(ValidateError::SINGULAR_VERT, ~0u, "Vert on multiple fans", optOutReport);
+		}
+	}
+}
+
+namespace mesh
+{
+	namespace half_edge
+	{
+		template<typename IdT>
+		bool Validate(const TopologyT<IdT>& mesh, ValidateReport* optOutReport, const ValidateOptions& options)
+		{
+			if (optOutReport)
+				*optOutReport = ValidateReport();
+
+			if (options.level == ValidateLevel::VALIDATE_NONE)
+				return true;
+
+			if (!structure::CheckSizes(mesh, optOutReport))
+				return false;
+
+			const unsigned threadCount = mesh.halfEdgeNexts.size() < PARALLEL_MIN_HALF_EDGES ? 1 : Parallel_ThreadCount(options.threadCount);
+			const bool structureValid = structure::CheckVerts(mesh, threadCount, optOutReport)
+				&& structure::CheckFaces(mesh, FaceType::REAL, threadCount, optOutReport)
+				&& structure::CheckFaces(mesh, FaceType::BOUNDARY, threadCount, optOutReport)
+				&& structure::CheckHalfEdges(mesh, threadCount, optOutReport);
+
+			if (!structureValid || options.level == ValidateLevel::VALIDATE_STRUCTURE)
+				return structureValid;
+
+			return full::CheckLoops(mesh, threadCount, optOutReport) && full::CheckSingularities(mesh, threadCount, optOutReport);
+		}
+
+		template bool Validate(const Topology&, ValidateReport*, const ValidateOptions&);
+		template bool Validate(const Topology64&, ValidateReport*, const ValidateOptions&);
+	}
+}
@@ -0,0 +1,234 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "MeshProc/IndexOptimize.h"
+#include "sanity.h"
+
+namespace
+{
+	using namespace mesh;
+
+	static constexpr unsigned NONE = ~0u;
+
+	static unsigned IndexCount(const unsigned* indices, unsigned triCount)
+	{
+		unsigned maxIndex = 0;
+
+		for (unsigned corner = 0; corner < triCount * 3; ++corner)
+			maxIndex = std::max(maxIndex, indices[corner]);
+
+		return triCount ? maxIndex + 1 : 0;
+	}
+
+	namespace tipsify
+	{
+		// Triangles using each vert, as offsets into one flat list
+		struct Adjacency
+		{
+			std::vector<unsigned> vertStarts;
+			std::vector<unsigned> vertTris;
+			std::vector<unsigned> liveTris; // Triangles not yet emitted per vert
+		};
+
+		static void BuildAdjacency(const unsigned* indices, unsigned triCount, unsigned vertCount, Adjacency* outAdjacency)
+		{
+			std::vector<unsigned>& vertStarts = outAdjacency->vertStarts;
+			std::vector<unsigned>& vertTris = outAdjacency->vertTris;
+
+			outAdjacency->liveTris.assign(vertCount, 0);
+			for (unsigned corner = 0; corner < triCount * 3; ++corner)
+				++outAdjacency->liveTris[indices[corner]];
+
+			vertStarts.resize(vertCount + 1);
+			vertStarts[0] = 0;
+			for (unsigned vert = 0; vert < vertCount; ++vert)
+				vertStarts[vert + 1] = vertStarts[vert] + outAdjacency->liveTris[vert];
+
+			std::vector<unsigned> vertFill(vertStarts.begin(), vertStarts.end() - 1);
+
+			vertTris.resize(triCount * 3);
+			for (unsigned corner = 0; corner < triCount * 3; ++corner)
+				vertTris[vertFill[indices[corner]]++] = corner / 3;
+		}
+
+		// Picks the candidate that stays in the cache longest without being evicted before its remaining triangles are
+		// drawn. Falls back to recently used verts with live triangles, then to the lowest live vert.
+		static unsigned NextVert(const Adjacency& adjacency, const std::vector<unsigned>& candidates, const std::vector<unsigned>& cacheTimes, unsigned time, unsigned cacheSize, std::vector<unsigned>* inoutDeadEnds, unsigned* inoutCursor)
+		{
+			unsigned bestVert = NONE;
+			int bestPriority = -1;
+
+			for (unsigned vert : candidates)
+			{
+				const unsigned liveTris = adjacency.liveTris[vert];
+
+				if (liveTris)
+				{
+					int priority = 0;
+
+					if (time - cacheTimes[vert] + 2 * liveTris <= cacheSize)
+						priority = static_cast<int>(time - cacheTimes[vert]);
+
+					if (priority > bestPriority)
+					{
+						bestPriority = priority;
+						bestVert = vert;
+					}
+				}
+			}
+
+			if (bestVert != NONE)
+				return bestVert;
+
+			while (!inoutDeadEnds->empty())
+			{
+				const unsigned vert = inoutDeadEnds->back();
+
+				inoutDeadEnds->pop_back();
+				if (adjacency.liveTris[vert])
+					return vert;
+			}
+
+			const unsigned vertCount = static_cast<unsigned>(adjacency.liveTris.size());
+
+			while (*inoutCursor < vertCount)
+			{
+				if (adjacency.liveTris[*inoutCursor])
+					return *inoutCursor;
+
+				++*inoutCursor;
+			}
+
+			return NONE;
+		}
+	}
+}
+
+namespace mesh
+{
+	VertexCacheStats AnalyzeVertexCache(const unsigned* indices, unsigned triCount, unsigned cacheSize)
+	{
+		const unsigned vertCount = IndexCount(indices, triCount);
+		// A vert is cached while fewer than cacheSize misses happened since its own. Times start past cacheSize so
+		// untouched verts always miss.
+		std::vector<unsigned> cacheTimes(vertCount, 0);
+		unsigned time = cacheSize + 1;
+		unsigned usedVerts = 0;
+		VertexCacheStats stats;
+
+		for (unsigned corner = 0; corner < triCount * 3; ++corner)
+		{
+			const unsigned vert = indices[corner];
+
+			usedVerts += cacheTimes[vert] == 0;
+			if (time - cacheTimes[vert] > cacheSize)
+				cacheTimes[vert] = time++;
+		}
+
+		const unsigned misses = time - (cacheSize + 1);
+
+		stats.acmr = triCount ? static_cast<float>(misses) / triCount : 0.0f;
+		stats.atvr = usedVerts ? static_cast<float>(misses) / usedVerts : 0.0f;
+
+		return stats;
+	}
+
+	void OptimizeVertexCache(const unsigned* indices, unsigned triCount, unsigned* outIndices, const IndexOptimizeOptions& options)
+	{
+		sanity(options.cacheSize >= 3 && "Vertex cache must hold a triangle");
+
+		const unsigned vertCount = IndexCount(indices, triCount);
+		const unsigned cacheSize = options.cacheSize;
+		tipsify::Adjacency adjacency;
+		std::vector<unsigned> cacheTimes(vertCount, 0);
+		std::vector<uint8_t> emitted(triCount, 0);
+		std::vector<unsigned> deadEnds;
+		std::vector<unsigned> candidates;
+		unsigned time = cacheSize + 1;
+		unsigned cursor = 0;
+		unsigned outCorner = 0;
+
+		tipsify::BuildAdjacency(indices, triCount, vertCount, &adjacency);
+		deadEnds.reserve(triCount * 3);
+
+		for (unsigned fanVert = vertCount ? 0 : NONE; fanVert != NONE; )
+		{
+			candidates.clear();
+
+			for (unsigned adjacent = adjacency.vertStarts[fanVert]; adjacent < adjacency.vertStarts[fanVert + 1]; ++adjacent)
+			{
+				const unsigned tri = adjacency.vertTris[adjacent];
+
+				if (emitted[tri])
+					continue;
+
+				for (unsigned corner = tri * 3; corner < tri * 3 + 3; ++corner)
+				{
+					const unsigned vert = indices[corner];
+
+					outIndices[outCorner++] = vert;
+					deadEnds.push_back(vert);
+					candidates.push_back(vert);
+					--adjacency.liveTris[vert];
+
+					if (time - cacheTimes[vert] > cacheSize)
+						cacheTimes[vert] = time++;
+				}
+
+				emitted[tri] = 1;
+			}
+
+			fanVert = tipsify::NextVert(adjacency, candidates, cacheTimes, time, cacheSize, &deadEnds, &cursor);
+		}
+
+		sanity(outCorner == triCount * 3);
+	}
+
+	unsigned OptimizeVertexFetch(unsigned* inoutIndices, unsigned triCount, std::vector<unsigned>* outVertRemap)
+	{
+		std::vector<unsigned>& vertRemap = *outVertRemap;
+		unsigned vertCount = 0;
+
+		vertRemap.assign(IndexCount(inoutIndices, triCount), NONE);
+
+		for (unsigned corner = 0; corner < triCount * 3; ++corner)
+		{
+			unsigned* const mappedVert = vertRemap.data() + inoutIndices[corner];
+
+			if (*mappedVert == NONE)
+				*mappedVert = vertCount++;
+
+			inoutIndices[corner] = *mappedVert;
+		}
+
+		return vertCount;
+	}
+
+	void OptimizeIndices(const unsigned* indices, unsigned triCount, unsigned* outIndices, std::vector<unsigned>* outVertRemap, IndexOptimizeReport* optOutReport, const IndexOptimizeOptions& options)
+	{
+		if (optOutReport)
+			optOutReport->before = AnalyzeVertexCache(indices, triCount, options.cacheSize);
+
+		OptimizeVertexCache(indices, triCount, outIndices, options);
+		const unsigned vertCount = OptimizeVertexFetch(outIndices, triCount, outVertRemap);
+
+		if (optOutReport)
+		{
+			optOutReport->after = AnalyzeVertexCache(outIndices, triCount, options.cacheSize);
+			optOutReport->vertCount = vertCount;
+		}
+	}
+
+	void RemapVertexData(const void* verts, size_t vertSize, const std::vector<unsigned>& vertRemap, void* outVerts)
+	{
+		const char* const inBytes = static_cast<const char*>(verts);
+		char* const outBytes = static_cast<char*>(outVerts);
+
+		for (size_t vert = 0; vert < vertRemap.size(); ++vert)
+		{
+			if (vertRemap[vert] != NONE)
+				memcpy(outBytes + vertRemap[vert] * vertSize, inBytes + vert * vertSize, vertSize);
+		}
+	}
+}
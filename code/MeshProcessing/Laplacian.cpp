@@ -0,0 +1,291 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <Eigen/SparseCholesky>
+#include "MeshProc/HalfEdgeCirculators.h"
+#include "MeshProc/Laplacian.h"
+#include "Parallel.h"
+#include "sanity.h"
+
+namespace mesh
+{
+	namespace half_edge
+	{
+		struct CholeskyFactor
+		{
+			Eigen::SparseMatrix<double> system; // Compressed, with the pattern AnalyzeLaplacian built
+			Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>> ldlt;
+			bool factored = false;
+		};
+	}
+}
+
+namespace
+{
+	using namespace mesh;
+	using namespace mesh::half_edge;
+
+	// Below this the threads cost more than the passes they split
+	static constexpr unsigned PARALLEL_MIN_ELEMENTS = 1u << 14;
+
+	static unsigned ThreadCount(unsigned elementCount, const LaplacianOptions& options)
+	{
+		return elementCount < PARALLEL_MIN_ELEMENTS ? 1 : std::min(Parallel_ThreadCount(options.threadCount), elementCount / (PARALLEL_MIN_ELEMENTS / 4));
+	}
+
+	// Column v holds v and every vert v shares an edge with. Multiple edges between two verts share one entry.
+	namespace pattern
+	{
+		template<typename IdT>
+		static void GatherColumn(const TopologyT<IdT>& mesh, unsigned vert, std::vector<int>* outRows)
+		{
+			outRows->clear();
+			outRows->push_back(static_cast<int>(vert));
+
+			for (unsigned halfEdge : VertRing(mesh, vert))
+				outRows->push_back(static_cast<int>(mesh.halfEdgeVerts[halfEdge ^ 1]));
+
+			std::sort(outRows->begin(), outRows->end());
+			outRows->erase(std::unique(outRows->begin(), outRows->end()), outRows->end());
+		}
+
+		template<typename IdT>
+		static void Build(const TopologyT<IdT>& mesh, std::vector<int>* outOuterStarts, std::vector<int>* outInnerIndices, const LaplacianOptions& options)
+		{
+			const unsigned vertCount = static_cast<unsigned>(mesh.verts.size());
+			const unsigned threadCount = ThreadCount(vertCount, options);
+
+			outOuterStarts->assign(vertCount + 1, 0);
+
+			Parallel_For(threadCount, vertCount, [&](unsigned, unsigned begin, unsigned end)
+			{
+				std::vector<int> rows;
+
+				for (unsigned vert = begin; vert < end; ++vert)
+				{
+					GatherColumn(mesh, vert, &rows);
+					(*outOuterStarts)[vert + 1] = static_cast<int>(rows.size());
+				}
+			});
+
+			for (unsigned vert = 0; vert < vertCount; ++vert)
+			{
+				sanity((*outOuterStarts)[vert + 1] <= INT32_MAX - (*outOuterStarts)[vert] && "mesh::half_edge::AnalyzeLaplacian too many entries for int indices");
+				(*outOuterStarts)[vert + 1] += (*outOuterStarts)[vert];
+			}
+
+			outInnerIndices->resize((*outOuterStarts)[vertCount]);
+
+			Parallel_For(threadCount, vertCount, [&](unsigned, unsigned begin, unsigned end)
+			{
+				std::vector<int> rows;
+
+				for (unsigned vert = begin; vert < end; ++vert)
+				{
+					GatherColumn(mesh, vert, &rows);
+					std::copy(rows.begin(), rows.end(), outInnerIndices->begin() + (*outOuterStarts)[vert]);
+				}
+			});
+		}
+	}
+
+	namespace values
+	{
+		// Cotangent of the angle across each half edge in its face, 0 for boundary half edges and degenerate faces, and a
+		// third of each face's area. Each face writes only its own half edges.
+		template<typename IdT>
+		static void FaceTerms(const TopologyT<IdT>& mesh, const float* positions, unsigned threadCount, std::vector<double>* outCots, std::vector<double>* outThirdAreas)
+		{
+			const unsigned faceCount = static_cast<unsigned>(mesh.faceHalfEdges[FaceType::REAL].size());
+
+			outCots->assign(mesh.halfEdgeNexts.size(), 0.0);
+			outThirdAreas->resize(faceCount);
+
+			Parallel_For(threadCount, faceCount, [&](unsigned, unsigned begin, unsigned end)
+			{
+				for (unsigned face = begin; face < end; ++face)
+				{
+					const unsigned first = mesh.faceHalfEdges[FaceType::REAL][face];
+
+					if (first == ~0u)
+					{
+						(*outThirdAreas)[face] = 0.0;
+						continue;
+					}
+
+					const unsigned halfEdges[3] = { first, mesh.halfEdgeNexts[first], mesh.halfEdgeNexts[mesh.halfEdgeNexts[first]] };
+					double p[3][3];
+
+					for (unsigned corner = 0; corner < 3; ++corner)
+					{
+						const float* const position = positions + static_cast<size_t>(mesh.verts[mesh.halfEdgeVerts[halfEdges[corner]]].realIndex) * 3;
+
+						for (unsigned component = 0; component < 3; ++component)
+							p[corner][component] = position[component];
+					}
+
+					double doubleArea = 0.0;
+
+					// The half edge leaving corner c is across from corner c + 2
+					for (unsigned corner = 0; corner < 3; ++corner)
+					{
+						const double* const apex = p[(corner + 2) % 3];
+						double lhs[3], rhs[3];
+
+						for (unsigned component = 0; component < 3; ++component)
+						{
+							lhs[component] = p[corner][component] - apex[component];
+							rhs[component] = p[(corner + 1) % 3][component] - apex[component];
+						}
+
+						const double cross[3] = { lhs[1] * rhs[2] - lhs[2] * rhs[1], lhs[2] * rhs[0] - lhs[0] * rhs[2], lhs[0] * rhs[1] - lhs[1] * rhs[0] };
+						const double crossLength = std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+						const double dot = lhs[0] * rhs[0] + lhs[1] * rhs[1] + lhs[2] * rhs[2];
+
+						(*outCots)[halfEdges[corner]] = crossLength > 0.0 ? dot / crossLength : 0.0;
+						doubleArea = crossLength;
+					}
+
+					(*outThirdAreas)[face] = doubleArea / 6.0;
+				}
+			});
+		}
+
+		// Writes stiffnessWeight * L + massWeight * M into the pattern's values, one column per vert, and the lumped
+		// mass into optOutMass.
+		template<typename IdT>
+		static void Fill(const TopologyT<IdT>& mesh, const float* positions, double massWeight, double stiffnessWeight, const int* outerStarts, const int* innerIndices, double* outValues, std::vector<double>* optOutMass, const LaplacianOptions& options)
+		{
+			const unsigned vertCount = static_cast<unsigned>(mesh.verts.size());
+			const unsigned faceCount = static_cast<unsigned>(mesh.faceHalfEdges[FaceType::REAL].size());
+			std::vector<double> cots;
+			std::vector<double> thirdAreas;
+
+			FaceTerms(mesh, positions, ThreadCount(faceCount, options), &cots, &thirdAreas);
+
+			if (optOutMass)
+				optOutMass->resize(vertCount);
+
+			Parallel_For(ThreadCount(vertCount, options), vertCount, [&](unsigned, unsigned begin, unsigned end)
+			{
+				for (unsigned vert = begin; vert < end; ++vert)
+				{
+					const int* const rowsBegin = innerIndices + outerStarts[vert];
+					const int* const rowsEnd = innerIndices + outerStarts[vert + 1];
+					double* const column = outValues + outerStarts[vert];
+					double diagonal = 0.0;
+					double mass = 0.0;
+
+					std::fill(column, column + (rowsEnd - rowsBegin), 0.0);
+
+					for (unsigned halfEdge : VertRing(mesh, vert))
+					{
+						const int row = static_cast<int>(mesh.halfEdgeVerts[halfEdge ^ 1]);
+						const double weight = 0.5 * (cots[halfEdge] + cots[halfEdge ^ 1]);
+
+						column[std::lower_bound(rowsBegin, rowsEnd, row) - rowsBegin] -= stiffnessWeight * weight;
+						diagonal += weight;
+
+						if (mesh.halfEdgeFaces[halfEdge].type == FaceType::REAL)
+							mass += thirdAreas[mesh.halfEdgeFaces[halfEdge].index];
+					}
+
+					column[std::lower_bound(rowsBegin, rowsEnd, static_cast<int>(vert)) - rowsBegin] += stiffnessWeight * diagonal + massWeight * mass;
+
+					if (optOutMass)
+						(*optOutMass)[vert] = mass;
+				}
+			});
+		}
+	}
+}
+
+namespace mesh
+{
+	namespace half_edge
+	{
+		template<typename IdT>
+		void AssembleLaplacian(const TopologyT<IdT>& mesh, const float* positions, SparseMatrix* outLaplacian, std::vector<double>* outMass, const LaplacianOptions& options)
+		{
+			outLaplacian->size = static_cast<unsigned>(mesh.verts.size());
+			pattern::Build(mesh, &outLaplacian->outerStarts, &outLaplacian->innerIndices, options);
+			outLaplacian->values.resize(outLaplacian->innerIndices.size());
+			values::Fill(mesh, positions, 0.0, 1.0, outLaplacian->outerStarts.data(), outLaplacian->innerIndices.data(), outLaplacian->values.data(), outMass, options);
+		}
+
+		LaplacianSolver::LaplacianSolver() = default;
+		LaplacianSolver::~LaplacianSolver() = default;
+		LaplacianSolver::LaplacianSolver(LaplacianSolver&&) noexcept = default;
+		LaplacianSolver& LaplacianSolver::operator=(LaplacianSolver&&) noexcept = default;
+
+		template<typename IdT>
+		void AnalyzeLaplacian(const TopologyT<IdT>& mesh, LaplacianSolver* outSolver, const LaplacianOptions& options)
+		{
+			const int vertCount = static_cast<int>(mesh.verts.size());
+			std::vector<int> outerStarts;
+			std::vector<int> innerIndices;
+
+			pattern::Build(mesh, &outerStarts, &innerIndices, options);
+
+			outSolver->mass.clear();
+			outSolver->factor.reset(new CholeskyFactor());
+
+			Eigen::SparseMatrix<double>& system = outSolver->factor->system;
+
+			// Filled in place as compressed storage. The ordering and elimination tree only read the pattern.
+			system.resize(vertCount, vertCount);
+			system.resizeNonZeros(static_cast<Eigen::Index>(innerIndices.size()));
+			std::copy(outerStarts.begin(), outerStarts.end(), system.outerIndexPtr());
+			std::copy(innerIndices.begin(), innerIndices.end(), system.innerIndexPtr());
+			std::fill(system.valuePtr(), system.valuePtr() + innerIndices.size(), 0.0);
+
+			outSolver->factor->ldlt.analyzePattern(system);
+		}
+
+		template<typename IdT>
+		bool FactorLaplacian(const TopologyT<IdT>& mesh, const float* positions, double massWeight, double stiffnessWeight, LaplacianSolver* inoutSolver, const LaplacianOptions& options)
+		{
+			CholeskyFactor* const factor = inoutSolver->factor.get();
+
+			sanity(factor && factor->system.rows() == static_cast<Eigen::Index>(mesh.verts.size()) && "mesh::half_edge::FactorLaplacian solver not analyzed for this topology");
+
+			Eigen::SparseMatrix<double>& system = factor->system;
+
+			values::Fill(mesh, positions, massWeight, stiffnessWeight, system.outerIndexPtr(), system.innerIndexPtr(), system.valuePtr(), &inoutSolver->mass, options);
+
+			factor->ldlt.factorize(system);
+			factor->factored = factor->ldlt.info() == Eigen::Success;
+
+			return factor->factored;
+		}
+
+		void SolveLaplacian(const LaplacianSolver& solver, const double* rhs, unsigned rhsCount, double* outSolution, const LaplacianOptions& options)
+		{
+			const CholeskyFactor* const factor = solver.factor.get();
+
+			sanity(factor && factor->factored && "mesh::half_edge::SolveLaplacian solver not factored");
+
+			const Eigen::Index vertCount = factor->system.rows();
+			const unsigned threadCount = std::min(Parallel_ThreadCount(options.threadCount), rhsCount);
+
+			Parallel_For(threadCount, rhsCount, [&](unsigned, unsigned begin, unsigned end)
+			{
+				for (unsigned column = begin; column < end; ++column)
+				{
+					const Eigen::Map<const Eigen::VectorXd> b(rhs + column * vertCount, vertCount);
+					Eigen::Map<Eigen::VectorXd> x(outSolution + column * vertCount, vertCount);
+
+					x = factor->ldlt.solve(b);
+				}
+			});
+		}
+
+		template void AssembleLaplacian(const Topology&, const float*, SparseMatrix*, std::vector<double>*, const LaplacianOptions&);
+		template void AssembleLaplacian(const Topology64&, const float*, SparseMatrix*, std::vector<double>*, const LaplacianOptions&);
+		template void AnalyzeLaplacian(const Topology&, LaplacianSolver*, const LaplacianOptions&);
+		template void AnalyzeLaplacian(const Topology64&, LaplacianSolver*, const LaplacianOptions&);
+		template bool FactorLaplacian(const Topology&, const float*, double, double, LaplacianSolver*, const LaplacianOptions&);
+		template bool FactorLaplacian(const Topology64&, const float*, double, double, LaplacianSolver*, const LaplacianOptions&);
+	}
+}
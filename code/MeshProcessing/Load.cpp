@@ -0,0 +1,842 @@
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "MeshProc/Load.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+
+namespace
+{
+	using namespace mesh;
+	using namespace mesh::io;
+
+	// Below these, parsing is over before threads would have started.
+	static constexpr unsigned PARALLEL_MIN_RECORDS = 1u << 15;
+	static constexpr size_t PARALLEL_MIN_CHUNK_BYTES = 1u << 20;
+
+	static constexpr uint64_t MAX_INDEX_COUNT = 0xFFFFFFFFull;
+
+	static inline bool IsSpace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	static inline const char* SkipSpace(const char* cur, const char* end)
+	{
+		while (cur < end && IsSpace(*cur))
+			++cur;
+
+		return cur;
+	}
+
+	static inline const char* LineEnd(const char* cur, const char* end)
+	{
+		const void* const newLine = std::memchr(cur, '\n', static_cast<size_t>(end - cur));
+
+		return newLine ? static_cast<const char*>(newLine) : end;
+	}
+
+	// std::from_chars takes no leading '+', which text formats allow
+	static inline const char* SkipPlus(const char* cur, const char* end)
+	{
+		return end - cur >= 2 && cur[0] == '+' && cur[1] != '-' && cur[1] != '+' ? cur + 1 : cur;
+	}
+
+	namespace ply
+	{
+		enum class ScalarType : uint8_t
+		{
+			NONE,
+			INT8,
+			UINT8,
+			INT16,
+			UINT16,
+			INT32,
+			UINT32,
+			FLOAT32,
+			FLOAT64
+		};
+
+		struct Property
+		{
+			std::string name;
+			ScalarType type;
+			ScalarType countType; // NONE unless this is a list.
+		};
+
+		struct Element
+		{
+			std::string name;
+			uint64_t count;
+			std::vector<Property> props;
+		};
+
+		struct Header
+		{
+			std::vector<Element> elements;
+			size_t dataOffset;
+			bool bigEndian;
+		};
+
+		static unsigned ScalarSize(ScalarType type)
+		{
+			switch (type)
+			{
+			case ScalarType::INT8: case ScalarType::UINT8: return 1;
+			case ScalarType::INT16: case ScalarType::UINT16: return 2;
+			case ScalarType::INT32: case ScalarType::UINT32: case ScalarType::FLOAT32: return 4;
+			case ScalarType::FLOAT64: return 8;
+			default: return 0;
+			}
+		}
+
+		static ScalarType ParseScalarType(const std::string& name)
+		{
+			static const struct { const char* name; ScalarType type; } TYPES[] =
+			{
+				{ "char", ScalarType::INT8 }, { "int8", ScalarType::INT8 },
+				{ "uchar", ScalarType::UINT8 }, { "uint8", ScalarType::UINT8 },
+				{ "short", ScalarType::INT16 }, { "int16", ScalarType::INT16 },
+				{ "ushort", ScalarType::UINT16 }, { "uint16", ScalarType::UINT16 },
+				{ "int", ScalarType::INT32 }, { "int32", ScalarType::INT32 },
+				{ "uint", ScalarType::UINT32 }, { "uint32", ScalarType::UINT32 },
+				{ "float", ScalarType::FLOAT32 }, { "float32", ScalarType::FLOAT32 },
+				{ "double", ScalarType::FLOAT64 }, { "float64", ScalarType::FLOAT64 },
+			};
+
+			for (const auto& entry : TYPES)
+			{
+				if (name == entry.name)
+					return entry.type;
+			}
+
+			return ScalarType::NONE;
+		}
+
+		static std::vector<std::string> SplitWords(const char* cur, const char* end)
+		{
+			std::vector<std::string> words;
+
+			for (cur = SkipSpace(cur, end); cur < end; cur = SkipSpace(cur, end))
+			{
+				const char* const wordBegin = cur;
+
+				while (cur < end && !IsSpace(*cur))
+					++cur;
+
+				words.emplace_back(wordBegin, cur);
+			}
+
+			return words;
+		}
+
+		static bool ParseHeader(const char* data, size_t size, Header* outHeader)
+		{
+			const char* const end = data + size;
+			const char* cur = data;
+			bool hasFormat = false;
+
+			outHeader->elements.clear();
+			outHeader->bigEndian = false;
+
+			for (unsigned lineIndex = 0; cur < end; ++lineIndex)
+			{
+				const char* const lineEnd = LineEnd(cur, end);
+				const std::vector<std::string> words = SplitWords(cur, lineEnd);
+
+				cur = lineEnd == end ? end : lineEnd + 1;
+
+				if (lineIndex == 0)
+				{
+					if (words.size() != 1 || words[0] != "ply")
+						return false;
+				}
+				else if (words.empty() || words[0] == "comment" || words[0] == "obj_info")
+				{
+				}
+				else if (words[0] == "format")
+				{
+					// ASCII PLY is not supported; it is rare for meshes large enough to matter.
+					if (words.size() != 3 || (words[1] != "binary_little_endian" && words[1] != "binary_big_endian"))
+						return false;
+
+					outHeader->bigEndian = words[1] == "binary_big_endian";
+					hasFormat = true;
+				}
+				else if (words[0] == "element")
+				{
+					Element element;
+					const char* const countEnd = words.size() == 3 ? words[2].data() + words[2].size() : nullptr;
+
+					if (!countEnd || std::from_chars(words[2].data(), countEnd, element.count).ptr != countEnd)
+						return false;
+
+					element.name = words[1];
+					outHeader->elements.emplace_back(std::move(element));
+				}
+				else if (words[0] == "property")
+				{
+					Property prop;
+
+					if (outHeader->elements.empty())
+						return false;
+
+					if (words.size() == 5 && words[1] == "list")
+					{
+						prop.countType = ParseScalarType(words[2]);
+						prop.type = ParseScalarType(words[3]);
+						prop.name = words[4];
+
+						if (prop.countType == ScalarType::NONE || prop.countType == ScalarType::FLOAT32 || prop.countType == ScalarType::FLOAT64)
+							return false;
+					}
+					else if (words.size() == 3)
+					{
+						prop.countType = ScalarType::NONE;
+						prop.type = ParseScalarType(words[1]);
+						prop.name = words[2];
+					}
+					else
+					{
+						return false;
+					}
+
+					if (prop.type == ScalarType::NONE)
+						return false;
+
+					outHeader->elements.back().props.emplace_back(std::move(prop));
+				}
+				else if (words[0] == "end_header")
+				{
+					outHeader->dataOffset = static_cast<size_t>(cur - data);
+					return hasFormat;
+				}
+				else
+				{
+					return false;
+				}
+			}
+
+			return false;
+		}
+
+		template<typename T>
+		static inline T ReadScalar(const char* src, bool swap)
+		{
+			T value;
+
+			if (swap)
+			{
+				char bytes[sizeof(T)];
+
+				for (unsigned byteIndex = 0; byteIndex < sizeof(T); ++byteIndex)
+					bytes[byteIndex] = src[sizeof(T) - 1 - byteIndex];
+
+				std::memcpy(&value, bytes, sizeof(T));
+			}
+			else
+			{
+				std::memcpy(&value, src, sizeof(T));
+			}
+
+			return value;
+		}
+
+		static inline double ReadFloat(const char* src, ScalarType type, bool swap)
+		{
+			switch (type)
+			{
+			case ScalarType::INT8: return ReadScalar<int8_t>(src, swap);
+			case ScalarType::UINT8: return ReadScalar<uint8_t>(src, swap);
+			case ScalarType::INT16: return ReadScalar<int16_t>(src, swap);
+			case ScalarType::UINT16: return ReadScalar<uint16_t>(src, swap);
+			case ScalarType::INT32: return ReadScalar<int32_t>(src, swap);
+			case ScalarType::UINT32: return ReadScalar<uint32_t>(src, swap);
+			case ScalarType::FLOAT32: return ReadScalar<float>(src, swap);
+			case ScalarType::FLOAT64: return ReadScalar<double>(src, swap);
+			default: return 0.0;
+			}
+		}
+
+		// Float properties read as indices become -1, which every range check rejects.
+		static inline int64_t ReadInt(const char* src, ScalarType type, bool swap)
+		{
+			switch (type)
+			{
+			case ScalarType::INT8: return ReadScalar<int8_t>(src, swap);
+			case ScalarType::UINT8: return ReadScalar<uint8_t>(src, swap);
+			case ScalarType::INT16: return ReadScalar<int16_t>(src, swap);
+			case ScalarType::UINT16: return ReadScalar<uint16_t>(src, swap);
+			case ScalarType::INT32: return ReadScalar<int32_t>(src, swap);
+			case ScalarType::UINT32: return ReadScalar<uint32_t>(src, swap);
+			default: return -1;
+			}
+		}
+
+		// Byte size of every record, or 0 when the element holds lists and records vary in size.
+		static size_t FixedStride(const Element& element)
+		{
+			size_t stride = 0;
+
+			for (const Property& prop : element.props)
+			{
+				if (prop.countType != ScalarType::NONE)
+					return 0;
+
+				stride += ScalarSize(prop.type);
+			}
+
+			return stride;
+		}
+
+		// Walks count records of a variable size element, calling fn(listData, listCount) for the list property at
+		// listPropIndex. Returns the end of the last record, or nullptr when a record runs past end or fn fails.
+		template<typename Fn>
+		static const char* WalkRecords(const Element& element, size_t listPropIndex, const char* cur, const char* end, bool swap, const Fn& fn)
+		{
+			for (uint64_t recordIndex = 0; recordIndex < element.count; ++recordIndex)
+			{
+				for (size_t propIndex = 0; propIndex < element.props.size(); ++propIndex)
+				{
+					const Property& prop = element.props[propIndex];
+					const size_t valueSize = ScalarSize(prop.type);
+
+					if (prop.countType == ScalarType::NONE)
+					{
+						if (static_cast<size_t>(end - cur) < valueSize)
+							return nullptr;
+
+						cur += valueSize;
+					}
+					else
+					{
+						const size_t countSize = ScalarSize(prop.countType);
+
+						if (static_cast<size_t>(end - cur) < countSize)
+							return nullptr;
+
+						const int64_t listCount = ReadInt(cur, prop.countType, swap);
+
+						cur += countSize;
+						if (listCount < 0 || static_cast<uint64_t>(end - cur) / valueSize < static_cast<uint64_t>(listCount))
+							return nullptr;
+
+						if (propIndex == listPropIndex && !fn(cur, static_cast<unsigned>(listCount)))
+							return nullptr;
+
+						cur += valueSize * static_cast<size_t>(listCount);
+					}
+				}
+			}
+
+			return cur;
+		}
+
+		static const char* ReadVerts(const Element& element, const char* cur, const char* end, bool swap, unsigned threadCount, IndexedMesh* outMesh)
+		{
+			const size_t stride = FixedStride(element);
+			size_t offsets[3];
+			ScalarType types[3];
+			static const char* const AXES[3] = { "x", "y", "z" };
+
+			// List properties on verts are not supported; no common exporter writes them.
+			if (!stride || element.count > MAX_INDEX_COUNT || static_cast<uint64_t>(end - cur) / stride < element.count)
+				return nullptr;
+
+			for (unsigned axis = 0; axis < 3; ++axis)
+			{
+				size_t offset = 0;
+
+				types[axis] = ScalarType::NONE;
+				for (const Property& prop : element.props)
+				{
+					if (prop.name == AXES[axis])
+					{
+						offsets[axis] = offset;
+						types[axis] = prop.type;
+					}
+
+					offset += ScalarSize(prop.type);
+				}
+
+				if (types[axis] == ScalarType::NONE)
+					return nullptr;
+			}
+
+			const unsigned vertCount = static_cast<unsigned>(element.count);
+			const bool packedFloats = !swap && stride == 12 && offsets[0] == 0 && offsets[1] == 4 && offsets[2] == 8 &&
+				types[0] == ScalarType::FLOAT32 && types[1] == ScalarType::FLOAT32 && types[2] == ScalarType::FLOAT32;
+
+			outMesh->positions.resize(static_cast<size_t>(vertCount) * 3);
+
+			float* const outPositions = outMesh->positions.data();
+
+			Parallel_For(vertCount < PARALLEL_MIN_RECORDS ? 1 : threadCount, vertCount, [&](unsigned, unsigned begin, unsigned sliceEnd)
+			{
+				if (packedFloats)
+				{
+					std::memcpy(outPositions + static_cast<size_t>(begin) * 3, cur + static_cast<size_t>(begin) * stride, static_cast<size_t>(sliceEnd - begin) * stride);
+				}
+				else
+				{
+					for (unsigned vertIndex = begin; vertIndex < sliceEnd; ++vertIndex)
+					{
+						const char* const record = cur + static_cast<size_t>(vertIndex) * stride;
+
+						for (unsigned axis = 0; axis < 3; ++axis)
+							outPositions[static_cast<size_t>(vertIndex) * 3 + axis] = static_cast<float>(ReadFloat(record + offsets[axis], types[axis], swap));
+					}
+				}
+			});
+
+			return cur + stride * static_cast<size_t>(element.count);
+		}
+
+		// All triangle files, the common case, have fixed size records once the index list is known to hold 3 entries.
+		// Those are read in parallel; anything else falls back to a serial count pass and fill pass.
+		static const char* ReadTriangleFaces(const Element& element, size_t listPropIndex, const char* cur, const char* end, bool swap, unsigned threadCount, unsigned vertCount, IndexedMesh* outMesh)
+		{
+			size_t stride = 0;
+			size_t listOffset = 0;
+
+			for (size_t propIndex = 0; propIndex < element.props.size(); ++propIndex)
+			{
+				const Property& prop = element.props[propIndex];
+
+				if (propIndex == listPropIndex)
+				{
+					listOffset = stride;
+					stride += ScalarSize(prop.countType) + 3 * ScalarSize(prop.type);
+				}
+				else if (prop.countType != ScalarType::NONE)
+				{
+					return nullptr;
+				}
+				else
+				{
+					stride += ScalarSize(prop.type);
+				}
+			}
+
+			if (element.count * 3 > MAX_INDEX_COUNT || static_cast<uint64_t>(end - cur) / stride < element.count)
+				return nullptr;
+
+			const Property& listProp = element.props[listPropIndex];
+			const size_t countSize = ScalarSize(listProp.countType);
+			const size_t indexSize = ScalarSize(listProp.type);
+			const unsigned triCount = static_cast<unsigned>(element.count);
+			const unsigned sliceCount = triCount < PARALLEL_MIN_RECORDS ? 1 : threadCount;
+			std::vector<uint8_t> sliceOk(sliceCount, 1);
+
+			outMesh->indices.resize(static_cast<size_t>(triCount) * 3);
+
+			unsigned* const outIndices = outMesh->indices.data();
+
+			Parallel_For(sliceCount, triCount, [&](unsigned threadIndex, unsigned begin, unsigned sliceEnd)
+			{
+				for (unsigned triIndex = begin; triIndex < sliceEnd; ++triIndex)
+				{
+					const char* const list = cur + static_cast<size_t>(triIndex) * stride + listOffset;
+
+					if (ReadInt(list, listProp.countType, swap) != 3)
+					{
+						sliceOk[threadIndex] = 0;
+						return;
+					}
+
+					for (unsigned corner = 0; corner < 3; ++corner)
+					{
+						const int64_t index = ReadInt(list + countSize + corner * indexSize, listProp.type, swap);
+
+						if (index < 0 || index >= vertCount)
+						{
+							sliceOk[threadIndex] = 0;
+							return;
+						}
+
+						outIndices[static_cast<size_t>(triIndex) * 3 + corner] = static_cast<unsigned>(index);
+					}
+				}
+			});
+
+			if (std::find(sliceOk.begin(), sliceOk.end(), 0) != sliceOk.end())
+				return nullptr;
+
+			return cur + stride * static_cast<size_t>(element.count);
+		}
+
+		static const char* ReadFaces(const Element& element, const char* cur, const char* end, bool swap, unsigned threadCount, unsigned vertCount, IndexedMesh* outMesh)
+		{
+			size_t listPropIndex = element.props.size();
+
+			for (size_t propIndex = 0; propIndex < element.props.size(); ++propIndex)
+			{
+				const Property& prop = element.props[propIndex];
+
+				if (prop.countType != ScalarType::NONE && (prop.name == "vertex_indices" || prop.name == "vertex_index"))
+					listPropIndex = propIndex;
+			}
+
+			if (listPropIndex == element.props.size())
+				return nullptr;
+
+			if (const char* const trianglesEnd = ReadTriangleFaces(element, listPropIndex, cur, end, swap, threadCount, vertCount, outMesh))
+				return trianglesEnd;
+
+			const ScalarType indexType = element.props[listPropIndex].type;
+			const size_t indexSize = ScalarSize(indexType);
+			uint64_t indexCount = 0;
+
+			const bool counted = WalkRecords(element, listPropIndex, cur, end, swap, [&](const char*, unsigned listCount)
+			{
+				indexCount += listCount >= 3 ? (listCount - 2) * 3ull : 0;
+				return indexCount <= MAX_INDEX_COUNT;
+			}) != nullptr;
+
+			if (!counted)
+				return nullptr;
+
+			outMesh->indices.resize(static_cast<size_t>(indexCount));
+
+			unsigned* outIndex = outMesh->indices.data();
+
+			return WalkRecords(element, listPropIndex, cur, end, swap, [&](const char* list, unsigned listCount)
+			{
+				int64_t polyIndices[3];
+
+				for (unsigned listIndex = 0; listIndex < listCount; ++listIndex)
+				{
+					const int64_t index = ReadInt(list + listIndex * indexSize, indexType, swap);
+
+					if (index < 0 || index >= vertCount)
+						return false;
+
+					polyIndices[listIndex < 2 ? listIndex : 2] = index;
+					if (listIndex >= 2)
+					{
+						*outIndex++ = static_cast<unsigned>(polyIndices[0]);
+						*outIndex++ = static_cast<unsigned>(polyIndices[1]);
+						*outIndex++ = static_cast<unsigned>(polyIndices[2]);
+						polyIndices[1] = polyIndices[2];
+					}
+				}
+
+				return true;
+			});
+		}
+
+		static bool Load(const char* data, size_t size, unsigned threadCount, IndexedMesh* outMesh)
+		{
+			Header header;
+
+			if (!ParseHeader(data, size, &header))
+				return false;
+
+			const char* const end = data + size;
+			const char* cur = data + header.dataOffset;
+			uint64_t vertCount = 0;
+			bool hasVerts = false;
+			bool hasFaces = false;
+
+			for (const Element& element : header.elements)
+			{
+				if (element.name == "vertex")
+					vertCount = element.count;
+			}
+
+			for (const Element& element : header.elements)
+			{
+				if (element.name == "vertex" && !hasVerts)
+				{
+					cur = ReadVerts(element, cur, end, header.bigEndian, threadCount, outMesh);
+					hasVerts = true;
+				}
+				else if (element.name == "face" && !hasFaces)
+				{
+					cur = ReadFaces(element, cur, end, header.bigEndian, threadCount, static_cast<unsigned>(vertCount), outMesh);
+					hasFaces = true;
+				}
+				else if (const size_t stride = FixedStride(element))
+				{
+					cur = static_cast<uint64_t>(end - cur) / stride < element.count ? nullptr : cur + stride * static_cast<size_t>(element.count);
+				}
+				else
+				{
+					cur = WalkRecords(element, element.props.size(), cur, end, header.bigEndian, [](const char*, unsigned) { return true; });
+				}
+
+				if (!cur)
+					return false;
+			}
+
+			return hasVerts;
+		}
+	}
+
+	namespace obj
+	{
+		// Lines belong to the chunk their first character falls in.
+		struct Chunk
+		{
+			const char* begin;
+			const char* end;
+			uint64_t vertCount;
+			uint64_t indexCount;
+			uint64_t vertOffset;
+			uint64_t indexOffset;
+			bool ok;
+		};
+
+		enum class LineType
+		{
+			VERT,
+			FACE,
+			OTHER
+		};
+
+		// Vert and face data ends at outDataEnd, before any trailing comment
+		static inline LineType ClassifyLine(const char** inoutCur, const char* lineEnd, const char** outDataEnd)
+		{
+			const char* const cur = SkipSpace(*inoutCur, lineEnd);
+			const void* const comment = std::memchr(cur, '#', static_cast<size_t>(lineEnd - cur));
+
+			*outDataEnd = comment ? static_cast<const char*>(comment) : lineEnd;
+			if (*outDataEnd - cur >= 2 && IsSpace(cur[1]))
+			{
+				*inoutCur = cur + 2;
+				if (cur[0] == 'v')
+					return LineType::VERT;
+				if (cur[0] == 'f')
+					return LineType::FACE;
+			}
+
+			return LineType::OTHER;
+		}
+
+		// Parses the vertex reference of a face token ("v", "v/vt", "v//vn" or "v/vt/vn") as a zero based index.
+		// Negative references count back from the verts declared so far.
+		static inline bool ParseFaceVert(const char** inoutCur, const char* lineEnd, uint64_t vertsBefore, uint64_t vertCount, unsigned* outIndex)
+		{
+			const char* cur = *inoutCur;
+			int64_t reference;
+			const std::from_chars_result result = std::from_chars(SkipPlus(cur, lineEnd), lineEnd, reference);
+
+			if (result.ec != std::errc() || reference == 0)
+				return false;
+
+			const int64_t index = reference < 0 ? static_cast<int64_t>(vertsBefore) + reference : reference - 1;
+
+			if (index < 0 || static_cast<uint64_t>(index) >= vertCount)
+				return false;
+
+			for (cur = result.ptr; cur < lineEnd && !IsSpace(*cur); ++cur);
+
+			*outIndex = static_cast<unsigned>(index);
+			*inoutCur = SkipSpace(cur, lineEnd);
+			return true;
+		}
+
+		static void CountChunk(Chunk* chunk)
+		{
+			for (const char* cur = chunk->begin; cur < chunk->end;)
+			{
+				const char* const lineEnd = LineEnd(cur, chunk->end);
+				const char* token = cur;
+				const char* dataEnd;
+
+				switch (ClassifyLine(&token, lineEnd, &dataEnd))
+				{
+				case LineType::VERT:
+					++chunk->vertCount;
+					break;
+				case LineType::FACE:
+				{
+					unsigned polyVertCount = 0;
+
+					for (token = SkipSpace(token, dataEnd); token < dataEnd; token = SkipSpace(token, dataEnd), ++polyVertCount)
+					{
+						while (token < dataEnd && !IsSpace(*token))
+							++token;
+					}
+
+					chunk->indexCount += polyVertCount >= 3 ? (polyVertCount - 2) * 3ull : 0;
+					break;
+				}
+				default:
+					break;
+				}
+
+				cur = lineEnd < chunk->end ? lineEnd + 1 : lineEnd;
+			}
+		}
+
+		static void FillChunk(Chunk* chunk, uint64_t vertCount, float* outPositions, unsigned* outIndices)
+		{
+			float* outVert = outPositions + chunk->vertOffset * 3;
+			unsigned* outIndex = outIndices + chunk->indexOffset;
+			uint64_t vertsBefore = chunk->vertOffset;
+
+			for (const char* cur = chunk->begin; cur < chunk->end;)
+			{
+				const char* const lineEnd = LineEnd(cur, chunk->end);
+				const char* token = cur;
+				const char* dataEnd;
+
+				switch (ClassifyLine(&token, lineEnd, &dataEnd))
+				{
+				case LineType::VERT:
+					for (unsigned axis = 0; axis < 3; ++axis)
+					{
+						token = SkipSpace(token, dataEnd);
+
+						const std::from_chars_result result = std::from_chars(SkipPlus(token, dataEnd), dataEnd, outVert[axis]);
+
+						if (result.ec != std::errc())
+						{
+							chunk->ok = false;
+							return;
+						}
+
+						token = result.ptr;
+					}
+
+					outVert += 3;
+					++vertsBefore;
+					break;
+				case LineType::FACE:
+				{
+					unsigned polyIndices[3];
+					unsigned polyVertCount = 0;
+
+					for (token = SkipSpace(token, dataEnd); token < dataEnd; ++polyVertCount)
+					{
+						if (!ParseFaceVert(&token, dataEnd, vertsBefore, vertCount, polyIndices + (polyVertCount < 2 ? polyVertCount : 2)))
+						{
+							chunk->ok = false;
+							return;
+						}
+
+						if (polyVertCount >= 2)
+						{
+							*outIndex++ = polyIndices[0];
+							*outIndex++ = polyIndices[1];
+							*outIndex++ = polyIndices[2];
+							polyIndices[1] = polyIndices[2];
+						}
+					}
+					break;
+				}
+				default:
+					break;
+				}
+
+				cur = lineEnd < chunk->end ? lineEnd + 1 : lineEnd;
+			}
+		}
+
+		static bool Load(const char* data, size_t size, unsigned threadCount, IndexedMesh* outMesh)
+		{
+			const unsigned chunkCount = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threadCount, size / PARALLEL_MIN_CHUNK_BYTES)));
+			const char* const end = data + size;
+			std::vector<Chunk> chunks(chunkCount);
+
+			for (unsigned chunkIndex = 0; chunkIndex < chunkCount; ++chunkIndex)
+			{
+				const char* const nominalBegin = data + static_cast<size_t>((static_cast<unsigned long long>(size) * chunkIndex) / chunkCount);
+
+				chunks[chunkIndex] = Chunk{ chunkIndex ? std::min(LineEnd(nominalBegin - 1, end) + 1, end) : data, end, 0, 0, 0, 0, true };
+				if (chunkIndex)
+					chunks[chunkIndex - 1].end = chunks[chunkIndex].begin;
+			}
+
+			Parallel_For(chunkCount, chunkCount, [&](unsigned threadIndex, unsigned, unsigned)
+			{
+				CountChunk(&chunks[threadIndex]);
+			});
+
+			uint64_t vertCount = 0;
+			uint64_t indexCount = 0;
+
+			for (Chunk& chunk : chunks)
+			{
+				chunk.vertOffset = vertCount;
+				chunk.indexOffset = indexCount;
+				vertCount += chunk.vertCount;
+				indexCount += chunk.indexCount;
+			}
+
+			if (vertCount > MAX_INDEX_COUNT || indexCount > MAX_INDEX_COUNT)
+				return false;
+
+			outMesh->positions.resize(static_cast<size_t>(vertCount) * 3);
+			outMesh->indices.resize(static_cast<size_t>(indexCount));
+
+			Parallel_For(chunkCount, chunkCount, [&](unsigned threadIndex, unsigned, unsigned)
+			{
+				FillChunk(&chunks[threadIndex], vertCount, outMesh->positions.data(), outMesh->indices.data());
+			});
+
+			for (const Chunk& chunk : chunks)
+			{
+				if (!chunk.ok)
+					return false;
+			}
+
+			return true;
+		}
+	}
+
+	template<typename LoadFn>
+	static bool LoadMapped(const char* path, IndexedMesh* outMesh, const LoadOptions& options, const LoadFn& load)
+	{
+		MappedFile file;
+
+		outMesh->positions.clear();
+		outMesh->indices.clear();
+
+		if (!MappedFile_Open(path, &file))
+			return false;
+
+		const bool loaded = load(file.data ? file.data : "", file.size, Parallel_ThreadCount(options.threadCount), outMesh);
+
+		MappedFile_Close(&file);
+
+		if (!loaded)
+		{
+			outMesh->positions.clear();
+			outMesh->indices.clear();
+		}
+
+		return loaded;
+	}
+}
+
+namespace mesh
+{
+	namespace io
+	{
+		bool Load(const char* path, IndexedMesh* outMesh, const LoadOptions& options)
+		{
+			return LoadMapped(path, outMesh, options, [](const char* data, size_t size, unsigned threadCount, IndexedMesh* outLoaded)
+			{
+				if (size >= 4 && std::memcmp(data, "ply", 3) == 0 && (data[3] == '\n' || data[3] == '\r'))
+					return ply::Load(data, size, threadCount, outLoaded);
+
+				return obj::Load(data, size, threadCount, outLoaded);
+			});
+		}
+
+		bool LoadPly(const char* path, IndexedMesh* outMesh, const LoadOptions& options)
+		{
+			return LoadMapped(path, outMesh, options, &ply::Load);
+		}
+
+		bool LoadObj(const char* path, IndexedMesh* outMesh, const LoadOptions& options)
+		{
+			return LoadMapped(path, outMesh, options, &obj::Load);
+		}
+	}
+}
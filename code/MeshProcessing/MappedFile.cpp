@@ -0,0 +1,106 @@
+#include "MappedFile.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool MappedFile_Open(const char* path, MappedFile* outFile)
+{
+	outFile->data = nullptr;
+	outFile->size = 0;
+	outFile->handle = nullptr;
+
+#if defined(_WIN32)
+	const HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	LARGE_INTEGER fileSize;
+
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	if (!GetFileSizeEx(file, &fileSize))
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	// Empty files cannot be mapped, but are still valid files.
+	if (fileSize.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return true;
+	}
+
+	const HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+	CloseHandle(file);
+	if (!mapping)
+		return false;
+
+	const void* const view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+	if (!view)
+	{
+		CloseHandle(mapping);
+		return false;
+	}
+
+	outFile->data = static_cast<const char*>(view);
+	outFile->size = static_cast<size_t>(fileSize.QuadPart);
+	outFile->handle = mapping;
+#else
+	const int fd = open(path, O_RDONLY);
+	struct stat fileStat;
+
+	if (fd < 0)
+		return false;
+
+	if (fstat(fd, &fileStat) != 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	if (fileStat.st_size == 0)
+	{
+		close(fd);
+		return true;
+	}
+
+	void* const view = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+
+	close(fd);
+	if (view == MAP_FAILED)
+		return false;
+
+	madvise(view, static_cast<size_t>(fileStat.st_size), MADV_SEQUENTIAL);
+
+	outFile->data = static_cast<const char*>(view);
+	outFile->size = static_cast<size_t>(fileStat.st_size);
+#endif
+
+	return true;
+}
+
+void MappedFile_Close(MappedFile* file)
+{
+	if (file->data)
+	{
+#if defined(_WIN32)
+		UnmapViewOfFile(file->data);
+		CloseHandle(file->handle);
+#else
+		munmap(const_cast<char*>(file->data), file->size);
+#endif
+	}
+
+	file->data = nullptr;
+	file->size = 0;
+	file->handle = nullptr;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+
+// Read-only mapping of a whole file. Pages are faulted in as they are touched, so parsing streams straight from the
+// page cache without a read buffer.
+struct MappedFile
+{
+	const char* data;
+	size_t size;
+	void* handle;
+};
+
+bool MappedFile_Open(const char* path, MappedFile* outFile);
+void MappedFile_Close(MappedFile* file);
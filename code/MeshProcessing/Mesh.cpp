@@ -1,82 +1,215 @@
+#include <algorithm>
 #include <cfloat>
-#include <immintrin.h>
+#include <cmath>
+#include <vector>
 #include "MeshProc/Mesh.h"
+#include "MeshKernels.h"
+#include "Parallel.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 namespace
 {
-	void MeshBounds(const float* verts, unsigned vertCount, __m128* outMins, __m128* outMaxs)
+	using namespace mesh;
+
+	// Below this a pass is over before threads would have started.
+	static constexpr unsigned PARALLEL_MIN_VERTS = 1u << 16;
+
+	namespace cpu
 	{
-		const __m128i vertMask = _mm_set_epi32(-1, -1, -1, 0);
-		__m128 mins = _mm_set1_ps(FLT_MAX);
-		__m128 maxs = _mm_set1_ps(-FLT_MAX);
+		static bool SupportsAvx2()
+		{
+#if defined(_MSC_VER)
+			int regs[4];
+
+			__cpuid(regs, 1);
+			const bool osxsave = (regs[2] & (1 << 27)) != 0;
+			const bool avx = (regs[2] & (1 << 28)) != 0;
+
+			if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+				return false;
+
+			__cpuidex(regs, 7, 0);
+			return (regs[1] & (1 << 5)) != 0;
+#else
+			return __builtin_cpu_supports("avx2");
+#endif
+		}
+
+		static bool SupportsAvx512()
+		{
+#if defined(_MSC_VER)
+			int regs[4];
+
+			__cpuid(regs, 1);
+			if (!(regs[2] & (1 << 27)) || (_xgetbv(0) & 0xE6) != 0xE6)
+				return false;
+
+			__cpuidex(regs, 7, 0);
+			return (regs[1] & (1 << 16)) != 0;
+#else
+			return __builtin_cpu_supports("avx512f");
+#endif
+		}
+	}
+
+	namespace transform
+	{
+		static unsigned ThreadCount(unsigned vertCount, const TransformOptions& options)
+		{
+			return vertCount < PARALLEL_MIN_VERTS ? 1 : std::min(Parallel_ThreadCount(options.threadCount), vertCount / (PARALLEL_MIN_VERTS / 4));
+		}
+
+		static kernels::Bounds MeshBounds(const float* verts, unsigned vertCount, unsigned threadCount)
+		{
+			const kernels::Kernels& impl = kernels::Select();
+			const kernels::Bounds empty = { { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+			std::vector<kernels::Bounds> sliceBounds(threadCount, empty);
+
+			Parallel_For(threadCount, vertCount, [&](unsigned threadIndex, unsigned begin, unsigned end)
+			{
+				impl.bounds(verts + static_cast<size_t>(begin) * 3, end - begin, &sliceBounds[threadIndex]);
+			});
+
+			kernels::Bounds bounds = empty;
+
+			for (const kernels::Bounds& slice : sliceBounds)
+			{
+				for (unsigned component = 0; component < 3; ++component)
+				{
+					bounds.mins[component] = std::min(bounds.mins[component], slice.mins[component]);
+					bounds.maxs[component] = std::max(bounds.maxs[component], slice.maxs[component]);
+				}
+			}
+
+			return bounds;
+		}
+
+		static void Transform(float* inoutVerts, unsigned vertCount, const float* offset, float scale, unsigned threadCount)
+		{
+			const kernels::Kernels& impl = kernels::Select();
+
+			Parallel_For(threadCount, vertCount, [&](unsigned, unsigned begin, unsigned end)
+			{
+				impl.transform(inoutVerts + static_cast<size_t>(begin) * 3, end - begin, offset, scale);
+			});
+		}
 
-		for (unsigned vertIndex = 0; vertIndex < vertCount; ++vertIndex)
+		// Offset that moves the bounds center onto the desired center.
+		static void CenterOffset(const kernels::Bounds& bounds, const float* optCenter, float* outOffset)
 		{
-			const float* const vertPtr = verts + (vertIndex * 3);
-			const __m128 vert = _mm_maskload_ps(vertPtr, vertMask);
+			for (unsigned component = 0; component < 3; ++component)
+			{
+				const float desiredCenter = optCenter ? optCenter[component] : 0.0f;
+				const float center = (bounds.mins[component] + bounds.maxs[component]) * 0.5f;
 
-			mins = _mm_min_ps(mins, vert);
-			maxs = _mm_max_ps(maxs, vert);
+				outOffset[component] = desiredCenter - center;
+			}
 		}
 
-		*outMins = mins;
-		*outMaxs = maxs;
+		// Largest absolute coordinate of the verts once offset. Float addition is monotonic, so offsetting the bounds
+		// matches offsetting every vert.
+		static float Radius(const kernels::Bounds& bounds, const float* offset)
+		{
+			float radius = 0.0f;
+
+			for (unsigned component = 0; component < 3; ++component)
+			{
+				radius = std::max(radius, std::abs(bounds.mins[component] + offset[component]));
+				radius = std::max(radius, std::abs(bounds.maxs[component] + offset[component]));
+			}
+
+			return radius;
+		}
 	}
 }
 
 namespace mesh
 {
-	void Recenter(float* inoutVerts, unsigned vertCount, const float* optCenter, float* optOutOffset)
+	namespace kernels
 	{
-		const __m128i vertMask = _mm_set_epi32(-1, -1, -1, 0);
-		__m128 mins;
-		__m128 maxs;
+		void Bounds_Scalar(const float* verts, unsigned vertCount, Bounds* inoutBounds)
+		{
+			Bounds bounds = *inoutBounds;
+
+			for (unsigned vertIndex = 0; vertIndex < vertCount; ++vertIndex)
+			{
+				const float* const vert = verts + static_cast<size_t>(vertIndex) * 3;
 
-		MeshBounds(inoutVerts, vertCount, &mins, &maxs);
+				for (unsigned component = 0; component < 3; ++component)
+				{
+					bounds.mins[component] = vert[component] < bounds.mins[component] ? vert[component] : bounds.mins[component];
+					bounds.maxs[component] = vert[component] > bounds.maxs[component] ? vert[component] : bounds.maxs[component];
+				}
+			}
 
-		const __m128 desiredCenter = optCenter ? _mm_maskload_ps(optCenter, vertMask) : _mm_set1_ps(0.0f);
-		const __m128 center = _mm_mul_ps(_mm_add_ps(mins, maxs), _mm_set1_ps(0.5f));
-		const __m128 offset = _mm_sub_ps(desiredCenter, center);
+			*inoutBounds = bounds;
+		}
 
-		for (unsigned vertIndex = 0; vertIndex < vertCount; ++vertIndex)
+		void Transform_Scalar(float* inoutVerts, unsigned vertCount, const float* offset, float scale)
 		{
-			float* const vertPtr = inoutVerts + (vertIndex * 3);
-			const __m128 vert = _mm_maskload_ps(vertPtr, vertMask);
-			const __m128 offsetVert = _mm_add_ps(vert, offset);
+			for (unsigned vertIndex = 0; vertIndex < vertCount; ++vertIndex)
+			{
+				float* const vert = inoutVerts + static_cast<size_t>(vertIndex) * 3;
 
-			_mm_maskstore_ps(vertPtr, vertMask, offsetVert);
+				for (unsigned component = 0; component < 3; ++component)
+					vert[component] = (vert[component] + offset[component]) * scale;
+			}
 		}
 
-		if (optOutOffset)
+		const Kernels& Select()
 		{
-			_mm_maskstore_ps(optOutOffset, vertMask, offset);
+			static const Kernels SCALAR = { &Bounds_Scalar, &Transform_Scalar, "scalar" };
+			static const Kernels AVX2 = { &Bounds_Avx2, &Transform_Avx2, "avx2" };
+			static const Kernels AVX512 = { &Bounds_Avx512, &Transform_Avx512, "avx512" };
+			static const Kernels& selected = cpu::SupportsAvx512() ? AVX512 : cpu::SupportsAvx2() ? AVX2 : SCALAR;
+
+			return selected;
 		}
 	}
 
-	float Normalize(float* inoutVerts, unsigned vertCount)
+	void Recenter(float* inoutVerts, unsigned vertCount, const float* optCenter, float* optOutOffset, const TransformOptions& options)
 	{
-		const __m128i vertMask = _mm_set_epi32(-1, -1, -1, 0);
-		const __m128 posMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFF));
-		__m128 mins;
-		__m128 maxs;
+		const unsigned threadCount = transform::ThreadCount(vertCount, options);
+		const kernels::Bounds bounds = transform::MeshBounds(inoutVerts, vertCount, threadCount);
+		float offset[3];
 
-		MeshBounds(inoutVerts, vertCount, &mins, &maxs);
+		transform::CenterOffset(bounds, optCenter, offset);
+		transform::Transform(inoutVerts, vertCount, offset, 1.0f, threadCount);
 
-		const __m128 absMax = _mm_max_ps(_mm_or_ps(mins, posMask), _mm_or_ps(maxs, posMask));
-		const float radius = std::max(absMax.m128_f32[0], std::max(absMax.m128_f32[1], absMax.m128_f32[2]));
-		const __m128 invRadius = _mm_set1_ps(1.0f / radius);
+		if (optOutOffset)
+			std::copy(offset, offset + 3, optOutOffset);
+	}
 
-		for (unsigned vertIndex = 0; vertIndex < vertCount; ++vertIndex)
-		{
-			float* const vertPtr = inoutVerts + (vertIndex * 3);
-			const __m128 vert = _mm_maskload_ps(vertPtr, vertMask);
-			const __m128 scaledVert = _mm_mul_ps(vert, invRadius);
+	float Normalize(float* inoutVerts, unsigned vertCount, const TransformOptions& options)
+	{
+		static const float NO_OFFSET[3] = { 0.0f, 0.0f, 0.0f };
+		const unsigned threadCount = transform::ThreadCount(vertCount, options);
+		const kernels::Bounds bounds = transform::MeshBounds(inoutVerts, vertCount, threadCount);
+		const float radius = transform::Radius(bounds, NO_OFFSET);
 
-			_mm_maskstore_ps(vertPtr, vertMask, scaledVert);
-		}
+		transform::Transform(inoutVerts, vertCount, NO_OFFSET, 1.0f / radius, threadCount);
 
 		return radius;
 	}
 
-	
+	float RecenterNormalize(float* inoutVerts, unsigned vertCount, const float* optCenter, float* optOutOffset, const TransformOptions& options)
+	{
+		const unsigned threadCount = transform::ThreadCount(vertCount, options);
+		const kernels::Bounds bounds = transform::MeshBounds(inoutVerts, vertCount, threadCount);
+		float offset[3];
+
+		transform::CenterOffset(bounds, optCenter, offset);
+
+		const float radius = transform::Radius(bounds, offset);
+
+		transform::Transform(inoutVerts, vertCount, offset, 1.0f / radius, threadCount);
+
+		if (optOutOffset)
+			std::copy(offset, offset + 3, optOutOffset);
+
+		return radius;
+	}
 }
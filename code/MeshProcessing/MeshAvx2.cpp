@@ -0,0 +1,102 @@
+#include <cstddef>
+#include <immintrin.h>
+#include "MeshKernels.h"
+
+// Built with AVX2 enabled. Only reached through kernels::Select on CPUs that support it.
+namespace
+{
+	// 8 packed verts span 3 registers; lane i of register r holds component (r * 8 + i) % 3.
+	static constexpr unsigned BLOCK_VERTS = 8;
+	static constexpr unsigned BLOCK_FLOATS = BLOCK_VERTS * 3;
+}
+
+namespace mesh
+{
+	namespace kernels
+	{
+		void Bounds_Avx2(const float* verts, unsigned vertCount, Bounds* inoutBounds)
+		{
+			const unsigned blockCount = vertCount / BLOCK_VERTS;
+			__m256 mins[3];
+			__m256 maxs[3];
+
+			for (unsigned reg = 0; reg < 3; ++reg)
+			{
+				alignas(32) float seedMins[BLOCK_FLOATS];
+				alignas(32) float seedMaxs[BLOCK_FLOATS];
+
+				for (unsigned lane = 0; lane < BLOCK_FLOATS; ++lane)
+				{
+					seedMins[lane] = inoutBounds->mins[lane % 3];
+					seedMaxs[lane] = inoutBounds->maxs[lane % 3];
+				}
+
+				mins[reg] = _mm256_load_ps(seedMins + reg * 8);
+				maxs[reg] = _mm256_load_ps(seedMaxs + reg * 8);
+			}
+
+			for (unsigned blockIndex = 0; blockIndex < blockCount; ++blockIndex)
+			{
+				const float* const blockPtr = verts + static_cast<size_t>(blockIndex) * BLOCK_FLOATS;
+
+				for (unsigned reg = 0; reg < 3; ++reg)
+				{
+					const __m256 values = _mm256_loadu_ps(blockPtr + reg * 8);
+
+					mins[reg] = _mm256_min_ps(mins[reg], values);
+					maxs[reg] = _mm256_max_ps(maxs[reg], values);
+				}
+			}
+
+			alignas(32) float laneMins[BLOCK_FLOATS];
+			alignas(32) float laneMaxs[BLOCK_FLOATS];
+
+			for (unsigned reg = 0; reg < 3; ++reg)
+			{
+				_mm256_store_ps(laneMins + reg * 8, mins[reg]);
+				_mm256_store_ps(laneMaxs + reg * 8, maxs[reg]);
+			}
+
+			for (unsigned lane = 0; lane < BLOCK_FLOATS; ++lane)
+			{
+				const unsigned component = lane % 3;
+
+				inoutBounds->mins[component] = laneMins[lane] < inoutBounds->mins[component] ? laneMins[lane] : inoutBounds->mins[component];
+				inoutBounds->maxs[component] = laneMaxs[lane] > inoutBounds->maxs[component] ? laneMaxs[lane] : inoutBounds->maxs[component];
+			}
+
+			Bounds_Scalar(verts + static_cast<size_t>(blockCount) * BLOCK_FLOATS, vertCount - blockCount * BLOCK_VERTS, inoutBounds);
+		}
+
+		void Transform_Avx2(float* inoutVerts, unsigned vertCount, const float* offset, float scale)
+		{
+			const unsigned blockCount = vertCount / BLOCK_VERTS;
+			const __m256 scales = _mm256_set1_ps(scale);
+			__m256 offsets[3];
+
+			{
+				alignas(32) float laneOffsets[BLOCK_FLOATS];
+
+				for (unsigned lane = 0; lane < BLOCK_FLOATS; ++lane)
+					laneOffsets[lane] = offset[lane % 3];
+
+				for (unsigned reg = 0; reg < 3; ++reg)
+					offsets[reg] = _mm256_load_ps(laneOffsets + reg * 8);
+			}
+
+			for (unsigned blockIndex = 0; blockIndex < blockCount; ++blockIndex)
+			{
+				float* const blockPtr = inoutVerts + static_cast<size_t>(blockIndex) * BLOCK_FLOATS;
+
+				for (unsigned reg = 0; reg < 3; ++reg)
+				{
+					const __m256 values = _mm256_loadu_ps(blockPtr + reg * 8);
+
+					_mm256_storeu_ps(blockPtr + reg * 8, _mm256_mul_ps(_mm256_add_ps(values, offsets[reg]), scales));
+				}
+			}
+
+			Transform_Scalar(inoutVerts + static_cast<size_t>(blockCount) * BLOCK_FLOATS, vertCount - blockCount * BLOCK_VERTS, offset, scale);
+		}
+	}
+}
@@ -0,0 +1,105 @@
+#include <cstddef>
+#include <immintrin.h>
+#include "MeshKernels.h"
+
+// Built with AVX-512F enabled. Only reached through kernels::Select on CPUs that support it.
+namespace
+{
+	// 16 packed verts span 3 registers; lane i of register r holds component (r * 16 + i) % 3.
+	static constexpr unsigned BLOCK_VERTS = 16;
+	static constexpr unsigned BLOCK_FLOATS = BLOCK_VERTS * 3;
+	static constexpr __mmask16 ALL_LANES = 0xFFFF;
+}
+
+namespace mesh
+{
+	namespace kernels
+	{
+		void Bounds_Avx512(const float* verts, unsigned vertCount, Bounds* inoutBounds)
+		{
+			const unsigned blockCount = vertCount / BLOCK_VERTS;
+			__m512 mins[3];
+			__m512 maxs[3];
+
+			for (unsigned reg = 0; reg < 3; ++reg)
+			{
+				alignas(64) float seedMins[BLOCK_FLOATS];
+				alignas(64) float seedMaxs[BLOCK_FLOATS];
+
+				for (unsigned lane = 0; lane < BLOCK_FLOATS; ++lane)
+				{
+					seedMins[lane] = inoutBounds->mins[lane % 3];
+					seedMaxs[lane] = inoutBounds->maxs[lane % 3];
+				}
+
+				mins[reg] = _mm512_load_ps(seedMins + reg * 16);
+				maxs[reg] = _mm512_load_ps(seedMaxs + reg * 16);
+			}
+
+			for (unsigned blockIndex = 0; blockIndex < blockCount; ++blockIndex)
+			{
+				const float* const blockPtr = verts + static_cast<size_t>(blockIndex) * BLOCK_FLOATS;
+
+				for (unsigned reg = 0; reg < 3; ++reg)
+				{
+					const __m512 values = _mm512_loadu_ps(blockPtr + reg * 16);
+
+					// The masked forms take an explicit source. GCC's unmasked ones pass an undefined register that
+					// -Wmaybe-uninitialized flags.
+					mins[reg] = _mm512_mask_min_ps(mins[reg], ALL_LANES, mins[reg], values);
+					maxs[reg] = _mm512_mask_max_ps(maxs[reg], ALL_LANES, maxs[reg], values);
+				}
+			}
+
+			alignas(64) float laneMins[BLOCK_FLOATS];
+			alignas(64) float laneMaxs[BLOCK_FLOATS];
+
+			for (unsigned reg = 0; reg < 3; ++reg)
+			{
+				_mm512_store_ps(laneMins + reg * 16, mins[reg]);
+				_mm512_store_ps(laneMaxs + reg * 16, maxs[reg]);
+			}
+
+			for (unsigned lane = 0; lane < BLOCK_FLOATS; ++lane)
+			{
+				const unsigned component = lane % 3;
+
+				inoutBounds->mins[component] = laneMins[lane] < inoutBounds->mins[component] ? laneMins[lane] : inoutBounds->mins[component];
+				inoutBounds->maxs[component] = laneMaxs[lane] > inoutBounds->maxs[component] ? laneMaxs[lane] : inoutBounds->maxs[component];
+			}
+
+			Bounds_Scalar(verts + static_cast<size_t>(blockCount) * BLOCK_FLOATS, vertCount - blockCount * BLOCK_VERTS, inoutBounds);
+		}
+
+		void Transform_Avx512(float* inoutVerts, unsigned vertCount, const float* offset, float scale)
+		{
+			const unsigned blockCount = vertCount / BLOCK_VERTS;
+			const __m512 scales = _mm512_set1_ps(scale);
+			__m512 offsets[3];
+
+			{
+				alignas(64) float laneOffsets[BLOCK_FLOATS];
+
+				for (unsigned lane = 0; lane < BLOCK_FLOATS; ++lane)
+					laneOffsets[lane] = offset[lane % 3];
+
+				for (unsigned reg = 0; reg < 3; ++reg)
+					offsets[reg] = _mm512_load_ps(laneOffsets + reg * 16);
+			}
+
+			for (unsigned blockIndex = 0; blockIndex < blockCount; ++blockIndex)
+			{
+				float* const blockPtr = inoutVerts + static_cast<size_t>(blockIndex) * BLOCK_FLOATS;
+
+				for (unsigned reg = 0; reg < 3; ++reg)
+				{
+					const __m512 values = _mm512_loadu_ps(blockPtr + reg * 16);
+
+					_mm512_storeu_ps(blockPtr + reg * 16, _mm512_mul_ps(_mm512_add_ps(values, offsets[reg]), scales));
+				}
+			}
+
+			Transform_Scalar(inoutVerts + static_cast<size_t>(blockCount) * BLOCK_FLOATS, vertCount - blockCount * BLOCK_VERTS, offset, scale);
+		}
+	}
+}
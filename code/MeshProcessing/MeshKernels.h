@@ -0,0 +1,41 @@
+#pragma once
+
+// Vertex stream kernels over packed xyz floats. Each instruction set lives in its own translation unit so only that
+// file is built with the wider target flags; Mesh.cpp picks one at runtime. Every path does the same per component
+// float operations, so results are bit identical whichever kernel runs.
+namespace mesh
+{
+	namespace kernels
+	{
+		struct Bounds
+		{
+			float mins[3];
+			float maxs[3];
+		};
+
+		// Grows inoutBounds to contain the verts.
+		typedef void (*BoundsFn)(const float* verts, unsigned vertCount, Bounds* inoutBounds);
+
+		// Applies vert = (vert + offset) * scale.
+		typedef void (*TransformFn)(float* inoutVerts, unsigned vertCount, const float* offset, float scale);
+
+		struct Kernels
+		{
+			BoundsFn bounds;
+			TransformFn transform;
+			const char* name;
+		};
+
+		void Bounds_Scalar(const float* verts, unsigned vertCount, Bounds* inoutBounds);
+		void Transform_Scalar(float* inoutVerts, unsigned vertCount, const float* offset, float scale);
+
+		void Bounds_Avx2(const float* verts, unsigned vertCount, Bounds* inoutBounds);
+		void Transform_Avx2(float* inoutVerts, unsigned vertCount, const float* offset, float scale);
+
+		void Bounds_Avx512(const float* verts, unsigned vertCount, Bounds* inoutBounds);
+		void Transform_Avx512(float* inoutVerts, unsigned vertCount, const float* offset, float scale);
+
+		// Widest kernels the running CPU and OS support. Resolved once.
+		const Kernels& Select();
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "HalfEdge.h"
+
+// Per face and per vert geometry of a half edge topology: normals, areas and the discrete curvatures of Meyer et al.,
+// "Discrete Differential-Geometry Operators for Triangulated 2-Manifolds". Faces are evaluated four at a time, each
+// writing only its own face and its own half edges, then every vert sums what its fan's half edges hold, so no two
+// threads ever write the same slot.
+namespace mesh
+{
+	namespace half_edge
+	{
+		enum AttributeFlags : uint32_t
+		{
+			ATTRIBUTE_FACE_NORMALS = 1 << 0,
+			ATTRIBUTE_FACE_AREAS = 1 << 1,
+			ATTRIBUTE_VERT_NORMALS = 1 << 2,
+			ATTRIBUTE_VERT_AREAS = 1 << 3,
+			ATTRIBUTE_MEAN_CURVATURE = 1 << 4,
+			ATTRIBUTE_GAUSSIAN_CURVATURE = 1 << 5,
+			ATTRIBUTE_ALL = (1 << 6) - 1
+		};
+
+		// Only the requested arrays are filled, the others are left empty. Face arrays are indexed by real face and vert
+		// arrays by topology vert, so each fan of a split vert gets its own values. Deleted faces and verts get zeros.
+		struct Attributes
+		{
+			std::vector<float> faceNormals; // Packed xyz, unit length, 0 for degenerate faces
+			std::vector<float> faceAreas;
+			std::vector<float> vertNormals; // Packed xyz, unit length sum of the fan's face normals weighted by area
+			std::vector<float> vertAreas; // Mixed Voronoi area. Summed over verts it gives the total surface area
+			std::vector<float> meanCurvature; // Positive where the surface bends away from its normals, as on a sphere
+			std::vector<float> gaussianCurvature; // Angle defect over vert area
+		};
+
+		struct AttributeOptions
+		{
+			unsigned threadCount = 1; // 0 uses every hardware thread. The result is identical for any thread count.
+
+			// Computes every requested attribute in one pass over the faces and one over the verts. Off, each attribute
+			// runs its own passes, as separate calls per attribute would. Both give identical results.
+			bool fused = true;
+		};
+
+		// positions are packed xyz indexed by Vert::realIndex, the positions the topology was constructed from. flags
+		// combines AttributeFlags. Curvatures are 0 on boundary verts and verts without area. Instantiated for Topology
+		// and Topology64.
+		template<typename IdT>
+		void ComputeAttributes(const TopologyT<IdT>& mesh, const float* positions, uint32_t flags, Attributes* outAttributes, const AttributeOptions& options = AttributeOptions());
+	}
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cfloat>
+#include <cstdint>
+#include <vector>
+
+// Bounding volume hierarchy over the packed xyz verts and index buffer taken by Recenter and Normalize. The buffers
+// are referenced, not copied, and must outlive the Bvh and stay unchanged while it is queried. Face ids are triangle
+// indices into the index buffer, which half_edge::Construct keeps as real face indices, so a hit's face can be used
+// on a topology built from the same indices as long as it has not been reordered or edited since.
+namespace mesh
+{
+	static const unsigned BVH_NO_FACE = ~0u;
+
+	// Four children per node with their boxes stored per axis, so one SSE test covers all of them. Children are inner
+	// nodes when faceCounts is 0, leaves holding Bvh::faces[children] onward otherwise. Unused slots hold inverted
+	// boxes that no ray or point query reaches.
+	struct alignas(64) BvhNode
+	{
+		float bounds[6][4]; // minX, minY, minZ, maxX, maxY, maxZ for each child
+		unsigned children[4];
+		unsigned faceCounts[4];
+	};
+
+	struct Bvh
+	{
+		std::vector<BvhNode> nodes; // Root first, empty for a mesh without triangles
+		std::vector<unsigned> faces; // Face ids in leaf order
+		const float* verts = nullptr;
+		const unsigned* indices = nullptr;
+	};
+
+	struct BvhOptions
+	{
+		unsigned maxLeafFaces = 4; // 1 to 16
+		unsigned threadCount = 1; // 0 uses every hardware thread. The result is identical for any thread count.
+	};
+
+	// Binned SAH build. Subtrees are built in parallel once the top levels have split the faces finely enough.
+	void BuildBvh(const float* verts, const unsigned* indices, unsigned triCount, Bvh* outBvh, const BvhOptions& options = BvhOptions());
+
+	struct Ray
+	{
+		float origin[3];
+		float dir[3]; // Need not be normalized, t is measured in lengths of dir
+		float tMin = 0.0f;
+		float tMax = FLT_MAX;
+	};
+
+	struct RayHit
+	{
+		unsigned face = BVH_NO_FACE;
+		float t = FLT_MAX;
+		float u = 0.0f, v = 0.0f; // Barycentric weights of the face's second and third vert
+	};
+
+	struct ClosestPoint
+	{
+		unsigned face = BVH_NO_FACE;
+		float point[3] = {};
+		float distanceSquared = FLT_MAX;
+	};
+
+	// Nearest hit within [tMin, tMax], from either side of the faces.
+	bool Intersect(const Bvh& bvh, const Ray& ray, RayHit* outHit);
+
+	// Stops at the first hit found within [tMin, tMax]. Cheaper than Intersect for shadow and visibility rays.
+	bool Occluded(const Bvh& bvh, const Ray& ray);
+
+	// Nearest point on the surface within maxDistance of point.
+	bool FindClosestPoint(const Bvh& bvh, const float* point, ClosestPoint* outClosest, float maxDistance = FLT_MAX);
+
+	struct BvhQueryOptions
+	{
+		unsigned threadCount = 1; // 0 uses every hardware thread
+	};
+
+	// Batched forms of the above, spreading the queries over threads. Misses leave the defaults in outHits and
+	// outClosest, outOccluded gets 1 for occluded rays and 0 otherwise. points are packed xyz.
+	void Intersect(const Bvh& bvh, const Ray* rays, unsigned rayCount, RayHit* outHits, const BvhQueryOptions& options = BvhQueryOptions());
+	void Occluded(const Bvh& bvh, const Ray* rays, unsigned rayCount, uint8_t* outOccluded, const BvhQueryOptions& options = BvhQueryOptions());
+	void FindClosestPoints(const Bvh& bvh, const float* points, unsigned pointCount, ClosestPoint* outClosest, float maxDistance = FLT_MAX, const BvhQueryOptions& options = BvhQueryOptions());
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+#include "HalfEdge.h"
+
+// Connected components of a half edge topology and the holes in each. Verts are joined across every edge with a lock
+// free union find, linking the higher root under the lower, so every component ends up rooted at its lowest vert
+// whatever order the threads link in.
+namespace mesh
+{
+	namespace half_edge
+	{
+		static const unsigned COMPONENT_NONE = ~0u;
+
+		struct ComponentInfo
+		{
+			unsigned vertCount = 0;
+			unsigned edgeCount = 0;
+			unsigned faceCount = 0; // Real faces
+			unsigned boundaryCount = 0; // Boundary loops
+			int eulerCharacteristic = 0; // verts - edges + faces, which is 2 - 2 genus - boundaryCount
+			unsigned genus = 0;
+		};
+
+		// Components are edge connected over topology verts, so the fans of a split vert that only meet at it end up in
+		// separate components. They are numbered in order of their lowest vert. Deleted elements get COMPONENT_NONE.
+		struct Components
+		{
+			std::vector<unsigned> vertComponents;
+			std::vector<unsigned> faceComponents; // Real faces
+			std::vector<ComponentInfo> components;
+			std::vector<unsigned> boundaryComponents; // Component of each FaceType::BOUNDARY face
+			std::vector<unsigned> boundaryLengths; // Half edge count of each FaceType::BOUNDARY face's loop
+		};
+
+		struct ComponentOptions
+		{
+			unsigned threadCount = 1; // 0 uses every hardware thread. The result is identical for any thread count.
+		};
+
+		// Instantiated for Topology and Topology64.
+		template<typename IdT>
+		void FindComponents(const TopologyT<IdT>& mesh, Components* outComponents, const ComponentOptions& options = ComponentOptions());
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cfloat>
+#include <vector>
+#include "HalfEdge.h"
+
+// Quadric error edge collapse on half_edge::Topology. Every collapse goes through CollapseEdge, so the result stays
+// manifold, and boundary loops are held in place by extra planes along their edges.
+namespace mesh
+{
+	namespace half_edge
+	{
+		struct DecimateOptions
+		{
+			// 0 uses every hardware thread. Threads first decimate independent patches, then one thread finishes along the
+			// patch seams, so results differ between thread counts but are identical for a given count.
+			unsigned threadCount = 1;
+			float maxError = FLT_MAX; // Stops before a collapse whose area weighted squared distance error exceeds this
+			float boundaryWeight = 10.0f; // Weight of the planes keeping boundary edges in place
+			bool lockBoundary = false; // Boundary verts never move. Interior verts can still collapse onto them
+		};
+
+		// Self-contained: mesh and positions can be passed on to anything taking a topology and its positions.
+		struct Lod
+		{
+			Topology mesh; // Compacted, with each Vert::realIndex set to the vert itself
+			std::vector<float> positions; // Packed xyz for each mesh vert
+			std::vector<unsigned> sourceVerts; // realIndex of the input vert that survived as each mesh vert. It may have moved
+			float error = 0.0f; // Largest collapse error spent reaching this level
+		};
+
+		// positions are packed xyz indexed by Vert::realIndex, the positions the topology was constructed from. Stops
+		// early if no valid collapse below maxError remains.
+		void Decimate(const Topology& mesh, const float* positions, unsigned targetTris, Lod* outLod, const DecimateOptions& options = DecimateOptions());
+
+		// Builds a LOD chain in one pass: each level continues from the previous one, with the quadrics it gathered.
+		// targetTris must be decreasing.
+		void DecimateLods(const Topology& mesh, const float* positions, const unsigned* targetTris, unsigned lodCount, std::vector<Lod>* outLods, const DecimateOptions& options = DecimateOptions());
+	}
+}
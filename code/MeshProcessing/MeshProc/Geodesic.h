@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+#include "HalfEdge.h"
+#include "Laplacian.h"
+
+// Geodesic distances by the heat method of Crane et al., "Geodesics in Heat". Heat diffused from the sources for a
+// short time is solved with the factored (M + t L), its normalized gradient gives the direction distance grows in,
+// and the Poisson solve with L recovers distances from that field. Both operators are factored once per mesh, so a
+// query costs two sets of triangular solves and one pass over the faces.
+namespace mesh
+{
+	namespace half_edge
+	{
+		static const unsigned GEODESIC_LANES = 4;
+
+		// Four faces in SIMD lanes. basis holds N x e for each corner's opposite edge e, whose sum weighted by the corner
+		// values is the face gradient scaled by twice the area.
+		struct alignas(16) GeodesicFaceBlock
+		{
+			float basis[3][3][GEODESIC_LANES]; // corner, component, lane
+			unsigned verts[3][GEODESIC_LANES];
+		};
+
+		struct GeodesicSolver
+		{
+			LaplacianSolver heat; // M + t L
+			LaplacianSolver poisson; // L, shifted by a vanishing multiple of M to make it definite
+			std::vector<GeodesicFaceBlock> faceBlocks; // Lanes past the last face and deleted faces hold zero basis
+			std::vector<unsigned> vertCornerStarts; // Range of vertCorners for each vert, vertCount + 1 of them
+			std::vector<unsigned> vertCorners; // face * 3 + corner of each face corner on the vert
+			unsigned faceCount = 0;
+			unsigned vertCount = 0;
+			double time = 0.0; // t, the diffusion time
+		};
+
+		struct GeodesicOptions
+		{
+			double timeScale = 1.0; // t is this times the mean squared edge length. Larger smooths distances out
+			unsigned threadCount = 1; // 0 uses every hardware thread. The result is identical for any thread count.
+		};
+
+		// Builds and factors both operators. positions are packed xyz indexed by Vert::realIndex. The solver holds no
+		// reference to mesh or positions. Fails where FactorLaplacian does. Instantiated for Topology and Topology64.
+		template<typename IdT>
+		bool PrepareGeodesics(const TopologyT<IdT>& mesh, const float* positions, GeodesicSolver* outSolver, const GeodesicOptions& options = GeodesicOptions());
+
+		struct GeodesicQueryOptions
+		{
+			unsigned threadCount = 1; // 0 uses every hardware thread. The result is identical for any thread count.
+		};
+
+		// Distance from every vert to the nearest of sourceVerts, which are topology verts. Sources get distance 0 on
+		// average. Heat decays exponentially with distance, so on meshes hundreds of edges across, verts far enough from
+		// every source that the heat underflows get no direction and their distance comes out smoothed.
+		void ComputeGeodesics(const GeodesicSolver& solver, const unsigned* sourceVerts, unsigned sourceCount, float* outDistances, const GeodesicQueryOptions& options = GeodesicQueryOptions());
+
+		// Batched form of the above for setCount independent source sets, set s holding sourceVerts[setStarts[s]] up to
+		// sourceVerts[setStarts[s + 1]]. outDistances receives vertCount distances per set, one set after another. The
+		// triangular solves for the sets are spread over threads.
+		void ComputeGeodesics(const GeodesicSolver& solver, const unsigned* sourceVerts, const unsigned* setStarts, unsigned setCount, float* outDistances, const GeodesicQueryOptions& options = GeodesicQueryOptions());
+	}
+}
@@ -1,20 +1,34 @@
 #pragma once
 
+#include <cstdint>
 #include <vector>
 
+// Construct fills ConstructOptions::optOutStats only when the library is built with MESHPROC_CONSTRUCT_STATS set to 1.
+// Otherwise the instrumentation is compiled out and the stats are left untouched.
+#ifndef MESHPROC_CONSTRUCT_STATS
+#define MESHPROC_CONSTRUCT_STATS 0
+#endif
+
 namespace mesh
 {
+	struct TopologyBuilder;
+
 	namespace half_edge
 	{
-		union Vert
+		// Topologies are templated on the width of their packed ids. Topology keeps the compact 32 bit layout, with 24 bit
+		// realIndex and 31 bit face indices. Topology64 widens realIndex to 56 bits, for meshes over 16M verts, at the
+		// cost of 4 more bytes per vert. Only realIndex grows: vert, face and half edge pointers stay 32 bit, as do the
+		// index buffer and triCount, so Construct fails on meshes whose corners or half edges overflow them.
+		template<typename IdT>
+		union VertT
 		{
 			struct
 			{
-				uint32_t realIndex : 24;
-				uint32_t splitIndex : 8;
+				IdT realIndex : sizeof(IdT) * 8 - 8;
+				IdT splitIndex : 8;
 			};
 
-			uint32_t id;
+			IdT id;
 		};
 
 		enum FaceType : uint32_t
@@ -24,16 +38,18 @@ namespace mesh
 			COUNT
 		};
 
+		// 32 bit for either id width, as faces are numbered with 32 bit ids
 		struct FaceIndex
 		{
 			uint32_t index : 31;
-			FaceType type : 1;
+			uint32_t type : 1; // FaceType
 		};
 
-		struct Topology
+		template<typename IdT>
+		struct TopologyT
 		{
 			std::vector<unsigned> vertHalfEdges; // Half edge pointer for each vert
-			std::vector<Vert> verts; // Vert list. Holds original and split id
+			std::vector<VertT<IdT>> verts; // Vert list. Holds original and split id
 
 			std::vector<unsigned> faceHalfEdges[FaceType::COUNT]; // First half edge pointer for each face. Each boundary only has 1 face
 
@@ -46,8 +62,104 @@ namespace mesh
 			// Note: edge * 2 == halfEdge
 		};
 
+		using Vert = VertT<uint32_t>;
+		using Topology = TopologyT<uint32_t>;
+
+		using Vert64 = VertT<uint64_t>;
+		using Topology64 = TopologyT<uint64_t>;
+
+		enum ValidateLevel : uint32_t
+		{
+			VALIDATE_NONE,
+			VALIDATE_STRUCTURE, // Every pointer is in range and agrees with its neighbors. One linear pass
+			VALIDATE_FULL // Also every face loop closes at a valid length and no vert is left with a second fan
+		};
+
+		enum ValidateError : uint32_t
+		{
+			VALID,
+			BAD_SIZE, // Arrays that should match in size do not
+			BAD_INDEX, // A pointer is out of range
+			BROKEN_LINK, // A pointer disagrees with its neighbors, or an edge has no real face
+			BAD_LOOP, // A real face is not a triangle, or a boundary loop does not close or is shorter than 3
+			SINGULAR_VERT // A vert has half edges outside the fan its vertHalfEdges entry rotates through
+		};
+
+		struct ValidateReport
+		{
+			ValidateError error = ValidateError::VALID;
+			unsigned element = ~0u; // The vert, face, boundary or half edge the check failed on, as message says
+			const char* message = "";
+		};
+
+		struct ValidateOptions
+		{
+			ValidateLevel level = ValidateLevel::VALIDATE_FULL;
+			unsigned threadCount = 1; // 0 uses every hardware thread. The same first failure is reported for any thread count.
+		};
+
+		static constexpr bool CONSTRUCT_STATS_ENABLED = MESHPROC_CONSTRUCT_STATS != 0;
+
+		enum ConstructPhase : uint32_t
+		{
+			CONSTRUCT_REMAP, // Input indices to dense verts
+			CONSTRUCT_PAIR, // Corners paired across edges and edges numbered
+			CONSTRUCT_LINK, // Real faces linked into half edges
+			CONSTRUCT_BOUNDARY, // Unpaired half edges linked into boundary loops
+			CONSTRUCT_SPLIT, // Singular verts split into one vert per fan
+			CONSTRUCT_VALIDATE,
+			CONSTRUCT_PHASE_COUNT
+		};
+
+		static const char* const CONSTRUCT_PHASE_NAMES[CONSTRUCT_PHASE_COUNT] = { "remap", "pair", "link", "boundary", "split", "validate" };
+
+		// What a Construct call spent its time and memory on, for tracking down slow assets. Pairing sorts each vert's
+		// edges rather than hashing them, so its probes are the insertion sort moves within a vert's bucket and its
+		// collisions are the buckets too long for insertion sort. Counts other than pairCoarseBuckets and
+		// pairMaxCoarseEdges are identical for any thread count.
+		struct ConstructStats
+		{
+			double phaseSeconds[CONSTRUCT_PHASE_COUNT] = {}; // Wall time, see ConstructPhase
+			double totalSeconds = 0.0;
+			unsigned threadCount = 0;
+			uint64_t indexRange = 0; // Slots in the input index to vert map, one past the largest index. 0 when sorted as sparse
+			unsigned vertCount = 0; // Before splitting
+			unsigned edgeCount = 0;
+			uint64_t pairShifts = 0; // Edges moved while insertion sorting the edges of each lower vert
+			unsigned pairSortedBuckets = 0; // Lower verts with too many edges for insertion sort, sorted with std::sort
+			unsigned pairMaxBucketEdges = 0; // Most edges on one lower vert
+			unsigned pairCoarseBuckets = 0; // Work items the lower vert range was cut into
+			unsigned pairMaxCoarseEdges = 0; // Edges in the largest work item
+			unsigned boundaryLoops = 0;
+			unsigned boundaryHalfEdges = 0;
+			unsigned boundaryMinLength = 0; // Half edges in the shortest loop, 0 without loops
+			unsigned boundaryMaxLength = 0;
+			unsigned splitFans = 0; // Fans moved to new verts
+			unsigned splitVerts = 0; // Verts that had fans moved off
+			uint64_t peakScratchBytes = 0; // Largest builder scratch and temporary maps held at the end of any phase
+		};
+
+		struct ConstructOptions
+		{
+			unsigned threadCount = 1; // 0 uses every hardware thread. The resulting topology is identical for any thread count.
+			ValidateLevel validate = ValidateLevel::VALIDATE_FULL; // Run on the result with threadCount threads
+			ValidateReport* optOutReport = nullptr; // Receives the failure when validation fails
+			ConstructStats* optOutStats = nullptr; // Receives the phase timings and counts, see MESHPROC_CONSTRUCT_STATS
+		};
+
+		// Builds the topology of an indexed triangle list. Singular verts are split. Input the topology can't hold fails
+		// rather than traps, with options.optOutReport filled: degenerate triangles and boundary loops shorter than 3 as
+		// BAD_LOOP, edges with a third triangle or with two running the same way as BROKEN_LINK, indices past realIndex
+		// as BAD_INDEX, with the input triangle as element. Instantiated for Topology and Topology64.
+		template<typename IdT>
+		bool Construct(const unsigned* indices, unsigned triCount, TopologyT<IdT>* outMesh, const ConstructOptions& options = ConstructOptions());
+
+		// Same as above, keeping scratch in builder and reusing the capacity of inoutMesh, see TopologyBuilder.h.
+		template<typename IdT>
+		bool Construct(TopologyBuilder* builder, const unsigned* indices, unsigned triCount, TopologyT<IdT>* inoutMesh, const ConstructOptions& options = ConstructOptions());
 
-		// Assumptions: manifold (singularities allowed), no lines (triangles with 2 identical points)
-		bool Construct(const unsigned* indices, unsigned triCount, Topology* outMesh);
+		// Never traps: a failing mesh is reported and false is returned. Meshes with deleted elements fail, see Compact.
+		template<typename IdT>
+		bool Validate(const TopologyT<IdT>& mesh, ValidateReport* optOutReport = nullptr, const ValidateOptions& options = ValidateOptions());
 	};
 }
\ No newline at end of file
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "HalfEdge.h"
+
+// Binary cache of half_edge::Topology. Every array is stored 64 byte aligned so a mapped cache is used in place,
+// without copying or re-validating the topology.
+namespace mesh
+{
+	namespace half_edge
+	{
+		template<typename T>
+		struct ArrayView
+		{
+			const T* data = nullptr;
+			size_t count = 0;
+
+			const T& operator[](size_t index) const { return data[index]; }
+			const T* begin() const { return data; }
+			const T* end() const { return data + count; }
+			size_t size() const { return count; }
+		};
+
+		// Read-only Topology, pointing into a Topology or a mapped cache file.
+		struct TopologyView
+		{
+			ArrayView<unsigned> vertHalfEdges;
+			ArrayView<Vert> verts;
+			ArrayView<unsigned> faceHalfEdges[FaceType::COUNT];
+			ArrayView<unsigned> halfEdgeVerts;
+			ArrayView<FaceIndex> halfEdgeFaces;
+			ArrayView<unsigned> halfEdgeNexts;
+		};
+
+		struct CacheOptions
+		{
+			// Hash the whole file on open to catch corrupt or partially written caches. Staleness is always checked
+			// against the source hash in the header, which costs nothing.
+			bool verifyChecksum = false;
+		};
+
+		// A cache mapped from disk, or a freshly built topology when the cache could not be written. Owns the mapping,
+		// so it moves but does not copy. Destroying it closes the cache.
+		struct CachedTopology
+		{
+			CachedTopology() = default;
+			~CachedTopology();
+			CachedTopology(const CachedTopology&) = delete;
+			CachedTopology& operator=(const CachedTopology&) = delete;
+			CachedTopology(CachedTopology&& other) noexcept;
+			CachedTopology& operator=(CachedTopology&& other) noexcept;
+
+			TopologyView view;
+			Topology built;
+			const void* mappedData = nullptr;
+			size_t mappedSize = 0;
+			void* mappedHandle = nullptr;
+		};
+
+		TopologyView View(const Topology& mesh);
+
+		// Identifies the index buffer a cache was built from. Topology only depends on the indices.
+		uint64_t HashSource(const unsigned* indices, unsigned triCount);
+
+		// Writes to a temporary file and renames it over path, so readers never see a partial cache.
+		bool WriteCache(const char* path, const Topology& mesh, uint64_t sourceHash);
+
+		// Fails when the file is missing, from another format version, built from another source or corrupt.
+		bool OpenCache(const char* path, uint64_t sourceHash, CachedTopology* outCache, const CacheOptions& options = CacheOptions());
+
+		// Opens the cache at path, rebuilding and rewriting it when it is missing or stale. Returns false only if
+		// construction fails.
+		bool LoadCache(const char* path, const unsigned* indices, unsigned triCount, CachedTopology* outCache, const ConstructOptions& constructOptions = ConstructOptions(), const CacheOptions& options = CacheOptions());
+
+		void CloseCache(CachedTopology* inoutCache);
+	}
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "HalfEdge.h"
+
+// Range-for walks over a half edge topology. They work on Topology and TopologyView alike and compile down to the
+// loop over halfEdgeNexts that would be written by hand:
+//
+//	for (unsigned halfEdge : VertRing(mesh, vert))
+//		neighbor = mesh.halfEdgeVerts[halfEdge ^ 1];
+namespace mesh
+{
+	namespace half_edge
+	{
+		// Steps with halfEdgeNexts[halfEdge ^ ROTATE] until back at the first half edge. A first half edge of
+		// ~0u, as deleted elements hold, gives an empty range.
+		template<typename MeshT, unsigned ROTATE>
+		struct HalfEdgeCirculator
+		{
+			// Only compared against end(). The stepped flag is known at the first test, so the compiler peels it off and
+			// leaves the do-while.
+			struct Iterator
+			{
+				const MeshT* mesh;
+				unsigned halfEdge;
+				unsigned first;
+				bool stepped;
+
+				unsigned operator*() const { return halfEdge; }
+				bool operator!=(const Iterator&) const { return !stepped || halfEdge != first; }
+
+				Iterator& operator++()
+				{
+					halfEdge = mesh->halfEdgeNexts[halfEdge ^ ROTATE];
+					stepped = true;
+					return *this;
+				}
+			};
+
+			const MeshT* mesh;
+			unsigned first;
+
+			Iterator begin() const { return Iterator{ mesh, first, first, first == ~0u }; }
+			Iterator end() const { return Iterator{ mesh, first, first, true }; }
+		};
+
+		// Half edges leaving vert, rotating through its fan. Their twins' verts are its one ring.
+		template<typename MeshT>
+		static inline HalfEdgeCirculator<MeshT, 1> VertRing(const MeshT& mesh, unsigned vert)
+		{
+			return HalfEdgeCirculator<MeshT, 1>{ &mesh, mesh.vertHalfEdges[vert] };
+		}
+
+		// Half edges leaving the vert halfEdge leaves, starting at halfEdge.
+		template<typename MeshT>
+		static inline HalfEdgeCirculator<MeshT, 1> RingFrom(const MeshT& mesh, unsigned halfEdge)
+		{
+			return HalfEdgeCirculator<MeshT, 1>{ &mesh, halfEdge };
+		}
+
+		// Half edges around the face, real or boundary, that halfEdge belongs to, starting at halfEdge.
+		template<typename MeshT>
+		static inline HalfEdgeCirculator<MeshT, 0> LoopFrom(const MeshT& mesh, unsigned halfEdge)
+		{
+			return HalfEdgeCirculator<MeshT, 0>{ &mesh, halfEdge };
+		}
+
+		template<typename MeshT>
+		static inline HalfEdgeCirculator<MeshT, 0> FaceLoop(const MeshT& mesh, unsigned face)
+		{
+			return HalfEdgeCirculator<MeshT, 0>{ &mesh, mesh.faceHalfEdges[FaceType::REAL][face] };
+		}
+
+		template<typename MeshT>
+		static inline HalfEdgeCirculator<MeshT, 0> BoundaryLoop(const MeshT& mesh, unsigned boundary)
+		{
+			return HalfEdgeCirculator<MeshT, 0>{ &mesh, mesh.faceHalfEdges[FaceType::BOUNDARY][boundary] };
+		}
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+#include "HalfEdge.h"
+
+// Local edits on a constructed half_edge::Topology. Each edit only touches the faces around the edited element, so it
+// costs O(1), or O(valence) where a vert fan has to be walked. Deleted edges, faces and verts keep their slots, marked
+// INVALID_INDEX, and are reused by later edits. Compact removes the remaining holes.
+namespace mesh
+{
+	namespace half_edge
+	{
+		static constexpr unsigned INVALID_INDEX = ~0u;
+
+		struct Editor
+		{
+			Topology* mesh = nullptr;
+			std::vector<unsigned> freeEdges; // Edge index, halfEdge / 2
+			std::vector<unsigned> freeFaces; // Real faces. Boundary faces are never deleted
+			std::vector<unsigned> freeVerts;
+			std::vector<unsigned> scratch; // Reused by CanCollapseEdge
+		};
+
+		// Picks up the holes left by earlier edits, which is O(n). Edits keep the free lists current afterwards.
+		void BeginEdit(Topology* mesh, Editor* outEditor);
+
+		// Turns the edge shared by two real triangles to join their opposite verts. Fails if that edge already exists.
+		bool FlipEdge(Editor* editor, unsigned halfEdge);
+
+		// Inserts a vert on the edge and splits the real triangles on either side. realIndex is stored on the new vert.
+		// Returns the new vert.
+		unsigned SplitEdge(Editor* editor, unsigned halfEdge, unsigned realIndex);
+
+		// Inserts a vert inside a real triangle, splitting it in three. Returns the new vert.
+		unsigned SplitFace(Editor* editor, unsigned face, unsigned realIndex);
+
+		// True when collapsing keeps the mesh manifold: the edge passes the link condition, no boundary gets pinched
+		// or closed, and no opposite vert drops below a valid valence.
+		bool CanCollapseEdge(Editor* editor, unsigned halfEdge);
+
+		// Merges the origin of halfEdge into its destination, deleting the origin vert, the edge and the real triangles
+		// on either side. Returns false, leaving the mesh untouched, if CanCollapseEdge fails.
+		bool CollapseEdge(Editor* editor, unsigned halfEdge);
+
+		// Removes every deleted slot in O(n), renumbering verts, faces and half edges in their existing order.
+		void Compact(Editor* editor);
+	}
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include "HalfEdge.h"
+
+// Renumbers a constructed topology so that neighbors sit close together in memory. Construct numbers half edges in
+// the order edges are first seen in the index buffer, so walks over a badly ordered input jump all over the arrays.
+namespace mesh
+{
+	namespace half_edge
+	{
+		enum ReorderMethod : uint32_t
+		{
+			BREADTH_FIRST, // Grows outward from vert 0 through one rings, one connected component after another
+			MORTON // Sorts verts along a Z order curve through their positions
+		};
+
+		struct ReorderOptions
+		{
+			ReorderMethod method = ReorderMethod::BREADTH_FIRST;
+			unsigned threadCount = 1; // 0 uses every hardware thread. The result is identical for any thread count.
+		};
+
+		// Verts are put in the chosen order, real faces in the order their first vert is reached and edges in the order
+		// their first face is reached. Twins stay paired, boundary faces keep their index and Vert::realIndex is kept,
+		// so gathering positions by realIndex into the new vert order makes them follow along.
+		// optPositions are packed xyz indexed by Vert::realIndex and only needed for MORTON. The mesh must not hold
+		// deleted elements, see Compact.
+		void Reorder(Topology* inoutMesh, const float* optPositions, const ReorderOptions& options = ReorderOptions());
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Index buffer reordering for drawing. Triangles are reordered for post-transform vertex cache hits, then verts are
+// renumbered in first use order so vertex fetches stream through memory. Indices are taken as Construct takes them.
+namespace mesh
+{
+	struct VertexCacheStats
+	{
+		float acmr = 0.0f; // Average cache miss ratio: transformed verts per triangle. 0.5 is the limit for large grids, 3 the worst case
+		float atvr = 0.0f; // Average transform to vert ratio: transformed verts per referenced vert. 1 is ideal
+	};
+
+	struct IndexOptimizeOptions
+	{
+		unsigned cacheSize = 16; // FIFO cache entries, both for optimizing and for the stats
+	};
+
+	struct IndexOptimizeReport
+	{
+		VertexCacheStats before;
+		VertexCacheStats after;
+		unsigned vertCount = 0; // Referenced verts, the size of the remapped vertex buffer
+	};
+
+	// Simulates a FIFO post-transform cache over the index buffer.
+	VertexCacheStats AnalyzeVertexCache(const unsigned* indices, unsigned triCount, unsigned cacheSize = 16);
+
+	// Reorders triangles with Tipsify (Sander et al. 2007), which runs in linear time. Vertex numbering is unchanged.
+	// outIndices must not overlap indices.
+	void OptimizeVertexCache(const unsigned* indices, unsigned triCount, unsigned* outIndices, const IndexOptimizeOptions& options = IndexOptimizeOptions());
+
+	// Renumbers verts in first use order. outVertRemap receives the new vert of each input index, ~0u where an index
+	// is unused. Returns the referenced vert count.
+	unsigned OptimizeVertexFetch(unsigned* inoutIndices, unsigned triCount, std::vector<unsigned>* outVertRemap);
+
+	// OptimizeVertexCache followed by OptimizeVertexFetch, reporting the cache stats before and after.
+	void OptimizeIndices(const unsigned* indices, unsigned triCount, unsigned* outIndices, std::vector<unsigned>* outVertRemap, IndexOptimizeReport* optOutReport = nullptr, const IndexOptimizeOptions& options = IndexOptimizeOptions());
+
+	// Moves each vert of vertSize bytes to its remapped slot. outVerts must hold the referenced vert count.
+	void RemapVertexData(const void* verts, size_t vertSize, const std::vector<unsigned>& vertRemap, void* outVerts);
+}
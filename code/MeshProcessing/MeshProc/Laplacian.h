@@ -0,0 +1,66 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "HalfEdge.h"
+
+// Cotangent Laplacian and lumped mass matrix of a half edge topology, and a Cholesky solver that keeps its work
+// between solves. Smoothing and fairing solve (massWeight * M + stiffnessWeight * L) x = b many times on one
+// connectivity: the sparsity pattern and its symbolic analysis only depend on the connectivity, the numeric factors
+// only on the positions, and each new right hand side only costs the back substitution.
+namespace mesh
+{
+	namespace half_edge
+	{
+		// Compressed column storage of a symmetric matrix, which is also its compressed row storage. Rows are sorted
+		// within each column and indices are int, so Eigen::Map<const Eigen::SparseMatrix<double>> can wrap it as is.
+		struct SparseMatrix
+		{
+			unsigned size = 0; // Rows and columns
+			std::vector<int> outerStarts; // First entry of each column, size + 1 of them
+			std::vector<int> innerIndices; // Row of each entry
+			std::vector<double> values;
+		};
+
+		struct LaplacianOptions
+		{
+			unsigned threadCount = 1; // 0 uses every hardware thread. The result is identical for any thread count.
+		};
+
+		// L is positive semidefinite, with L_ij = -(cot a + cot b) / 2 over the angles across edge ij, and L_ii making
+		// each column sum to 0. outMass is the lumped diagonal of M, a third of the area of each face around the vert.
+		// Rows and columns are topology verts and positions are packed xyz indexed by Vert::realIndex. Entries are
+		// written straight into their column, without sorting triplets. Instantiated for Topology and Topology64.
+		template<typename IdT>
+		void AssembleLaplacian(const TopologyT<IdT>& mesh, const float* positions, SparseMatrix* outLaplacian, std::vector<double>* outMass, const LaplacianOptions& options = LaplacianOptions());
+
+		struct CholeskyFactor;
+
+		// Keep one per topology. Moving is cheap, the factor is not copied.
+		struct LaplacianSolver
+		{
+			LaplacianSolver();
+			~LaplacianSolver();
+			LaplacianSolver(LaplacianSolver&&) noexcept;
+			LaplacianSolver& operator=(LaplacianSolver&&) noexcept;
+
+			std::vector<double> mass; // Lumped mass of the positions last factored
+			std::unique_ptr<CholeskyFactor> factor; // System pattern, fill reducing ordering and factors
+		};
+
+		// Builds the system pattern for mesh's connectivity and runs the symbolic analysis. Needed once per topology, and
+		// again after any edit to its connectivity.
+		template<typename IdT>
+		void AnalyzeLaplacian(const TopologyT<IdT>& mesh, LaplacianSolver* outSolver, const LaplacianOptions& options = LaplacianOptions());
+
+		// Refills the analyzed pattern with massWeight * M + stiffnessWeight * L for positions and refactors it
+		// numerically. mesh must have the connectivity the solver was analyzed with. massWeight must be positive, as L
+		// alone is singular. Fails on a zero pivot, as deleted or isolated verts give, see Compact.
+		template<typename IdT>
+		bool FactorLaplacian(const TopologyT<IdT>& mesh, const float* positions, double massWeight, double stiffnessWeight, LaplacianSolver* inoutSolver, const LaplacianOptions& options = LaplacianOptions());
+
+		// Solves the factored system for rhsCount right hand sides of one value per vert, stored one after another.
+		// Right hand sides are spread over threads.
+		void SolveLaplacian(const LaplacianSolver& solver, const double* rhs, unsigned rhsCount, double* outSolution, const LaplacianOptions& options = LaplacianOptions());
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vector>
+
+namespace mesh
+{
+	namespace io
+	{
+		// Both arrays are written once, in place, while the mapped file is parsed.
+		struct IndexedMesh
+		{
+			std::vector<float> positions; // Packed xyz, as Recenter and Normalize take them.
+			std::vector<unsigned> indices; // Three per triangle, as half_edge::Construct and tri_edge::Construct take them.
+
+			unsigned VertCount() const { return static_cast<unsigned>(positions.size() / 3); }
+			unsigned TriCount() const { return static_cast<unsigned>(indices.size() / 3); }
+		};
+
+		struct LoadOptions
+		{
+			unsigned threadCount = 1; // 0 uses every hardware thread. The loaded mesh is identical for any thread count.
+		};
+
+		// Loads binary PLY (either endianness) or OBJ, detected from the file contents. Polygons are fan triangulated.
+		// Only positions and face indices are read; other attributes are skipped. Returns false on IO errors, malformed
+		// files, out of range indices and meshes too large for 32 bit indices.
+		bool Load(const char* path, IndexedMesh* outMesh, const LoadOptions& options = LoadOptions());
+
+		bool LoadPly(const char* path, IndexedMesh* outMesh, const LoadOptions& options = LoadOptions());
+		bool LoadObj(const char* path, IndexedMesh* outMesh, const LoadOptions& options = LoadOptions());
+	}
+}
@@ -4,8 +4,17 @@
 
 namespace mesh
 {
-	void Recenter(float* inoutVerts, unsigned vertCount, const float* optCenter = nullptr, float* optOutOffset = nullptr);
-	float Normalize(float* inoutVerts, unsigned vertCount);
+	struct TransformOptions
+	{
+		unsigned threadCount = 1; // 0 uses every hardware thread. Results are identical for any thread count.
+	};
+
+	// Verts are packed xyz floats.
+	void Recenter(float* inoutVerts, unsigned vertCount, const float* optCenter = nullptr, float* optOutOffset = nullptr, const TransformOptions& options = TransformOptions());
+	float Normalize(float* inoutVerts, unsigned vertCount, const TransformOptions& options = TransformOptions());
+
+	// Recenter followed by Normalize, reading the verts once for bounds and writing them once. Returns the radius.
+	float RecenterNormalize(float* inoutVerts, unsigned vertCount, const float* optCenter = nullptr, float* optOutOffset = nullptr, const TransformOptions& options = TransformOptions());
 
 	
 }
\ No newline at end of file
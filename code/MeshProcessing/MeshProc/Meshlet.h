@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cfloat>
+#include <cstdint>
+#include <vector>
+#include "HalfEdge.h"
+
+// Meshlets for cluster based rendering: small runs of triangles with their own vert list, small enough for one mesh
+// shader workgroup, each with the bounds to cull it as a whole. Faces are sorted along a Morton curve and cut into
+// fixed chunks, and each chunk grows its meshlets over face adjacency on its own thread, so the meshlets only depend
+// on the mesh and never on the thread count.
+//
+// The optional hierarchy is built the way cluster LOD streaming expects it: neighboring meshlets are grouped, each
+// group is decimated to half its triangles with its outline locked, and the result is split into meshlets again, level
+// after level. Locked outlines keep every group crack free against its neighbors at any mix of levels.
+namespace mesh
+{
+	namespace half_edge
+	{
+		struct Meshlet
+		{
+			unsigned vertOffset = 0; // First entry in Meshlets::verts
+			unsigned vertCount = 0;
+			unsigned triOffset = 0; // First triangle in Meshlets::triangles, which holds 3 entries per triangle
+			unsigned triCount = 0;
+
+			// Bounding sphere of the verts
+			float center[3] = {};
+			float radius = 0.0f;
+
+			// Normal cone. Seen from a camera with dot(normalize(coneApex - camera), coneAxis) >= coneCutoff every
+			// triangle faces away. Meshlets whose normals spread too far get a zero axis and a cutoff of 1, never culled.
+			float coneApex[3] = {};
+			float coneAxis[3] = {};
+			float coneCutoff = 1.0f;
+
+			// Hierarchy. A meshlet is drawn where its own error projects below the threshold and its parent's does not.
+			// Level 0 meshlets have a zero error and their own bounds, and meshlets never simplified further have a
+			// parent error of FLT_MAX. Errors are approximate distances and never decrease from a meshlet to its parent.
+			unsigned level = 0;
+			float lodCenter[3] = {}; // Bounds of the group this meshlet was simplified from
+			float lodRadius = 0.0f;
+			float lodError = 0.0f;
+			float parentCenter[3] = {}; // Bounds of the group this meshlet was simplified into
+			float parentRadius = 0.0f;
+			float parentError = FLT_MAX;
+		};
+
+		struct Meshlets
+		{
+			std::vector<Meshlet> meshlets; // Level 0 first, then each level of the hierarchy in turn
+			std::vector<unsigned> levelStarts; // First meshlet of each level, levelCount + 1 of them
+			std::vector<unsigned> verts; // Vert::realIndex, or lodVertBase plus an index into lodPositions
+			std::vector<uint8_t> triangles; // Indices into the meshlet's own verts, 3 per triangle
+			std::vector<unsigned> faces; // Source real face of each level 0 triangle
+			std::vector<float> lodPositions; // Packed xyz of verts the hierarchy moved
+			unsigned lodVertBase = 0; // One past the largest Vert::realIndex of the mesh
+		};
+
+		struct MeshletOptions
+		{
+			unsigned maxVerts = 64; // At most 256
+			unsigned maxTris = 124; // At most 512
+			bool buildHierarchy = false;
+			unsigned groupSize = 8; // Meshlets decimated together per hierarchy group
+			unsigned maxLevels = 24; // Hierarchy levels on top of level 0
+			unsigned threadCount = 1; // 0 uses every hardware thread. The result is identical for any thread count.
+		};
+
+		// positions are packed xyz indexed by Vert::realIndex. Deleted faces are skipped. Meshlets only follow face
+		// adjacency and the Morton chunks, so disconnected parts never share a meshlet unless they interleave within one
+		// meshlet's extent. Instantiated for Topology and Topology64.
+		template<typename IdT>
+		void BuildMeshlets(const TopologyT<IdT>& mesh, const float* positions, Meshlets* outMeshlets, const MeshletOptions& options = MeshletOptions());
+	}
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Scratch kept between topology constructions. Passing the same builder and output topology to every Construct call
+// reuses their capacity, so once both have grown to the largest mesh seen, single threaded builds make no heap
+// allocations. Parallel builds still allocate their atomic maps and threads.
+namespace mesh
+{
+	struct TopologyBuilder
+	{
+		// Contents are meaningless between calls
+		std::vector<unsigned> cornerVerts; // Dense vert id for each corner
+		std::vector<unsigned> cornerPartners; // Reverse corner for each corner, see corners::PairCorners
+		std::vector<unsigned> cornerHalfEdges;
+		std::vector<unsigned> vertIndices; // Input index for each vert
+		std::vector<unsigned> indexVertMap; // Vert id for each input index
+		std::vector<unsigned> sliceCounts;
+		std::vector<unsigned> coarseStarts;
+		std::vector<unsigned> sliceCoarseStarts;
+		std::vector<std::vector<unsigned>> threadVertStarts;
+		std::vector<uint64_t> coarseEdges;
+		std::vector<uint64_t> workEdges;
+		std::vector<unsigned> loopSplitStarts;
+		std::vector<uint64_t> splitVerts; // Original vert above new vert
+		std::vector<unsigned> vertBoundaryCorners;
+	};
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "HalfEdge.h"
+#include "TriEdge.h"
+
+// Conversions between the two topologies without going back to indices. Edge pairs are read from the source's links,
+// so neither direction sorts or hashes, and each is linear in the mesh size. Verts keep their numbering and ids,
+// split verts included.
+namespace mesh
+{
+	struct ConvertOptions
+	{
+		unsigned threadCount = 1; // 0 uses every hardware thread. The result is identical for any thread count.
+	};
+
+	// Half edges, faces and boundaries are numbered as half_edge::Construct numbers them from the same triangles, so
+	// converting tri_edge::Construct's result matches half_edge::Construct's wherever neither split a vert.
+	void Convert(const tri_edge::Topology& mesh, half_edge::Topology* outMesh, const ConvertOptions& options = ConvertOptions());
+
+	// Each real face becomes the triangle starting at the half edge after its faceHalfEdges entry, which gives back the
+	// triangles half_edge::Construct was given. Boundary loops follow boundary face order. mesh must pass Validate.
+	void Convert(const half_edge::Topology& mesh, tri_edge::Topology* outMesh, const ConvertOptions& options = ConvertOptions());
+}
@@ -1,36 +1,44 @@
 #pragma once
 
+#include <cstdint>
 #include <vector>
+#include "HalfEdge.h"
 
 namespace mesh
 {
+	struct TopologyBuilder;
+
 	namespace tri_edge
 	{
-		union Vert
+		// Templated on the width of the packed ids like half_edge::TopologyT. Topology keeps the compact 32 bit layout
+		// with 24 bit realIndex and 2^30 triangles. Topology64 lifts both limits for meshes over 16M verts.
+		template<typename IdT>
+		union VertT
 		{
 			struct
 			{
-				uint32_t realIndex : 24;
-				uint32_t splitIndex : 8;
+				IdT realIndex : sizeof(IdT) * 8 - 8;
+				IdT splitIndex : 8;
 			};
 
-			uint32_t id;
+			IdT id;
 		};
 
-		union SharedEdge
+		template<typename IdT>
+		union SharedEdgeT
 		{
-			static const uint32_t NONE = ~0u;
-			static const uint32_t NO_TRIANGLE = (1u << 30) - 1;
-			static const uint32_t NO_EDGE = 0x3;
+			static const IdT NONE = ~IdT(0);
+			static const IdT NO_TRIANGLE = (IdT(1) << (sizeof(IdT) * 8 - 2)) - 1;
+			static const IdT NO_EDGE = 0x3;
 
 			struct
 			{
 
-				uint32_t otherTriangle : 30;
-				uint32_t otherEdge : 2;
+				IdT otherTriangle : sizeof(IdT) * 8 - 2;
+				IdT otherEdge : 2;
 			};
 
-			uint32_t id;
+			IdT id;
 		};
 
 		struct Triangle
@@ -38,19 +46,44 @@ namespace mesh
 			unsigned verts[3];
 		};
 
-		struct TriangleNeighbors
+		template<typename IdT>
+		struct TriangleNeighborsT
 		{
-			SharedEdge edge[3];
+			SharedEdgeT<IdT> edge[3];
 		};
 
-		struct Topology
+		template<typename IdT>
+		struct TopologyT
 		{
-			std::vector<Vert> verts;
-			std::vector<TriangleNeighbors> triNeighbors;
+			std::vector<VertT<IdT>> verts;
+			std::vector<TriangleNeighborsT<IdT>> triNeighbors;
 			std::vector<Triangle> tris;
+
+			// Boundary loops, each a run of corners whose edge has no neighbor, in triangle winding order. Loop i holds
+			// boundaryCorners[boundaryStarts[i]] up to boundaryCorners[boundaryStarts[i + 1]]. A corner is
+			// triIndex * 3 + edge and stands for the edge from its vert to the next.
+			std::vector<unsigned> boundaryCorners;
+			std::vector<unsigned> boundaryStarts; // Loop count + 1 entries
 		};
 
-		// Assumptions: manifold (singularities allowed), no lines (triangles with 2 identical points)
-		bool Construct(const unsigned* indices, unsigned triCount, Topology* outMesh);
+		using Vert = VertT<uint32_t>;
+		using SharedEdge = SharedEdgeT<uint32_t>;
+		using TriangleNeighbors = TriangleNeighborsT<uint32_t>;
+		using Topology = TopologyT<uint32_t>;
+
+		using Vert64 = VertT<uint64_t>;
+		using SharedEdge64 = SharedEdgeT<uint64_t>;
+		using TriangleNeighbors64 = TriangleNeighborsT<uint64_t>;
+		using Topology64 = TopologyT<uint64_t>;
+
+		// Verts joining separate boundary fans are split, each extra fan getting a new vert with the same realIndex and a
+		// higher splitIndex. Fails on more triangles than 32 bit corner ids can hold, and on the input half_edge::Construct
+		// rejects, filling optOutReport the same way. Instantiated for Topology and Topology64.
+		template<typename IdT>
+		bool Construct(const unsigned* indices, unsigned triCount, TopologyT<IdT>* outMesh, half_edge::ValidateReport* optOutReport = nullptr);
+
+		// Same as above, keeping scratch in builder and reusing the capacity of inoutMesh, see TopologyBuilder.h.
+		template<typename IdT>
+		bool Construct(TopologyBuilder* builder, const unsigned* indices, unsigned triCount, TopologyT<IdT>* inoutMesh, half_edge::ValidateReport* optOutReport = nullptr);
 	};
 }
\ No newline at end of file
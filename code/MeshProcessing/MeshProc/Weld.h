@@ -0,0 +1,22 @@
+#pragma once
+
+#include <vector>
+
+// Turns unindexed triangle soups, as STL files and scanners produce them, into the positions and indices Construct
+// takes. Verts are hashed into a grid of cells sized by epsilon and only compared against verts in neighboring cells.
+namespace mesh
+{
+	struct WeldOptions
+	{
+		float epsilon = 0.0f; // Verts within this distance merge. 0 merges identical positions only, -0 matching 0.
+		bool dropCollapsed = true; // Drops triangles left with two corners on one vert, which Construct rejects
+		unsigned threadCount = 1; // 0 uses every hardware thread. The result is identical for any thread count.
+	};
+
+	// soupVerts holds three packed xyz verts per triangle. Each vert merges into the lowest numbered vert within
+	// epsilon of it, and merges chain, so verts a few epsilon apart can end up on one vert. Welded verts keep the
+	// position of their lowest numbered soup vert and are numbered in first use order. Kept triangles stay in soup
+	// order. A vert only collapsed triangles used keeps its slot in outPositions without any index referencing it.
+	// Returns the welded vert count.
+	unsigned WeldSoup(const float* soupVerts, unsigned triCount, std::vector<unsigned>* outIndices, std::vector<float>* outPositions, const WeldOptions& options = WeldOptions());
+}
@@ -0,0 +1,1023 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <vector>
+#include "MeshProc/Bvh.h"
+#include "MeshProc/Decimate.h"
+#include "MeshProc/Meshlet.h"
+#include "Parallel.h"
+#include "sanity.h"
+
+namespace
+{
+	using namespace mesh;
+	using namespace mesh::half_edge;
+
+	static constexpr unsigned NONE = ~0u;
+	static constexpr unsigned MORTON_BITS = 10; // Per axis, so a code fits the top 30 bits of a key's high word
+	static constexpr unsigned RADIX_BITS = 10;
+	static constexpr unsigned CHUNK_FACES = 1u << 16; // Faces one task grows meshlets over. Meshlets never cross chunks
+	static constexpr unsigned GROUP_VERT = 1u << 31; // Marks a vert a hierarchy group moved, by its index within the group
+	static constexpr float MIN_CONE_DOT = 0.1f; // Cones wider than about 84 degrees never cull anything worth the test
+	static constexpr float MIN_GROUP_REDUCTION = 0.85f; // Groups that cannot get below this share of their tris stop
+
+	// Below this the threads cost more than the passes they split
+	static constexpr unsigned PARALLEL_MIN_ELEMENTS = 1u << 14;
+
+	static unsigned ThreadCount(unsigned elementCount, const MeshletOptions& options)
+	{
+		return elementCount < PARALLEL_MIN_ELEMENTS ? 1 : std::min(Parallel_ThreadCount(options.threadCount), elementCount / (PARALLEL_MIN_ELEMENTS / 4));
+	}
+
+	static inline float Dot(const float* lhs, const float* rhs)
+	{
+		return lhs[0] * rhs[0] + lhs[1] * rhs[1] + lhs[2] * rhs[2];
+	}
+
+	namespace order
+	{
+		// Moves the low 10 bits of value to every third bit
+		static uint32_t SpreadBits(uint32_t value)
+		{
+			value &= 0x3FF;
+			value = (value | (value << 16)) & 0x030000FF;
+			value = (value | (value << 8)) & 0x0300F00F;
+			value = (value | (value << 4)) & 0x030C30C3;
+			value = (value | (value << 2)) & 0x09249249;
+			return value;
+		}
+
+		// Live real faces sorted by the Morton code of their centroid, and the rank of each face in that order
+		template<typename IdT>
+		static void MortonFaces(const TopologyT<IdT>& mesh, const float* positions, unsigned threadCount, std::vector<unsigned>* outOrder, std::vector<unsigned>* outRanks)
+		{
+			const unsigned faceCount = static_cast<unsigned>(mesh.faceHalfEdges[FaceType::REAL].size());
+			std::vector<float> centroids(static_cast<size_t>(faceCount) * 3);
+			std::vector<float> sliceBounds(threadCount * 6);
+
+			Parallel_For(threadCount, faceCount, [&](unsigned threadIndex, unsigned begin, unsigned end)
+			{
+				float* const bounds = sliceBounds.data() + threadIndex * 6;
+
+				for (unsigned axis = 0; axis < 3; ++axis)
+				{
+					bounds[axis] = FLT_MAX;
+					bounds[axis + 3] = -FLT_MAX;
+				}
+
+				for (unsigned face = begin; face < end; ++face)
+				{
+					unsigned halfEdge = mesh.faceHalfEdges[FaceType::REAL][face];
+					float* const centroid = centroids.data() + static_cast<size_t>(face) * 3;
+
+					if (halfEdge == NONE)
+						continue;
+
+					centroid[0] = centroid[1] = centroid[2] = 0.0f;
+					for (unsigned corner = 0; corner < 3; ++corner, halfEdge = mesh.halfEdgeNexts[halfEdge])
+					{
+						const float* const position = positions + static_cast<size_t>(mesh.verts[mesh.halfEdgeVerts[halfEdge]].realIndex) * 3;
+
+						for (unsigned axis = 0; axis < 3; ++axis)
+							centroid[axis] += position[axis] * (1.0f / 3.0f);
+					}
+
+					for (unsigned axis = 0; axis < 3; ++axis)
+					{
+						bounds[axis] = std::min(bounds[axis], centroid[axis]);
+						bounds[axis + 3] = std::max(bounds[axis + 3], centroid[axis]);
+					}
+				}
+			});
+
+			float boundsMin[3];
+			float scale[3];
+
+			for (unsigned axis = 0; axis < 3; ++axis)
+			{
+				float boundsMax = -FLT_MAX;
+
+				boundsMin[axis] = FLT_MAX;
+				for (unsigned threadIndex = 0; threadIndex < threadCount; ++threadIndex)
+				{
+					boundsMin[axis] = std::min(boundsMin[axis], sliceBounds[threadIndex * 6 + axis]);
+					boundsMax = std::max(boundsMax, sliceBounds[threadIndex * 6 + axis + 3]);
+				}
+
+				const float extent = boundsMax - boundsMin[axis];
+				scale[axis] = extent > 0.0f ? ((1u << MORTON_BITS) - 1) / extent : 0.0f;
+			}
+
+			// Keys hold the code above the face, so a stable sort on the code bits alone keeps ties in face order. Deleted
+			// faces get code 0 and are dropped afterwards.
+			std::vector<uint64_t> keys(faceCount);
+			std::vector<uint64_t> sortScratch(faceCount);
+
+			Parallel_For(threadCount, faceCount, [&](unsigned, unsigned begin, unsigned end)
+			{
+				for (unsigned face = begin; face < end; ++face)
+				{
+					const float* const centroid = centroids.data() + static_cast<size_t>(face) * 3;
+					uint32_t code = 0;
+
+					if (mesh.faceHalfEdges[FaceType::REAL][face] != NONE)
+					{
+						for (unsigned axis = 0; axis < 3; ++axis)
+							code |= SpreadBits(static_cast<uint32_t>((centroid[axis] - boundsMin[axis]) * scale[axis] + 0.5f)) << (2 - axis);
+					}
+
+					keys[face] = (static_cast<uint64_t>(code) << 32) | face;
+				}
+			});
+
+			for (unsigned shift = 32; shift < 32 + MORTON_BITS * 3; shift += RADIX_BITS)
+			{
+				unsigned bucketStarts[(1u << RADIX_BITS) + 1] = {};
+
+				for (uint64_t key : keys)
+					++bucketStarts[((key >> shift) & ((1u << RADIX_BITS) - 1)) + 1];
+
+				for (unsigned bucket = 1; bucket <= (1u << RADIX_BITS); ++bucket)
+					bucketStarts[bucket] += bucketStarts[bucket - 1];
+
+				for (uint64_t key : keys)
+					sortScratch[bucketStarts[(key >> shift) & ((1u << RADIX_BITS) - 1)]++] = key;
+
+				keys.swap(sortScratch);
+			}
+
+			outOrder->clear();
+			outOrder->reserve(faceCount);
+			outRanks->assign(faceCount, NONE);
+			for (uint64_t key : keys)
+			{
+				const unsigned face = static_cast<uint32_t>(key);
+
+				if (mesh.faceHalfEdges[FaceType::REAL][face] != NONE)
+				{
+					(*outRanks)[face] = static_cast<unsigned>(outOrder->size());
+					outOrder->push_back(face);
+				}
+			}
+		}
+	}
+
+	namespace grow
+	{
+		// Meshlets of one chunk, with offsets into the chunk's own arrays
+		struct Chunk
+		{
+			std::vector<Meshlet> meshlets;
+			std::vector<unsigned> verts; // Vert::realIndex
+			std::vector<uint8_t> triangles;
+			std::vector<unsigned> faces;
+		};
+
+		struct Face
+		{
+			unsigned verts[3]; // Chunk verts
+			unsigned neighbors[3]; // Chunk faces across each edge, NONE off the chunk or on a boundary
+			float centroid[3];
+		};
+
+		// Grows meshlets over the faces chunkFaces lists, which are ranks rankBegin onwards in faceRanks. Each meshlet
+		// starts at the first free face and takes the neighbor adding the fewest verts, then the one closest to its
+		// centroid. Once no neighbor fits, it may take the next free face in chunk order if that lies within its extent.
+		template<typename IdT>
+		static void GrowChunk(const TopologyT<IdT>& mesh, const float* positions, const unsigned* chunkFaces, unsigned chunkFaceCount, const unsigned* faceRanks, unsigned rankBegin, const MeshletOptions& options, Chunk* outChunk)
+		{
+			std::vector<Face> faces(chunkFaceCount);
+			std::vector<unsigned> chunkVerts(static_cast<size_t>(chunkFaceCount) * 3);
+
+			for (unsigned local = 0; local < chunkFaceCount; ++local)
+			{
+				Face& face = faces[local];
+				unsigned halfEdge = mesh.faceHalfEdges[FaceType::REAL][chunkFaces[local]];
+
+				face.centroid[0] = face.centroid[1] = face.centroid[2] = 0.0f;
+				for (unsigned corner = 0; corner < 3; ++corner, halfEdge = mesh.halfEdgeNexts[halfEdge])
+				{
+					const FaceIndex pairFace = mesh.halfEdgeFaces[halfEdge ^ 1];
+					const unsigned realIndex = static_cast<unsigned>(mesh.verts[mesh.halfEdgeVerts[halfEdge]].realIndex);
+					const float* const position = positions + static_cast<size_t>(realIndex) * 3;
+
+					face.verts[corner] = realIndex;
+					chunkVerts[local * 3 + corner] = realIndex;
+					face.neighbors[corner] = NONE;
+					if (pairFace.type == FaceType::REAL)
+					{
+						const unsigned rank = faceRanks[static_cast<unsigned>(pairFace.index)];
+
+						if (rank - rankBegin < chunkFaceCount)
+							face.neighbors[corner] = rank - rankBegin;
+					}
+
+					for (unsigned axis = 0; axis < 3; ++axis)
+						face.centroid[axis] += position[axis] * (1.0f / 3.0f);
+				}
+			}
+
+			// Dense chunk verts, so membership is a lookup rather than a search of the meshlet's verts
+			std::sort(chunkVerts.begin(), chunkVerts.end());
+			chunkVerts.erase(std::unique(chunkVerts.begin(), chunkVerts.end()), chunkVerts.end());
+			for (Face& face : faces)
+			{
+				for (unsigned corner = 0; corner < 3; ++corner)
+					face.verts[corner] = static_cast<unsigned>(std::lower_bound(chunkVerts.begin(), chunkVerts.end(), face.verts[corner]) - chunkVerts.begin());
+			}
+
+			// Free faces left on each chunk vert. A face whose vert has no other free face left would strand that vert
+			// in a meshlet of its own, so it ranks with the faces adding one vert.
+			std::vector<unsigned> vertFreeFaces(chunkVerts.size(), 0);
+
+			for (const Face& face : faces)
+			{
+				for (unsigned corner = 0; corner < 3; ++corner)
+					++vertFreeFaces[face.verts[corner]];
+			}
+
+			// Faces around each chunk vert
+			std::vector<unsigned> vertFaceStarts(chunkVerts.size() + 1, 0);
+			std::vector<unsigned> vertFaces(static_cast<size_t>(chunkFaceCount) * 3);
+
+			for (unsigned vert = 0; vert < chunkVerts.size(); ++vert)
+				vertFaceStarts[vert + 1] = vertFaceStarts[vert] + vertFreeFaces[vert];
+
+			for (unsigned local = 0; local < chunkFaceCount; ++local)
+			{
+				for (unsigned corner = 0; corner < 3; ++corner)
+					vertFaces[vertFaceStarts[faces[local].verts[corner]] + --vertFreeFaces[faces[local].verts[corner]]] = local;
+			}
+
+			for (unsigned vert = 0; vert < chunkVerts.size(); ++vert)
+				vertFreeFaces[vert] = vertFaceStarts[vert + 1] - vertFaceStarts[vert];
+
+			std::vector<uint8_t> used(chunkFaceCount, 0);
+			std::vector<unsigned> vertSlots(chunkVerts.size(), NONE);
+			std::vector<unsigned> meshletVerts;
+			std::vector<unsigned> candidates;
+			std::vector<unsigned> seeds; // The last meshlet's frontier
+			std::vector<unsigned> candidateMeshlets(chunkFaceCount, NONE); // Meshlet that last listed each face
+			float lastCentroid[3] = { 0.0f, 0.0f, 0.0f };
+			unsigned cursor = 0;
+
+			auto NewVerts = [&](unsigned candidate)
+			{
+				const Face& face = faces[candidate];
+
+				return static_cast<unsigned>((vertSlots[face.verts[0]] == NONE) + (vertSlots[face.verts[1]] == NONE) + (vertSlots[face.verts[2]] == NONE));
+			};
+
+			auto DistanceTo = [&](unsigned candidate, const float* point)
+			{
+				const float offset[3] = { faces[candidate].centroid[0] - point[0], faces[candidate].centroid[1] - point[1], faces[candidate].centroid[2] - point[2] };
+
+				return Dot(offset, offset);
+			};
+
+			meshletVerts.reserve(options.maxVerts);
+			for (;;)
+			{
+				// The next meshlet starts on the last one's frontier, at the face with the fewest free neighbors, so growth
+				// sweeps across the chunk instead of leaving pockets behind. An empty frontier falls back to chunk order.
+				unsigned local = NONE;
+				unsigned bestFree = 4;
+				float bestDistance = FLT_MAX;
+
+				for (unsigned candidate : candidates)
+				{
+					if (used[candidate])
+						continue;
+
+					const Face& face = faces[candidate];
+					const unsigned freeNeighbors = (face.neighbors[0] != NONE && !used[face.neighbors[0]]) + (face.neighbors[1] != NONE && !used[face.neighbors[1]]) + (face.neighbors[2] != NONE && !used[face.neighbors[2]]);
+					const float distance = DistanceTo(candidate, lastCentroid);
+
+					if (freeNeighbors < bestFree || (freeNeighbors == bestFree && (distance < bestDistance || (distance == bestDistance && candidate < local))))
+					{
+						local = candidate;
+						bestFree = freeNeighbors;
+						bestDistance = distance;
+					}
+				}
+
+				seeds.swap(candidates);
+				candidates.clear();
+				if (local == NONE)
+				{
+					while (cursor < chunkFaceCount && used[cursor])
+						++cursor;
+
+					if (cursor == chunkFaceCount)
+						break;
+
+					local = cursor;
+				}
+
+				Meshlet meshlet;
+				float centroidSum[3] = { 0.0f, 0.0f, 0.0f };
+				float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+				float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+				meshlet.vertOffset = static_cast<unsigned>(outChunk->verts.size());
+				meshlet.triOffset = static_cast<unsigned>(outChunk->faces.size());
+
+				while (local != NONE)
+				{
+					const Face& face = faces[local];
+
+					used[local] = 1;
+					for (unsigned corner = 0; corner < 3; ++corner)
+					{
+						const unsigned vert = face.verts[corner];
+
+						--vertFreeFaces[vert];
+						if (vertSlots[vert] == NONE)
+						{
+							const float* const position = positions + static_cast<size_t>(chunkVerts[vert]) * 3;
+
+							vertSlots[vert] = static_cast<unsigned>(meshletVerts.size());
+							meshletVerts.push_back(vert);
+							for (unsigned axis = 0; axis < 3; ++axis)
+							{
+								boundsMin[axis] = std::min(boundsMin[axis], position[axis]);
+								boundsMax[axis] = std::max(boundsMax[axis], position[axis]);
+							}
+
+							for (unsigned entry = vertFaceStarts[vert]; entry < vertFaceStarts[vert + 1]; ++entry)
+							{
+								const unsigned candidate = vertFaces[entry];
+
+								if (!used[candidate] && candidateMeshlets[candidate] != outChunk->meshlets.size())
+								{
+									candidateMeshlets[candidate] = static_cast<unsigned>(outChunk->meshlets.size());
+									candidates.push_back(candidate);
+								}
+							}
+						}
+
+						outChunk->triangles.push_back(static_cast<uint8_t>(vertSlots[vert]));
+					}
+
+					outChunk->faces.push_back(chunkFaces[local]);
+					for (unsigned axis = 0; axis < 3; ++axis)
+						centroidSum[axis] += face.centroid[axis];
+
+					const float scale = 1.0f / ++meshlet.triCount;
+
+					for (unsigned axis = 0; axis < 3; ++axis)
+						lastCentroid[axis] = centroidSum[axis] * scale;
+
+					if (meshlet.triCount == options.maxTris)
+						break;
+
+					// Faces adding no vert first, then stranded faces, then by the verts they add. Ties go to the face
+					// closest to the centroid. Neighbors already taken are dropped as they are met.
+					unsigned bestRank = 5;
+
+					local = NONE;
+					bestDistance = FLT_MAX;
+					for (size_t index = 0; index < candidates.size(); ++index)
+					{
+						const unsigned candidate = candidates[index];
+
+						if (used[candidate])
+						{
+							candidates[index--] = candidates.back();
+							candidates.pop_back();
+							continue;
+						}
+
+						const unsigned newVerts = NewVerts(candidate);
+
+						if (meshletVerts.size() + newVerts > options.maxVerts)
+							continue;
+
+						const unsigned* const verts = faces[candidate].verts;
+						const bool stranding = vertFreeFaces[verts[0]] == 1 || vertFreeFaces[verts[1]] == 1 || vertFreeFaces[verts[2]] == 1;
+						const unsigned rank = newVerts == 0 ? 0 : stranding ? 1 : 2;
+
+						if (rank > bestRank)
+							continue;
+
+						const float distance = DistanceTo(candidate, lastCentroid);
+
+						if (rank < bestRank || distance < bestDistance || (distance == bestDistance && candidate < local))
+						{
+							local = candidate;
+							bestRank = rank;
+							bestDistance = distance;
+						}
+					}
+
+					if (local != NONE)
+						continue;
+
+					// Nothing adjacent fits. The closest free face on the last meshlet's frontier, or else the next free face
+					// in chunk order, joins if its centroid lies in the meshlet's box grown by half its largest side.
+					const float margin = 0.5f * std::max(std::max(boundsMax[0] - boundsMin[0], boundsMax[1] - boundsMin[1]), boundsMax[2] - boundsMin[2]);
+
+					auto Fits = [&](unsigned candidate)
+					{
+						const float* const next = faces[candidate].centroid;
+
+						return meshletVerts.size() + NewVerts(candidate) <= options.maxVerts &&
+							next[0] >= boundsMin[0] - margin && next[0] <= boundsMax[0] + margin &&
+							next[1] >= boundsMin[1] - margin && next[1] <= boundsMax[1] + margin &&
+							next[2] >= boundsMin[2] - margin && next[2] <= boundsMax[2] + margin;
+					};
+
+					for (unsigned seed : seeds)
+					{
+						if (!used[seed] && meshletVerts.size() + NewVerts(seed) <= options.maxVerts)
+						{
+							const float distance = DistanceTo(seed, lastCentroid);
+
+							if (local == NONE || distance < bestDistance || (distance == bestDistance && seed < local))
+							{
+								local = seed;
+								bestDistance = distance;
+							}
+						}
+					}
+
+					while (cursor < chunkFaceCount && used[cursor])
+						++cursor;
+
+					if (local == NONE && cursor < chunkFaceCount && Fits(cursor))
+						local = cursor;
+				}
+
+				meshlet.vertCount = static_cast<unsigned>(meshletVerts.size());
+				for (unsigned vert : meshletVerts)
+				{
+					outChunk->verts.push_back(chunkVerts[vert]);
+					vertSlots[vert] = NONE;
+				}
+
+				meshletVerts.clear();
+				outChunk->meshlets.push_back(meshlet);
+			}
+		}
+
+		// Appends chunks in order, moving their offsets past what is already there
+		static void Append(std::vector<Chunk>* inoutChunks, unsigned threadCount, Meshlets* inoutMeshlets)
+		{
+			std::vector<Chunk>& chunks = *inoutChunks;
+			const unsigned chunkCount = static_cast<unsigned>(chunks.size());
+			std::vector<unsigned> meshletStarts(chunkCount + 1, static_cast<unsigned>(inoutMeshlets->meshlets.size()));
+			std::vector<unsigned> vertStarts(chunkCount + 1, static_cast<unsigned>(inoutMeshlets->verts.size()));
+			std::vector<unsigned> triStarts(chunkCount + 1, static_cast<unsigned>(inoutMeshlets->triangles.size() / 3));
+			std::vector<unsigned> faceStarts(chunkCount + 1, static_cast<unsigned>(inoutMeshlets->faces.size()));
+
+			for (unsigned chunk = 0; chunk < chunkCount; ++chunk)
+			{
+				meshletStarts[chunk + 1] = meshletStarts[chunk] + static_cast<unsigned>(chunks[chunk].meshlets.size());
+				vertStarts[chunk + 1] = vertStarts[chunk] + static_cast<unsigned>(chunks[chunk].verts.size());
+				triStarts[chunk + 1] = triStarts[chunk] + static_cast<unsigned>(chunks[chunk].triangles.size() / 3);
+				faceStarts[chunk + 1] = faceStarts[chunk] + static_cast<unsigned>(chunks[chunk].faces.size());
+			}
+
+			inoutMeshlets->meshlets.resize(meshletStarts[chunkCount]);
+			inoutMeshlets->verts.resize(vertStarts[chunkCount]);
+			inoutMeshlets->triangles.resize(static_cast<size_t>(triStarts[chunkCount]) * 3);
+			inoutMeshlets->faces.resize(faceStarts[chunkCount]);
+
+			Parallel_For(threadCount, chunkCount, [&](unsigned, unsigned begin, unsigned end)
+			{
+				for (unsigned chunk = begin; chunk < end; ++chunk)
+				{
+					Chunk& source = chunks[chunk];
+
+					for (size_t index = 0; index < source.meshlets.size(); ++index)
+					{
+						Meshlet& meshlet = inoutMeshlets->meshlets[meshletStarts[chunk] + index];
+
+						meshlet = source.meshlets[index];
+						meshlet.vertOffset += vertStarts[chunk];
+						meshlet.triOffset += triStarts[chunk];
+					}
+
+					std::copy(source.verts.begin(), source.verts.end(), inoutMeshlets->verts.begin() + vertStarts[chunk]);
+					std::copy(source.triangles.begin(), source.triangles.end(), inoutMeshlets->triangles.begin() + static_cast<size_t>(triStarts[chunk]) * 3);
+					std::copy(source.faces.begin(), source.faces.end(), inoutMeshlets->faces.begin() + faceStarts[chunk]);
+					source = Chunk();
+				}
+			});
+		}
+	}
+
+	namespace bounds
+	{
+		static const float* Position(const Meshlets& meshlets, const float* positions, unsigned vert)
+		{
+			return vert < meshlets.lodVertBase ? positions + static_cast<size_t>(vert) * 3 : meshlets.lodPositions.data() + static_cast<size_t>(vert - meshlets.lodVertBase) * 3;
+		}
+
+		// Sphere around the box center, and the normal cone of the unit face normals' mean. The apex goes back along
+		// the axis until it lies behind every triangle's plane.
+		static void Compute(const float* positions, unsigned meshletBegin, unsigned meshletEnd, const MeshletOptions& options, Meshlets* inoutMeshlets)
+		{
+			Parallel_For(ThreadCount(meshletEnd - meshletBegin, options), meshletEnd - meshletBegin, [&](unsigned, unsigned begin, unsigned end)
+			{
+				std::vector<float> normals;
+
+				for (unsigned index = meshletBegin + begin; index < meshletBegin + end; ++index)
+				{
+					Meshlet& meshlet = inoutMeshlets->meshlets[index];
+					const unsigned* const verts = inoutMeshlets->verts.data() + meshlet.vertOffset;
+					const uint8_t* const triangles = inoutMeshlets->triangles.data() + static_cast<size_t>(meshlet.triOffset) * 3;
+					float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+					float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+					for (unsigned vert = 0; vert < meshlet.vertCount; ++vert)
+					{
+						const float* const position = Position(*inoutMeshlets, positions, verts[vert]);
+
+						for (unsigned axis = 0; axis < 3; ++axis)
+						{
+							boundsMin[axis] = std::min(boundsMin[axis], position[axis]);
+							boundsMax[axis] = std::max(boundsMax[axis], position[axis]);
+						}
+					}
+
+					float radiusSquared = 0.0f;
+
+					for (unsigned axis = 0; axis < 3; ++axis)
+						meshlet.center[axis] = 0.5f * (boundsMin[axis] + boundsMax[axis]);
+
+					for (unsigned vert = 0; vert < meshlet.vertCount; ++vert)
+					{
+						const float* const position = Position(*inoutMeshlets, positions, verts[vert]);
+						const float offset[3] = { position[0] - meshlet.center[0], position[1] - meshlet.center[1], position[2] - meshlet.center[2] };
+
+						radiusSquared = std::max(radiusSquared, Dot(offset, offset));
+					}
+
+					meshlet.radius = std::sqrt(radiusSquared);
+
+					// Unit normals of the triangles with area, each followed by its first corner
+					float axis[3] = { 0.0f, 0.0f, 0.0f };
+
+					normals.clear();
+					for (unsigned tri = 0; tri < meshlet.triCount; ++tri)
+					{
+						const float* const p0 = Position(*inoutMeshlets, positions, verts[triangles[tri * 3]]);
+						const float* const p1 = Position(*inoutMeshlets, positions, verts[triangles[tri * 3 + 1]]);
+						const float* const p2 = Position(*inoutMeshlets, positions, verts[triangles[tri * 3 + 2]]);
+						const float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+						const float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+						float normal[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+						const float length = std::sqrt(Dot(normal, normal));
+
+						if (length == 0.0f)
+							continue;
+
+						for (unsigned component = 0; component < 3; ++component)
+						{
+							normal[component] /= length;
+							axis[component] += normal[component];
+						}
+
+						normals.insert(normals.end(), normal, normal + 3);
+						normals.insert(normals.end(), p0, p0 + 3);
+					}
+
+					const float axisLength = std::sqrt(Dot(axis, axis));
+					float minDot = 1.0f;
+
+					for (unsigned component = 0; component < 3; ++component)
+						axis[component] = axisLength > 0.0f ? axis[component] / axisLength : 0.0f;
+
+					for (size_t normal = 0; normal < normals.size(); normal += 6)
+						minDot = std::min(minDot, Dot(axis, normals.data() + normal));
+
+					std::copy(meshlet.center, meshlet.center + 3, meshlet.coneApex);
+					if (axisLength == 0.0f || minDot < MIN_CONE_DOT)
+					{
+						meshlet.coneAxis[0] = meshlet.coneAxis[1] = meshlet.coneAxis[2] = 0.0f;
+						meshlet.coneCutoff = 1.0f;
+						continue;
+					}
+
+					// center - t axis is behind the plane of triangle n.(p - p0) = 0 for t >= n.(center - p0) / n.axis
+					float maxT = 0.0f;
+
+					for (size_t normal = 0; normal < normals.size(); normal += 6)
+					{
+						const float* const n = normals.data() + normal;
+						const float offset[3] = { meshlet.center[0] - n[3], meshlet.center[1] - n[4], meshlet.center[2] - n[5] };
+
+						maxT = std::max(maxT, Dot(offset, n) / Dot(axis, n));
+					}
+
+					for (unsigned component = 0; component < 3; ++component)
+					{
+						meshlet.coneApex[component] = meshlet.center[component] - axis[component] * maxT;
+						meshlet.coneAxis[component] = axis[component];
+					}
+
+					meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+				}
+			});
+		}
+	}
+
+	namespace hierarchy
+	{
+		// The group a level's meshlets were decimated in, and the meshlets split from the result
+		struct Group
+		{
+			bool simplified = false;
+			float center[3] = {};
+			float radius = 0.0f;
+			float error = 0.0f;
+			grow::Chunk chunk; // Verts are ids, or GROUP_VERT plus an index into movedPositions
+			std::vector<float> movedPositions;
+		};
+
+		// Greedy grouping over shared verts. Each group starts at the first ungrouped meshlet and takes the ungrouped
+		// neighbor sharing the most verts with the whole group until it is full or has no neighbor left.
+		static void GroupMeshlets(const Meshlets& meshlets, const std::vector<unsigned>& pending, unsigned groupSize, std::vector<unsigned>* outGroupStarts, std::vector<unsigned>* outGroupMeshlets)
+		{
+			const unsigned pendingCount = static_cast<unsigned>(pending.size());
+			const unsigned vertCount = meshlets.lodVertBase + static_cast<unsigned>(meshlets.lodPositions.size() / 3);
+			std::vector<unsigned> vertStarts(vertCount + 1, 0);
+
+			for (unsigned meshlet : pending)
+			{
+				for (unsigned vert = 0; vert < meshlets.meshlets[meshlet].vertCount; ++vert)
+					++vertStarts[meshlets.verts[meshlets.meshlets[meshlet].vertOffset + vert] + 1];
+			}
+
+			for (unsigned vert = 0; vert < vertCount; ++vert)
+				vertStarts[vert + 1] += vertStarts[vert];
+
+			std::vector<unsigned> vertMeshlets(vertStarts[vertCount]);
+			std::vector<unsigned> fill(vertStarts.begin(), vertStarts.end() - 1);
+
+			for (unsigned index = 0; index < pendingCount; ++index)
+			{
+				const Meshlet& meshlet = meshlets.meshlets[pending[index]];
+
+				for (unsigned vert = 0; vert < meshlet.vertCount; ++vert)
+					vertMeshlets[fill[meshlets.verts[meshlet.vertOffset + vert]]++] = index;
+			}
+
+			fill = std::vector<unsigned>();
+
+			std::vector<uint8_t> grouped(pendingCount, 0);
+			std::vector<unsigned> shared(pendingCount, 0);
+			std::vector<unsigned> touched;
+
+			outGroupStarts->assign(1, 0);
+			outGroupMeshlets->clear();
+			for (unsigned seed = 0; seed < pendingCount; ++seed)
+			{
+				if (grouped[seed])
+					continue;
+
+				unsigned member = seed;
+
+				for (unsigned size = 0; member != NONE; )
+				{
+					const Meshlet& meshlet = meshlets.meshlets[pending[member]];
+
+					grouped[member] = 1;
+					outGroupMeshlets->push_back(pending[member]);
+					if (++size == groupSize)
+						break;
+
+					for (unsigned vert = 0; vert < meshlet.vertCount; ++vert)
+					{
+						const unsigned id = meshlets.verts[meshlet.vertOffset + vert];
+
+						for (unsigned entry = vertStarts[id]; entry < vertStarts[id + 1]; ++entry)
+						{
+							const unsigned neighbor = vertMeshlets[entry];
+
+							if (!grouped[neighbor] && shared[neighbor]++ == 0)
+								touched.push_back(neighbor);
+						}
+					}
+
+					member = NONE;
+					for (unsigned neighbor : touched)
+					{
+						if (!grouped[neighbor] && (member == NONE || shared[neighbor] > shared[member] || (shared[neighbor] == shared[member] && neighbor < member)))
+							member = neighbor;
+					}
+				}
+
+				for (unsigned neighbor : touched)
+					shared[neighbor] = 0;
+
+				touched.clear();
+				outGroupStarts->push_back(static_cast<unsigned>(outGroupMeshlets->size()));
+			}
+		}
+
+		// Decimates the group's triangles to half with the group outline locked, and splits the result into meshlets.
+		// Verts the decimation left in place keep their ids, so neighboring groups still meet them exactly.
+		static void SimplifyGroup(const Meshlets& meshlets, const float* positions, const unsigned* groupMeshlets, unsigned groupMeshletCount, const MeshletOptions& options, Group* outGroup)
+		{
+			std::vector<unsigned> ids;
+			std::vector<unsigned> indices;
+
+			// Bounds enclose the members' own LOD bounds, so the error projected from a parent never falls below a child's
+			float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+			float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+			for (unsigned member = 0; member < groupMeshletCount; ++member)
+			{
+				const Meshlet& meshlet = meshlets.meshlets[groupMeshlets[member]];
+
+				for (unsigned tri = 0; tri < meshlet.triCount * 3; ++tri)
+					indices.push_back(meshlets.verts[meshlet.vertOffset + meshlets.triangles[static_cast<size_t>(meshlet.triOffset) * 3 + tri]]);
+
+				outGroup->error = std::max(outGroup->error, meshlet.lodError);
+				for (unsigned axis = 0; axis < 3; ++axis)
+				{
+					boundsMin[axis] = std::min(boundsMin[axis], meshlet.lodCenter[axis] - meshlet.lodRadius);
+					boundsMax[axis] = std::max(boundsMax[axis], meshlet.lodCenter[axis] + meshlet.lodRadius);
+				}
+			}
+
+			for (unsigned axis = 0; axis < 3; ++axis)
+				outGroup->center[axis] = 0.5f * (boundsMin[axis] + boundsMax[axis]);
+
+			for (unsigned member = 0; member < groupMeshletCount; ++member)
+			{
+				const Meshlet& meshlet = meshlets.meshlets[groupMeshlets[member]];
+				const float offset[3] = { meshlet.lodCenter[0] - outGroup->center[0], meshlet.lodCenter[1] - outGroup->center[1], meshlet.lodCenter[2] - outGroup->center[2] };
+
+				outGroup->radius = std::max(outGroup->radius, std::sqrt(Dot(offset, offset)) + meshlet.lodRadius);
+			}
+
+			// Group verts numbered densely for the topology
+			const unsigned triCount = static_cast<unsigned>(indices.size() / 3);
+
+			ids = indices;
+			std::sort(ids.begin(), ids.end());
+			ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+			for (unsigned& index : indices)
+				index = static_cast<unsigned>(std::lower_bound(ids.begin(), ids.end(), index) - ids.begin());
+
+			// Neighboring groups can each draw an edge between the same two outline verts, so a later group can meet an
+			// edge of four faces. Triangles on such an edge get their own copies of their verts: they come apart as
+			// islands of the topology, all boundary, and stay as they are.
+			std::vector<uint64_t> edges(indices.size());
+
+			for (unsigned corner = 0; corner < indices.size(); ++corner)
+				edges[corner] = (static_cast<uint64_t>(indices[corner]) << 32) | indices[corner - corner % 3 + (corner + 1) % 3];
+
+			std::sort(edges.begin(), edges.end());
+			for (unsigned tri = 0; tri < triCount; ++tri)
+			{
+				unsigned* const corners = indices.data() + tri * 3;
+				bool island = false;
+
+				for (unsigned corner = 0; corner < 3; ++corner)
+				{
+					const uint64_t edge = (static_cast<uint64_t>(corners[corner]) << 32) | corners[(corner + 1) % 3];
+					const std::vector<uint64_t>::const_iterator match = std::lower_bound(edges.begin(), edges.end(), edge);
+
+					island |= match + 1 != edges.end() && match[1] == edge;
+				}
+
+				for (unsigned corner = 0; island && corner < 3; ++corner)
+				{
+					ids.push_back(ids[corners[corner]]);
+					corners[corner] = static_cast<unsigned>(ids.size() - 1);
+				}
+			}
+
+			std::vector<float> groupPositions(ids.size() * 3);
+
+			for (size_t vert = 0; vert < ids.size(); ++vert)
+				std::memcpy(groupPositions.data() + vert * 3, bounds::Position(meshlets, positions, ids[vert]), sizeof(float) * 3);
+
+			Topology topology;
+
+			// Groups whose fans do not close up around a vert are left as they are, as the decimation needs full validity
+			if (!Construct(indices.data(), triCount, &topology))
+				return;
+
+			Lod lod;
+			DecimateOptions decimateOptions;
+
+			decimateOptions.lockBoundary = true;
+			Decimate(topology, groupPositions.data(), triCount / 2, &lod, decimateOptions);
+
+			const unsigned lodTriCount = static_cast<unsigned>(lod.mesh.faceHalfEdges[FaceType::REAL].size());
+
+			if (lodTriCount == 0 || lodTriCount > triCount * MIN_GROUP_REDUCTION)
+				return;
+
+			std::vector<float> lodPositions(ids.size() * 3, 0.0f);
+			std::vector<unsigned> lodIndices;
+			std::vector<unsigned> faceOrder(lodTriCount);
+
+			// The rest works in group verts, so the LOD's verts are pointed back at the group verts they came from
+			for (size_t vert = 0; vert < lod.mesh.verts.size(); ++vert)
+			{
+				lod.mesh.verts[vert].realIndex = lod.sourceVerts[vert];
+				std::memcpy(lodPositions.data() + static_cast<size_t>(lod.sourceVerts[vert]) * 3, lod.positions.data() + vert * 3, sizeof(float) * 3);
+			}
+
+			// The error is the farthest any group vert the decimation removed or moved ended up from the result
+			std::vector<uint8_t> kept(ids.size(), 0);
+			Bvh bvh;
+
+			lodIndices.reserve(static_cast<size_t>(lodTriCount) * 3);
+			for (unsigned face = 0; face < lodTriCount; ++face)
+			{
+				unsigned halfEdge = lod.mesh.faceHalfEdges[FaceType::REAL][face];
+
+				for (unsigned corner = 0; corner < 3; ++corner, halfEdge = lod.mesh.halfEdgeNexts[halfEdge])
+					lodIndices.push_back(lod.mesh.verts[lod.mesh.halfEdgeVerts[halfEdge]].realIndex);
+			}
+
+			for (unsigned vert : lodIndices)
+				kept[vert] = std::memcmp(lodPositions.data() + static_cast<size_t>(vert) * 3, groupPositions.data() + static_cast<size_t>(vert) * 3, sizeof(float) * 3) == 0;
+
+			BuildBvh(lodPositions.data(), lodIndices.data(), lodTriCount, &bvh);
+			for (unsigned vert = 0; vert < ids.size(); ++vert)
+			{
+				ClosestPoint closest;
+
+				if (!kept[vert] && FindClosestPoint(bvh, groupPositions.data() + static_cast<size_t>(vert) * 3, &closest))
+					outGroup->error = std::max(outGroup->error, std::sqrt(closest.distanceSquared));
+			}
+
+			outGroup->simplified = true;
+			std::iota(faceOrder.begin(), faceOrder.end(), 0u);
+			grow::GrowChunk(lod.mesh, lodPositions.data(), faceOrder.data(), lodTriCount, faceOrder.data(), 0, options, &outGroup->chunk);
+
+			// Faces of simplified levels have no source face
+			outGroup->chunk.faces.clear();
+
+			std::vector<unsigned> moved(ids.size(), NONE);
+
+			for (unsigned& vert : outGroup->chunk.verts)
+			{
+				const float* const position = lodPositions.data() + static_cast<size_t>(vert) * 3;
+
+				if (std::memcmp(position, groupPositions.data() + static_cast<size_t>(vert) * 3, sizeof(float) * 3) == 0)
+				{
+					vert = ids[vert];
+					continue;
+				}
+
+				if (moved[vert] == NONE)
+				{
+					moved[vert] = static_cast<unsigned>(outGroup->movedPositions.size() / 3);
+					outGroup->movedPositions.insert(outGroup->movedPositions.end(), position, position + 3);
+				}
+
+				vert = GROUP_VERT | moved[vert];
+			}
+		}
+
+		static void Build(const float* positions, const MeshletOptions& options, Meshlets* inoutMeshlets)
+		{
+			std::vector<unsigned> pending(inoutMeshlets->meshlets.size());
+			std::vector<unsigned> groupStarts;
+			std::vector<unsigned> groupMeshlets;
+
+			std::iota(pending.begin(), pending.end(), 0u);
+			for (unsigned level = 1; level <= options.maxLevels && pending.size() > 1; ++level)
+			{
+				GroupMeshlets(*inoutMeshlets, pending, options.groupSize, &groupStarts, &groupMeshlets);
+
+				const unsigned groupCount = static_cast<unsigned>(groupStarts.size() - 1);
+				std::vector<Group> groups(groupCount);
+
+				Parallel_For(std::min(Parallel_ThreadCount(options.threadCount), groupCount), groupCount, [&](unsigned, unsigned begin, unsigned end)
+				{
+					for (unsigned group = begin; group < end; ++group)
+						SimplifyGroup(*inoutMeshlets, positions, groupMeshlets.data() + groupStarts[group], groupStarts[group + 1] - groupStarts[group], options, &groups[group]);
+				});
+
+				// Moved verts are numbered in group order, and groups that could not simplify wait for the next level
+				const unsigned levelBegin = static_cast<unsigned>(inoutMeshlets->meshlets.size());
+				std::vector<grow::Chunk> chunks;
+				std::vector<unsigned> nextPending;
+				unsigned levelMeshletCount = 0;
+
+				for (unsigned group = 0; group < groupCount; ++group)
+				{
+					Group& source = groups[group];
+
+					if (!source.simplified)
+					{
+						nextPending.insert(nextPending.end(), groupMeshlets.begin() + groupStarts[group], groupMeshlets.begin() + groupStarts[group + 1]);
+						continue;
+					}
+
+					const unsigned movedBase = inoutMeshlets->lodVertBase + static_cast<unsigned>(inoutMeshlets->lodPositions.size() / 3);
+
+					sanity(movedBase + source.movedPositions.size() / 3 < GROUP_VERT && "mesh::BuildMeshlets: too many verts");
+					inoutMeshlets->lodPositions.insert(inoutMeshlets->lodPositions.end(), source.movedPositions.begin(), source.movedPositions.end());
+					for (unsigned& vert : source.chunk.verts)
+					{
+						if (vert & GROUP_VERT)
+							vert = movedBase + (vert & ~GROUP_VERT);
+					}
+
+					for (unsigned member = groupStarts[group]; member < groupStarts[group + 1]; ++member)
+					{
+						Meshlet& child = inoutMeshlets->meshlets[groupMeshlets[member]];
+
+						std::copy(source.center, source.center + 3, child.parentCenter);
+						child.parentRadius = source.radius;
+						child.parentError = source.error;
+					}
+
+					for (Meshlet& meshlet : source.chunk.meshlets)
+					{
+						meshlet.level = level;
+						std::copy(source.center, source.center + 3, meshlet.lodCenter);
+						meshlet.lodRadius = source.radius;
+						meshlet.lodError = source.error;
+						nextPending.push_back(levelBegin + levelMeshletCount++);
+					}
+
+					chunks.push_back(std::move(source.chunk));
+				}
+
+				if (chunks.empty())
+					break;
+
+				grow::Append(&chunks, 1, inoutMeshlets);
+				bounds::Compute(positions, levelBegin, static_cast<unsigned>(inoutMeshlets->meshlets.size()), options, inoutMeshlets);
+				inoutMeshlets->levelStarts.push_back(static_cast<unsigned>(inoutMeshlets->meshlets.size()));
+				pending.swap(nextPending);
+			}
+		}
+	}
+}
+
+namespace mesh
+{
+	namespace half_edge
+	{
+		template<typename IdT>
+		void BuildMeshlets(const TopologyT<IdT>& mesh, const float* positions, Meshlets* outMeshlets, const MeshletOptions& options)
+		{
+			sanity(options.maxVerts >= 3 && options.maxVerts <= 256 && "mesh::BuildMeshlets: maxVerts must be in [3, 256]");
+			sanity(options.maxTris >= 1 && options.maxTris <= 512 && "mesh::BuildMeshlets: maxTris must be in [1, 512]");
+			sanity(options.groupSize >= 1 && "mesh::BuildMeshlets: groupSize must be positive");
+
+			const unsigned faceCount = static_cast<unsigned>(mesh.faceHalfEdges[FaceType::REAL].size());
+			const unsigned vertCount = static_cast<unsigned>(mesh.verts.size());
+			std::vector<unsigned> faceOrder;
+			std::vector<unsigned> faceRanks;
+			IdT maxRealIndex = 0;
+
+			for (unsigned vert = 0; vert < vertCount; ++vert)
+				maxRealIndex = std::max<IdT>(maxRealIndex, mesh.verts[vert].realIndex);
+
+			sanity(maxRealIndex < GROUP_VERT && "mesh::BuildMeshlets: realIndex out of range");
+
+			*outMeshlets = Meshlets();
+			outMeshlets->lodVertBase = vertCount ? static_cast<unsigned>(maxRealIndex) + 1 : 0;
+			order::MortonFaces(mesh, positions, ThreadCount(faceCount, options), &faceOrder, &faceRanks);
+
+			const unsigned liveCount = static_cast<unsigned>(faceOrder.size());
+			const unsigned chunkCount = (liveCount + CHUNK_FACES - 1) / CHUNK_FACES;
+			std::vector<grow::Chunk> chunks(chunkCount);
+
+			Parallel_For(std::min(Parallel_ThreadCount(options.threadCount), std::max(chunkCount, 1u)), chunkCount, [&](unsigned, unsigned begin, unsigned end)
+			{
+				for (unsigned chunk = begin; chunk < end; ++chunk)
+				{
+					const unsigned rankBegin = chunk * CHUNK_FACES;
+
+					grow::GrowChunk(mesh, positions, faceOrder.data() + rankBegin, std::min(liveCount - rankBegin, CHUNK_FACES), faceRanks.data(), rankBegin, options, &chunks[chunk]);
+				}
+			});
+
+			grow::Append(&chunks, std::min(Parallel_ThreadCount(options.threadCount), std::max(chunkCount, 1u)), outMeshlets);
+
+			const unsigned meshletCount = static_cast<unsigned>(outMeshlets->meshlets.size());
+
+			bounds::Compute(positions, 0, meshletCount, options, outMeshlets);
+			for (Meshlet& meshlet : outMeshlets->meshlets)
+			{
+				std::copy(meshlet.center, meshlet.center + 3, meshlet.lodCenter);
+				meshlet.lodRadius = meshlet.radius;
+			}
+
+			outMeshlets->levelStarts = { 0, meshletCount };
+			if (options.buildHierarchy)
+				hierarchy::Build(positions, options, outMeshlets);
+		}
+
+		template void BuildMeshlets(const Topology&, const float*, Meshlets*, const MeshletOptions&);
+		template void BuildMeshlets(const Topology64&, const float*, Meshlets*, const MeshletOptions&);
+	}
+}
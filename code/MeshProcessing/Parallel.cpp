@@ -0,0 +1,206 @@
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include "Parallel.h"
+
+namespace
+{
+	// Workers sleep between calls, so a call costs a wake up per thread instead of a thread start and join.
+	class WorkerPool
+	{
+	public:
+		~WorkerPool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+
+				stopping = true;
+			}
+
+			wake.notify_all();
+			for (std::thread& worker : workers)
+				worker.join();
+		}
+
+		// Fails without waiting when another call holds the pool
+		bool TryRun(unsigned threadCount, void (*job)(void*, unsigned), void* context)
+		{
+			bool expected = false;
+
+			if (!busy.compare_exchange_strong(expected, true, std::memory_order_acquire))
+				return false;
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+
+				// Grows to the largest thread count asked for. Workers are only released at exit.
+				try
+				{
+					while (workers.size() + 1 < threadCount)
+					{
+						const unsigned threadIndex = static_cast<unsigned>(workers.size()) + 1;
+
+						workers.emplace_back([this, threadIndex]() { Work(threadIndex); });
+					}
+				}
+				catch (...)
+				{
+					busy.store(false, std::memory_order_release);
+					return false;
+				}
+
+				jobFn = job;
+				jobContext = context;
+				jobThreadCount = threadCount;
+				pending = threadCount - 1;
+				++generation;
+			}
+
+			wake.notify_all();
+
+			// Workers still read context after a throw here, so the call can only unwind once they are done
+			std::exception_ptr error;
+
+			try
+			{
+				job(context, 0);
+			}
+			catch (...)
+			{
+				error = std::current_exception();
+			}
+
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+
+				done.wait(lock, [this]() { return pending == 0; });
+				if (!error)
+					error = jobError;
+
+				jobError = nullptr;
+			}
+
+			busy.store(false, std::memory_order_release);
+			if (error)
+				std::rethrow_exception(error);
+
+			return true;
+		}
+
+	private:
+		void Work(unsigned threadIndex)
+		{
+			uint64_t seenGeneration = 0;
+
+			for (;;)
+			{
+				void (*job)(void*, unsigned);
+				void* context;
+
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+
+					wake.wait(lock, [&]() { return stopping || (generation != seenGeneration && threadIndex < jobThreadCount); });
+					if (stopping)
+						return;
+
+					seenGeneration = generation;
+					job = jobFn;
+					context = jobContext;
+				}
+
+				std::exception_ptr error;
+
+				try
+				{
+					job(context, threadIndex);
+				}
+				catch (...)
+				{
+					error = std::current_exception();
+				}
+
+				bool last;
+
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+
+					if (error && !jobError)
+						jobError = error;
+
+					last = --pending == 0;
+				}
+
+				if (last)
+					done.notify_one();
+			}
+		}
+
+		std::atomic<bool> busy{ false };
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::condition_variable done;
+		std::vector<std::thread> workers; // Worker i runs thread index i + 1
+		uint64_t generation = 0; // Bumped once per call
+		void (*jobFn)(void*, unsigned) = nullptr;
+		void* jobContext = nullptr;
+		unsigned jobThreadCount = 0;
+		unsigned pending = 0; // Workers still running the current call
+		std::exception_ptr jobError; // First exception a worker threw in the current call
+		bool stopping = false;
+	};
+
+	static WorkerPool pool;
+}
+
+void Parallel_Run(unsigned threadCount, void (*job)(void* context, unsigned threadIndex), void* context)
+{
+	if (threadCount <= 1)
+	{
+		job(context, 0);
+		return;
+	}
+
+	if (pool.TryRun(threadCount, job, context))
+		return;
+
+	// Same as the pool: every thread is joined before the first exception thrown is passed on
+	std::vector<std::exception_ptr> threadErrors(threadCount);
+	std::vector<std::thread> threads;
+	auto RunCaught = [job, context, &threadErrors](unsigned threadIndex)
+	{
+		try
+		{
+			job(context, threadIndex);
+		}
+		catch (...)
+		{
+			threadErrors[threadIndex] = std::current_exception();
+		}
+	};
+
+	threads.reserve(threadCount - 1);
+	for (unsigned threadIndex = 1; threadIndex < threadCount; ++threadIndex)
+	{
+		try
+		{
+			threads.emplace_back(RunCaught, threadIndex);
+		}
+		catch (...)
+		{
+			// Out of threads, so this slice runs here
+			RunCaught(threadIndex);
+		}
+	}
+
+	RunCaught(0);
+
+	for (std::thread& thread : threads)
+		thread.join();
+
+	for (const std::exception_ptr& error : threadErrors)
+	{
+		if (error)
+			std::rethrow_exception(error);
+	}
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// Resolves a requested thread count. 0 means one per hardware thread.
+static inline unsigned Parallel_ThreadCount(unsigned requested)
+{
+	return requested ? requested : std::max(1u, std::thread::hardware_concurrency());
+}
+
+static inline unsigned Parallel_SliceBegin(unsigned threadIndex, unsigned threadCount, unsigned count)
+{
+	return static_cast<unsigned>((static_cast<uint64_t>(count) * threadIndex) / threadCount);
+}
+
+// Runs job(context, threadIndex) for every threadIndex in [0, threadCount) and returns once all have finished. Index
+// 0 runs on the calling thread, the rest on a process wide pool of workers that is kept between calls. A call made
+// while the pool is busy, from another thread or from inside a job, starts threads of its own instead. An exception
+// thrown by a job is passed on to the caller once every index has finished. When several throw, index 0's is kept.
+void Parallel_Run(unsigned threadCount, void (*job)(void* context, unsigned threadIndex), void* context);
+
+// Calls fn(threadIndex, begin, end) once per thread over contiguous slices of [0, count). Slices only depend on
+// count and threadCount, so per slice results can be combined in slice order deterministically. Slice 0 runs on
+// the calling thread.
+template<typename Fn>
+static inline void Parallel_For(unsigned threadCount, unsigned count, const Fn& fn)
+{
+	if (threadCount <= 1)
+	{
+		fn(0u, 0u, count);
+	}
+	else
+	{
+		struct Slices
+		{
+			const Fn* fn;
+			unsigned threadCount;
+			unsigned count;
+		} slices = { &fn, threadCount, count };
+
+		Parallel_Run(threadCount, [](void* context, unsigned threadIndex)
+		{
+			const Slices& slices = *static_cast<const Slices*>(context);
+
+			(*slices.fn)(threadIndex, Parallel_SliceBegin(threadIndex, slices.threadCount, slices.count), Parallel_SliceBegin(threadIndex + 1, slices.threadCount, slices.count));
+		}, &slices);
+	}
+}
+
+static inline void Parallel_AtomicMin(std::atomic<unsigned>* value, unsigned candidate)
+{
+	unsigned cur = value->load(std::memory_order_relaxed);
+
+	while (candidate < cur && !value->compare_exchange_weak(cur, candidate, std::memory_order_relaxed));
+}
+
+static inline void Parallel_AtomicMax(std::atomic<unsigned>* value, unsigned candidate)
+{
+	unsigned cur = value->load(std::memory_order_relaxed);
+
+	while (candidate > cur && !value->compare_exchange_weak(cur, candidate, std::memory_order_relaxed));
+}
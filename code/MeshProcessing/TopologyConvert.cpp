@@ -0,0 +1,321 @@
+#include <atomic>
+#include <vector>
+#include "MeshProc/TopologyConvert.h"
+#include "Corners.h"
+#include "Parallel.h"
+#include "sanity.h"
+
+namespace
+{
+	using namespace mesh;
+
+	static constexpr unsigned FACE_NONE = (1u << 31) - 1;
+	static constexpr unsigned PARALLEL_MIN_TRIS = 1u << 15; // Below this, thread start up costs more than it saves
+
+	static unsigned LoopCount(const tri_edge::Topology& mesh)
+	{
+		return mesh.boundaryStarts.empty() ? 0 : static_cast<unsigned>(mesh.boundaryStarts.size() - 1);
+	}
+
+	namespace to_half_edge
+	{
+		// The first corner of an edge in corner order gets its even half edge, as corners::PairCorners and
+		// half_edge::Construct number them
+		static unsigned EarlierPartner(const tri_edge::Topology& mesh, unsigned corner)
+		{
+			const tri_edge::SharedEdge edge = mesh.triNeighbors[corner / 3].edge[corner % 3];
+
+			if (edge.id == tri_edge::SharedEdge::NONE)
+				return corners::NONE;
+
+			const unsigned partner = edge.otherTriangle * 3 + edge.otherEdge;
+
+			return partner < corner ? partner : corners::NONE;
+		}
+
+		// Gives each corner its half edge. Edges are counted per slice first so every thread numbers its own.
+		static void NumberHalfEdges(const tri_edge::Topology& mesh, unsigned threadCount, std::vector<unsigned>* workSliceCounts, unsigned* outCornerHEs)
+		{
+			const unsigned cornerCount = static_cast<unsigned>(mesh.tris.size() * 3);
+			std::vector<unsigned>& sliceCounts = *workSliceCounts;
+
+			Parallel_For(threadCount, cornerCount, [&](unsigned threadIndex, unsigned begin, unsigned end)
+			{
+				unsigned halfEdge = sliceCounts[threadIndex] * 2;
+
+				for (unsigned corner = begin; corner < end; ++corner)
+				{
+					if (EarlierPartner(mesh, corner) == corners::NONE)
+					{
+						outCornerHEs[corner] = halfEdge;
+						halfEdge += 2;
+					}
+				}
+			});
+
+			Parallel_For(threadCount, cornerCount, [&](unsigned, unsigned begin, unsigned end)
+			{
+				for (unsigned corner = begin; corner < end; ++corner)
+				{
+					const unsigned partner = EarlierPartner(mesh, corner);
+
+					if (partner != corners::NONE)
+						outCornerHEs[corner] = outCornerHEs[partner] + 1;
+				}
+			});
+		}
+	}
+
+	namespace to_tri_edge
+	{
+		// Position of a real half edge within its triangle, counted from the half edge after the faceHalfEdges entry
+		static unsigned TriCorner(const half_edge::Topology& mesh, unsigned halfEdge)
+		{
+			const unsigned face = mesh.halfEdgeFaces[halfEdge].index;
+			const unsigned first = mesh.halfEdgeNexts[mesh.faceHalfEdges[half_edge::FaceType::REAL][face]];
+
+			if (halfEdge == first)
+				return face * 3;
+
+			return face * 3 + (halfEdge == mesh.halfEdgeNexts[first] ? 1 : 2);
+		}
+	}
+}
+
+namespace mesh
+{
+	void Convert(const tri_edge::Topology& mesh, half_edge::Topology* outMesh, const ConvertOptions& options)
+	{
+		using namespace mesh::half_edge;
+
+		const unsigned triCount = static_cast<unsigned>(mesh.tris.size());
+		const unsigned cornerCount = triCount * 3;
+		const unsigned vertCount = static_cast<unsigned>(mesh.verts.size());
+		const unsigned loopCount = LoopCount(mesh);
+		const unsigned threadCount = triCount < PARALLEL_MIN_TRIS ? 1 : Parallel_ThreadCount(options.threadCount);
+		const unsigned* const cornerVerts = mesh.tris.empty() ? nullptr : mesh.tris.data()->verts;
+		std::vector<unsigned> sliceCounts(threadCount + 1, 0);
+
+		Parallel_For(threadCount, cornerCount, [&](unsigned threadIndex, unsigned begin, unsigned end)
+		{
+			unsigned sliceEdgeCount = 0;
+
+			for (unsigned corner = begin; corner < end; ++corner)
+				sliceEdgeCount += to_half_edge::EarlierPartner(mesh, corner) == corners::NONE;
+
+			sliceCounts[threadIndex + 1] = sliceEdgeCount;
+		});
+
+		for (unsigned threadIndex = 0; threadIndex < threadCount; ++threadIndex)
+			sliceCounts[threadIndex + 1] += sliceCounts[threadIndex];
+
+		const unsigned halfEdgeCount = sliceCounts[threadCount] * 2;
+		std::vector<half_edge::Vert>& outVerts = outMesh->verts;
+		std::vector<unsigned>& outVertHEs = outMesh->vertHalfEdges;
+		std::vector<unsigned>& outFaceHEs = outMesh->faceHalfEdges[FaceType::REAL];
+		std::vector<unsigned>& outBoundaryHEs = outMesh->faceHalfEdges[FaceType::BOUNDARY];
+		std::vector<unsigned>& outHEVerts = outMesh->halfEdgeVerts;
+		std::vector<FaceIndex>& outHEFaces = outMesh->halfEdgeFaces;
+		std::vector<unsigned>& outHENexts = outMesh->halfEdgeNexts;
+		std::vector<std::atomic<unsigned>> vertLastCorners(threadCount == 1 ? 0 : vertCount);
+
+		outVerts.resize(vertCount);
+		for (unsigned vert = 0; vert < vertCount; ++vert)
+			outVerts[vert].id = mesh.verts[vert].id;
+
+		outVertHEs.resize(vertCount);
+		outFaceHEs.resize(triCount);
+		outBoundaryHEs.clear();
+		outHEVerts.resize(halfEdgeCount);
+		outHEFaces.resize(halfEdgeCount);
+		outHENexts.resize(halfEdgeCount);
+
+		// Every corner has its own half edge, so halfEdgeVerts has room to hold each corner's half edge until the
+		// links are written. Verts go in last, walking each face from its faceHalfEdges entry and setting the boundary
+		// twins of unshared edges on the way.
+		unsigned* const cornerHEs = outHEVerts.data();
+
+		to_half_edge::NumberHalfEdges(mesh, threadCount, &sliceCounts, cornerHEs);
+
+		Parallel_For(threadCount, triCount, [&](unsigned, unsigned begin, unsigned end)
+		{
+			for (unsigned triIndex = begin; triIndex < end; ++triIndex)
+			{
+				for (unsigned corner = triIndex * 3; corner < triIndex * 3 + 3; ++corner)
+				{
+					const unsigned halfEdge = cornerHEs[corner];
+
+					outHEFaces[halfEdge].index = triIndex;
+					outHEFaces[halfEdge].type = FaceType::REAL;
+					sanity(outHEFaces[halfEdge].index == triIndex && "FaceIndex::index overflow");
+
+					outHENexts[halfEdge] = cornerHEs[corners::NextCorner(corner)];
+
+					// A vert takes the half edge of its last corner
+					if (threadCount == 1)
+						outVertHEs[cornerVerts[corner]] = halfEdge;
+					else
+						Parallel_AtomicMax(&vertLastCorners[cornerVerts[corner]], corner);
+				}
+
+				outFaceHEs[triIndex] = cornerHEs[triIndex * 3 + 2];
+			}
+		});
+
+		if (threadCount != 1)
+		{
+			Parallel_For(threadCount, vertCount, [&](unsigned, unsigned begin, unsigned end)
+			{
+				for (unsigned vert = begin; vert < end; ++vert)
+					outVertHEs[vert] = cornerHEs[vertLastCorners[vert].load(std::memory_order_relaxed)];
+			});
+		}
+
+		// A boundary half edge is the twin of a boundary corner's and runs against the winding, so it is followed by the
+		// twin of the corner before it in the loop
+		Parallel_For(threadCount, loopCount, [&](unsigned, unsigned begin, unsigned end)
+		{
+			for (unsigned loop = begin; loop < end; ++loop)
+			{
+				const unsigned loopBegin = mesh.boundaryStarts[loop];
+				const unsigned loopEnd = mesh.boundaryStarts[loop + 1];
+
+				for (unsigned loopCorner = loopBegin, prevCorner = loopEnd - 1; loopCorner < loopEnd; prevCorner = loopCorner++)
+				{
+					const unsigned halfEdge = cornerHEs[mesh.boundaryCorners[loopCorner]] ^ 1;
+
+					outHEFaces[halfEdge] = FaceIndex{ FACE_NONE, FaceType::BOUNDARY };
+					outHENexts[halfEdge] = cornerHEs[mesh.boundaryCorners[prevCorner]] ^ 1;
+				}
+			}
+		});
+
+		Parallel_For(threadCount, triCount, [&](unsigned, unsigned begin, unsigned end)
+		{
+			for (unsigned triIndex = begin; triIndex < end; ++triIndex)
+			{
+				unsigned halfEdge = outFaceHEs[triIndex];
+
+				for (unsigned vertIndex = 0; vertIndex < 3; ++vertIndex)
+				{
+					halfEdge = outHENexts[halfEdge];
+					outHEVerts[halfEdge] = cornerVerts[triIndex * 3 + vertIndex];
+
+					if (mesh.triNeighbors[triIndex].edge[vertIndex].id == tri_edge::SharedEdge::NONE)
+						outHEVerts[halfEdge ^ 1] = cornerVerts[triIndex * 3 + (vertIndex + 1) % 3];
+				}
+			}
+		});
+
+		// Boundary faces are numbered by their lowest half edge, as half_edge::Construct numbers them
+		for (unsigned halfEdge = 0; halfEdge < halfEdgeCount; ++halfEdge)
+		{
+			if (outHEFaces[halfEdge].type == FaceType::BOUNDARY && outHEFaces[halfEdge].index == FACE_NONE)
+			{
+				const FaceIndex boundaryFace{ static_cast<unsigned>(outBoundaryHEs.size()), FaceType::BOUNDARY };
+				unsigned boundaryHE = halfEdge;
+
+				sanity(boundaryFace.index == outBoundaryHEs.size() && "FaceIndex::index overflow");
+				outBoundaryHEs.push_back(halfEdge);
+
+				do
+				{
+					outHEFaces[boundaryHE] = boundaryFace;
+					boundaryHE = outHENexts[boundaryHE];
+				} while (boundaryHE != halfEdge);
+			}
+		}
+	}
+
+	void Convert(const half_edge::Topology& mesh, tri_edge::Topology* outMesh, const ConvertOptions& options)
+	{
+		using namespace mesh::tri_edge;
+		using half_edge::FaceType;
+
+		const std::vector<unsigned>& faceHEs = mesh.faceHalfEdges[FaceType::REAL];
+		const std::vector<unsigned>& boundaryHEs = mesh.faceHalfEdges[FaceType::BOUNDARY];
+		const unsigned triCount = static_cast<unsigned>(faceHEs.size());
+		const unsigned vertCount = static_cast<unsigned>(mesh.verts.size());
+		const unsigned loopCount = static_cast<unsigned>(boundaryHEs.size());
+		const unsigned threadCount = triCount < PARALLEL_MIN_TRIS ? 1 : Parallel_ThreadCount(options.threadCount);
+		std::vector<tri_edge::Vert>& outVerts = outMesh->verts;
+		std::vector<Triangle>& outTris = outMesh->tris;
+		std::vector<TriangleNeighbors>& outNeighbors = outMesh->triNeighbors;
+		std::vector<unsigned>& outBoundaryCorners = outMesh->boundaryCorners;
+		std::vector<unsigned>& outBoundaryStarts = outMesh->boundaryStarts;
+
+		outVerts.resize(vertCount);
+		for (unsigned vert = 0; vert < vertCount; ++vert)
+			outVerts[vert].id = mesh.verts[vert].id;
+
+		outTris.resize(triCount);
+		outNeighbors.resize(triCount);
+
+		Parallel_For(threadCount, triCount, [&](unsigned, unsigned begin, unsigned end)
+		{
+			for (unsigned triIndex = begin; triIndex < end; ++triIndex)
+			{
+				unsigned halfEdge = faceHEs[triIndex];
+
+				for (unsigned vertIndex = 0; vertIndex < 3; ++vertIndex)
+				{
+					SharedEdge* const edge = outNeighbors[triIndex].edge + vertIndex;
+					const half_edge::FaceIndex twinFace = mesh.halfEdgeFaces[(halfEdge = mesh.halfEdgeNexts[halfEdge]) ^ 1];
+
+					outTris[triIndex].verts[vertIndex] = mesh.halfEdgeVerts[halfEdge];
+
+					if (twinFace.type == FaceType::BOUNDARY)
+					{
+						edge->id = SharedEdge::NONE;
+					}
+					else
+					{
+						const unsigned twinCorner = to_tri_edge::TriCorner(mesh, halfEdge ^ 1);
+
+						edge->otherTriangle = twinCorner / 3;
+						edge->otherEdge = twinCorner % 3;
+						sanity(edge->otherTriangle == twinCorner / 3 && "mesh::tri_edge::SharedEdge::otherTriangle overflow");
+					}
+				}
+
+				sanity(halfEdge == faceHEs[triIndex] && "Real face is not a triangle");
+			}
+		});
+
+		outBoundaryStarts.assign(loopCount + 1, 0);
+		Parallel_For(threadCount, loopCount, [&](unsigned, unsigned begin, unsigned end)
+		{
+			for (unsigned loop = begin; loop < end; ++loop)
+			{
+				unsigned halfEdge = boundaryHEs[loop];
+
+				do
+				{
+					++outBoundaryStarts[loop + 1];
+					halfEdge = mesh.halfEdgeNexts[halfEdge];
+				} while (halfEdge != boundaryHEs[loop]);
+			}
+		});
+
+		for (unsigned loop = 0; loop < loopCount; ++loop)
+			outBoundaryStarts[loop + 1] += outBoundaryStarts[loop];
+
+		// Boundary half edges run against the winding, so each loop is written back to front after its first corner
+		outBoundaryCorners.resize(outBoundaryStarts[loopCount]);
+		Parallel_For(threadCount, loopCount, [&](unsigned, unsigned begin, unsigned end)
+		{
+			for (unsigned loop = begin; loop < end; ++loop)
+			{
+				const unsigned loopBegin = outBoundaryStarts[loop];
+				const unsigned loopLength = outBoundaryStarts[loop + 1] - loopBegin;
+				unsigned halfEdge = boundaryHEs[loop];
+
+				for (unsigned step = 0; step < loopLength; ++step)
+				{
+					outBoundaryCorners[loopBegin + (loopLength - step) % loopLength] = to_tri_edge::TriCorner(mesh, halfEdge ^ 1);
+					halfEdge = mesh.halfEdgeNexts[halfEdge];
+				}
+			}
+		});
+	}
+}
@@ -1,97 +1,235 @@
 #include <algorithm>
-#include <unordered_map>
-#include <cassert>
 #include "MeshProc/TriEdge.h"
+#include "MeshProc/TopologyBuilder.h"
+#include "Corners.h"
 #include "sanity.h"
 
-namespace mesh
+namespace
 {
-	namespace tri_edge
+	using namespace mesh;
+	using namespace mesh::tri_edge;
+
+	static unsigned PrevCorner(unsigned corner)
+	{
+		return corner % 3 == 0 ? corner + 2 : corner - 1;
+	}
+
+	// Corner on the reverse of corner's edge, NONE on the boundary
+	template<typename IdT>
+	static unsigned PartnerCorner(const TopologyT<IdT>& mesh, unsigned corner)
+	{
+		const SharedEdgeT<IdT> edge = mesh.triNeighbors[corner / 3].edge[corner % 3];
+
+		return edge.id == SharedEdgeT<IdT>::NONE ? corners::NONE : static_cast<unsigned>(edge.otherTriangle * 3 + edge.otherEdge);
+	}
+
+	namespace singularity
 	{
-		bool Construct(const unsigned* indices, unsigned triCount, Topology* outMesh)
+		// An open fan ends on the one corner at its vert whose edge has no partner, so a vert with several such
+		// corners joins several fans. The first in corner order keeps the vert and the fans of the others move to new
+		// verts, found by rotating back from the boundary corner with partner(prev(corner)). Only boundary fans are
+		// walked, and verts joining closed fans alone are left as half_edge::Construct leaves them. Each vert ends
+		// with at most one boundary corner, which outVertBoundaryCorners receives.
+		template<typename IdT>
+		static void SplitSingularities(TopologyT<IdT>* inoutMesh, std::vector<unsigned>* workVertSplits, std::vector<unsigned>* outVertBoundaryCorners)
 		{
-			struct MappedEdge
-			{
-				uint32_t edgeIndex : 31;
-				uint32_t occupied : 1;
-			};
-
-			std::vector<Vert> outVerts;
-			std::vector<Triangle> outTris(triCount);
-			std::vector<TriangleNeighbors> outNeighbors(triCount, TriangleNeighbors{ {SharedEdge::NONE, SharedEdge::NONE, SharedEdge::NONE} });
-			std::unordered_map<uint64_t, SharedEdge> triEdges;
-			std::unordered_map<unsigned, unsigned> vertMap;
-
-			vertMap.reserve(triCount * 4);
-			for (unsigned triIndex = 0; triIndex < triCount; ++triIndex)
+			TopologyT<IdT>& mesh = *inoutMesh;
+			const unsigned triCount = static_cast<unsigned>(mesh.tris.size());
+			const unsigned vertCount = static_cast<unsigned>(mesh.verts.size());
+			unsigned* const cornerVerts = mesh.tris.empty() ? nullptr : mesh.tris.data()->verts;
+			std::vector<unsigned>& vertSplits = *workVertSplits;
+			std::vector<unsigned>& vertBoundaryCorners = *outVertBoundaryCorners;
+
+			vertSplits.assign(vertCount, 0);
+			vertBoundaryCorners.assign(vertCount, corners::NONE);
+
+			// Walked by triangle, so corners are visited in order without dividing each one by 3
+			for (unsigned tri = 0; tri < triCount; ++tri)
 			{
-				Triangle* const outTri = outTris.data() + triIndex;
-				const unsigned* const triIndices = indices + (triIndex * 3);
-
-				sanity(triIndices[0] != triIndices[1] && triIndices[1] != triIndices[2] && triIndices[2] != triIndices[0] && "Degenerate triangle detected");
+				const TriangleNeighborsT<IdT> neighbors = mesh.triNeighbors[tri];
 
-				for (unsigned vertIndex = 0; vertIndex < 3; ++vertIndex)
+				for (unsigned edge = 0; edge < 3; ++edge)
 				{
-					const unsigned realIndex = triIndices[vertIndex];
-					auto vertIt = vertMap.find(realIndex);
+					if (neighbors.edge[edge].id != SharedEdgeT<IdT>::NONE)
+						continue;
 
-					if (vertIt == vertMap.end())
+					const unsigned corner = tri * 3 + edge;
+					const unsigned vert = cornerVerts[corner];
+
+					if (vertBoundaryCorners[vert] == corners::NONE)
 					{
-						const Vert vert{ realIndex, 0 };
+						vertBoundaryCorners[vert] = corner;
+						continue;
+					}
 
-						sanity(vert.realIndex == realIndex && "mesh::tri_edge::Vert::realIndex overflow. Input tri index out of bounds [0, 1<<24) supported.");
+					const unsigned newVertIndex = static_cast<unsigned>(mesh.verts.size());
+					const unsigned splitIndex = ++vertSplits[vert];
+					VertT<IdT> newVert = mesh.verts[vert];
 
-						vertIt = vertMap.emplace(realIndex, static_cast<unsigned>(outVerts.size())).first;
-						outVerts.emplace_back(vert);
-					}
+					newVert.splitIndex = splitIndex;
+					sanity(newVert.splitIndex == splitIndex && "mesh::tri_edge::Vert::splitIndex overflow");
+					mesh.verts.push_back(newVert);
+					vertBoundaryCorners.push_back(corner);
 
-					outTri->verts[vertIndex] = vertIt->second;
+					for (unsigned fanCorner = corner; fanCorner != corners::NONE; fanCorner = PartnerCorner(mesh, PrevCorner(fanCorner)))
+						cornerVerts[fanCorner] = newVertIndex;
 				}
 			}
+		}
+	}
 
+	namespace boundary
+	{
+		// The boundary edge after a corner's leaves the vert the corner's edge ends on, and with verts split there is
+		// one. Loops are emitted from their lowest vert, clearing each vert's entry as its corner is taken.
+		template<typename IdT>
+		static void ExtractLoops(TopologyT<IdT>* inoutMesh, std::vector<unsigned>* inoutVertBoundaryCorners)
+		{
+			TopologyT<IdT>& mesh = *inoutMesh;
+			const unsigned vertCount = static_cast<unsigned>(mesh.verts.size());
+			const unsigned* const cornerVerts = mesh.tris.empty() ? nullptr : mesh.tris.data()->verts;
+			std::vector<unsigned>& vertBoundaryCorners = *inoutVertBoundaryCorners;
+			std::vector<unsigned>& boundaryCorners = mesh.boundaryCorners;
+			std::vector<unsigned>& boundaryStarts = mesh.boundaryStarts;
 
-			triEdges.reserve(triCount * 3);
-			for (unsigned triIndex = 0; triIndex < triCount; ++triIndex)
-			{
-				const unsigned* const triIndices = indices + (triIndex * 3);
-				TriangleNeighbors* const outTriNeighbors = outNeighbors.data() + triIndex;
+			boundaryCorners.clear();
+			boundaryStarts.assign(1, 0);
 
-				for (unsigned edgeIndex = 0; edgeIndex < 3; ++edgeIndex)
+			for (unsigned vert = 0; vert < vertCount; ++vert)
+			{
+				// Each corner's vert is the one the last corner's edge ended on, so only the next vert is looked up
+				for (unsigned corner = vertBoundaryCorners[vert], cornerVert = vert; corner != corners::NONE; )
 				{
-					const uint32_t aIndex = triIndices[edgeIndex];
-					const uint32_t bIndex = triIndices[(edgeIndex + 1) % 3];
-					const uint64_t otherEdgeId = (static_cast<uint64_t>(bIndex) << 32) | aIndex;
-					const auto otherEdgeIt = triEdges.find(otherEdgeId);
-					const SharedEdge thisTriEdge{ triIndex, edgeIndex};
+					const unsigned nextVert = cornerVerts[corners::NextCorner(corner)];
 
-					if (otherEdgeIt != triEdges.end())
-					{
-						SharedEdge otherEdge = otherEdgeIt->second;
-						TriangleNeighbors* const otherTriNeighbors = outNeighbors.data() + otherEdge.otherTriangle;
-						SharedEdge* const otherTriNeighborEdge = otherTriNeighbors->edge + otherEdge.otherEdge;
+					boundaryCorners.push_back(corner);
+					vertBoundaryCorners[cornerVert] = corners::NONE;
+					corner = vertBoundaryCorners[nextVert];
+					cornerVert = nextVert;
+				}
 
-						sanity(otherTriNeighborEdge->id == SharedEdge::NONE && "Non-manifold edge detected");
+				if (boundaryCorners.size() != boundaryStarts.back())
+					boundaryStarts.push_back(static_cast<unsigned>(boundaryCorners.size()));
+			}
+		}
+	}
 
-						outTriNeighbors->edge[edgeIndex] = otherEdge;
-						*otherTriNeighborEdge = thisTriEdge;
-					}
-					else
-					{
-						const uint64_t edgeId = (static_cast<uint64_t>(aIndex) << 32) | bIndex;
-						const bool inserted = triEdges.emplace(edgeId, thisTriEdge).second;
+	template<typename IdT>
+	static bool ConstructTopology(TopologyBuilder* builder, const unsigned* indices, unsigned triCount, bool freeScratch, TopologyT<IdT>* inoutMesh, half_edge::ValidateReport* optOutReport)
+	{
+		static_assert(sizeof(Triangle) == sizeof(unsigned) * 3, "Triangles are filled as a flat corner array");
 
-						sanity(inserted && "Non-manifold edge detected");
-					}
+		// One-off builds drop their scratch on failure as well
+		auto Fail = [&]()
+		{
+			if (freeScratch)
+				*builder = TopologyBuilder();
+
+			return false;
+		};
+		auto Reject = [&](half_edge::ValidateError error, unsigned element, const char* message)
+		{
+			if (optOutReport)
+				*optOutReport = half_edge::ValidateReport{ error, element, message };
+
+			return Fail();
+		};
+
+		// Corner ids are 32 bit for either id width
+		if (triCount > ~0u / 3)
+			return Reject(half_edge::ValidateError::BAD_SIZE, ~0u, "Corner count overflows 32 bits");
+
+		const unsigned cornerCount = triCount * 3;
+		std::vector<VertT<IdT>>& outVerts = inoutMesh->verts;
+		std::vector<Triangle>& outTris = inoutMesh->tris;
+		std::vector<TriangleNeighborsT<IdT>>& outNeighbors = inoutMesh->triNeighbors;
+		SharedEdgeT<IdT> noEdge;
+		noEdge.id = SharedEdgeT<IdT>::NONE;
+
+		outTris.resize(triCount);
+		outNeighbors.assign(triCount, TriangleNeighborsT<IdT>{ {noEdge, noEdge, noEdge} });
+		unsigned* const cornerVerts = outTris.empty() ? nullptr : outTris.data()->verts;
+
+		{
+			std::vector<unsigned>& vertIndices = builder->vertIndices;
+			const unsigned vertCount = corners::RemapVerts(indices, triCount, corners::MaxRealIndex<IdT>(), 1, builder, cornerVerts, &vertIndices, optOutReport);
+
+			if (vertCount == corners::NONE)
+				return Fail();
+
+			corners::FreeScratch(freeScratch, &builder->indexVertMap);
+
+			outVerts.resize(vertCount);
+			for (unsigned vertIndex = 0; vertIndex < vertCount; ++vertIndex)
+			{
+				VertT<IdT>* const vert = outVerts.data() + vertIndex;
+
+				vert->id = 0;
+				vert->realIndex = vertIndices[vertIndex];
+			}
+			corners::FreeScratch(freeScratch, &vertIndices);
+		}
+
+		{
+			std::vector<unsigned>& cornerPartners = builder->cornerPartners;
+
+			if (!corners::PairCorners(cornerVerts, cornerCount, static_cast<unsigned>(outVerts.size()), 1, builder, &cornerPartners, optOutReport))
+				return Fail();
+
+			corners::FreeScratch(freeScratch, &builder->workEdges);
+
+			for (unsigned corner = 0; corner < cornerCount; ++corner)
+			{
+				const unsigned otherCorner = cornerPartners[corner];
+
+				if (otherCorner != corners::NONE)
+				{
+					SharedEdgeT<IdT>* const thisTriEdge = outNeighbors[corner / 3].edge + corner % 3;
+					SharedEdgeT<IdT>* const otherTriEdge = outNeighbors[otherCorner / 3].edge + otherCorner % 3;
+
+					sanity(thisTriEdge->id == SharedEdgeT<IdT>::NONE && otherTriEdge->id == SharedEdgeT<IdT>::NONE && "Corner pairing let a non-manifold edge through");
+
+					thisTriEdge->otherTriangle = otherCorner / 3;
+					thisTriEdge->otherEdge = otherCorner % 3;
+					otherTriEdge->otherTriangle = corner / 3;
+					otherTriEdge->otherEdge = corner % 3;
+					sanity(otherTriEdge->otherTriangle == corner / 3 && "mesh::tri_edge::SharedEdge::otherTriangle overflow");
 				}
 			}
+		}
 
-			// TODO: Split singularities
+		corners::FreeScratch(freeScratch, &builder->cornerPartners);
 
-			outMesh->verts = std::move(outVerts);
-			outMesh->tris = std::move(outTris);
-			outMesh->triNeighbors = std::move(outNeighbors);
+		singularity::SplitSingularities(inoutMesh, &builder->vertIndices, &builder->vertBoundaryCorners);
+		corners::FreeScratch(freeScratch, &builder->vertIndices);
+		boundary::ExtractLoops(inoutMesh, &builder->vertBoundaryCorners);
+		corners::FreeScratch(freeScratch, &builder->vertBoundaryCorners);
 
-			return true;
+		return true;
+	}
+}
+
+namespace mesh
+{
+	namespace tri_edge
+	{
+		template<typename IdT>
+		bool Construct(const unsigned* indices, unsigned triCount, TopologyT<IdT>* outMesh, half_edge::ValidateReport* optOutReport)
+		{
+			TopologyBuilder builder;
+
+			return ConstructTopology(&builder, indices, triCount, true, outMesh, optOutReport);
 		}
+
+		template<typename IdT>
+		bool Construct(TopologyBuilder* builder, const unsigned* indices, unsigned triCount, TopologyT<IdT>* inoutMesh, half_edge::ValidateReport* optOutReport)
+		{
+			return ConstructTopology(builder, indices, triCount, false, inoutMesh, optOutReport);
+		}
+
+		template bool Construct(const unsigned*, unsigned, Topology*, half_edge::ValidateReport*);
+		template bool Construct(const unsigned*, unsigned, Topology64*, half_edge::ValidateReport*);
+		template bool Construct(TopologyBuilder*, const unsigned*, unsigned, Topology*, half_edge::ValidateReport*);
+		template bool Construct(TopologyBuilder*, const unsigned*, unsigned, Topology64*, half_edge::ValidateReport*);
 	}
 }
@@ -0,0 +1,464 @@
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "MeshProc/Weld.h"
+#include "Parallel.h"
+#include "sanity.h"
+
+namespace
+{
+	using namespace mesh;
+
+	static constexpr unsigned NONE = ~0u;
+	static constexpr unsigned PARALLEL_MIN_VERTS = 1u << 15; // Below this, thread start up costs more than it saves
+
+	// Each vert's cell hash sits above the vert in a 64 bit key, so sorting on the hash gathers cells into runs with
+	// their verts in increasing order.
+	namespace grid
+	{
+		static constexpr float MAX_CELL = static_cast<float>(1u << 30);
+
+		struct Grid
+		{
+			float mins[3];
+			float invCellSize;
+			float epsilon;
+		};
+
+		static Grid Setup(const float* verts, unsigned vertCount, float epsilon, unsigned threadCount)
+		{
+			std::vector<float> sliceBounds(threadCount * 6);
+
+			Parallel_For(threadCount, vertCount, [&](unsigned threadIndex, unsigned begin, unsigned end)
+			{
+				float* const bounds = sliceBounds.data() + threadIndex * 6;
+
+				for (unsigned axis = 0; axis < 3; ++axis)
+				{
+					bounds[axis] = FLT_MAX;
+					bounds[axis + 3] = -FLT_MAX;
+				}
+
+				for (unsigned vert = begin; vert < end; ++vert)
+				{
+					for (unsigned axis = 0; axis < 3; ++axis)
+					{
+						bounds[axis] = std::min(bounds[axis], verts[vert * 3ull + axis]);
+						bounds[axis + 3] = std::max(bounds[axis + 3], verts[vert * 3ull + axis]);
+					}
+				}
+			});
+
+			Grid grid{ { FLT_MAX, FLT_MAX, FLT_MAX }, 0.0f, epsilon };
+			float maxExtent = 0.0f;
+
+			for (unsigned axis = 0; axis < 3; ++axis)
+			{
+				float boundsMax = -FLT_MAX;
+
+				for (unsigned threadIndex = 0; threadIndex < threadCount; ++threadIndex)
+				{
+					grid.mins[axis] = std::min(grid.mins[axis], sliceBounds[threadIndex * 6 + axis]);
+					boundsMax = std::max(boundsMax, sliceBounds[threadIndex * 6 + axis + 3]);
+				}
+
+				maxExtent = std::max(maxExtent, boundsMax - grid.mins[axis]);
+			}
+
+			// Cells 8 epsilon wide put a vert's neighborhood in its own cell alone 42% of the time and in 2 cells on
+			// average, where 2 epsilon would always reach 8. Weld epsilons sit far below vert spacing, so the wider
+			// cells rarely hold more verts. Tiny epsilons widen cells instead of overflowing the cell coordinates.
+			if (epsilon > 0.0f)
+				grid.invCellSize = 1.0f / std::max(8.0f * epsilon, maxExtent / MAX_CELL);
+
+			return grid;
+		}
+
+		// Cell coordinate of an offset in cells, clamped so far off and NaN positions stay in range
+		static int64_t CellOf(float offset)
+		{
+			if (!(offset >= -1.0f))
+				offset = -1.0f;
+
+			const int64_t cell = static_cast<int64_t>(std::min(offset, MAX_CELL));
+
+			return cell - (offset < cell);
+		}
+
+		// Cells covering the verts within radius of position. Exact welding uses the position bits as cells, with
+		// -0 turned into 0 by the addition.
+		static void CellRange(const Grid& grid, const float* position, float radius, int64_t* outLow, int64_t* outHigh)
+		{
+			for (unsigned axis = 0; axis < 3; ++axis)
+			{
+				if (grid.epsilon > 0.0f)
+				{
+					outLow[axis] = CellOf((position[axis] - radius - grid.mins[axis]) * grid.invCellSize);
+					outHigh[axis] = CellOf((position[axis] + radius - grid.mins[axis]) * grid.invCellSize);
+				}
+				else
+				{
+					const float value = position[axis] + 0.0f;
+					uint32_t bits;
+
+					std::memcpy(&bits, &value, sizeof(bits));
+					outLow[axis] = outHigh[axis] = bits;
+				}
+			}
+		}
+
+		static uint32_t Hash(int64_t x, int64_t y, int64_t z)
+		{
+			uint64_t hash = static_cast<uint64_t>(x) * 0x9E3779B97F4A7C15ull ^ static_cast<uint64_t>(y) * 0xC2B2AE3D27D4EB4Full ^ static_cast<uint64_t>(z) * 0x165667B19E3779F9ull;
+
+			hash ^= hash >> 32;
+			hash *= 0xD6E8FEB86659FD93ull;
+			return static_cast<uint32_t>(hash >> 32);
+		}
+
+		static bool Equal(const float* a, const float* b)
+		{
+			return a[0] == b[0] && a[1] == b[1] && a[2] == b[2];
+		}
+
+		static bool Matches(const Grid& grid, const float* a, const float* b)
+		{
+			if (grid.epsilon > 0.0f)
+			{
+				const float x = a[0] - b[0];
+				const float y = a[1] - b[1];
+				const float z = a[2] - b[2];
+
+				return x * x + y * y + z * z <= grid.epsilon * grid.epsilon;
+			}
+
+			return Equal(a, b);
+		}
+	}
+
+	namespace sort
+	{
+		static constexpr unsigned RADIX_BITS = 11;
+		static constexpr unsigned RADIX_SIZE = 1u << RADIX_BITS;
+
+		// Stable sort of (hash << 32 | vert) keys on their hash. Slices count and scatter their own keys and each
+		// bucket is laid out slice by slice, which keeps the order identical for any thread count.
+		static void SortByHash(unsigned threadCount, std::vector<uint64_t>* inoutKeys, std::vector<uint64_t>* scratch)
+		{
+			const unsigned count = static_cast<unsigned>(inoutKeys->size());
+			std::vector<unsigned> sliceStarts(threadCount * RADIX_SIZE);
+
+			scratch->resize(count);
+			for (unsigned shift = 32; shift < 64; shift += RADIX_BITS)
+			{
+				Parallel_For(threadCount, count, [&](unsigned threadIndex, unsigned begin, unsigned end)
+				{
+					unsigned* const counts = sliceStarts.data() + threadIndex * RADIX_SIZE;
+
+					std::fill(counts, counts + RADIX_SIZE, 0);
+					for (unsigned index = begin; index < end; ++index)
+						++counts[((*inoutKeys)[index] >> shift) & (RADIX_SIZE - 1)];
+				});
+
+				unsigned offset = 0;
+
+				for (unsigned bucket = 0; bucket < RADIX_SIZE; ++bucket)
+				{
+					for (unsigned threadIndex = 0; threadIndex < threadCount; ++threadIndex)
+					{
+						const unsigned bucketCount = sliceStarts[threadIndex * RADIX_SIZE + bucket];
+
+						sliceStarts[threadIndex * RADIX_SIZE + bucket] = offset;
+						offset += bucketCount;
+					}
+				}
+
+				Parallel_For(threadCount, count, [&](unsigned threadIndex, unsigned begin, unsigned end)
+				{
+					unsigned* const starts = sliceStarts.data() + threadIndex * RADIX_SIZE;
+
+					for (unsigned index = begin; index < end; ++index)
+					{
+						const uint64_t key = (*inoutKeys)[index];
+
+						(*scratch)[starts[(key >> shift) & (RADIX_SIZE - 1)]++] = key;
+					}
+				});
+
+				inoutKeys->swap(*scratch);
+			}
+		}
+	}
+
+	namespace weld
+	{
+		static uint32_t KeyHash(uint64_t key)
+		{
+			return static_cast<uint32_t>(key >> 32);
+		}
+
+		// Sorted keys with a directory over the top bits of their hashes, which finds a cell's run in a bucket of
+		// about two keys
+		struct CellTable
+		{
+			std::vector<uint64_t> keys;
+			std::vector<unsigned> bucketStarts;
+			unsigned bucketBits;
+
+			unsigned Bucket(uint32_t hash) const { return hash >> (32 - bucketBits); }
+		};
+
+		static void BuildTable(const float* verts, unsigned vertCount, const grid::Grid& grid, unsigned threadCount, CellTable* outTable)
+		{
+			std::vector<uint64_t>& keys = outTable->keys;
+			std::vector<uint64_t> sortScratch;
+
+			keys.resize(vertCount);
+			Parallel_For(threadCount, vertCount, [&](unsigned, unsigned begin, unsigned end)
+			{
+				for (unsigned vert = begin; vert < end; ++vert)
+				{
+					int64_t low[3], high[3];
+
+					grid::CellRange(grid, verts + vert * 3ull, 0.0f, low, high);
+					keys[vert] = (static_cast<uint64_t>(grid::Hash(low[0], low[1], low[2])) << 32) | vert;
+				}
+			});
+
+			sort::SortByHash(threadCount, &keys, &sortScratch);
+
+			// Exact welding never looks up other cells
+			if (!(grid.epsilon > 0.0f))
+				return;
+
+			unsigned& bucketBits = outTable->bucketBits;
+			std::vector<unsigned>& bucketStarts = outTable->bucketStarts;
+
+			for (bucketBits = 1; bucketBits < 24 && (2ull << bucketBits) <= vertCount; ++bucketBits);
+
+			bucketStarts.resize((1u << bucketBits) + 1);
+			Parallel_For(threadCount, vertCount, [&](unsigned, unsigned begin, unsigned end)
+			{
+				for (unsigned index = begin; index < end; ++index)
+				{
+					const unsigned first = index ? outTable->Bucket(KeyHash(keys[index - 1])) + 1 : 0;
+
+					for (unsigned bucket = first; bucket <= outTable->Bucket(KeyHash(keys[index])); ++bucket)
+						bucketStarts[bucket] = index;
+				}
+			});
+
+			for (unsigned bucket = outTable->Bucket(KeyHash(keys.back())) + 1; bucket < bucketStarts.size(); ++bucket)
+				bucketStarts[bucket] = vertCount;
+		}
+
+		// First key of the cell's run, or the key its run would start at when the cell holds no verts
+		static unsigned FindRun(const CellTable& table, uint32_t hash)
+		{
+			const unsigned bucket = table.Bucket(hash);
+			unsigned index = table.bucketStarts[bucket];
+
+			while (index < table.bucketStarts[bucket + 1] && KeyHash(table.keys[index]) < hash)
+				++index;
+
+			return index;
+		}
+
+		// Lowest numbered vert within epsilon, the vert itself when there is none below it
+		static unsigned FindParent(const float* verts, unsigned vert, const grid::Grid& grid, const CellTable& table)
+		{
+			const float* const position = verts + vert * 3ull;
+			int64_t low[3], high[3];
+			unsigned parent = vert;
+
+			grid::CellRange(grid, position, grid.epsilon, low, high);
+
+			for (int64_t z = low[2]; z <= high[2]; ++z)
+			{
+				for (int64_t y = low[1]; y <= high[1]; ++y)
+				{
+					for (int64_t x = low[0]; x <= high[0]; ++x)
+					{
+						const uint32_t hash = grid::Hash(x, y, z);
+
+						// Runs hold their verts in increasing order, so the first match is the lowest
+						for (unsigned index = FindRun(table, hash); index < table.keys.size() && KeyHash(table.keys[index]) == hash; ++index)
+						{
+							const unsigned other = static_cast<uint32_t>(table.keys[index]);
+
+							if (other >= parent)
+								break;
+
+							if (grid::Matches(grid, verts + other * 3ull, position))
+							{
+								parent = other;
+								break;
+							}
+						}
+					}
+				}
+			}
+
+			return parent;
+		}
+
+		// Identical positions share a cell, so exact welding only looks back through the vert's own run
+		static unsigned FindEqual(const float* verts, const uint64_t* runBegin, const uint64_t* key)
+		{
+			const unsigned vert = static_cast<uint32_t>(*key);
+
+			for (const uint64_t* other = runBegin; other < key; ++other)
+			{
+				if (grid::Equal(verts + static_cast<uint32_t>(*other) * 3ull, verts + vert * 3ull))
+					return static_cast<uint32_t>(*other);
+			}
+
+			return vert;
+		}
+
+		// Exact welding walks the sorted keys run by run, each slice taking the runs that start inside it, and never
+		// looks anything up. Otherwise verts go in soup order, reading their own positions in order.
+		static void FindParents(const float* verts, const grid::Grid& grid, const CellTable& table, unsigned threadCount, unsigned* outParents)
+		{
+			const std::vector<uint64_t>& keys = table.keys;
+
+			if (grid.epsilon > 0.0f)
+			{
+				Parallel_For(threadCount, static_cast<unsigned>(keys.size()), [&](unsigned, unsigned begin, unsigned end)
+				{
+					for (unsigned vert = begin; vert < end; ++vert)
+						outParents[vert] = FindParent(verts, vert, grid, table);
+				});
+
+				return;
+			}
+
+			Parallel_For(threadCount, static_cast<unsigned>(keys.size()), [&](unsigned, unsigned begin, unsigned end)
+			{
+				while (begin && begin < end && KeyHash(keys[begin]) == KeyHash(keys[begin - 1]))
+					++begin;
+
+				for (unsigned runBegin = begin; runBegin < end; )
+				{
+					unsigned runEnd = runBegin + 1;
+
+					while (runEnd < keys.size() && KeyHash(keys[runEnd]) == KeyHash(keys[runBegin]))
+						++runEnd;
+
+					for (unsigned index = runBegin; index < runEnd; ++index)
+						outParents[static_cast<uint32_t>(keys[index])] = FindEqual(verts, keys.data() + runBegin, keys.data() + index);
+
+					runBegin = runEnd;
+				}
+			});
+		}
+	}
+}
+
+namespace mesh
+{
+	unsigned WeldSoup(const float* soupVerts, unsigned triCount, std::vector<unsigned>* outIndices, std::vector<float>* outPositions, const WeldOptions& options)
+	{
+		sanity(triCount <= NONE / 3 && "Soup too large for 32 bit indices");
+		sanity(options.epsilon >= 0.0f && "Negative weld epsilon");
+
+		const unsigned vertCount = triCount * 3;
+		const unsigned threadCount = vertCount < PARALLEL_MIN_VERTS ? 1 : Parallel_ThreadCount(options.threadCount);
+
+		outIndices->clear();
+		outPositions->clear();
+
+		if (!triCount)
+			return 0;
+
+		const grid::Grid grid = grid::Setup(soupVerts, vertCount, options.epsilon, threadCount);
+		weld::CellTable table;
+		std::vector<unsigned> parents(vertCount);
+
+		weld::BuildTable(soupVerts, vertCount, grid, threadCount, &table);
+
+		weld::FindParents(soupVerts, grid, table, threadCount, parents.data());
+
+		// Parents are lower numbered, so resolving in order finds each parent's root already in place
+		for (unsigned vert = 0; vert < vertCount; ++vert)
+			parents[vert] = parents[parents[vert]];
+
+		// Roots are numbered in soup order, which is first use order
+		std::vector<unsigned> sliceCounts(threadCount);
+		std::vector<unsigned> rootNumbers(vertCount, NONE);
+
+		table = weld::CellTable();
+		Parallel_For(threadCount, vertCount, [&](unsigned threadIndex, unsigned begin, unsigned end)
+		{
+			for (unsigned vert = begin; vert < end; ++vert)
+				sliceCounts[threadIndex] += parents[vert] == vert;
+		});
+
+		unsigned weldedCount = 0;
+
+		for (unsigned& count : sliceCounts)
+		{
+			const unsigned sliceCount = count;
+
+			count = weldedCount;
+			weldedCount += sliceCount;
+		}
+
+		outPositions->resize(weldedCount * 3ull);
+		Parallel_For(threadCount, vertCount, [&](unsigned threadIndex, unsigned begin, unsigned end)
+		{
+			unsigned number = sliceCounts[threadIndex];
+
+			for (unsigned vert = begin; vert < end; ++vert)
+			{
+				if (parents[vert] != vert)
+					continue;
+
+				std::copy(soupVerts + vert * 3ull, soupVerts + vert * 3ull + 3, outPositions->data() + number * 3ull);
+				rootNumbers[vert] = number++;
+			}
+		});
+
+		std::fill(sliceCounts.begin(), sliceCounts.end(), 0);
+		Parallel_For(threadCount, triCount, [&](unsigned threadIndex, unsigned begin, unsigned end)
+		{
+			for (unsigned tri = begin; tri < end; ++tri)
+			{
+				const unsigned* const roots = parents.data() + tri * 3;
+
+				sliceCounts[threadIndex] += !options.dropCollapsed || (roots[0] != roots[1] && roots[1] != roots[2] && roots[2] != roots[0]);
+			}
+		});
+
+		unsigned keptCount = 0;
+
+		for (unsigned& count : sliceCounts)
+		{
+			const unsigned sliceCount = count;
+
+			count = keptCount;
+			keptCount += sliceCount;
+		}
+
+		outIndices->resize(keptCount * 3ull);
+		Parallel_For(threadCount, triCount, [&](unsigned threadIndex, unsigned begin, unsigned end)
+		{
+			unsigned* out = outIndices->data() + sliceCounts[threadIndex] * 3ull;
+
+			for (unsigned tri = begin; tri < end; ++tri)
+			{
+				const unsigned* const roots = parents.data() + tri * 3;
+
+				if (options.dropCollapsed && (roots[0] == roots[1] || roots[1] == roots[2] || roots[2] == roots[0]))
+					continue;
+
+				for (unsigned corner = 0; corner < 3; ++corner)
+					*out++ = rootNumbers[roots[corner]];
+			}
+		});
+
+		return weldedCount;
+	}
+}
@@ -1,3 +1,9 @@
 #pragma once
 
-#define sanity(X) if(!(X)) __debugbreak();
+#if defined(_MSC_VER)
+#define sanity_break() __debugbreak()
+#else
+#define sanity_break() __builtin_trap()
+#endif
+
+#define sanity(X) if(!(X)) sanity_break();